@@ -83,6 +83,8 @@ namespace benchmark {
 
     public:
         BenchRunner(std::string name, BenchFunction func);
+        //! Picks the benchmark out of same-named functions, like OpenSSL's SHA1/SHA256/SHA512
+        BenchRunner(std::string name, void (*func)(State&)) : BenchRunner(name, BenchFunction(func)) {}
 
         static void RunAll(duration elapsedTimeForOne = std::chrono::seconds(1));
     };
@@ -0,0 +1,91 @@
+// Copyright (c) 2021-2024 The DECENOMY Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "base58.h"
+#include "burnaddresses.h"
+#include "chainparams.h"
+#include "key.h"
+#include "primitives/transaction.h"
+#include "random.h"
+#include "script/standard.h"
+
+#include <map>
+#include <string>
+
+// The outputs of a heavy block: 1000 transactions of 10 outputs, mostly P2PKH
+// with some P2PK. The benches only time the burn address lookup of each output,
+// not the rest of the block connection
+static void GetBurnLookupOutputs(std::vector<CTransaction>& vtx, std::map<std::string, int>& mapAddresses)
+{
+    SelectParams(CBaseChainParams::MAIN);
+
+    FastRandomContext rng(true);
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript scriptP2PK = GetScriptForRawPubKey(key.GetPubKey());
+
+    for (int i = 0; i < 8; i++) {
+        mapAddresses[EncodeDestination(CKeyID(uint160(rng.randbytes(20))))] = 0;
+    }
+
+    for (int i = 0; i < 1000; i++) {
+        CMutableTransaction mtx;
+        for (int j = 0; j < 10; j++) {
+            const CScript script = (j == 0) ? scriptP2PK : GetScriptForDestination(CKeyID(uint160(rng.randbytes(20))));
+            mtx.vout.emplace_back(CTxOut(1 * COIN, script));
+        }
+        vtx.emplace_back(mtx);
+    }
+}
+
+// The lookup as it was done, encoding the address of each output
+static void BurnLookupAddressString(benchmark::State& state)
+{
+    std::vector<CTransaction> vtx;
+    std::map<std::string, int> mapAddresses;
+    GetBurnLookupOutputs(vtx, mapAddresses);
+
+    CAmount nUnspendableValue = 0;
+    while (state.KeepRunning()) {
+        for (const CTransaction& tx : vtx) {
+            for (const CTxOut& out : tx.vout) {
+                CTxDestination source;
+                if (ExtractDestination(out.scriptPubKey, source)) {
+                    const std::string addr = EncodeDestination(source);
+                    if (mapAddresses.find(addr) != mapAddresses.end() &&
+                        mapAddresses.at(addr) < 1) {
+                        nUnspendableValue += out.nValue;
+                    }
+                }
+            }
+        }
+    }
+    assert(nUnspendableValue == 0);
+}
+
+static void BurnLookupScriptSet(benchmark::State& state)
+{
+    std::vector<CTransaction> vtx;
+    std::map<std::string, int> mapAddresses;
+    GetBurnLookupOutputs(vtx, mapAddresses);
+    CBurnAddresses burnAddresses;
+    burnAddresses.Init(mapAddresses);
+
+    CAmount nUnspendableValue = 0;
+    while (state.KeepRunning()) {
+        for (const CTransaction& tx : vtx) {
+            for (const CTxOut& out : tx.vout) {
+                if (burnAddresses.IsBurned(out.scriptPubKey, 1)) {
+                    nUnspendableValue += out.nValue;
+                }
+            }
+        }
+    }
+    assert(nUnspendableValue == 0);
+}
+
+BENCHMARK(BurnLookupAddressString);
+BENCHMARK(BurnLookupScriptSet);
@@ -0,0 +1,63 @@
+// Copyright (c) 2021-2024 The DECENOMY Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "kernel.h"
+#include "uint256.h"
+
+// A kernel message as staked with the v2 stake modifier, each iteration
+// probes one time slot against a target that is never met
+static void GetKernelParts(CDataStream& stakeModifier, int& nTimeBlockFrom, CDataStream& stakeUniqueness)
+{
+    stakeModifier << uint256S("0x2f39dd3eecf11bd4b1b3e1cdb7ad74d87d9bc7a0c72cf3e44f8c24a1bd8bfb4c");
+    nTimeBlockFrom = 1600000000;
+    stakeUniqueness << (unsigned int) 1 << uint256S("0x7e35a84a2e3c81c4a5b3a3f0e4b6c92d1a7f1f3c2b9a8e7d6c5b4a3f2e1d0c9b");
+}
+
+// The kernel hash as it was computed, serializing the whole message for every slot
+static void StakeKernelProbeStream(benchmark::State& state)
+{
+    CDataStream stakeModifier(SER_GETHASH, 0);
+    CDataStream stakeUniqueness(SER_GETHASH, 0);
+    int nTimeBlockFrom;
+    GetKernelParts(stakeModifier, nTimeBlockFrom, stakeUniqueness);
+
+    int nTime = 1600100000;
+    bool fFound = false;
+    while (state.KeepRunning()) {
+        uint256 bnTarget;
+        bnTarget.SetCompact(0x1b0404cb);
+        bnTarget *= (uint256(1000) / 100);
+        CDataStream ss(stakeModifier);
+        ss << nTimeBlockFrom << stakeUniqueness << nTime++;
+        fFound |= Hash(ss.begin(), ss.end()) < bnTarget;
+    }
+    assert(!fFound);
+}
+
+static void StakeKernelProbeMidstate(benchmark::State& state)
+{
+    CDataStream stakeModifier(SER_GETHASH, 0);
+    CDataStream stakeUniqueness(SER_GETHASH, 0);
+    int nTimeBlockFrom;
+    GetKernelParts(stakeModifier, nTimeBlockFrom, stakeUniqueness);
+
+    uint256 bnTarget;
+    bnTarget.SetCompact(0x1b0404cb);
+    bnTarget *= (uint256(1000) / 100);
+    CDataStream ss(SER_GETHASH, 0);
+    ss << stakeModifier << nTimeBlockFrom << stakeUniqueness;
+    const CStakeKernelMidstate kernel(ss, bnTarget);
+
+    int nTime = 1600100000;
+    bool fFound = false;
+    while (state.KeepRunning()) {
+        fFound |= kernel.CheckKernelHash(nTime++);
+    }
+    assert(!fFound);
+}
+
+BENCHMARK(StakeKernelProbeStream);
+BENCHMARK(StakeKernelProbeMidstate);
@@ -0,0 +1,294 @@
+// Copyright (c) 2021-2024 The DECENOMY Core Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockindexsnapshot.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "clientversion.h"
+#include "hash.h"
+#include "main.h"
+#include "random.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+
+fs::path CBlockIndexSnapshot::GetPath()
+{
+    return GetDataDir() / "blocks" / "indexsnapshot.dat";
+}
+
+bool CBlockIndexSnapshot::Write()
+{
+    AssertLockHeld(cs_main);
+    const int64_t nStart = GetTimeMillis();
+
+    std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
+    vSortedByHeight.reserve(mapBlockIndex.size());
+    for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex)
+        vSortedByHeight.push_back(std::make_pair(item.second->nHeight, item.second));
+    std::sort(vSortedByHeight.begin(), vSortedByHeight.end());
+
+    // Generate random temporary filename
+    const fs::path path = GetPath();
+    unsigned short randv = 0;
+    GetRandBytes((unsigned char*)&randv, sizeof(randv));
+    fs::path pathTmp = path;
+    pathTmp += strprintf(".%04x", randv);
+
+    // open temp output file, and associate with CAutoFile
+    FILE* file = fsbridge::fopen(pathTmp, "wb");
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull())
+        return error("%s: Failed to open file %s", __func__, pathTmp.string());
+
+    const uint256 hashSnapshot = GetRandHash();
+    std::unordered_map<const CBlockIndex*, uint32_t> mapPositions;
+    mapPositions.reserve(vSortedByHeight.size());
+    std::vector<CBlockIndexSnapshotChunk> vChunks;
+    uint64_t nTablePos = 0;
+    try {
+        for (size_t nFirst = 0; nFirst < vSortedByHeight.size(); nFirst += CHUNK_ENTRIES) {
+            const size_t nEnd = std::min<size_t>(vSortedByHeight.size(), nFirst + CHUNK_ENTRIES);
+            CDataStream ssChunk(SER_DISK, CLIENT_VERSION);
+            for (size_t i = nFirst; i < nEnd; i++) {
+                const CBlockIndex* pindex = vSortedByHeight[i].second;
+                // a parent is always lower, so already written
+                uint32_t nPrev = NO_PARENT;
+                if (pindex->pprev) {
+                    auto it = mapPositions.find(pindex->pprev);
+                    if (it == mapPositions.end())
+                        return error("%s: Parent of block %s not in the block index", __func__, pindex->GetBlockHash().ToString());
+                    nPrev = it->second;
+                }
+                mapPositions.emplace(pindex, (uint32_t)i);
+                ssChunk << pindex->GetBlockHash();
+                ssChunk << nPrev;
+                ssChunk << CDiskBlockIndex(pindex);
+            }
+
+            CBlockIndexSnapshotChunk chunk;
+            chunk.nEntries = nEnd - nFirst;
+            chunk.nSize = ssChunk.size();
+            chunk.hash = Hash(ssChunk.begin(), ssChunk.end());
+            vChunks.push_back(chunk);
+            fileout << ssChunk;
+            nTablePos += chunk.nSize;
+        }
+
+        // the table of the chunks closes the file, with its checksum and its position
+        CDataStream ssTable(SER_DISK, CLIENT_VERSION);
+        ssTable << FLATDATA(Params().MessageStart());
+        ssTable << FILE_VERSION;
+        ssTable << hashSnapshot;
+        ssTable << (uint64_t)vSortedByHeight.size();
+        ssTable << vChunks;
+        uint256 hash = Hash(ssTable.begin(), ssTable.end());
+        fileout << ssTable;
+        fileout << hash;
+        fileout << nTablePos;
+    } catch (const std::exception& e) {
+        return error("%s: Serialize or I/O error - %s", __func__, e.what());
+    }
+    FileCommit(fileout.Get());
+    fileout.fclose();
+
+    // replace the existing file, if any, with the new one
+    if (!RenameOver(pathTmp, path))
+        return error("%s: Rename-into-place failed", __func__);
+
+    // until this is written, the database still refers to the previous snapshot, which no longer matches the file
+    if (!pblocktree->WriteBlockIndexSnapshot(hashSnapshot))
+        return error("%s: Failed to write the snapshot id to the block index database", __func__);
+
+    LogPrintf("%s: %u entries written in %dms\n", __func__, vSortedByHeight.size(), GetTimeMillis() - nStart);
+    return true;
+}
+
+bool CBlockIndexSnapshot::Load(std::vector<std::pair<int, CBlockIndex*> >& vSortedByHeight)
+{
+    const int64_t nStart = GetTimeMillis();
+    const fs::path path = GetPath();
+
+    uint256 hashExpected;
+    if (!pblocktree->ReadBlockIndexSnapshot(hashExpected)) {
+        LogPrintf("%s: No snapshot matches the block index database\n", __func__);
+        return false;
+    }
+
+    // open input file, and associate with CAutoFile
+    FILE* file = fsbridge::fopen(path, "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: Failed to open file %s", __func__, path.string());
+
+    uint64_t nTablePos = 0;
+    uint256 hashSnapshot;
+    uint64_t nEntries = 0;
+    std::vector<CBlockIndexSnapshotChunk> vChunks;
+    try {
+        // the position of the table of the chunks ends the file
+        if (fseek(filein.Get(), -(long)sizeof(nTablePos), SEEK_END))
+            return error("%s: Truncated file %s", __func__, path.string());
+        filein >> nTablePos;
+        if (fseek(filein.Get(), nTablePos, SEEK_SET))
+            return error("%s: Truncated file %s", __func__, path.string());
+
+        CHashVerifier<CAutoFile> verifier(&filein);
+        unsigned char pchMsgTmp[4];
+        int nVersion;
+        verifier >> FLATDATA(pchMsgTmp);
+        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
+            return error("%s: Invalid network magic number", __func__);
+        verifier >> nVersion;
+        if (nVersion != FILE_VERSION)
+            return error("%s: Unsupported version %d", __func__, nVersion);
+        verifier >> hashSnapshot;
+        verifier >> nEntries;
+        verifier >> vChunks;
+
+        uint256 hashIn;
+        filein >> hashIn;
+        if (hashIn != verifier.GetHash())
+            return error("%s: Checksum mismatch, data corrupted", __func__);
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+    filein.fclose();
+
+    if (hashSnapshot != hashExpected) {
+        LogPrintf("%s: The snapshot is older than the block index database\n", __func__);
+        return false;
+    }
+
+    // where each chunk starts in the file, and in the entries
+    std::vector<uint64_t> vChunkPos;
+    std::vector<size_t> vChunkFirst;
+    uint64_t nPos = 0;
+    size_t nCount = 0;
+    for (const CBlockIndexSnapshotChunk& chunk : vChunks) {
+        if (chunk.nEntries == 0)
+            return error("%s: Empty chunk", __func__);
+        vChunkPos.push_back(nPos);
+        vChunkFirst.push_back(nCount);
+        nPos += chunk.nSize;
+        nCount += chunk.nEntries;
+    }
+    if (nPos != nTablePos || nCount != nEntries || nEntries >= NO_PARENT)
+        return error("%s: The chunks don't match the table", __func__);
+    if (!mapBlockIndex.empty())
+        return error("%s: The block index is already loaded", __func__);
+
+    std::vector<CBlockIndex*> vIndex(nEntries);
+    for (size_t i = 0; i < vIndex.size(); i++)
+        vIndex[i] = blockIndexArena.New();
+    std::vector<uint256> vHashes(nEntries);
+
+    // Each thread reads, checks and fills the entries of the next chunk left,
+    // the parents are linked by position as their entries already exist
+    std::atomic<size_t> nNextChunk{0};
+    std::atomic<bool> fFailed{false};
+    auto loadChunks = [&]() {
+        FILE* file = fsbridge::fopen(path, "rb");
+        CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull()) {
+            fFailed = true;
+            return;
+        }
+        try {
+            for (size_t n = nNextChunk++; n < vChunks.size() && !fFailed; n = nNextChunk++) {
+                const CBlockIndexSnapshotChunk& chunk = vChunks[n];
+                if (fseek(filein.Get(), vChunkPos[n], SEEK_SET))
+                    throw std::runtime_error("seek failed");
+                CDataStream ssChunk(SER_DISK, CLIENT_VERSION);
+                ssChunk.resize(chunk.nSize);
+                filein.read(&ssChunk[0], chunk.nSize);
+                if (Hash(ssChunk.begin(), ssChunk.end()) != chunk.hash)
+                    throw std::runtime_error("checksum mismatch, data corrupted");
+
+                for (size_t i = vChunkFirst[n]; i < vChunkFirst[n] + chunk.nEntries; i++) {
+                    uint32_t nPrev;
+                    CDiskBlockIndex diskindex;
+                    ssChunk >> vHashes[i];
+                    ssChunk >> nPrev;
+                    ssChunk >> diskindex;
+                    if (nPrev != NO_PARENT && nPrev >= i)
+                        throw std::runtime_error("parent stored after its child");
+                    diskindex.CopyTo(vIndex[i]);
+                    vIndex[i]->pprev = nPrev == NO_PARENT ? nullptr : vIndex[nPrev];
+                }
+            }
+        } catch (const std::exception& e) {
+            LogPrintf("CBlockIndexSnapshot::Load: Deserialize or I/O error - %s\n", e.what());
+            fFailed = true;
+        }
+    };
+    const int nThreads = std::min<int>(std::max(1, nScriptCheckThreads), vChunks.size());
+    std::vector<std::thread> vThreads;
+    for (int i = 1; i < nThreads; i++)
+        vThreads.emplace_back(loadChunks);
+    loadChunks();
+    for (std::thread& t : vThreads)
+        t.join();
+
+    // Only the insertion in mapBlockIndex is left to a single thread, in height order
+    bool fValid = !fFailed;
+    size_t nInserted = 0;
+    if (fValid) {
+        mapBlockIndex.reserve(nEntries);
+        vSortedByHeight.reserve(nEntries);
+        for (; nInserted < nEntries; nInserted++) {
+            CBlockIndex* pindex = vIndex[nInserted];
+            if (nInserted > 0 && pindex->nHeight < vIndex[nInserted - 1]->nHeight) {
+                fValid = false;
+                break;
+            }
+            auto ret = mapBlockIndex.emplace(vHashes[nInserted], pindex);
+            if (!ret.second) {
+                fValid = false;
+                break;
+            }
+            pindex->phashBlock = &ret.first->first;
+            vSortedByHeight.push_back(std::make_pair(pindex->nHeight, pindex));
+        }
+    }
+
+    // The coins database and the block file info are written along the block index,
+    // a snapshot missing the blocks they refer to is stale and the database is loaded instead
+    if (fValid) {
+        const uint256 hashBestCoins = pcoinsTip->GetBestBlock();
+        if (!hashBestCoins.IsNull() && !mapBlockIndex.count(hashBestCoins)) {
+            LogPrintf("%s: The best block of the coins database %s is not in the snapshot\n", __func__, hashBestCoins.ToString());
+            fValid = false;
+        }
+    }
+    if (fValid) {
+        int nLastFile = 0;
+        CBlockFileInfo info;
+        pblocktree->ReadLastBlockFile(nLastFile);
+        if (pblocktree->ReadBlockFileInfo(nLastFile, info) && info.nBlocks > 0) {
+            fValid = std::any_of(vIndex.begin(), vIndex.end(), [&](const CBlockIndex* pindex) {
+                return (pindex->nStatus & BLOCK_HAVE_DATA) && pindex->nFile == nLastFile && pindex->nHeight == (int)info.nHeightLast;
+            });
+            if (!fValid)
+                LogPrintf("%s: The last block of the block file %d is not in the snapshot\n", __func__, nLastFile);
+        }
+    }
+    if (!fValid) {
+        for (size_t i = 0; i < nInserted; i++)
+            mapBlockIndex.erase(vHashes[i]);
+        for (CBlockIndex* pindex : vIndex)
+            blockIndexArena.Delete(pindex);
+        vSortedByHeight.clear();
+        return error("%s: Failed to load %s", __func__, path.string());
+    }
+
+    LogPrintf("%s: %u entries loaded in %dms with %d threads\n", __func__, nEntries, GetTimeMillis() - nStart, nThreads);
+    return true;
+}
@@ -0,0 +1,63 @@
+// Copyright (c) 2021-2024 The DECENOMY Core Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BLOCKINDEXSNAPSHOT_H
+#define BLOCKINDEXSNAPSHOT_H
+
+#include "fs.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <utility>
+#include <vector>
+
+class CBlockIndex;
+
+/** Consecutive entries of the snapshot, read and checksummed together */
+class CBlockIndexSnapshotChunk
+{
+public:
+    uint32_t nEntries;
+    uint64_t nSize;
+    uint256 hash;
+
+    CBlockIndexSnapshotChunk() : nEntries(0), nSize(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(nEntries);
+        READWRITE(nSize);
+        READWRITE(hash);
+    }
+};
+
+/**
+ * Flat copy of the block index database, sorted by height, where the parent of
+ * an entry is stored as its position in the file. Its chunks are loaded by
+ * several threads at once, without a hash lookup per parent nor a sort,
+ * instead of iterating the database at every start.
+ * The database keeps the id of the snapshot matching its content, any later
+ * write of the block index erases it and the database is loaded instead.
+ */
+class CBlockIndexSnapshot
+{
+public:
+    static const int FILE_VERSION = 1;
+    static const uint32_t CHUNK_ENTRIES = 16384;
+    static const uint32_t NO_PARENT = 0xffffffff;
+
+    static fs::path GetPath();
+
+    //! Writes every entry of mapBlockIndex, which must not have any entry left to flush to the database
+    static bool Write();
+
+    //! Loads the snapshot into an empty mapBlockIndex, returns false if it is missing, stale or corrupted,
+    //! or lacks the best block of pcoinsTip or the last block of the last block file
+    static bool Load(std::vector<std::pair<int, CBlockIndex*> >& vSortedByHeight);
+};
+
+#endif // BLOCKINDEXSNAPSHOT_H
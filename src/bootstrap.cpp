@@ -10,12 +10,27 @@
 
 #include "amount.h"
 #include "chainparams.h"
+#include "crypto/sha256.h"
 #include "curl.h"
 #include "guiinterface.h"
+#include "hash.h"
+#include "init.h"
+#include "messagesigner.h"
 #include "util.h"
+#include "utilstrencodings.h"
 #include "zip.h"
 
+#include <condition_variable>
+#include <deque>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#include <boost/algorithm/string.hpp>
 
 namespace fs = boost::filesystem;
 
@@ -52,12 +67,300 @@ int progressCallback(
     return 0;
 }
 
-bool CBootstrap::DownloadAndApply()
+namespace {
+
+/** File of the data directory recording how far a streamed bootstrap went */
+const char* const BOOTSTRAP_PROGRESS_FILENAME = "bootstrap.progress";
+/** Bytes of the archive downloaded ahead of its extraction */
+const size_t BOOTSTRAP_PIPE_SIZE = 16 * 1024 * 1024;
+/** Folders of the data directory a bootstrap writes to */
+const std::vector<std::string> BOOTSTRAP_FOLDERS = {"blocks", "chainstate", "sporks"};
+
+/** A file of the bootstrap, as listed in its manifest */
+struct CBootstrapFile
+{
+    std::string strHash;
+    uint64_t nSize;
+};
+
+/**
+ * Hands the bytes of the archive from the downloading thread over to the
+ * extracting one, holding at most nMaxBytes of them.
+ */
+class CBootstrapPipe
+{
+private:
+    const size_t nMaxBytes;
+    std::mutex cs;
+    std::condition_variable condWrite;
+    std::condition_variable condRead;
+    std::deque<std::vector<char> > queue;
+    size_t nBytes = 0;
+    size_t nFrontPos = 0;
+    //! no more bytes are written
+    bool fClosed = false;
+    //! no more bytes are read
+    bool fAborted = false;
+
+public:
+    explicit CBootstrapPipe(size_t nMaxBytesIn) : nMaxBytes(nMaxBytesIn) {}
+
+    /** Waits for room for the bytes, false if the reader is gone */
+    bool Write(const char* data, size_t n)
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        condWrite.wait(lock, [this] { return fAborted || nBytes < nMaxBytes; });
+        if (fAborted) return false;
+        queue.emplace_back(data, data + n);
+        nBytes += n;
+        condRead.notify_one();
+        return true;
+    }
+
+    /** Waits for bytes, 0 once the writer closed the pipe and all were read */
+    size_t Read(char* buf, size_t n)
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        condRead.wait(lock, [this] { return fClosed || !queue.empty(); });
+        if (queue.empty()) return 0;
+        const std::vector<char>& front = queue.front();
+        const size_t nChunk = std::min(n, front.size() - nFrontPos);
+        memcpy(buf, front.data() + nFrontPos, nChunk);
+        nFrontPos += nChunk;
+        nBytes -= nChunk;
+        if (nFrontPos == front.size()) {
+            queue.pop_front();
+            nFrontPos = 0;
+        }
+        condWrite.notify_one();
+        return nChunk;
+    }
+
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        fClosed = true;
+        condRead.notify_all();
+    }
+
+    void Abort()
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        fAborted = true;
+        condWrite.notify_all();
+    }
+};
+
+fs::path GetProgressPath()
+{
+    return GetDataDir() / BOOTSTRAP_PROGRESS_FILENAME;
+}
+
+/**
+ * The progress is a "<manifest hash> <offset>" line, followed by an
+ * "<offset> <path>" line appended after each extracted file: the download
+ * resumes from the last offset, and the paths are not extracted again.
+ */
+bool ReadProgress(std::string& strManifestHash, uint64_t& nOffset, std::set<std::string>& setExtracted)
+{
+    std::ifstream file(GetProgressPath().string());
+    std::string strLine;
+    if (!file.is_open() || !(file >> strManifestHash >> nOffset) || !std::getline(file, strLine)) return false;
+
+    setExtracted.clear();
+    // a line cut short by an interruption is not recorded, its file is extracted again
+    while (std::getline(file, strLine) && !file.eof()) {
+        std::stringstream ss(strLine);
+        uint64_t nFileOffset;
+        std::string strPath;
+        if (!(ss >> nFileOffset >> strPath)) break;
+        nOffset = nFileOffset;
+        setExtracted.insert(strPath);
+    }
+    return true;
+}
+
+bool WriteProgress(const std::string& strManifestHash, uint64_t nOffset, const std::set<std::string>& setExtracted)
+{
+    const fs::path path = GetProgressPath();
+    const fs::path pathTmp = path.string() + ".new";
+    {
+        std::ofstream file(pathTmp.string(), std::ios::trunc);
+        file << strManifestHash << " " << nOffset << "\n";
+        for (const std::string& strPath : setExtracted) {
+            file << nOffset << " " << strPath << "\n";
+        }
+        file.close();
+        if (file.fail()) return false;
+    }
+    return RenameOver(pathTmp, path);
+}
+
+// Only relative paths below the bootstrap folders are written to
+bool IsSafePath(const std::string& strPath)
+{
+    if (strPath.empty() || strPath[0] == '/' ||
+        strPath.find('\\') != std::string::npos || strPath.find(':') != std::string::npos) {
+        return false;
+    }
+
+    std::vector<std::string> vParts;
+    std::stringstream ss(strPath);
+    std::string strPart;
+    while (std::getline(ss, strPart, '/')) {
+        if (strPart == "." || strPart == "..") return false;
+        vParts.push_back(strPart);
+    }
+    return !vParts.empty() &&
+        std::find(BOOTSTRAP_FOLDERS.begin(), BOOTSTRAP_FOLDERS.end(), vParts[0]) != BOOTSTRAP_FOLDERS.end();
+}
+
+/**
+ * Checks the manifest, one "<sha256> <size> <path>" line per file followed by
+ * a "signature <base64>" line, signed with the spork key, and lists its files.
+ */
+bool ParseManifest(const std::string& strManifest, std::map<std::string, CBootstrapFile>& mapFilesRet)
+{
+    const std::string strTag = "signature ";
+    size_t nSignaturePos = strManifest.compare(0, strTag.size(), strTag) == 0 ? 0 : strManifest.find("\n" + strTag);
+    if (nSignaturePos == std::string::npos) {
+        LogPrintf("CBootstrap::%s: The manifest is not signed\n", __func__);
+        return false;
+    }
+    if (nSignaturePos > 0) nSignaturePos++;
+
+    const std::string strMessage = strManifest.substr(0, nSignaturePos);
+    bool fInvalid = false;
+    const std::vector<unsigned char> vchSig = DecodeBase64(boost::algorithm::trim_copy(strManifest.substr(nSignaturePos + strTag.size())).c_str(), &fInvalid);
+
+    const Consensus::Params& consensus = Params().GetConsensus();
+    std::string strError;
+    if (fInvalid ||
+        (!CMessageSigner::VerifyMessage(CPubKey(ParseHex(consensus.strSporkPubKey)), vchSig, strMessage, strError) &&
+         (consensus.strSporkPubKeyOld.empty() ||
+          !CMessageSigner::VerifyMessage(CPubKey(ParseHex(consensus.strSporkPubKeyOld)), vchSig, strMessage, strError)))) {
+        LogPrintf("CBootstrap::%s: Bad manifest signature %s\n", __func__, strError);
+        return false;
+    }
+
+    mapFilesRet.clear();
+    std::stringstream ss(strMessage);
+    std::string strLine;
+    while (std::getline(ss, strLine)) {
+        if (boost::algorithm::trim_copy(strLine).empty()) continue;
+
+        std::stringstream ssLine(strLine);
+        std::string strPath;
+        CBootstrapFile file;
+        if (!(ssLine >> file.strHash >> file.nSize >> strPath) ||
+            file.strHash.size() != CSHA256::OUTPUT_SIZE * 2 || !IsHex(file.strHash) ||
+            !IsSafePath(strPath) || IsDirectory(strPath)) {
+            LogPrintf("CBootstrap::%s: Bad manifest line: %s\n", __func__, strLine);
+            return false;
+        }
+        mapFilesRet[strPath] = file;
+    }
+
+    return !mapFilesRet.empty();
+}
+
+/**
+ * Extracts the archive read from the pipe into the data directory, checking
+ * each file against the manifest and recording the progress after it. Every
+ * file of the manifest must be extracted, each one once.
+ */
+bool ExtractStream(
+    CBootstrapPipe& pipe,
+    const std::map<std::string, CBootstrapFile>& mapFiles,
+    uint64_t nResumeOffset,
+    std::set<std::string>& setExtracted)
+{
+    const auto datadir = GetDataDir();
+
+    try {
+        std::ofstream progress(GetProgressPath().string(), std::ios::app);
+        if (!progress.is_open()) {
+            throw std::runtime_error("error opening the bootstrap progress");
+        }
+
+        CZipStreamReader zip([&pipe](char* buf, size_t n) { return pipe.Read(buf, n); });
+        std::vector<char> vBuffer(1024 * 1024);
+        std::string strName;
+        while (zip.NextEntry(strName)) {
+            if (ShutdownRequested()) {
+                LogPrintf("CBootstrap::%s: Shutdown requested while extracting the bootstrap\n", __func__);
+                return false;
+            }
+            if (!IsSafePath(strName)) {
+                throw std::runtime_error(strprintf("unexpected entry %s", strName));
+            }
+
+            const fs::path path = datadir / strName;
+            if (IsDirectory(strName)) {
+                fs::create_directories(path);
+                continue;
+            }
+
+            const auto it = mapFiles.find(strName);
+            if (it == mapFiles.end()) {
+                throw std::runtime_error(strprintf("%s is not in the manifest", strName));
+            }
+            if (!setExtracted.insert(strName).second) {
+                throw std::runtime_error(strprintf("%s is in the archive more than once", strName));
+            }
+
+            fs::create_directories(path.parent_path());
+            std::ofstream output(path.string(), std::ios::binary | std::ios::trunc);
+            if (!output.is_open()) {
+                throw std::runtime_error(strprintf("error creating output file %s", path.string()));
+            }
+
+            CSHA256 hasher;
+            uint64_t nSize = 0;
+            size_t nRead;
+            while ((nRead = zip.ReadEntry(vBuffer.data(), vBuffer.size())) > 0) {
+                output.write(vBuffer.data(), nRead);
+                hasher.Write((const unsigned char*)vBuffer.data(), nRead);
+                nSize += nRead;
+            }
+            output.close();
+            if (output.fail()) {
+                throw std::runtime_error(strprintf("error writing output file %s", path.string()));
+            }
+
+            unsigned char hash[CSHA256::OUTPUT_SIZE];
+            hasher.Finalize(hash);
+            if (nSize != it->second.nSize || HexStr(hash, hash + sizeof(hash)) != it->second.strHash) {
+                throw std::runtime_error(strprintf("%s does not match the manifest", strName));
+            }
+
+            progress << (nResumeOffset + zip.GetOffset()) << " " << strName << "\n";
+            progress.flush();
+            if (progress.fail()) {
+                throw std::runtime_error("error recording the bootstrap progress");
+            }
+            LogPrintf("CBootstrap::%s: Extracted file: %s\n", __func__, strName);
+        }
+
+        for (const auto& file : mapFiles) {
+            if (!setExtracted.count(file.first)) {
+                throw std::runtime_error(strprintf("%s of the manifest is not in the archive", file.first));
+            }
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("CBootstrap::%s: Error extracting the bootstrap: %s\n", __func__, e.what());
+        return false;
+    }
+
+    return true;
+}
+
+} // anon namespace
+
+// Downloads the whole bootstrap file, then extracts it, for the servers
+// that publish no manifest
+static bool DownloadAndExtract(const std::string& url)
 {
-    const auto url =
-        std::string(BOOTSTRAP_URL) +
-        (Params().IsTestNet() ? "T" : "") + std::string(CURRENCY_UNIT) +
-        "/bootstrap.zip";
     const auto datadir = GetDataDir();
     const auto fileName = datadir / extractFilenameFromURL(url);
     const auto blocks = datadir / "blocks";
@@ -119,3 +422,104 @@ bool CBootstrap::DownloadAndApply()
 
     return true;
 }
+
+// Downloads the archive and extracts its files as the bytes arrive,
+// verifying each one against the manifest
+static bool StreamAndApply(const std::string& url, const std::string& strManifest)
+{
+    std::map<std::string, CBootstrapFile> mapFiles;
+    if (!ParseManifest(strManifest, mapFiles)) {
+        return false;
+    }
+    const std::string strManifestHash = Hash(strManifest.begin(), strManifest.end()).GetHex();
+
+    std::string strProgressHash;
+    uint64_t nOffset = 0;
+    std::set<std::string> setExtracted;
+    if (ReadProgress(strProgressHash, nOffset, setExtracted) && strProgressHash == strManifestHash) {
+        LogPrintf("CBootstrap::%s: Resuming the bootstrap after %u files\n", __func__, setExtracted.size());
+    } else {
+        nOffset = 0;
+        setExtracted.clear();
+
+        // Cleanup the existing folders and files
+        const auto datadir = GetDataDir();
+        try {
+            for (const std::string& folder : BOOTSTRAP_FOLDERS) {
+                fs::remove_all(datadir / folder);
+            }
+            fs::remove_all(datadir / "banlist.dat");
+        } catch (const boost::filesystem::filesystem_error& e) {
+            LogPrintf("CBootstrap::%s: Error removing: %s\n", __func__, e.what());
+            return false;
+        }
+    }
+
+    // Rewritten whole, without a line an interruption cut short
+    if (!WriteProgress(strManifestHash, nOffset, setExtracted)) {
+        LogPrintf("CBootstrap::%s: Error recording the bootstrap progress\n", __func__);
+        return false;
+    }
+
+    // The archive is extracted on its own thread, the download goes on
+    // meanwhile, up to BOOTSTRAP_PIPE_SIZE bytes ahead
+    CBootstrapPipe pipe(BOOTSTRAP_PIPE_SIZE);
+    bool fExtracted = false;
+    std::thread threadExtract([&] {
+        util::ThreadRename("pivx-bootstrap");
+        fExtracted = ExtractStream(pipe, mapFiles, nOffset, setExtracted);
+        // Stops the download, past the last entry only the central directory is left
+        pipe.Abort();
+    });
+
+    CCurlWrapper::DownloadStream(
+        url, nOffset,
+        [&pipe](const char* data, size_t n) { return pipe.Write(data, n); },
+        progressCallback);
+    pipe.Close();
+    threadExtract.join();
+
+    if (!fExtracted) {
+        LogPrintf("CBootstrap::%s: The bootstrap is incomplete, it is resumed on the next start\n", __func__);
+        return false;
+    }
+
+    fs::remove(GetProgressPath());
+    return true;
+}
+
+bool CBootstrap::DownloadAndApply(std::string& strError)
+{
+    strError = _("Unable to download and apply the bootstrap file. See debug log for details.");
+
+    const auto url = GetArg("-bootstrapurl",
+        std::string(BOOTSTRAP_URL) +
+        (Params().IsTestNet() ? "T" : "") + std::string(CURRENCY_UNIT) +
+        "/bootstrap.zip");
+
+    // A signed manifest of the files allows to apply the archive while it
+    // is downloaded
+    std::string strManifest;
+    if (CCurlWrapper::DownloadString(url + ".manifest", strManifest)) {
+        return StreamAndApply(url, strManifest);
+    }
+
+    if (IsPending()) {
+        LogPrintf("CBootstrap::%s: The manifest is needed to resume the bootstrap\n", __func__);
+        strError = _("The manifest needed to resume the interrupted bootstrap could not be downloaded. Restart with -resync to discard the partial blockchain and sync from scratch.");
+        return false;
+    }
+
+    LogPrintf("CBootstrap::%s: No manifest found, downloading the whole bootstrap file\n", __func__);
+    return DownloadAndExtract(url);
+}
+
+bool CBootstrap::IsPending()
+{
+    return fs::exists(GetProgressPath());
+}
+
+void CBootstrap::ClearPending()
+{
+    fs::remove(GetProgressPath());
+}
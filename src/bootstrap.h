@@ -5,10 +5,18 @@
 #ifndef BOOTSTRAP_H
 #define BOOTSTRAP_H
 
+#include <string>
+
 class CBootstrap
 {
 public:
-    static bool DownloadAndApply();
+    /** Download the bootstrap and apply it, on failure strError is the reason shown to the user */
+    static bool DownloadAndApply(std::string& strError);
+
+    /** Whether a streamed bootstrap was interrupted, and is resumed on the next start */
+    static bool IsPending();
+    /** Forget an interrupted bootstrap, its partial data is left to be removed */
+    static void ClearPending();
 };
 
 #endif
@@ -0,0 +1,67 @@
+// Copyright (c) 2021-2024 The DECENOMY Core Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "burnaddresses.h"
+
+#include "base58.h"
+#include "script/standard.h"
+#include "util.h"
+
+CBurnAddresses g_burn_addresses;
+
+void CBurnAddresses::Init(const std::map<std::string, int>& mapAddresses)
+{
+    mapKeyIDs.clear();
+    mapScriptIDs.clear();
+
+    for (const auto& p : mapAddresses) {
+        const CTxDestination dest = DecodeDestination(p.first);
+        // Only the canonical encoding of an address was ever matched
+        if (!IsValidDestination(dest) || EncodeDestination(dest) != p.first) {
+            LogPrintf("%s : ignoring invalid burn address %s\n", __func__, p.first);
+            continue;
+        }
+        if (const CKeyID* keyID = boost::get<CKeyID>(&dest))
+            mapKeyIDs.emplace(*keyID, p.second);
+        else if (const CScriptID* scriptID = boost::get<CScriptID>(&dest))
+            mapScriptIDs.emplace(*scriptID, p.second);
+    }
+}
+
+static bool FindBurnHeight(const std::unordered_map<uint160, int, uint160CheapHasher>& mapIDs, const uint160& id, int& nHeightRet)
+{
+    const auto it = mapIDs.find(id);
+    if (it == mapIDs.end())
+        return false;
+    nHeightRet = it->second;
+    return true;
+}
+
+bool CBurnAddresses::GetBurnHeight(const CScript& scriptPubKey, int& nHeightRet) const
+{
+    if (empty())
+        return false;
+
+    // P2PKH and P2SH scripts carry the id in place
+    if (scriptPubKey.size() == 25 &&
+        scriptPubKey[0] == OP_DUP && scriptPubKey[1] == OP_HASH160 && scriptPubKey[2] == 20 &&
+        scriptPubKey[23] == OP_EQUALVERIFY && scriptPubKey[24] == OP_CHECKSIG) {
+        const uint160 id(std::vector<unsigned char>(scriptPubKey.begin() + 3, scriptPubKey.begin() + 23));
+        return FindBurnHeight(mapKeyIDs, id, nHeightRet);
+    }
+    if (scriptPubKey.IsPayToScriptHash()) {
+        const uint160 id(std::vector<unsigned char>(scriptPubKey.begin() + 2, scriptPubKey.begin() + 22));
+        return FindBurnHeight(mapScriptIDs, id, nHeightRet);
+    }
+
+    // Pay to pubkey and non canonical encodings go through the solver
+    CTxDestination dest;
+    if (!ExtractDestination(scriptPubKey, dest))
+        return false;
+    if (const CKeyID* keyID = boost::get<CKeyID>(&dest))
+        return FindBurnHeight(mapKeyIDs, *keyID, nHeightRet);
+    if (const CScriptID* scriptID = boost::get<CScriptID>(&dest))
+        return FindBurnHeight(mapScriptIDs, *scriptID, nHeightRet);
+    return false;
+}
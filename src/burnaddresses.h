@@ -0,0 +1,57 @@
+// Copyright (c) 2021-2024 The DECENOMY Core Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BURNADDRESSES_H
+#define BURNADDRESSES_H
+
+#include "uint256.h"
+
+#include <map>
+#include <string>
+#include <unordered_map>
+
+class CScript;
+
+struct uint160CheapHasher {
+    uint64_t operator()(const uint160& i) const {
+        return i.GetCheapHash();
+    }
+};
+
+/**
+ * The burn addresses of the consensus params, decoded once into their
+ * key and script ids. Matching an output is then a hash lookup on the
+ * bytes of its script, instead of building its base58 address string.
+ */
+class CBurnAddresses
+{
+private:
+    typedef std::unordered_map<uint160, int, uint160CheapHasher> BurnMap;
+    BurnMap mapKeyIDs;
+    BurnMap mapScriptIDs;
+
+public:
+    CBurnAddresses() {}
+
+    /** Decode the address strings, mapped to the height they are burned from */
+    void Init(const std::map<std::string, int>& mapAddresses);
+
+    bool empty() const { return mapKeyIDs.empty() && mapScriptIDs.empty(); }
+    size_t size() const { return mapKeyIDs.size() + mapScriptIDs.size(); }
+
+    /** Return true if scriptPubKey pays to a burn address, with its height in nHeightRet */
+    bool GetBurnHeight(const CScript& scriptPubKey, int& nHeightRet) const;
+
+    /** Return true if scriptPubKey pays to an address burned before nHeight */
+    bool IsBurned(const CScript& scriptPubKey, int nHeight) const
+    {
+        int nBurnHeight;
+        return GetBurnHeight(scriptPubKey, nBurnHeight) && nBurnHeight < nHeight;
+    }
+};
+
+/** Burn addresses of the selected chain, rebuilt by SelectParams */
+extern CBurnAddresses g_burn_addresses;
+
+#endif // BURNADDRESSES_H
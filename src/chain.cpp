@@ -6,8 +6,11 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "chain.h"
+#include "main.h"
 #include "masternode.h"
 #include "masternodeman.h"
+#include "memusage.h"
+#include "txdb.h"
 #include "legacy/stakemodifier.h"  // for ComputeNextStakeModifier
 
 
@@ -246,21 +249,71 @@ uint256 CBlockIndex::GetStakeModifierV2() const
 
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex);
 
-CScript* CBlockIndex::GetPaidPayee()
+namespace {
+
+//! (memory only) paid masternode of the blocks looked up, out of their index entries
+RecursiveMutex cs_paidPayees;
+boost::unordered_map<uint256, CScript, BlockHasher> mapPaidPayees;
+
+//! Remembered for the blocks known to pay no masternode, which a missing entry is not
+const CScript NO_PAID_PAYEE = CScript();
+
+} // anon namespace
+
+CScript CBlockIndex::GetPaidPayee()
 {
-    if(paidPayee == nullptr || paidPayee->empty()) {
+    const uint256 hash = GetBlockHash();
+    {
+        LOCK(cs_paidPayees);
+        auto it = mapPaidPayees.find(hash);
+        if (it != mapPaidPayees.end()) {
+            return it->second;
+        }
+    }
+
+    CScript payee = NO_PAID_PAYEE;
+    bool fKnown = false;
+    CDiskPayee diskPayee;
+    if (pblocktree && pblocktree->ReadPayeeIndex(nHeight, diskPayee) && diskPayee.hashBlock == hash) {
+        payee = diskPayee.payee;
+        fKnown = true;
+    } else {
         CBlock block;
         if (nHeight <= chainActive.Height() && ReadBlockFromDisk(block, this)) {
             auto amount = CMasternode::GetMasternodePayment(nHeight);
-            auto mnpayee = block.GetPaidPayee(amount);
-            
-            if(!mnpayee.empty()) {
-                paidPayee = new CScript(mnpayee);
+            payee = block.GetPaidPayee(amount);
+            fKnown = true;
+
+            // backfill the index for the blocks connected before it existed
+            if (pblocktree && chainActive.Contains(this)) {
+                pblocktree->WritePayeeIndex({std::make_pair(nHeight, CDiskPayee(hash, payee))});
             }
         }
     }
 
-    return paidPayee;
+    // a block not read yet is looked up again, one paying no masternode is not
+    if (fKnown) {
+        LOCK(cs_paidPayees);
+        mapPaidPayees.emplace(hash, payee);
+    }
+
+    return payee;
+}
+
+size_t CBlockIndex::GetPaidPayeesCount()
+{
+    LOCK(cs_paidPayees);
+    return mapPaidPayees.size();
+}
+
+size_t CBlockIndex::GetPaidPayeesUsage()
+{
+    LOCK(cs_paidPayees);
+    size_t nUsage = memusage::DynamicUsage(mapPaidPayees);
+    for (const auto& entry : mapPaidPayees) {
+        nUsage += memusage::DynamicUsage(entry.second);
+    }
+    return nUsage;
 }
 
 //! Check whether this block index entry is valid up to the passed validity level.
@@ -288,3 +341,30 @@ bool CBlockIndex::RaiseValidity(enum BlockStatus nUpTo)
 
 
 
+
+void* CBlockIndexArena::Allocate()
+{
+    if (!vFree.empty()) {
+        CBlockIndex* pindex = vFree.back();
+        vFree.pop_back();
+        return pindex;
+    }
+    if (nSlabUsed == SLAB_SIZE) {
+        vSlabs.emplace_back(new Slot[SLAB_SIZE]);
+        nSlabUsed = 0;
+    }
+    return &vSlabs.back()[nSlabUsed++];
+}
+
+void CBlockIndexArena::Delete(CBlockIndex* pindex)
+{
+    pindex->~CBlockIndex();
+    vFree.push_back(pindex);
+    nEntries--;
+}
+
+size_t CBlockIndexArena::DynamicMemoryUsage() const
+{
+    return vSlabs.size() * memusage::MallocUsage(SLAB_SIZE * sizeof(Slot)) +
+           memusage::DynamicUsage(vSlabs) + memusage::DynamicUsage(vFree);
+}
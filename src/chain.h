@@ -13,12 +13,15 @@
 
 #include "chainparams.h"
 #include "pow.h"
+#include "prevector.h"
 #include "primitives/block.h"
 #include "timedata.h"
 #include "tinyformat.h"
 #include "uint256.h"
 #include "util.h"
 
+#include <memory>
+#include <type_traits>
 #include <vector>
 
 class CBlockFileInfo
@@ -213,8 +216,8 @@ public:
 
     // proof-of-stake specific fields
     // char vector holding the stake modifier bytes. It is empty for PoW blocks.
-    // Modifier V1 is 64 bit while modifier V2 is 256 bit.
-    std::vector<unsigned char> vStakeModifier{};
+    // Modifier V1 is 64 bit while modifier V2 is 256 bit, both are stored inline.
+    prevector<32, unsigned char> vStakeModifier{};
     unsigned int nFlags{0};
 
     //! Money supply at this block.
@@ -231,9 +234,6 @@ public:
     //! (memory only) Sequential id assigned to distinguish order in which blocks are received.
     uint32_t nSequenceId{0};
 
-    //! (memory only) paid masternode.
-    CScript* paidPayee{nullptr};
-
     CBlockIndex() {}
     CBlockIndex(const CBlock& block);
 
@@ -263,7 +263,11 @@ public:
     void SetNewStakeModifier(const uint256& prevoutId);     // generates and sets new v2 modifier
     uint64_t GetStakeModifierV1() const;
     uint256 GetStakeModifierV2() const;
-    CScript* GetPaidPayee();
+    //! Paid masternode of this block, empty if none or unknown. Kept in an index aside, see GetPaidPayeesUsage
+    CScript GetPaidPayee();
+    //! Number of paid masternodes remembered, and their memory usage
+    static size_t GetPaidPayeesCount();
+    static size_t GetPaidPayeesUsage();
 
     //! Check whether this block index entry is valid up to the passed validity level.
     bool IsValid(enum BlockStatus nUpTo = BLOCK_VALID_TRANSACTIONS) const;
@@ -387,6 +391,28 @@ public:
         return block.GetHash();
     }
 
+    //! Copies the stored fields to an entry of mapBlockIndex, whose hash and parent are set by the caller
+    void CopyTo(CBlockIndex* pindex) const
+    {
+        pindex->nHeight = nHeight;
+        pindex->nFile = nFile;
+        pindex->nDataPos = nDataPos;
+        pindex->nUndoPos = nUndoPos;
+        pindex->nVersion = nVersion;
+        pindex->hashMerkleRoot = hashMerkleRoot;
+        pindex->nTime = nTime;
+        pindex->nBits = nBits;
+        pindex->nNonce = nNonce;
+        pindex->nStatus = nStatus;
+        pindex->nTx = nTx;
+
+        //Proof Of Stake
+        pindex->nFlags = nFlags;
+        pindex->vStakeModifier = vStakeModifier;
+
+        pindex->nMoneySupply = nMoneySupply;
+    }
+
 
     std::string ToString() const
     {
@@ -397,6 +423,45 @@ public:
     }
 };
 
+/**
+ * Allocates the block index entries in slabs, rather than one by one, and
+ * recycles the entries deleted. Not thread safe, the block index is guarded
+ * by cs_main.
+ */
+class CBlockIndexArena
+{
+private:
+    //! Entries per slab
+    static const size_t SLAB_SIZE = 4096;
+
+    typedef std::aligned_storage<sizeof(CBlockIndex), alignof(CBlockIndex)>::type Slot;
+
+    std::vector<std::unique_ptr<Slot[]> > vSlabs;
+    //! Slots handed out from the last slab
+    size_t nSlabUsed{SLAB_SIZE};
+    std::vector<CBlockIndex*> vFree;
+    size_t nEntries{0};
+
+    void* Allocate();
+
+public:
+    template <typename... Args>
+    CBlockIndex* New(Args&&... args)
+    {
+        CBlockIndex* pindex = new (Allocate()) CBlockIndex(std::forward<Args>(args)...);
+        nEntries++;
+        return pindex;
+    }
+
+    void Delete(CBlockIndex* pindex);
+
+    //! Number of live entries
+    size_t Size() const { return nEntries; }
+    //! Number of slabs allocated
+    size_t Slabs() const { return vSlabs.size(); }
+    size_t DynamicMemoryUsage() const;
+};
+
 /** An in-memory indexed chain of blocks. */
 class CChain
 {
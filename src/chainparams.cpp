@@ -7,6 +7,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "chainparams.h"
+#include "burnaddresses.h"
 
 #include "chainparamsseeds.h"
 #include "consensus/merkle.h"
@@ -471,6 +472,7 @@ void SelectParams(CBaseChainParams::Network network)
 {
     SelectBaseParams(network);
     pCurrentParams = &Params(network);
+    g_burn_addresses.Init(pCurrentParams->GetConsensus().mBurnAddresses);
 }
 
 bool SelectParamsFromCommandLine()
@@ -63,8 +63,12 @@ public:
 
     /** Make miner wait to have peers to avoid wasting work */
     bool MiningRequiresPeers() const { return !IsRegTestNet(); }
-    /** Headers first syncing is disabled */
-    bool HeadersFirstSyncingActive() const { return false; };
+    /**
+     * Headers first syncing, a regtest only scaffold: a proof of stake header
+     * received alone is only checked for difficulty, its kernel needs the
+     * coinstake, so it stays disabled on the networks with value.
+     */
+    bool HeadersFirstSyncingActive() const { return IsRegTestNet(); };
     /** Default value for -checkmempool and -checkblockindex argument */
     bool DefaultConsistencyChecks() const { return IsRegTestNet(); }
 
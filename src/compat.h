@@ -94,12 +94,13 @@ typedef u_int SOCKET;
 size_t strnlen( const char *start, size_t max_len);
 #endif // HAVE_DECL_STRNLEN
 
-bool static inline IsSelectableSocket(SOCKET s)
+//! Whether the socket can be waited for by select(), if fSelect, or by poll() and epoll otherwise
+bool static inline IsSelectableSocket(SOCKET s, bool fSelect = true)
 {
 #ifdef WIN32
     return true;
 #else
-    return (s < FD_SETSIZE);
+    return !fSelect || (s < FD_SETSIZE);
 #endif
 }
 
@@ -531,6 +531,22 @@ static const sph_u32 IV512[] = {
 
 #endif
 
+/*
+ * Optional replacement of the rounds, e.g. a vectorized implementation,
+ * set with sph_cubehash_set_rounds(). It applies 16 * n rounds to the
+ * state kept in the context.
+ */
+static void (*cubehash_rounds_impl)(sph_u32 *state, unsigned n) = 0;
+
+static void
+cubehash_input_block(sph_cubehash_context *sc)
+{
+	int i;
+
+	for (i = 0; i < 8; i ++)
+		sc->state[i] ^= sph_dec32le_aligned(sc->buf + (i << 2));
+}
+
 static void
 cubehash_init(sph_cubehash_context *sc, const sph_u32 *iv)
 {
@@ -554,6 +570,27 @@ cubehash_core(sph_cubehash_context *sc, const void *data, size_t len)
 		return;
 	}
 
+	if (cubehash_rounds_impl) {
+		while (len > 0) {
+			size_t clen;
+
+			clen = (sizeof sc->buf) - ptr;
+			if (clen > len)
+				clen = len;
+			memcpy(buf + ptr, data, clen);
+			ptr += clen;
+			data = (const unsigned char *)data + clen;
+			len -= clen;
+			if (ptr == sizeof sc->buf) {
+				cubehash_input_block(sc);
+				cubehash_rounds_impl(sc->state, 1);
+				ptr = 0;
+			}
+		}
+		sc->ptr = ptr;
+		return;
+	}
+
 	READ_STATE(sc);
 	while (len > 0) {
 		size_t clen;
@@ -590,19 +627,33 @@ cubehash_close(sph_cubehash_context *sc, unsigned ub, unsigned n,
 	z = 0x80 >> n;
 	buf[ptr ++] = ((ub & -z) | z) & 0xFF;
 	memset(buf + ptr, 0, (sizeof sc->buf) - ptr);
-	READ_STATE(sc);
-	INPUT_BLOCK;
-	for (i = 0; i < 11; i ++) {
-		SIXTEEN_ROUNDS;
-		if (i == 0)
-			xv ^= SPH_C32(1);
+	if (cubehash_rounds_impl) {
+		cubehash_input_block(sc);
+		cubehash_rounds_impl(sc->state, 1);
+		sc->state[31] ^= SPH_C32(1);
+		cubehash_rounds_impl(sc->state, 10);
+	} else {
+		READ_STATE(sc);
+		INPUT_BLOCK;
+		for (i = 0; i < 11; i ++) {
+			SIXTEEN_ROUNDS;
+			if (i == 0)
+				xv ^= SPH_C32(1);
+		}
+		WRITE_STATE(sc);
 	}
-	WRITE_STATE(sc);
 	out = dst;
 	for (z = 0; z < out_size_w32; z ++)
 		sph_enc32le(out + (z << 2), sc->state[z]);
 }
 
+/* see sph_cubehash.h */
+void
+sph_cubehash_set_rounds(void (*rounds)(sph_u32 *state, unsigned n))
+{
+	cubehash_rounds_impl = rounds;
+}
+
 /* see sph_cubehash.h */
 void
 sph_cubehash224_init(void *cc)
@@ -0,0 +1,70 @@
+// Copyright (c) 2021-2024 The DECENOMY Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// CubeHash rounds on AVX2 registers.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+namespace {
+
+template <int n>
+__m256i inline Rotl(__m256i x) { return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n)); }
+
+/**
+ * One round on the state split as a = x[0..7], b = x[8..15], c = x[16..23]
+ * and d = x[24..31]. The swaps of the specification are register renames
+ * or shuffles.
+ */
+void inline Round(__m256i& a, __m256i& b, __m256i& c, __m256i& d)
+{
+    c = _mm256_add_epi32(c, a);
+    d = _mm256_add_epi32(d, b);
+    // rotate the first half, then swap x_00klm with x_01klm
+    const __m256i t = Rotl<7>(a);
+    a = Rotl<7>(b);
+    b = t;
+    a = _mm256_xor_si256(a, c);
+    b = _mm256_xor_si256(b, d);
+    // swap x_1jk0m with x_1jk1m
+    c = _mm256_shuffle_epi32(c, 0x4e);
+    d = _mm256_shuffle_epi32(d, 0x4e);
+    c = _mm256_add_epi32(c, a);
+    d = _mm256_add_epi32(d, b);
+    // rotate the first half, then swap x_0j0lm with x_0j1lm
+    a = _mm256_permute4x64_epi64(Rotl<11>(a), 0x4e);
+    b = _mm256_permute4x64_epi64(Rotl<11>(b), 0x4e);
+    a = _mm256_xor_si256(a, c);
+    b = _mm256_xor_si256(b, d);
+    // swap x_1jkl0 with x_1jkl1
+    c = _mm256_shuffle_epi32(c, 0xb1);
+    d = _mm256_shuffle_epi32(d, 0xb1);
+}
+
+} // namespace
+
+namespace cubehash_avx2 {
+
+void Rounds(uint32_t* state, unsigned n)
+{
+    __m256i a = _mm256_loadu_si256((const __m256i*)(state + 0));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(state + 8));
+    __m256i c = _mm256_loadu_si256((const __m256i*)(state + 16));
+    __m256i d = _mm256_loadu_si256((const __m256i*)(state + 24));
+
+    for (unsigned i = 0; i < 16 * n; i++) {
+        Round(a, b, c, d);
+    }
+
+    _mm256_storeu_si256((__m256i*)(state + 0), a);
+    _mm256_storeu_si256((__m256i*)(state + 8), b);
+    _mm256_storeu_si256((__m256i*)(state + 16), c);
+    _mm256_storeu_si256((__m256i*)(state + 24), d);
+}
+
+}
+
+#endif
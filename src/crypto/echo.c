@@ -719,11 +719,21 @@ echo_small_compress(sph_echo_small_context *sc)
 	COMPRESS_SMALL(sc);
 }
 
+/*
+ * Optional replacement of the big compression function, e.g. using AES-NI,
+ * set with sph_echo_big_set_compress().
+ */
+static void (*echo_big_compress_impl)(sph_echo_big_context *sc) = 0;
+
 static void
 echo_big_compress(sph_echo_big_context *sc)
 {
 	DECL_STATE_BIG
 
+	if (echo_big_compress_impl) {
+		echo_big_compress_impl(sc);
+		return;
+	}
 	COMPRESS_BIG(sc);
 }
 
@@ -999,6 +1009,13 @@ sph_echo384_addbits_and_close(void *cc, unsigned ub, unsigned n, void *dst)
 	echo_big_close(cc, ub, n, dst, 12);
 }
 
+/* see sph_echo.h */
+void
+sph_echo_big_set_compress(void (*compress)(sph_echo_big_context *sc))
+{
+	echo_big_compress_impl = compress;
+}
+
 /* see sph_echo.h */
 void
 sph_echo512_init(void *cc)
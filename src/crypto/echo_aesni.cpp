@@ -0,0 +1,100 @@
+// Copyright (c) 2021-2024 The DECENOMY Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// ECHO-512 compression function using the AES instructions.
+
+#ifdef ENABLE_AESNI
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "crypto/sph_echo.h"
+
+namespace {
+
+/** Multiply each byte by 2 in GF(2^8) modulo the AES polynomial. */
+__m128i inline Mul2(__m128i x)
+{
+    const __m128i carry = _mm_and_si128(_mm_cmplt_epi8(x, _mm_setzero_si128()), _mm_set1_epi8(0x1b));
+    return _mm_xor_si128(_mm_add_epi8(x, x), carry);
+}
+
+void inline MixColumn(__m128i* w, int ia, int ib, int ic, int id)
+{
+    const __m128i a = w[ia], b = w[ib], c = w[ic], d = w[id];
+    const __m128i ab = _mm_xor_si128(a, b);
+    const __m128i bc = _mm_xor_si128(b, c);
+    const __m128i cd = _mm_xor_si128(c, d);
+    const __m128i abx = Mul2(ab);
+    const __m128i bcx = Mul2(bc);
+    const __m128i cdx = Mul2(cd);
+    w[ia] = _mm_xor_si128(abx, _mm_xor_si128(bc, d));
+    w[ib] = _mm_xor_si128(bcx, _mm_xor_si128(a, cd));
+    w[ic] = _mm_xor_si128(cdx, _mm_xor_si128(ab, d));
+    w[id] = _mm_xor_si128(_mm_xor_si128(abx, bcx), _mm_xor_si128(_mm_xor_si128(cdx, ab), c));
+}
+
+} // namespace
+
+namespace echo_aesni {
+
+void Compress(sph_echo_big_context* sc)
+{
+    const __m128i zero = _mm_setzero_si128();
+    unsigned char* v = (unsigned char*)sc->u.Vs;
+    __m128i w[16];
+
+    for (int i = 0; i < 8; i++) {
+        w[i] = _mm_loadu_si128((const __m128i*)(v + 16 * i));
+        w[i + 8] = _mm_loadu_si128((const __m128i*)(sc->buf + 16 * i));
+    }
+
+    // the 128-bit counter is the key of the first AES round of each word
+    uint64_t k0 = (uint64_t)sc->C0 | ((uint64_t)sc->C1 << 32);
+    uint64_t k1 = (uint64_t)sc->C2 | ((uint64_t)sc->C3 << 32);
+
+    for (int round = 0; round < 10; round++) {
+        // BIG.SubWords
+        for (int i = 0; i < 16; i++) {
+            w[i] = _mm_aesenc_si128(_mm_aesenc_si128(w[i], _mm_set_epi64x(k1, k0)), zero);
+            if (++k0 == 0) k1++;
+        }
+
+        // BIG.ShiftRows
+        __m128i t = w[1];
+        w[1] = w[5];
+        w[5] = w[9];
+        w[9] = w[13];
+        w[13] = t;
+        t = w[2];
+        w[2] = w[10];
+        w[10] = t;
+        t = w[6];
+        w[6] = w[14];
+        w[14] = t;
+        t = w[15];
+        w[15] = w[11];
+        w[11] = w[7];
+        w[7] = w[3];
+        w[3] = t;
+
+        // BIG.MixColumns
+        MixColumn(w, 0, 1, 2, 3);
+        MixColumn(w, 4, 5, 6, 7);
+        MixColumn(w, 8, 9, 10, 11);
+        MixColumn(w, 12, 13, 14, 15);
+    }
+
+    // BIG.Final
+    for (int i = 0; i < 8; i++) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(v + 16 * i));
+        x = _mm_xor_si128(x, _mm_loadu_si128((const __m128i*)(sc->buf + 16 * i)));
+        x = _mm_xor_si128(x, _mm_xor_si128(w[i], w[i + 8]));
+        _mm_storeu_si128((__m128i*)(v + 16 * i), x);
+    }
+}
+
+}
+
+#endif
@@ -2734,6 +2734,15 @@ static const sph_u32 T3dn[] = {
 
 #endif
 
+/*
+ * Optional replacements of the big compression function and output
+ * transformation, e.g. using AES-NI, set with sph_groestl_big_set_impl().
+ * They work on the state as bytes, so they are only used with the
+ * little-endian state layout.
+ */
+static void (*groestl_big_compress_impl)(unsigned char *h, const unsigned char *m) = 0;
+static void (*groestl_big_final_impl)(unsigned char *h) = 0;
+
 static void
 groestl_small_init(sph_groestl_small_context *sc, unsigned out_size)
 {
@@ -2932,6 +2941,11 @@ groestl_big_core(sph_groestl_big_context *sc, const void *data, size_t len)
 		data = (const unsigned char *)data + clen;
 		len -= clen;
 		if (ptr == sizeof sc->buf) {
+#if USE_LE
+			if (groestl_big_compress_impl)
+				groestl_big_compress_impl((unsigned char *)H, buf);
+			else
+#endif
 			COMPRESS_BIG;
 #if SPH_64
 			sc->count ++;
@@ -2995,6 +3009,11 @@ groestl_big_close(sph_groestl_big_context *sc,
 #endif
 	groestl_big_core(sc, pad, pad_len);
 	READ_STATE_BIG(sc);
+#if USE_LE
+	if (groestl_big_final_impl)
+		groestl_big_final_impl((unsigned char *)H);
+	else
+#endif
 	FINAL_BIG;
 #if SPH_GROESTL_64
 	for (u = 0; u < 8; u ++)
@@ -3091,6 +3110,15 @@ sph_groestl384_addbits_and_close(void *cc, unsigned ub, unsigned n, void *dst)
 	groestl_big_close(cc, ub, n, dst, 48);
 }
 
+/* see sph_groestl.h */
+void
+sph_groestl_big_set_impl(void (*compress)(unsigned char *h, const unsigned char *m),
+	void (*final)(unsigned char *h))
+{
+	groestl_big_compress_impl = compress;
+	groestl_big_final_impl = final;
+}
+
 /* see sph_groestl.h */
 void
 sph_groestl512_init(void *cc)
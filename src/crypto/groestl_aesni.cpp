@@ -0,0 +1,233 @@
+// Copyright (c) 2021-2024 The DECENOMY Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// Groestl-512 using the AES instructions, following the row-wise approach
+// of the AES-NI implementation submitted to the SHA-3 competition.
+
+#ifdef ENABLE_AESNI
+
+#include <stdint.h>
+#include <immintrin.h>
+
+namespace {
+
+/**
+ * The state is kept as its 8 rows of 16 bytes, so ShiftBytesWide rotates
+ * each register and MixBytes combines whole registers.
+ *
+ * SubBytes is AESENCLAST with a zero key, which also applies the AES
+ * ShiftRows; each shuffle below undoes it and rotates the row by the
+ * Groestl shift of its row at once: byte j takes the byte
+ * (ShiftRows^-1(j) + shift) % 16 of the row.
+ */
+alignas(16) const uint8_t SHUFFLE_P[8][16] = {
+    {0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03}, // 0
+    {0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04}, // 1
+    {0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05}, // 2
+    {0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06}, // 3
+    {0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07}, // 4
+    {0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08}, // 5
+    {0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09}, // 6
+    {0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e}, // 11
+};
+
+alignas(16) const uint8_t SHUFFLE_Q[8][16] = {
+    {0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04}, // 1
+    {0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06}, // 3
+    {0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08}, // 5
+    {0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e}, // 11
+    {0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03}, // 0
+    {0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05}, // 2
+    {0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07}, // 4
+    {0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09}, // 6
+};
+
+//! Column index times 16, the round constant of P before adding the round number
+alignas(16) const uint8_t COLUMNS[16] = {
+    0x00, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80, 0x90, 0xa0, 0xb0, 0xc0, 0xd0, 0xe0, 0xf0};
+
+//! Interleave the two 8-byte columns of a register
+alignas(16) const uint8_t INTERLEAVE[16] = {0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15};
+alignas(16) const uint8_t DEINTERLEAVE[16] = {0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15};
+
+__m128i inline Load(const uint8_t* p) { return _mm_load_si128((const __m128i*)p); }
+
+/** Multiply each byte by 2 in GF(2^8) modulo the AES polynomial. */
+__m128i inline __attribute__((always_inline)) Mul2(__m128i x)
+{
+    const __m128i carry = _mm_and_si128(_mm_cmplt_epi8(x, _mm_setzero_si128()), _mm_set1_epi8(0x1b));
+    return _mm_xor_si128(_mm_add_epi8(x, x), carry);
+}
+
+/** Transpose the 8x8 matrix of 16-bit words in r. */
+void inline Transpose16(__m128i* r)
+{
+    const __m128i t0 = _mm_unpacklo_epi16(r[0], r[1]);
+    const __m128i t1 = _mm_unpackhi_epi16(r[0], r[1]);
+    const __m128i t2 = _mm_unpacklo_epi16(r[2], r[3]);
+    const __m128i t3 = _mm_unpackhi_epi16(r[2], r[3]);
+    const __m128i t4 = _mm_unpacklo_epi16(r[4], r[5]);
+    const __m128i t5 = _mm_unpackhi_epi16(r[4], r[5]);
+    const __m128i t6 = _mm_unpacklo_epi16(r[6], r[7]);
+    const __m128i t7 = _mm_unpackhi_epi16(r[6], r[7]);
+    const __m128i u0 = _mm_unpacklo_epi32(t0, t2);
+    const __m128i u1 = _mm_unpackhi_epi32(t0, t2);
+    const __m128i u2 = _mm_unpacklo_epi32(t1, t3);
+    const __m128i u3 = _mm_unpackhi_epi32(t1, t3);
+    const __m128i u4 = _mm_unpacklo_epi32(t4, t6);
+    const __m128i u5 = _mm_unpackhi_epi32(t4, t6);
+    const __m128i u6 = _mm_unpacklo_epi32(t5, t7);
+    const __m128i u7 = _mm_unpackhi_epi32(t5, t7);
+    r[0] = _mm_unpacklo_epi64(u0, u4);
+    r[1] = _mm_unpackhi_epi64(u0, u4);
+    r[2] = _mm_unpacklo_epi64(u1, u5);
+    r[3] = _mm_unpackhi_epi64(u1, u5);
+    r[4] = _mm_unpacklo_epi64(u2, u6);
+    r[5] = _mm_unpackhi_epi64(u2, u6);
+    r[6] = _mm_unpacklo_epi64(u3, u7);
+    r[7] = _mm_unpackhi_epi64(u3, u7);
+}
+
+/** Load the 16 columns of 8 bytes into 8 rows of 16 bytes. */
+void inline ToRows(__m128i* r, const unsigned char* in)
+{
+    const __m128i interleave = Load(INTERLEAVE);
+    for (int i = 0; i < 8; i++) {
+        r[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 16 * i)), interleave);
+    }
+    Transpose16(r);
+}
+
+/** Store the 8 rows of 16 bytes back as 16 columns of 8 bytes. */
+void inline FromRows(unsigned char* out, __m128i* r)
+{
+    const __m128i deinterleave = Load(DEINTERLEAVE);
+    Transpose16(r);
+    for (int i = 0; i < 8; i++) {
+        _mm_storeu_si128((__m128i*)(out + 16 * i), _mm_shuffle_epi8(r[i], deinterleave));
+    }
+}
+
+/**
+ * MixBytes: multiply every column by the circulant matrix (2, 2, 3, 4, 5, 3, 5, 7).
+ * With t_i = a_i + a_{i+1}, x_i = t_i + t_{i+3} and y_i = a_{i+2} + t_{i+4} + t_{i+6},
+ * row i of the result is y_i + 2 * (y_{i+3} + 2 * x_{i+3}), as in the AES-NI
+ * implementation of the SHA-3 submission.
+ */
+void inline __attribute__((always_inline)) MixBytes(__m128i* r)
+{
+    const __m128i t0 = _mm_xor_si128(r[0], r[1]);
+    const __m128i t1 = _mm_xor_si128(r[1], r[2]);
+    const __m128i t2 = _mm_xor_si128(r[2], r[3]);
+    const __m128i t3 = _mm_xor_si128(r[3], r[4]);
+    const __m128i t4 = _mm_xor_si128(r[4], r[5]);
+    const __m128i t5 = _mm_xor_si128(r[5], r[6]);
+    const __m128i t6 = _mm_xor_si128(r[6], r[7]);
+    const __m128i t7 = _mm_xor_si128(r[7], r[0]);
+    const __m128i x0 = _mm_xor_si128(t0, t3);
+    const __m128i x1 = _mm_xor_si128(t1, t4);
+    const __m128i x2 = _mm_xor_si128(t2, t5);
+    const __m128i x3 = _mm_xor_si128(t3, t6);
+    const __m128i x4 = _mm_xor_si128(t4, t7);
+    const __m128i x5 = _mm_xor_si128(t5, t0);
+    const __m128i x6 = _mm_xor_si128(t6, t1);
+    const __m128i x7 = _mm_xor_si128(t7, t2);
+    const __m128i y0 = _mm_xor_si128(r[2], _mm_xor_si128(t4, t6));
+    const __m128i y1 = _mm_xor_si128(r[3], _mm_xor_si128(t5, t7));
+    const __m128i y2 = _mm_xor_si128(r[4], _mm_xor_si128(t6, t0));
+    const __m128i y3 = _mm_xor_si128(r[5], _mm_xor_si128(t7, t1));
+    const __m128i y4 = _mm_xor_si128(r[6], _mm_xor_si128(t0, t2));
+    const __m128i y5 = _mm_xor_si128(r[7], _mm_xor_si128(t1, t3));
+    const __m128i y6 = _mm_xor_si128(r[0], _mm_xor_si128(t2, t4));
+    const __m128i y7 = _mm_xor_si128(r[1], _mm_xor_si128(t3, t5));
+    r[0] = _mm_xor_si128(y0, Mul2(_mm_xor_si128(y3, Mul2(x3))));
+    r[1] = _mm_xor_si128(y1, Mul2(_mm_xor_si128(y4, Mul2(x4))));
+    r[2] = _mm_xor_si128(y2, Mul2(_mm_xor_si128(y5, Mul2(x5))));
+    r[3] = _mm_xor_si128(y3, Mul2(_mm_xor_si128(y6, Mul2(x6))));
+    r[4] = _mm_xor_si128(y4, Mul2(_mm_xor_si128(y7, Mul2(x7))));
+    r[5] = _mm_xor_si128(y5, Mul2(_mm_xor_si128(y0, Mul2(x0))));
+    r[6] = _mm_xor_si128(y6, Mul2(_mm_xor_si128(y1, Mul2(x1))));
+    r[7] = _mm_xor_si128(y7, Mul2(_mm_xor_si128(y2, Mul2(x2))));
+}
+
+void inline __attribute__((always_inline)) RoundP(__m128i* r, int round)
+{
+    r[0] = _mm_xor_si128(r[0], _mm_xor_si128(Load(COLUMNS), _mm_set1_epi8(round)));
+    const __m128i zero = _mm_setzero_si128();
+    r[0] = _mm_aesenclast_si128(_mm_shuffle_epi8(r[0], Load(SHUFFLE_P[0])), zero);
+    r[1] = _mm_aesenclast_si128(_mm_shuffle_epi8(r[1], Load(SHUFFLE_P[1])), zero);
+    r[2] = _mm_aesenclast_si128(_mm_shuffle_epi8(r[2], Load(SHUFFLE_P[2])), zero);
+    r[3] = _mm_aesenclast_si128(_mm_shuffle_epi8(r[3], Load(SHUFFLE_P[3])), zero);
+    r[4] = _mm_aesenclast_si128(_mm_shuffle_epi8(r[4], Load(SHUFFLE_P[4])), zero);
+    r[5] = _mm_aesenclast_si128(_mm_shuffle_epi8(r[5], Load(SHUFFLE_P[5])), zero);
+    r[6] = _mm_aesenclast_si128(_mm_shuffle_epi8(r[6], Load(SHUFFLE_P[6])), zero);
+    r[7] = _mm_aesenclast_si128(_mm_shuffle_epi8(r[7], Load(SHUFFLE_P[7])), zero);
+    MixBytes(r);
+}
+
+void inline __attribute__((always_inline)) RoundQ(__m128i* r, int round)
+{
+    const __m128i ones = _mm_set1_epi8((char)0xff);
+    r[0] = _mm_xor_si128(r[0], ones);
+    r[1] = _mm_xor_si128(r[1], ones);
+    r[2] = _mm_xor_si128(r[2], ones);
+    r[3] = _mm_xor_si128(r[3], ones);
+    r[4] = _mm_xor_si128(r[4], ones);
+    r[5] = _mm_xor_si128(r[5], ones);
+    r[6] = _mm_xor_si128(r[6], ones);
+    r[7] = _mm_xor_si128(r[7], _mm_xor_si128(_mm_xor_si128(Load(COLUMNS), ones), _mm_set1_epi8(round)));
+    const __m128i zero = _mm_setzero_si128();
+    r[0] = _mm_aesenclast_si128(_mm_shuffle_epi8(r[0], Load(SHUFFLE_Q[0])), zero);
+    r[1] = _mm_aesenclast_si128(_mm_shuffle_epi8(r[1], Load(SHUFFLE_Q[1])), zero);
+    r[2] = _mm_aesenclast_si128(_mm_shuffle_epi8(r[2], Load(SHUFFLE_Q[2])), zero);
+    r[3] = _mm_aesenclast_si128(_mm_shuffle_epi8(r[3], Load(SHUFFLE_Q[3])), zero);
+    r[4] = _mm_aesenclast_si128(_mm_shuffle_epi8(r[4], Load(SHUFFLE_Q[4])), zero);
+    r[5] = _mm_aesenclast_si128(_mm_shuffle_epi8(r[5], Load(SHUFFLE_Q[5])), zero);
+    r[6] = _mm_aesenclast_si128(_mm_shuffle_epi8(r[6], Load(SHUFFLE_Q[6])), zero);
+    r[7] = _mm_aesenclast_si128(_mm_shuffle_epi8(r[7], Load(SHUFFLE_Q[7])), zero);
+    MixBytes(r);
+}
+
+} // namespace
+
+namespace groestl_aesni {
+
+void Compress(unsigned char* h, const unsigned char* m)
+{
+    __m128i hr[8], p[8], q[8];
+    ToRows(hr, h);
+    ToRows(q, m);
+    for (int i = 0; i < 8; i++) {
+        p[i] = _mm_xor_si128(hr[i], q[i]);
+    }
+    // P and Q are independent, interleaving them keeps the AES unit busy
+    for (int round = 0; round < 14; round++) {
+        RoundP(p, round);
+        RoundQ(q, round);
+    }
+    for (int i = 0; i < 8; i++) {
+        hr[i] = _mm_xor_si128(hr[i], _mm_xor_si128(p[i], q[i]));
+    }
+    FromRows(h, hr);
+}
+
+void Final(unsigned char* h)
+{
+    __m128i hr[8], p[8];
+    ToRows(hr, h);
+    for (int i = 0; i < 8; i++) {
+        p[i] = hr[i];
+    }
+    for (int round = 0; round < 14; round++) {
+        RoundP(p, round);
+    }
+    for (int i = 0; i < 8; i++) {
+        hr[i] = _mm_xor_si128(hr[i], p[i]);
+    }
+    FromRows(h, hr);
+}
+
+}
+
+#endif
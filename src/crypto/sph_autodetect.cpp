@@ -0,0 +1,157 @@
+// Copyright (c) 2021-2024 The DECENOMY Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/sph_autodetect.h"
+
+#include "crypto/common.h"
+#include "crypto/sph_cubehash.h"
+#include "crypto/sph_echo.h"
+#include "crypto/sph_groestl.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
+#if defined(USE_ASM)
+#include <cpuid.h>
+#endif
+#endif
+
+namespace groestl_aesni
+{
+void Compress(unsigned char* h, const unsigned char* m);
+void Final(unsigned char* h);
+}
+
+namespace echo_aesni
+{
+void Compress(sph_echo_big_context* sc);
+}
+
+namespace cubehash_avx2
+{
+void Rounds(uint32_t* state, unsigned n);
+}
+
+namespace
+{
+/** Fill a buffer with a fixed pattern, long enough to span several blocks. */
+void SelfTestInput(unsigned char* data, size_t len)
+{
+    uint32_t x = 0x9e3779b9;
+    for (size_t i = 0; i < len; i++) {
+        x = x * 1103515245 + 12345;
+        data[i] = x >> 24;
+    }
+}
+
+typedef void (*SphInit)(void*);
+typedef void (*SphUpdate)(void*, const void*, size_t);
+typedef void (*SphClose)(void*, void*);
+
+/** Hash inputs of every length up to a few blocks, each in two parts. */
+template <typename Context>
+void SelfTestDigest(SphInit init, SphUpdate update, SphClose close, unsigned char* out)
+{
+    unsigned char data[300];
+    SelfTestInput(data, sizeof(data));
+    for (size_t len = 0; len <= sizeof(data); len += 13) {
+        Context ctx;
+        init(&ctx);
+        update(&ctx, data, len / 3);
+        update(&ctx, data + len / 3, len - len / 3);
+        close(&ctx, out + 64 * (len / 13));
+    }
+}
+
+const size_t SELFTEST_SIZE = 64 * (300 / 13 + 1);
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+/** Check whether the OS has enabled AVX registers. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+} // namespace
+
+std::string SphAutoDetect()
+{
+    std::string ret = "standard";
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+    bool have_sse4 = false;
+    bool have_aes = false;
+    bool have_avx2 = false;
+    bool enabled_avx = false;
+
+    (void)have_sse4;
+    (void)have_aes;
+    (void)have_avx2;
+    (void)enabled_avx;
+
+    uint32_t eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        have_sse4 = (ecx >> 19) & 1;
+        have_aes = (ecx >> 25) & 1;
+        const bool have_xsave = (ecx >> 27) & 1;
+        const bool have_avx = (ecx >> 28) & 1;
+        if (have_xsave && have_avx) {
+            enabled_avx = AVXEnabled();
+        }
+        if (__get_cpuid_max(0, nullptr) >= 7) {
+            __cpuid_count(7, 0, eax, ebx, ecx, edx);
+            have_avx2 = (ebx >> 5) & 1;
+        }
+    }
+
+    unsigned char expected[SELFTEST_SIZE], out[SELFTEST_SIZE];
+    std::string accelerated;
+
+#if defined(ENABLE_AESNI) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_aes && have_sse4) {
+        sph_groestl_big_set_impl(nullptr, nullptr);
+        SelfTestDigest<sph_groestl512_context>(sph_groestl512_init, sph_groestl512, sph_groestl512_close, expected);
+        sph_groestl_big_set_impl(groestl_aesni::Compress, groestl_aesni::Final);
+        SelfTestDigest<sph_groestl512_context>(sph_groestl512_init, sph_groestl512, sph_groestl512_close, out);
+        if (memcmp(expected, out, SELFTEST_SIZE) == 0) {
+            accelerated += ",groestl(aesni)";
+        } else {
+            sph_groestl_big_set_impl(nullptr, nullptr);
+        }
+
+        sph_echo_big_set_compress(nullptr);
+        SelfTestDigest<sph_echo512_context>(sph_echo512_init, sph_echo512, sph_echo512_close, expected);
+        sph_echo_big_set_compress(echo_aesni::Compress);
+        SelfTestDigest<sph_echo512_context>(sph_echo512_init, sph_echo512, sph_echo512_close, out);
+        if (memcmp(expected, out, SELFTEST_SIZE) == 0) {
+            accelerated += ",echo(aesni)";
+        } else {
+            sph_echo_big_set_compress(nullptr);
+        }
+    }
+#endif
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx2 && enabled_avx) {
+        sph_cubehash_set_rounds(nullptr);
+        SelfTestDigest<sph_cubehash512_context>(sph_cubehash512_init, sph_cubehash512, sph_cubehash512_close, expected);
+        sph_cubehash_set_rounds(cubehash_avx2::Rounds);
+        SelfTestDigest<sph_cubehash512_context>(sph_cubehash512_init, sph_cubehash512, sph_cubehash512_close, out);
+        if (memcmp(expected, out, SELFTEST_SIZE) == 0) {
+            accelerated += ",cubehash(avx2)";
+        } else {
+            sph_cubehash_set_rounds(nullptr);
+        }
+    }
+#endif
+
+    if (!accelerated.empty()) {
+        ret = accelerated.substr(1);
+    }
+#endif
+
+    return ret;
+}
@@ -0,0 +1,17 @@
+// Copyright (c) 2021-2024 The DECENOMY Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef DECENOMY_CRYPTO_SPH_AUTODETECT_H
+#define DECENOMY_CRYPTO_SPH_AUTODETECT_H
+
+#include <string>
+
+/** Autodetect the best available implementations of the sph functions that
+ *  have accelerated variants (Groestl, ECHO and CubeHash) and install them.
+ *  Each one is checked against the portable code before being used.
+ *  Returns the names of the implementations.
+ */
+std::string SphAutoDetect();
+
+#endif // DECENOMY_CRYPTO_SPH_AUTODETECT_H
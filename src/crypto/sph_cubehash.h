@@ -285,6 +285,16 @@ void sph_cubehash512_close(void *cc, void *dst);
  */
 void sph_cubehash512_addbits_and_close(
 	void *cc, unsigned ub, unsigned n, void *dst);
+
+/**
+ * Replace the rounds of all the CubeHash variants, e.g. with a vectorized
+ * implementation. The function must apply <code>16 * n</code> rounds to
+ * the 32-word state. Passing <code>NULL</code> restores the portable code.
+ * This is not thread-safe and is meant to be called once, at startup.
+ *
+ * @param rounds   the round function, or <code>NULL</code>
+ */
+void sph_cubehash_set_rounds(void (*rounds)(sph_u32 *state, unsigned n));
 #ifdef __cplusplus
 }
 #endif
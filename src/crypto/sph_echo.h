@@ -312,6 +312,17 @@ void sph_echo512_close(void *cc, void *dst);
  */
 void sph_echo512_addbits_and_close(
 	void *cc, unsigned ub, unsigned n, void *dst);
+
+/**
+ * Replace the compression function shared by ECHO-384 and ECHO-512, e.g.
+ * with an implementation using the AES instructions of the CPU. It must
+ * process <code>buf</code> into the chaining value like the portable code
+ * does. Passing <code>NULL</code> restores the portable code. This is not
+ * thread-safe and is meant to be called once, at startup.
+ *
+ * @param compress   the compression function, or <code>NULL</code>
+ */
+void sph_echo_big_set_compress(void (*compress)(sph_echo_big_context *sc));
 	
 #ifdef __cplusplus
 }
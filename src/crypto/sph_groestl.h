@@ -322,6 +322,22 @@ void sph_groestl512_close(void *cc, void *dst);
 void sph_groestl512_addbits_and_close(
 	void *cc, unsigned ub, unsigned n, void *dst);
 
+/**
+ * Replace the compression function and output transformation shared by
+ * Groestl-384 and Groestl-512, e.g. with implementations using the AES
+ * instructions of the CPU. Both work on the 128-byte chaining value, in
+ * the byte order of the specification, and the compression function
+ * processes one 128-byte message block into it. They are only used on
+ * little-endian builds. Passing <code>NULL</code> restores the portable
+ * code. This is not thread-safe and is meant to be called once, at
+ * startup.
+ *
+ * @param compress   the compression function, or <code>NULL</code>
+ * @param final      the output transformation, or <code>NULL</code>
+ */
+void sph_groestl_big_set_impl(void (*compress)(unsigned char *h, const unsigned char *m),
+	void (*final)(unsigned char *h));
+
 #ifdef __cplusplus
 }
 #endif
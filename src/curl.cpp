@@ -63,44 +63,69 @@ std::string caPath = "";
 
 #endif
 
+// Initializes libcurl for a download from url, with the HTTPS parameters set
+static CURL* InitDownload(const std::string& url)
+{
+    // Initializes libcurl
+    const auto curl = curl_easy_init();
+    if (!curl) {
+        LogPrintf(
+            "CCurlWrapper::%s: Error initializing libcurl.\n", __func__);
+        return nullptr;
+    }
+
+    // Gets libcurl version information
+    const auto info = curl_version_info(CURLVERSION_NOW);
+    if (info) {
+        LogPrintf(
+            "CCurlWrapper::%s: libcurl version: %s\n", 
+            __func__, info->version);
+        LogPrintf(
+            "CCurlWrapper::%s: libcurl SSL version: %s\n", 
+            __func__, info->ssl_version);
+        LogPrintf(
+            "CCurlWrapper::%s: libcurl zlib version: %s\n", 
+            __func__, info->libz_version);
+    } else {
+        LogPrintf(
+            "CCurlWrapper::%s: Failed to retrieve libcurl version information.\n", 
+            __func__);
+        curl_easy_cleanup(curl);
+        return nullptr;
+    }
+
+    LogPrintf(
+        "CCurlWrapper::%s: Downloading from %s\n", 
+        __func__,
+        url);
+
+    // Sets url parameter
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+
+    // Sets HTTPS parameters
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+    curl_easy_setopt(curl, CURLOPT_SSL_OPTIONS, CURLSSLOPT_NATIVE_CA);
+
+#ifndef WIN32
+    if (caPath.empty()) {
+        caPath = findCAPath();
+    }
+    if (!caPath.empty()) {
+        // Set the path to the CA bundle if found
+        LogPrintf("CCurlWrapper::%s: ca path: %s\n", __func__, caPath);
+        curl_easy_setopt(curl, CURLOPT_CAINFO, caPath.c_str());
+    }
+#endif
+
+    return curl;
+}
+
 bool CCurlWrapper::DownloadFile(
     const std::string& url,
     const std::string& filename,
     curl_xferinfo_callback xferinfoCallback)
 {
     try {
-        // Initializes libcurl
-        const auto curl = curl_easy_init();
-        if (!curl) {
-            LogPrintf(
-                "CCurlWrapper::%s: Error initializing libcurl.\n", __func__);
-            return false;
-        }
-
-        // Gets libcurl version information
-        const auto info = curl_version_info(CURLVERSION_NOW);
-        if (info) {
-            LogPrintf(
-                "CCurlWrapper::%s: libcurl version: %s\n", 
-                __func__, info->version);
-            LogPrintf(
-                "CCurlWrapper::%s: libcurl SSL version: %s\n", 
-                __func__, info->ssl_version);
-            LogPrintf(
-                "CCurlWrapper::%s: libcurl zlib version: %s\n", 
-                __func__, info->libz_version);
-        } else {
-            LogPrintf(
-                "CCurlWrapper::%s: Failed to retrieve libcurl version information.\n", 
-                __func__);
-            return false;
-        }
-
-        LogPrintf(
-            "CCurlWrapper::%s: Downloading from %s\n", 
-            __func__,
-            url);
-
         // Creates and open the destination file
         std::ofstream outputFile(filename, std::ios::binary);
         if (!outputFile.is_open()) {
@@ -110,23 +135,11 @@ bool CCurlWrapper::DownloadFile(
             return false;
         }
 
-        // Sets url parameter
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-
-        // Sets HTTPS parameters
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-        curl_easy_setopt(curl, CURLOPT_SSL_OPTIONS, CURLSSLOPT_NATIVE_CA);
-
-#ifndef WIN32
-        if (caPath.empty()) {
-            caPath = findCAPath();
-        }
-        if (!caPath.empty()) {
-            // Set the path to the CA bundle if found
-            LogPrintf("CCurlWrapper::%s: ca path: %s\n", __func__, caPath);
-            curl_easy_setopt(curl, CURLOPT_CAINFO, caPath.c_str());
+        // Initializes libcurl
+        const auto curl = InitDownload(url);
+        if (!curl) {
+            return false;
         }
-#endif
 
         // Sets file releated parameters
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
@@ -169,3 +182,98 @@ bool CCurlWrapper::DownloadFile(
 
     return true;
 }
+
+// Callback function to append downloaded data to a string
+size_t writeStringCallback(void* data, size_t size, size_t nmemb, void* clientp)
+{
+    size_t total_size = size * nmemb;
+    std::string* str = static_cast<std::string*>(clientp);
+    str->append(static_cast<const char*>(data), total_size);
+    return total_size;
+}
+
+bool CCurlWrapper::DownloadString(
+    const std::string& url,
+    std::string& strRet)
+{
+    strRet.clear();
+
+    const auto curl = InitDownload(url);
+    if (!curl) {
+        return false;
+    }
+
+    // Any HTTP error, such as a missing file, fails the download
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeStringCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &strRet);
+
+    const auto res = curl_easy_perform(curl);
+    curl_easy_cleanup(curl);
+
+    if (res != CURLE_OK) {
+        LogPrintf(
+            "CCurlWrapper::%s: Error downloading %s: %s\n",
+            __func__, url, curl_easy_strerror(res));
+        strRet.clear();
+        return false;
+    }
+
+    return true;
+}
+
+// Callback function to hand downloaded data to a stream consumer
+size_t writeStreamCallback(void* data, size_t size, size_t nmemb, void* clientp)
+{
+    if(ShutdownRequested()) {
+        LogPrintf(
+            "CCurlWrapper::%s: Shutdown requested while downloading a file\n", 
+            __func__);
+        return 0;
+    }
+
+    size_t total_size = size * nmemb;
+    const auto writeFunc = static_cast<const std::function<bool(const char*, size_t)>*>(clientp);
+    return (*writeFunc)(static_cast<const char*>(data), total_size) ? total_size : 0;
+}
+
+bool CCurlWrapper::DownloadStream(
+    const std::string& url,
+    uint64_t nResumeFrom,
+    const std::function<bool(const char*, size_t)>& writeFunc,
+    curl_xferinfo_callback xferinfoCallback)
+{
+    const auto curl = InitDownload(url);
+    if (!curl) {
+        return false;
+    }
+
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    if (nResumeFrom > 0) {
+        LogPrintf("CCurlWrapper::%s: Resuming from byte %u\n", __func__, nResumeFrom);
+        curl_easy_setopt(curl, CURLOPT_RESUME_FROM_LARGE, (curl_off_t)nResumeFrom);
+    }
+
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeStreamCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &writeFunc);
+
+    if (xferinfoCallback) {
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, xferinfoCallback);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, NULL);
+    }
+
+    const auto res = curl_easy_perform(curl);
+    curl_easy_cleanup(curl);
+
+    if (res != CURLE_OK) {
+        if(!ShutdownRequested()) {
+            LogPrintf(
+                "CCurlWrapper::%s: Error downloading file: %s\n", 
+                __func__, curl_easy_strerror(res));
+        }
+        return false;
+    }
+
+    return true;
+}
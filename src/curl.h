@@ -6,6 +6,7 @@
 #define CURL_H
 
 #include <curl/curl.h>
+#include <functional>
 #include <string>
 
 class CCurlWrapper
@@ -15,6 +16,22 @@ public:
         const std::string& url,
         const std::string& filename,
         curl_xferinfo_callback xferinfoCallback = nullptr);
+
+    /** Downloads a small file, such as a manifest, into memory */
+    static bool DownloadString(
+        const std::string& url,
+        std::string& strRet);
+
+    /**
+     * Downloads a file from the given offset on, handing its bytes to
+     * writeFunc as they arrive. The download stops when writeFunc returns
+     * false. Resuming fails if the server does not serve byte ranges.
+     */
+    static bool DownloadStream(
+        const std::string& url,
+        uint64_t nResumeFrom,
+        const std::function<bool(const char*, size_t)>& writeFunc,
+        curl_xferinfo_callback xferinfoCallback = nullptr);
 };
 
 #endif // CURL_H
@@ -24,6 +24,8 @@
 #include "checkpoints.h"
 #include "compat/sanity.h"
 #include "consensus/upgrades.h"
+#include "crypto/sha256.h"
+#include "crypto/sph_autodetect.h"
 #include "fs.h"
 #include "httpserver.h"
 #include "httprpc.h"
@@ -245,6 +247,7 @@ void PrepareShutdown()
 
         if (pcoinsTip != NULL) {
             FlushStateToDisk();
+            WriteBlockIndexSnapshot();
 
             //record that client took the proper shutdown procedure
             pblocktree->WriteFlag("shutdown", true);
@@ -379,6 +382,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-?", _("This help message"));
     strUsage += HelpMessageOpt("-version", _("Print version and exit"));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
+    strUsage += HelpMessageOpt("-blockindexsnapshot", strprintf(_("Keep a snapshot of the block index, loaded instead of its database at the next start (default: %u)"), DEFAULT_BLOCK_INDEX_SNAPSHOT));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     strUsage += HelpMessageOpt("-blocksizenotify=<cmd>", _("Execute command when the best block changes and its size is over (%s in cmd is replaced by block hash, %d with the block size)"));
     strUsage += HelpMessageOpt("-checkblocks=<n>", strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), DEFAULT_CHECKBLOCKS));
@@ -402,6 +406,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), PIVX_PID_FILENAME));
 #endif
     strUsage += HelpMessageOpt("-reindex", _("Rebuild block chain index from current blk000??.dat files") + " " + _("on startup"));
+    strUsage += HelpMessageOpt("-reindexpayees", _("Rebuild the masternode payee index from the active chain blocks") + " " + _("on startup"));
     strUsage += HelpMessageOpt("-resync", _("Delete blockchain folders and resync from scratch") + " " + _("on startup"));
     strUsage += HelpMessageOpt("-rewindblockindex[=<n or hash>]", _("When used without a value, rewinds blockchain to last checkpoint. When passing a number, rolls back the chain by the given number of blocks. When passing a block hash (as a hex string), rewind up to (not including) the block with the matching hash."));
 #if !defined(WIN32)
@@ -414,6 +419,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-banscore=<n>", strprintf(_("Threshold for disconnecting misbehaving peers (default: %u)"), DEFAULT_BANSCORE_THRESHOLD));
     strUsage += HelpMessageOpt("-bantime=<n>", strprintf(_("Number of seconds to keep misbehaving peers from reconnecting (default: %u)"), DEFAULT_MISBEHAVING_BANTIME));
     strUsage += HelpMessageOpt("-bind=<addr>", _("Bind to given address and always listen on it. Use [host]:port notation for IPv6"));
+    strUsage += HelpMessageOpt("-cmpcthighbandwidth", _("Ask the peers that send us new blocks first to announce the next ones as compact blocks, without waiting for a request (default: 1 for masternodes, 0 otherwise)"));
     strUsage += HelpMessageOpt("-connect=<ip>", _("Connect only to the specified node(s); -noconnect or -connect=0 alone to disable automatic connections"));
     strUsage += HelpMessageOpt("-discover", _("Discover own IP address (default: 1 when listening and no -externalip)"));
     strUsage += HelpMessageOpt("-dns", strprintf(_("Allow DNS lookups for -addnode, -seednode and -connect (default: %u)"), DEFAULT_NAME_LOOKUP));
@@ -434,6 +440,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-proxy=<ip:port>", _("Connect through SOCKS5 proxy"));
     strUsage += HelpMessageOpt("-proxyrandomize", strprintf(_("Randomize credentials for every proxy connection. This enables Tor stream isolation (default: %u)"), DEFAULT_PROXYRANDOMIZE));
     strUsage += HelpMessageOpt("-seednode=<ip>", _("Connect to a node to retrieve peer addresses, and disconnect"));
+    strUsage += HelpMessageOpt("-servedblockcache=<n>", strprintf(_("Keep up to <n> MiB of the blocks recently served to peers in memory, 0 to disable (default: %u)"), DEFAULT_SERVED_BLOCK_CACHE_SIZE));
+    strUsage += HelpMessageOpt("-socketevents=<mode>", strprintf(_("Socket events mode, which must be one of: %s (default: %s)"), GetSupportedSocketEventsModes(), SocketEventsModeToString(GetDefaultSocketEventsMode())));
     strUsage += HelpMessageOpt("-timeout=<n>", strprintf(_("Specify connection timeout in milliseconds (minimum: 1, default: %d)"), DEFAULT_CONNECT_TIMEOUT));
     strUsage += HelpMessageOpt("-torcontrol=<ip>:<port>", strprintf(_("Tor control port to use if onion listening enabled (default: %s)"), DEFAULT_TOR_CONTROL));
     strUsage += HelpMessageOpt("-torpassword=<pass>", _("Tor control port password (default: empty)"));
@@ -461,7 +469,11 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
     strUsage += HelpMessageOpt("-uacomment=<cmt>", _("Append comment to the user agent string"));
     if (showDebug) {
+#ifdef ENABLE_BOOTSTRAP
+        strUsage += HelpMessageOpt("-bootstrapurl=<url>", "Download the bootstrap archive applied by -bootstrap from <url>, with its signed manifest at <url>.manifest");
+#endif
         strUsage += HelpMessageOpt("-checkblockindex", strprintf("Do a full consistency check for mapBlockIndex, setBlockIndexCandidates, chainActive and mapBlocksUnlinked occasionally. Also sets -checkmempool (default: %u)", Params(CBaseChainParams::MAIN).DefaultConsistencyChecks()));
+        strUsage += HelpMessageOpt("-checkblockreads", strprintf("Rehash the blocks read from disk for a block index entry instead of trusting its hash (default: %u)", DEFAULT_CHECK_BLOCK_READS));
         strUsage += HelpMessageOpt("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u)", Params(CBaseChainParams::MAIN).DefaultConsistencyChecks()));
         strUsage += HelpMessageOpt("-checkpoints", strprintf(_("Only accept block chain matching built-in checkpoints (default: %u)"), DEFAULT_CHECKPOINTS_ENABLED));
         strUsage += HelpMessageOpt("-disablesafemode", strprintf("Disable safemode, override a real safe mode event (default: %u)", DEFAULT_DISABLE_SAFEMODE));
@@ -491,6 +503,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-limitfreerelay=<n>", strprintf(_("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default:%u)"), DEFAULT_LIMITFREERELAY));
         strUsage += HelpMessageOpt("-relaypriority", strprintf(_("Require high priority for relaying free or low-fee transactions (default:%u)"), DEFAULT_RELAYPRIORITY));
         strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf(_("Limit size of signature cache to <n> MiB (default: %u)"), DEFAULT_MAX_SIG_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxscriptcachesize=<n>", strprintf(_("Limit size of script execution cache to <n> MiB (default: %u)"), DEFAULT_MAX_SCRIPT_CACHE_SIZE));
     }
     strUsage += HelpMessageOpt("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE));
     strUsage += HelpMessageOpt("-minrelaytxfee=<amt>", strprintf(_("Fees (in %s/Kb) smaller than this are considered zero fee for relaying, mining and transaction creation (default: %s)"), CURRENCY_UNIT, FormatMoney(::minRelayTxFee.GetFeePerK())));
@@ -628,6 +641,7 @@ void ThreadImport(std::vector<fs::path> vImportFiles)
     // -reindex
     if (fReindex) {
         CImportingNow imp;
+        const int64_t nStart = GetTimeMillis();
         int nFile = 0;
         while (true) {
             CDiskBlockPos pos(nFile, 0);
@@ -642,7 +656,7 @@ void ThreadImport(std::vector<fs::path> vImportFiles)
         }
         pblocktree->WriteReindexing(false);
         fReindex = false;
-        LogPrintf("Reindexing finished\n");
+        LogPrintf("Reindexing finished, %d block files in %dms\n", nFile, GetTimeMillis() - nStart);
         // To avoid ending up in a situation without genesis block, re-try initializing (no-op if reindexing worked):
         InitBlockIndex();
     }
@@ -933,8 +947,14 @@ bool AppInit2()
     int nUserMaxConnections = GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
     int nMaxConnections = std::max(nUserMaxConnections, 4 * MAX_OUTBOUND_CONNECTIONS);
 
+    std::string strSocketEvents = GetArg("-socketevents", SocketEventsModeToString(GetDefaultSocketEventsMode()));
+    SocketEventsMode socketEventsMode;
+    if (!SocketEventsModeFromString(strSocketEvents, socketEventsMode))
+        return UIError(strprintf(_("Invalid -socketevents ('%s') specified. Only these modes are supported: %s"), strSocketEvents, GetSupportedSocketEventsModes()));
+
     // Trim requested connection counts, to fit into system limitations
-    nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
+    if (socketEventsMode == SOCKETEVENTS_SELECT)
+        nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
     int nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return UIError(_("Not enough file descriptors available."));
@@ -994,6 +1014,9 @@ bool AppInit2()
         mempool.setSanityCheck(1.0 / ratio);
     }
     fCheckBlockIndex = GetBoolArg("-checkblockindex", Params().DefaultConsistencyChecks());
+    fCheckBlockReads = GetBoolArg("-checkblockreads", DEFAULT_CHECK_BLOCK_READS);
+    fBlockIndexSnapshot = GetBoolArg("-blockindexsnapshot", DEFAULT_BLOCK_INDEX_SNAPSHOT);
+    nServedBlockCacheSize = std::max<int64_t>(0, GetArg("-servedblockcache", DEFAULT_SERVED_BLOCK_CACHE_SIZE)) * 1024 * 1024;
     Checkpoints::fEnabled = GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
 
     // -mempoollimit limits
@@ -1070,6 +1093,10 @@ bool AppInit2()
     fReindex = GetBoolArg("-reindex", false);
 
     // Initialize elliptic curve code
+    std::string sha256_algo = SHA256AutoDetect();
+    LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string sph_algo = SphAutoDetect();
+    LogPrintf("Using the '%s' implementations of the X11KV hash functions\n", sph_algo);
     RandomInit();
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1111,11 +1138,15 @@ bool AppInit2()
     std::ostringstream strErrors;
 
     InitSignatureCache();
+    InitScriptExecutionCache();
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
         for (int i = 0; i < nScriptCheckThreads - 1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        // legacy block headers are hashed ahead of validation by as many threads
+        for (int i = 0; i < nScriptCheckThreads - 1; i++)
+            threadGroup.create_thread(&ThreadHeaderHash);
     }
 
     if (mapArgs.count("-sporkkey")) // spork priv key
@@ -1210,58 +1241,64 @@ bool AppInit2()
             }
         }
 
-        if (GetBoolArg("-resync", false)) {
-            uiInterface.InitMessage(_("Preparing for resync..."));
-            // Delete the local blockchain folders to force a resync from scratch to get a consitent blockchain-state
-            fs::path blocksDir = GetDataDir() / "blocks";
-            fs::path chainstateDir = GetDataDir() / "chainstate";
-            fs::path sporksDir = GetDataDir() / "sporks";
+        if (!CWallet::Verify())
+            return false;
 
-            LogPrintf("Deleting blockchain folders blocks, chainstate, and sporks\n");
-            // We delete in 4 individual steps in case one of the folder is missing already
-            try {
-                if (fs::exists(blocksDir)){
-                    fs::remove_all(blocksDir);
-                    LogPrintf("-resync: folder deleted: %s\n", blocksDir.string().c_str());
-                }
+    }  // (!fDisableWallet)
+#endif // ENABLE_WALLET
 
-                if (fs::exists(chainstateDir)){
-                    fs::remove_all(chainstateDir);
-                    LogPrintf("-resync: folder deleted: %s\n", chainstateDir.string().c_str());
-                }
+    if (GetBoolArg("-resync", false)) {
+        uiInterface.InitMessage(_("Preparing for resync..."));
+        // Delete the local blockchain folders to force a resync from scratch to get a consitent blockchain-state
+        fs::path blocksDir = GetDataDir() / "blocks";
+        fs::path chainstateDir = GetDataDir() / "chainstate";
+        fs::path sporksDir = GetDataDir() / "sporks";
 
-                if (fs::exists(sporksDir)){
-                    fs::remove_all(sporksDir);
-                    LogPrintf("-resync: folder deleted: %s\n", sporksDir.string().c_str());
-                }
-            } catch (const fs::filesystem_error& error) {
-                LogPrintf("Failed to delete blockchain folders %s\n", error.what());
+        LogPrintf("Deleting blockchain folders blocks, chainstate, and sporks\n");
+        // We delete in 4 individual steps in case one of the folder is missing already
+        try {
+            if (fs::exists(blocksDir)){
+                fs::remove_all(blocksDir);
+                LogPrintf("-resync: folder deleted: %s\n", blocksDir.string().c_str());
+            }
+
+            if (fs::exists(chainstateDir)){
+                fs::remove_all(chainstateDir);
+                LogPrintf("-resync: folder deleted: %s\n", chainstateDir.string().c_str());
             }
+
+            if (fs::exists(sporksDir)){
+                fs::remove_all(sporksDir);
+                LogPrintf("-resync: folder deleted: %s\n", sporksDir.string().c_str());
+            }
+        } catch (const fs::filesystem_error& error) {
+            LogPrintf("Failed to delete blockchain folders %s\n", error.what());
         }
 
 #ifdef ENABLE_BOOTSTRAP
-        if (GetBoolArg("-bootstrap", false) ) {
+        CBootstrap::ClearPending();
+#endif
+    }
 
-            uiInterface.InitMessage(_("Preparing for bootstrap..."));
+#ifdef ENABLE_BOOTSTRAP
+    // An interrupted bootstrap left partial blockchain folders, it is resumed
+    if (GetBoolArg("-bootstrap", false) || CBootstrap::IsPending()) {
 
-            try {
-                if (!CBootstrap::DownloadAndApply()) {
-                    return UIError(_("Unable to download and apply the bootstrap file. See debug log for details."));
-                }
+        uiInterface.InitMessage(_("Preparing for bootstrap..."));
 
-            } catch (const std::exception& e) {
-                uiInterface.ThreadSafeMessageBox(_("Error downloading and applying the bootstrap file, shutting down."), "", CClientUIInterface::MSG_ERROR);
-                LogPrintf("Error downloading and applying the bootstrap file: %s\n", e.what());
-                return false;
+        try {
+            std::string strError;
+            if (!CBootstrap::DownloadAndApply(strError)) {
+                return UIError(strError);
             }
-        }
-#endif
 
-        if (!CWallet::Verify())
+        } catch (const std::exception& e) {
+            uiInterface.ThreadSafeMessageBox(_("Error downloading and applying the bootstrap file, shutting down."), "", CClientUIInterface::MSG_ERROR);
+            LogPrintf("Error downloading and applying the bootstrap file: %s\n", e.what());
             return false;
-
-    }  // (!fDisableWallet)
-#endif // ENABLE_WALLET
+        }
+    }
+#endif
 
     // Initialize dynamic rewards
     if(!CRewards::Init(fReindex)) 
@@ -1557,6 +1594,12 @@ bool AppInit2()
                         fVerifyingBlocks = false;
                         break;
                     }
+
+                    if (GetBoolArg("-reindexpayees", false) && !ReindexPayees()) {
+                        strLoadError = _("Error rebuilding the masternode payee index");
+                        fVerifyingBlocks = false;
+                        break;
+                    }
                 }
             } catch (const std::exception& e) {
                 LogPrintf("%s\n", e.what());
@@ -1779,6 +1822,7 @@ bool AppInit2()
     connOptions.uiInterface = &uiInterface;
     connOptions.nSendBufferMaxSize = 1000*GetArg("-maxsendbuffer", DEFAULT_MAXSENDBUFFER);
     connOptions.nReceiveFloodSize = 1000*GetArg("-maxreceivebuffer", DEFAULT_MAXRECEIVEBUFFER);
+    connOptions.socketEventsMode = socketEventsMode;
 
     if (!connman.Start(scheduler, strNodeError, connOptions))
         return UIError(strNodeError);
@@ -1802,6 +1846,14 @@ bool AppInit2()
         // StakeMiner thread disabled by default on regtest
         if (fStaking) {
             threadGroup.create_thread(boost::bind(&ThreadStakeMinter));
+
+            // the staking thread itself is one of the kernel search threads
+            int nStakingThreads = GetArg("-stakingthreads", DEFAULT_STAKING_THREADS);
+            if (nStakingThreads <= 0)
+                nStakingThreads += GetNumCores();
+            LogPrintf("Using %d threads for the stake kernel search\n", std::max(nStakingThreads, 1));
+            for (int i = 0; i < nStakingThreads - 1; i++)
+                threadGroup.create_thread(&ThreadStakeKernelSearch);
         }
     }
 #endif
@@ -8,6 +8,7 @@
 
 #include "kernel.h"
 
+#include "checkqueue.h"
 #include "db.h"
 #include "legacy/stakemodifier.h"
 #include "script/interpreter.h"
@@ -16,8 +17,75 @@
 #include "stakeinput.h"
 #include "utilmoneystr.h"
 
+#include <mutex>
+
 #include <boost/assign/list_of.hpp>
 
+// Serialize the stake modifier of a kernel on top of pindexPrev
+static void GetKernelStakeModifier(const CBlockIndex* pindexPrev, CStakeInput* stakeInput, CDataStream& ss)
+{
+    if (!Params().GetConsensus().NetworkUpgradeActive(pindexPrev->nHeight + 1, Consensus::UPGRADE_STAKE_MODIFIER_V2)) {
+        uint64_t nStakeModifier = 0;
+        if (!GetOldStakeModifier(stakeInput, nStakeModifier))
+            LogPrintf("%s : ERROR: Failed to get kernel stake modifier\n", __func__);
+        // Modifier v1
+        ss << nStakeModifier;
+    } else {
+        // Modifier v2
+        ss << pindexPrev->GetStakeModifierV2();
+    }
+}
+
+// Return the target of a kernel, weighted by the value of its input
+static uint256 GetKernelTarget(unsigned int nBits, CAmount stakeValue)
+{
+    uint256 bnTarget;
+    bnTarget.SetCompact(nBits);
+    bnTarget *= (uint256(stakeValue) / 100);
+    return bnTarget;
+}
+
+/*
+ * Time slots where a block can be staked on top of pindexPrev
+ *
+ * @param[in]   pindexPrev      index of the parent block of the block being staked
+ * @param[out]  nTimeCheck      time for the contextual checks of the stake inputs
+ * @param[out]  nFirstSlot      first time slot
+ * @param[out]  nLastSlot       last time slot
+ * @param[out]  nSlotStep       time between two slots
+ */
+static void GetStakeTimeSlots(const CBlockIndex* pindexPrev, int64_t& nTimeCheck, int64_t& nFirstSlot, int64_t& nLastSlot, int& nSlotStep)
+{
+    const int nHeightTx = pindexPrev->nHeight + 1;
+
+    // Get the new time slot (and verify it's not the same as previous block)
+    const bool fRegTest = Params().IsRegTestNet();
+    const bool fTimeProtocolV2 = Params().GetConsensus().IsTimeProtocolV2(nHeightTx) && !fRegTest;
+    const int nTimeSlotLength = Params().GetConsensus().nTimeSlotLength;
+    nTimeCheck = fTimeProtocolV2 ? pindexPrev->MinPastBlockTime() : GetAdjustedTime();
+
+    nSlotStep = fTimeProtocolV2 ? nTimeSlotLength : 1;
+
+    nFirstSlot = (nTimeCheck / nSlotStep) * nSlotStep;
+    while (nFirstSlot <= pindexPrev->MinPastBlockTime()) {
+        nFirstSlot += nSlotStep;
+    }
+
+    nLastSlot = fTimeProtocolV2 ? pindexPrev->MaxFutureBlockTime() : pindexPrev->GetBlockTime() + HASH_DRIFT;
+}
+
+CStakeKernelMidstate::CStakeKernelMidstate(const CDataStream& ssPrefix, const uint256& bnTargetIn):
+    bnTarget(bnTargetIn)
+{
+    hasher.Write((const unsigned char*)&ssPrefix[0], ssPrefix.size());
+}
+
+// Serialize the kernel message but its time: stake modifier, time of the block from and uniqueness
+static void GetKernelPrefix(const CDataStream& stakeModifier, int nTimeBlockFrom, const CDataStream& stakeUniqueness, CDataStream& ss)
+{
+    ss << stakeModifier << nTimeBlockFrom << stakeUniqueness;
+}
+
 /**
  * CStakeKernel Constructor
  *
@@ -33,35 +101,26 @@ CStakeKernel::CStakeKernel(const CBlockIndex* const pindexPrev, CStakeInput* sta
     stakeValue(stakeInput->GetValue())
 {
     // Set kernel stake modifier
-    if (!Params().GetConsensus().NetworkUpgradeActive(pindexPrev->nHeight + 1, Consensus::UPGRADE_STAKE_MODIFIER_V2)) {
-        uint64_t nStakeModifier = 0;
-        if (!GetOldStakeModifier(stakeInput, nStakeModifier))
-            LogPrintf("%s : ERROR: Failed to get kernel stake modifier\n", __func__);
-        // Modifier v1
-        stakeModifier << nStakeModifier;
-    } else {
-        // Modifier v2
-        stakeModifier << pindexPrev->GetStakeModifierV2();
-    }
+    GetKernelStakeModifier(pindexPrev, stakeInput, stakeModifier);
     CBlockIndex* pindexFrom = stakeInput->GetIndexFrom();
     nTimeBlockFrom = pindexFrom->nTime;
+
+    CDataStream ss(SER_GETHASH, 0);
+    GetKernelPrefix(stakeModifier, nTimeBlockFrom, stakeUniqueness, ss);
+    midstate = CStakeKernelMidstate(ss, GetKernelTarget(nBits, stakeValue));
 }
 
 // Return stake kernel hash
 uint256 CStakeKernel::GetHash() const
 {
-    CDataStream ss(stakeModifier);
-    ss << nTimeBlockFrom << stakeUniqueness << nTime;
-    return Hash(ss.begin(), ss.end());
+    return midstate.GetHash(nTime);
 }
 
 // Check that the kernel hash meets the target required
 bool CStakeKernel::CheckKernelHash(bool fSkipLog) const
 {
     // Get weighted target
-    uint256 bnTarget;
-    bnTarget.SetCompact(nBits);
-    bnTarget *= (uint256(stakeValue) / 100);
+    const uint256& bnTarget = midstate.GetTarget();
 
     // Check PoS kernel hash
     const uint256& hashProofOfStake = GetHash();
@@ -106,7 +165,17 @@ bool LoadStakeInput(const CBlock& block, const CBlockIndex* pindexPrev, std::uni
 
     // Construct the stakeinput object
     const CTxIn& txin = block.vtx[1].vin[0];
-    stake = std::unique_ptr<CStakeInput>(new CPivStake());
+    CPivStake* pivStake = new CPivStake();
+    stake = std::unique_ptr<CStakeInput>(pivStake);
+
+    // A block on top of the tip stakes a coin of the UTXO set, whose height
+    // gives the block of origin without reading the transaction from disk.
+    // Blocks on forks, or already connected, need the transaction lookup.
+    {
+        LOCK(cs_main);
+        if (pindexPrev == chainActive.Tip() && pivStake->InitFromCoin(txin))
+            return true;
+    }
 
     return stake->InitFromTxIn(txin);
 }
@@ -125,32 +194,156 @@ bool Stake(const CBlockIndex* pindexPrev, CStakeInput* stakeInput, unsigned int
     // Double check stake input contextual checks
     const int nHeightTx = pindexPrev->nHeight + 1;
 
-    // Get the new time slot (and verify it's not the same as previous block)
-    const bool fRegTest = Params().IsRegTestNet();
-    const bool fTimeProtocolV2 = Params().GetConsensus().IsTimeProtocolV2(nHeightTx) && !fRegTest;
-    const int nTimeSlotLength = Params().GetConsensus().nTimeSlotLength;
-    nTimeTx = fTimeProtocolV2 ? pindexPrev->MinPastBlockTime() : GetAdjustedTime();
+    int64_t nFirstSlot, nLastSlot;
+    int slotStep;
+    GetStakeTimeSlots(pindexPrev, nTimeTx, nFirstSlot, nLastSlot, slotStep);
 
     if (!stakeInput || !stakeInput->ContextCheck(nHeightTx, nTimeTx)) return false;
 
-    int slotStep = fTimeProtocolV2 ? nTimeSlotLength : 1;
-
-    nTimeTx = (nTimeTx / slotStep) * slotStep;
-
-    while(nTimeTx <= pindexPrev->MinPastBlockTime()) {
-        nTimeTx += slotStep;
-    }
-
-    while(nTimeTx <= (fTimeProtocolV2 ? pindexPrev->MaxFutureBlockTime() : pindexPrev->GetBlockTime() + HASH_DRIFT)) {
+    for (nTimeTx = nFirstSlot; nTimeTx <= nLastSlot; nTimeTx += slotStep) {
         // Verify Proof Of Stake
         CStakeKernel stakeKernel(pindexPrev, stakeInput, nBits, nTimeTx);
         if(stakeKernel.CheckKernelHash(true)) return true;
-        nTimeTx += slotStep;
     }
 
     return false;
 }
 
+CStakeKernelSearch::CStakeKernelSearch(const CBlockIndex* pindexPrevIn, unsigned int nBitsIn):
+    pindexPrev(pindexPrevIn),
+    nBits(nBitsIn)
+{
+    GetStakeTimeSlots(pindexPrev, nTimeCheck, nFirstSlot, nLastSlot, nSlotStep);
+}
+
+bool CStakeKernelSearch::AddInput(CStakeInput* stakeInput)
+{
+    if (!stakeInput || !stakeInput->ContextCheck(pindexPrev->nHeight + 1, nTimeCheck)) return false;
+
+    CDataStream stakeModifier(SER_GETHASH, 0);
+    GetKernelStakeModifier(pindexPrev, stakeInput, stakeModifier);
+    CDataStream ss(SER_GETHASH, 0);
+    GetKernelPrefix(stakeModifier, stakeInput->GetIndexFrom()->nTime, stakeInput->GetUniqueness(), ss);
+
+    Candidate candidate;
+    candidate.stakeInput = stakeInput;
+    candidate.kernel = CStakeKernelMidstate(ss, GetKernelTarget(nBits, stakeInput->GetValue()));
+    candidate.fExcluded = false;
+    vCandidates.push_back(std::move(candidate));
+    return true;
+}
+
+namespace {
+
+/** Outcome of a kernel search, shared by its checks. */
+struct StakeKernelResult {
+    std::mutex cs;
+    int nCandidate{-1};
+    int64_t nTimeTx{0};
+};
+
+/**
+ * Closure searching the time slots of a range of candidates. It returns
+ * false to stop the other workers of the queue, once a kernel is found or
+ * the search is interrupted.
+ */
+class CStakeKernelCheck
+{
+private:
+    const CStakeKernelSearch* search{nullptr};
+    size_t nBegin{0};
+    size_t nEnd{0};
+    const std::function<bool()>* fnInterrupt{nullptr};
+    StakeKernelResult* result{nullptr};
+
+public:
+    CStakeKernelCheck() {}
+    CStakeKernelCheck(const CStakeKernelSearch* searchIn, size_t nBeginIn, size_t nEndIn,
+                      const std::function<bool()>* fnInterruptIn, StakeKernelResult* resultIn) :
+        search(searchIn), nBegin(nBeginIn), nEnd(nEndIn), fnInterrupt(fnInterruptIn), result(resultIn) {}
+
+    bool operator()()
+    {
+        if ((*fnInterrupt)()) return false;
+        for (size_t i = nBegin; i < nEnd; i++) {
+            if (search->GetCandidate(i).fExcluded) continue;
+            for (int64_t nTimeTx = search->GetFirstSlot(); nTimeTx <= search->GetLastSlot(); nTimeTx += search->GetSlotStep()) {
+                if (search->CheckCandidate(i, nTimeTx)) {
+                    std::lock_guard<std::mutex> lock(result->cs);
+                    if (result->nCandidate < 0 || (size_t) result->nCandidate > i) {
+                        result->nCandidate = i;
+                        result->nTimeTx = nTimeTx;
+                    }
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void swap(CStakeKernelCheck& check)
+    {
+        std::swap(search, check.search);
+        std::swap(nBegin, check.nBegin);
+        std::swap(nEnd, check.nEnd);
+        std::swap(fnInterrupt, check.fnInterrupt);
+        std::swap(result, check.result);
+    }
+};
+
+//! Number of candidates searched by a check between two polls of the interruption
+const size_t STAKE_KERNEL_CHECK_SIZE = 16;
+
+CCheckQueue<CStakeKernelCheck> stakekernelqueue(4);
+//! The check queue supports a single master at a time
+RecursiveMutex cs_stakekernelqueue;
+
+} // anon namespace
+
+void ThreadStakeKernelSearch()
+{
+    util::ThreadRename("pivx-kernel");
+    stakekernelqueue.Thread();
+}
+
+int CStakeKernelSearch::Search(int64_t& nTimeTx, const std::function<bool()>& fnInterrupt)
+{
+    StakeKernelResult result;
+    std::vector<CStakeKernelCheck> vChecks;
+    // the queue hands out its last checks first
+    for (size_t nEnd = vCandidates.size(); nEnd > 0; ) {
+        const size_t nBegin = nEnd > STAKE_KERNEL_CHECK_SIZE ? nEnd - STAKE_KERNEL_CHECK_SIZE : 0;
+        vChecks.emplace_back(this, nBegin, nEnd, &fnInterrupt, &result);
+        nEnd = nBegin;
+    }
+
+    {
+        TRY_LOCK(cs_stakekernelqueue, lockQueue);
+        if (lockQueue) {
+            CCheckQueueControl<CStakeKernelCheck> control(&stakekernelqueue);
+            control.Add(vChecks);
+            control.Wait();
+        } else {
+            // another search is using the workers, e.g. from the RPC
+            for (auto it = vChecks.rbegin(); it != vChecks.rend(); ++it) {
+                if (!(*it)()) break;
+            }
+        }
+    }
+
+    if (result.nCandidate < 0) return -1;
+
+    // double check the kernel found, and log it
+    const Candidate& candidate = vCandidates[result.nCandidate];
+    CStakeKernel stakeKernel(pindexPrev, candidate.stakeInput, nBits, result.nTimeTx);
+    if (!stakeKernel.CheckKernelHash()) {
+        LogPrintf("%s : ERROR: kernel found does not meet its target\n", __func__);
+        return -1;
+    }
+    nTimeTx = result.nTimeTx;
+    return result.nCandidate;
+}
+
 
 /*
  * CheckProofOfStake    Check if block has valid proof of stake
@@ -9,11 +9,53 @@
 #ifndef PIVX_KERNEL_H
 #define PIVX_KERNEL_H
 
+#include "hash.h"
 #include "main.h"
 #include "stakeinput.h"
 
+#include <functional>
+
 #define HASH_DRIFT 45
 
+/** Default for -stakingthreads, 0 = one per core */
+static const int DEFAULT_STAKING_THREADS = 0;
+
+/**
+ * Stake kernel of one input on top of one tip, with everything but the time
+ * slot hashed ahead. The constant prefix of the kernel message (stake
+ * modifier, time of the block from and uniqueness) is fed to the hasher
+ * once, so checking a time slot costs the last block of the first SHA256,
+ * the second SHA256 and a comparison with the weighted target, computed
+ * once too. Nothing is allocated per slot.
+ */
+class CStakeKernelMidstate
+{
+public:
+    CStakeKernelMidstate() {}
+    CStakeKernelMidstate(const CDataStream& ssPrefix, const uint256& bnTargetIn);
+
+    // Return stake kernel hash at time nTimeTx
+    uint256 GetHash(int nTimeTx) const
+    {
+        unsigned char time[4];
+        WriteLE32(time, nTimeTx);
+        uint256 hash;
+        CHash256(hasher).Write(time, sizeof(time)).Finalize(hash.begin());
+        return hash;
+    }
+
+    // Check that the kernel hash at time nTimeTx meets the target
+    bool CheckKernelHash(int nTimeTx) const { return GetHash(nTimeTx) < bnTarget; }
+
+    const uint256& GetTarget() const { return bnTarget; }
+
+private:
+    //! hasher fed with the constant prefix of the kernel message
+    CHash256 hasher;
+    //! target weighted by the value of the input
+    uint256 bnTarget;
+};
+
 class CStakeKernel {
 public:
     /**
@@ -41,6 +83,8 @@ private:
     // hash target
     unsigned int nBits{0};     // difficulty for the target
     CAmount stakeValue{0};     // target multiplier
+    // the message but nTime, and the weighted target
+    CStakeKernelMidstate midstate;
 };
 
 /* PoS Validation */
@@ -56,6 +100,75 @@ private:
  */
 bool Stake(const CBlockIndex* pindexPrev, CStakeInput* stakeInput, unsigned int nBits, int64_t& nTimeTx);
 
+/**
+ * Kernel search of many stake inputs on top of one tip.
+ *
+ * The parts of the kernel of each input that do not depend on the time slot
+ * (stake modifier, time of the block from, uniqueness and weighted target)
+ * are computed once when the input is added. Search() then hashes the time
+ * slots of all the inputs on the kernel search threads, and stops at the
+ * first kernel found or when interrupted.
+ */
+class CStakeKernelSearch
+{
+public:
+    /** The data of one input, immutable once added. */
+    struct Candidate {
+        CStakeInput* stakeInput;
+        CStakeKernelMidstate kernel;
+        bool fExcluded;
+    };
+
+    /**
+     * @param[in]   pindexPrev      index of the parent block of the block being staked
+     * @param[in]   nBits           target difficulty bits
+     */
+    CStakeKernelSearch(const CBlockIndex* pindexPrev, unsigned int nBits);
+
+    /**
+     * Add a stake input, which must outlive the search. Returns false if it
+     * cannot stake on top of pindexPrev, e.g. because it is not mature yet.
+     */
+    bool AddInput(CStakeInput* stakeInput);
+
+    /** Leave the candidate out of the next searches, e.g. when its coinstake could not be built. */
+    void Exclude(size_t nCandidate) { vCandidates[nCandidate].fExcluded = true; }
+
+    size_t size() const { return vCandidates.size(); }
+    const Candidate& GetCandidate(size_t nCandidate) const { return vCandidates[nCandidate]; }
+
+    /**
+     * Search the time slots of all the candidates.
+     *
+     * @param[out]  nTimeTx         time slot of the kernel found
+     * @param[in]   fnInterrupt     polled between chunks of candidates, the
+     *                              search gives up once it returns true
+     * @return      int             the candidate that found a kernel, or -1
+     */
+    int Search(int64_t& nTimeTx, const std::function<bool()>& fnInterrupt);
+
+    //! Whether the kernel of the candidate at nTimeTx meets its target
+    bool CheckCandidate(size_t nCandidate, int nTimeTx) const { return vCandidates[nCandidate].kernel.CheckKernelHash(nTimeTx); }
+
+    //! Time slots of the search
+    int64_t GetFirstSlot() const { return nFirstSlot; }
+    int64_t GetLastSlot() const { return nLastSlot; }
+    int GetSlotStep() const { return nSlotStep; }
+
+private:
+    const CBlockIndex* pindexPrev;
+    unsigned int nBits;
+    //! time given to the contextual checks of the inputs
+    int64_t nTimeCheck;
+    int64_t nFirstSlot;
+    int64_t nLastSlot;
+    int nSlotStep;
+    std::vector<Candidate> vCandidates;
+};
+
+/** Worker thread of CStakeKernelSearch::Search() */
+void ThreadStakeKernelSearch();
+
 /*
  * CheckProofOfStake    Check if block has valid proof of stake
  *
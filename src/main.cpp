@@ -13,7 +13,10 @@
 
 #include "addrman.h"
 #include "amount.h"
+#include "blockencodings.h"
+#include "blockindexsnapshot.h"
 #include "blocksignature.h"
+#include "burnaddresses.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
@@ -21,6 +24,7 @@
 #include "consensus/merkle.h"
 #include "consensus/tx_verify.h"
 #include "consensus/validation.h"
+#include "cuckoocache.h"
 #include "fs.h"
 #include "init.h"
 #include "kernel.h"
@@ -35,6 +39,7 @@
 #include "pow.h"
 #include "reverse_iterate.h"
 #include "rewards.h"
+#include "script/sigcache.h"
 #include "spork.h"
 #include "sporkdb.h"
 #include "txdb.h"
@@ -51,8 +56,10 @@
 #include <boost/thread.hpp>
 #include <boost/foreach.hpp>
 #include <atomic>
+#include <condition_variable>
 #include <queue>
 #include <regex>
+#include <thread>
 
 
 #if defined(NDEBUG)
@@ -77,6 +84,7 @@
 RecursiveMutex cs_main;
 
 BlockMap mapBlockIndex;
+CBlockIndexArena blockIndexArena;
 CChain chainActive;
 CBlockIndex* pindexBestHeader = NULL;
 int64_t nTimeBestReceived = 0;
@@ -91,8 +99,11 @@ std::atomic<bool> fImporting{false};
 std::atomic<bool> fReindex{false};
 bool fTxIndex = true;
 bool fCheckBlockIndex = false;
+bool fCheckBlockReads = DEFAULT_CHECK_BLOCK_READS;
+bool fBlockIndexSnapshot = DEFAULT_BLOCK_INDEX_SNAPSHOT;
 bool fVerifyingBlocks = false;
 size_t nCoinCacheUsage = 5000 * 300;
+size_t nServedBlockCacheSize = DEFAULT_SERVED_BLOCK_CACHE_SIZE * 1024 * 1024;
 
 /* If the tip is older than this (in seconds), the node is considered to be in initial block download. */
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
@@ -208,12 +219,119 @@ struct QueuedBlock {
     int64_t nTime;              //! Time of "getdata" request in microseconds.
     int nValidatedQueuedBefore; //! Number of blocks queued with validated headers (globally) at the time this one is requested.
     bool fValidatedHeaders;     //! Whether this block has validated headers at the time of request.
+    std::unique_ptr<PartiallyDownloadedBlock> partialBlock; //! Optional, used for CMPCTBLOCK downloads
 };
 std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> > mapBlocksInFlight;
 
 /** Number of blocks in flight with validated headers. */
 int nQueuedValidatedHeaders = 0;
 
+/** Blocks of the download window received before their parent, kept until it is stored. Protected by cs_main. */
+struct OutOfOrderBlock {
+    CBlock block;
+    NodeId nodeid;         //! Peer the block was downloaded from.
+    size_t nSize;          //! Serialized size of the block.
+    int64_t nTimeReceived; //! Time the block was buffered, see BLOCK_OUT_OF_ORDER_EXPIRY.
+};
+std::map<uint256, OutOfOrderBlock> mapBlocksOutOfOrder;
+/** Hashes of the blocks in mapBlocksOutOfOrder, by the hash of their parent. */
+std::multimap<uint256, uint256> mapBlocksOutOfOrderByPrev;
+/** Total size of the blocks in mapBlocksOutOfOrder. */
+size_t nBlocksOutOfOrderSize = 0;
+
+/** Whether there is room in mapBlocksOutOfOrder for one more block of nSize bytes. */
+bool static HaveRoomOutOfOrder(size_t nSize)
+{
+    return mapBlocksOutOfOrder.size() < MAX_BLOCKS_OUT_OF_ORDER && nBlocksOutOfOrderSize + nSize <= MAX_BLOCKS_OUT_OF_ORDER_SIZE;
+}
+
+/**
+ * Drop the blocks waiting for a parent for longer than BLOCK_OUT_OF_ORDER_EXPIRY,
+ * e.g. because it is on a chain that turned out invalid or was never sent. The
+ * ones still in the download window are requested again.
+ */
+void static ExpireBlocksOutOfOrder()
+{
+    AssertLockHeld(cs_main);
+    const int64_t nExpiry = GetTime() - BLOCK_OUT_OF_ORDER_EXPIRY;
+    for (auto it = mapBlocksOutOfOrder.begin(); it != mapBlocksOutOfOrder.end();) {
+        if (it->second.nTimeReceived > nExpiry) {
+            ++it;
+            continue;
+        }
+        LogPrint(BCLog::NET, "%s : dropping block %s, its parent %s did not arrive\n", __func__,
+            it->first.ToString(), it->second.block.hashPrevBlock.ToString());
+        auto range = mapBlocksOutOfOrderByPrev.equal_range(it->second.block.hashPrevBlock);
+        for (auto itPrev = range.first; itPrev != range.second; ++itPrev) {
+            if (itPrev->second == it->first) {
+                mapBlocksOutOfOrderByPrev.erase(itPrev);
+                break;
+            }
+        }
+        nBlocksOutOfOrderSize -= it->second.nSize;
+        it = mapBlocksOutOfOrder.erase(it);
+    }
+}
+
+/**
+ * Serialized blocks recently served to peers, most recently used first. Peers
+ * syncing from us ask for the same blocks, which are then read from disk once.
+ */
+class CServedBlockCache
+{
+private:
+    typedef std::shared_ptr<const std::vector<unsigned char> > BlockPtr;
+    typedef std::list<std::pair<uint256, BlockPtr> > BlockList;
+
+    RecursiveMutex cs;
+    BlockList listBlocks;
+    boost::unordered_map<uint256, BlockList::iterator, BlockHasher> mapBlocks;
+    size_t nSize = 0;
+
+public:
+    BlockPtr Get(const uint256& hash)
+    {
+        LOCK(cs);
+        auto it = mapBlocks.find(hash);
+        if (it == mapBlocks.end())
+            return nullptr;
+        listBlocks.splice(listBlocks.begin(), listBlocks, it->second);
+        return it->second->second;
+    }
+
+    void Add(const uint256& hash, const BlockPtr& pvchBlock, size_t nMaxSize)
+    {
+        LOCK(cs);
+        if (pvchBlock->size() > nMaxSize || mapBlocks.count(hash))
+            return;
+        listBlocks.emplace_front(hash, pvchBlock);
+        mapBlocks.emplace(hash, listBlocks.begin());
+        nSize += pvchBlock->size();
+        while (nSize > nMaxSize) {
+            nSize -= listBlocks.back().second->size();
+            mapBlocks.erase(listBlocks.back().first);
+            listBlocks.pop_back();
+        }
+    }
+
+    void Clear()
+    {
+        LOCK(cs);
+        listBlocks.clear();
+        mapBlocks.clear();
+        nSize = 0;
+    }
+};
+CServedBlockCache servedBlockCache;
+
+/** Peers asked to announce their new blocks as compact blocks straight away, oldest first. Protected by cs_main. */
+std::list<NodeId> lNodesAnnouncingHeaderAndIDs;
+
+/** Compact block of the last tip connected from a full block, sent as is to the peers that announce with it. */
+RecursiveMutex cs_mostRecentCompactBlock;
+std::shared_ptr<const CBlockHeaderAndShortTxIDs> pMostRecentCompactBlock;
+uint256 hashMostRecentCompactBlock;
+
 /** Number of preferable block download peers. */
 int nPreferredDownload = 0;
 
@@ -347,6 +465,10 @@ struct CNodeState {
     int nBlocksInFlight;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
+    //! Whether this peer wants new blocks announced as cmpctblocks instead of invs.
+    bool fPreferHeaderAndIDs;
+    //! Whether this peer will send us cmpctblocks if we request them.
+    bool fProvidesHeaderAndIDs;
 
     CNodeBlocks nodeBlocks;
 
@@ -361,6 +483,8 @@ struct CNodeState {
         nStallingSince = 0;
         nBlocksInFlight = 0;
         fPreferredDownload = false;
+        fPreferHeaderAndIDs = false;
+        fProvidesHeaderAndIDs = false;
     }
 };
 
@@ -433,6 +557,7 @@ void FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTime)
 
     for (const QueuedBlock& entry : state->vBlocksInFlight)
         mapBlocksInFlight.erase(entry.hash);
+    lNodesAnnouncingHeaderAndIDs.remove(nodeid);
     EraseOrphansFor(nodeid);
     nPreferredDownload -= state->fPreferredDownload;
 
@@ -462,9 +587,9 @@ void MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, CBlockIndex* pindex
     // Make sure it's not listed somewhere already.
     MarkBlockAsReceived(hash);
 
-    QueuedBlock newentry = {hash, pindex, GetTimeMicros(), nQueuedValidatedHeaders, pindex != NULL};
+    QueuedBlock newentry = {hash, pindex, GetTimeMicros(), nQueuedValidatedHeaders, pindex != NULL, nullptr};
     nQueuedValidatedHeaders += newentry.fValidatedHeaders;
-    std::list<QueuedBlock>::iterator it = state->vBlocksInFlight.insert(state->vBlocksInFlight.end(), newentry);
+    std::list<QueuedBlock>::iterator it = state->vBlocksInFlight.insert(state->vBlocksInFlight.end(), std::move(newentry));
     state->nBlocksInFlight++;
     mapBlocksInFlight[hash] = std::make_pair(nodeid, it);
 }
@@ -504,6 +629,58 @@ void UpdateBlockAvailability(NodeId nodeid, const uint256& hash)
     }
 }
 
+/** Whether the tip is recent enough to request announced blocks directly, instead of in the download window. */
+bool CanDirectFetch()
+{
+    return chainActive.Tip()->GetBlockTime() > GetAdjustedTime() - Params().GetConsensus().nTargetSpacing * 20;
+}
+
+/**
+ * Ask a peer that gave us a new tip to announce its next blocks as compact
+ * blocks without waiting for a getdata, and ask the oldest such peer to stop
+ * when there are too many of them.
+ */
+void MaybeSetPeerAsAnnouncingHeaderAndIDs(const CNodeState* nodestate, CNode* pfrom, CConnman& connman)
+{
+    if (!nodestate->fProvidesHeaderAndIDs)
+        return;
+    for (std::list<NodeId>::iterator it = lNodesAnnouncingHeaderAndIDs.begin(); it != lNodesAnnouncingHeaderAndIDs.end(); it++) {
+        if (*it == pfrom->GetId()) {
+            lNodesAnnouncingHeaderAndIDs.erase(it);
+            lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
+            return;
+        }
+    }
+    if (lNodesAnnouncingHeaderAndIDs.size() >= MAX_CMPCTBLOCK_HIGH_BANDWIDTH_PEERS) {
+        // As per BIP152, we only get 3 of our peers to announce
+        // blocks using compact encodings.
+        connman.ForNode(lNodesAnnouncingHeaderAndIDs.front(), [&connman](CNode* pnodeStop) {
+            connman.PushMessage(pnodeStop, CNetMsgMaker(pnodeStop->GetSendVersion()).Make(NetMsgType::SENDCMPCT, false, CMPCTBLOCKS_VERSION));
+            return true;
+        });
+        lNodesAnnouncingHeaderAndIDs.pop_front();
+    }
+    connman.PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::SENDCMPCT, true, CMPCTBLOCKS_VERSION));
+    lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
+}
+
+void SetMostRecentCompactBlock(const CBlock& block)
+{
+    std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs>(block);
+    LOCK(cs_mostRecentCompactBlock);
+    pMostRecentCompactBlock = pcmpctblock;
+    hashMostRecentCompactBlock = block.GetHash();
+}
+
+/** The compact block of the given block, if it is the most recent one. */
+std::shared_ptr<const CBlockHeaderAndShortTxIDs> GetMostRecentCompactBlock(const uint256& hash)
+{
+    LOCK(cs_mostRecentCompactBlock);
+    if (hash != hashMostRecentCompactBlock)
+        return nullptr;
+    return pMostRecentCompactBlock;
+}
+
 /** Find the last common ancestor two blocks have.
  *  Both pa and pb must be non-NULL. */
 CBlockIndex* LastCommonAncestor(CBlockIndex* pa, CBlockIndex* pb)
@@ -586,8 +763,17 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<CBl
             if (pindex->nStatus & BLOCK_HAVE_DATA) {
                 if (pindex->nChainTx)
                     state->pindexLastCommonBlock = pindex;
+            } else if (mapBlocksOutOfOrder.count(pindex->GetBlockHash())) {
+                // Downloaded already, waiting for its parent.
+                continue;
             } else if (mapBlocksInFlight.count(pindex->GetBlockHash()) == 0) {
                 // The block is not already downloaded, and not yet in flight.
+                if (!(pindex->pprev->nStatus & BLOCK_HAVE_DATA) && !HaveRoomOutOfOrder(0)) {
+                    // No room to keep it until its parent arrives; only fetch blocks that can be stored now.
+                    ExpireBlocksOutOfOrder();
+                    if (!HaveRoomOutOfOrder(0))
+                        return;
+                }
                 if (pindex->nHeight > nWindowEnd) {
                     // We reached the end of the window.
                     if (vBlocks.size() == 0 && waitingfor != nodeid) {
@@ -866,18 +1052,14 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
     }
 
     // ----------- burn address scanning -----------
-    if (!consensus.mBurnAddresses.empty()) {
+    if (!g_burn_addresses.empty()) {
         for (unsigned int i = 0; i < tx.vin.size(); ++i) {
             uint256 hashBlock;
             CTransaction txPrev;
             if (GetTransaction(tx.vin[i].prevout.hash, txPrev, hashBlock, true)) { // get the vin's previous transaction
-                CTxDestination source;
-                if (ExtractDestination(txPrev.vout[tx.vin[i].prevout.n].scriptPubKey, source)) { // extract the destination of the previous transaction's vout[n]
-                    const std::string addr = EncodeDestination(source);
-                    if (consensus.mBurnAddresses.find(addr) != consensus.mBurnAddresses.end() &&
-                        consensus.mBurnAddresses.at(addr) < chainHeight) {
-                        return state.DoS(0, false, REJECT_INVALID, "bad-txns-invalid-outputs");
-                    }
+                // check the destination of the previous transaction's vout[n]
+                if (g_burn_addresses.IsBurned(txPrev.vout[tx.vin[i].prevout.n].scriptPubKey, chainHeight)) {
+                    return state.DoS(0, false, REJECT_INVALID, "bad-txns-invalid-outputs");
                 }
             }
         }
@@ -1044,23 +1226,25 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
             flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
 
         PrecomputedTransactionData precomTxData(tx);
-        if (!CheckInputs(tx, state, view, true, flags, true, precomTxData)) {
+        if (!CheckInputs(tx, state, view, true, flags, true, false, precomTxData)) {
             return false;
         }
 
-        // Check again against just the consensus-critical mandatory script
-        // verification flags, in case of bugs in the standard flags that cause
-        // transactions to pass as valid when they're actually invalid. For
-        // instance the STRICTENC flag was incorrectly allowing certain
-        // CHECKSIG NOT scripts to pass, even though they were invalid.
+        // Check again against just the consensus-critical script verification
+        // flags blocks are checked with, in case of bugs in the standard flags
+        // that cause transactions to pass as valid when they're actually
+        // invalid. For instance the STRICTENC flag was incorrectly allowing
+        // certain CHECKSIG NOT scripts to pass, even though they were invalid.
+        // The result is kept in the script execution cache, so that the
+        // scripts are not run again when the transaction is mined.
         //
         // There is a similar check in CreateNewBlock() to prevent creating
         // invalid blocks, however allowing such transactions into the mempool
         // can be exploited as a DoS attack.
-        flags = MANDATORY_SCRIPT_VERIFY_FLAGS;
+        flags = SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_DERSIG;
         if (fCLTVIsActivated)
             flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
-        if (!CheckInputs(tx, state, view, true, flags, true, precomTxData)) {
+        if (!CheckInputs(tx, state, view, true, flags, true, true, precomTxData)) {
             return error("%s: BUG! PLEASE REPORT THIS! ConnectInputs failed against MANDATORY but not STANDARD flags %s, %s",
                     __func__, hash.ToString(), FormatStateMessage(state));
         }
@@ -1258,7 +1442,7 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
             flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
 
         PrecomputedTransactionData precomTxData(tx);
-        if (!CheckInputs(tx, state, view, false, flags, true, precomTxData)) {
+        if (!CheckInputs(tx, state, view, false, flags, true, false, precomTxData)) {
             return error("AcceptableInputs: : ConnectInputs failed %s", hash.ToString());
         }
 
@@ -1272,7 +1456,7 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
         // invalid blocks, however allowing such transactions into the mempool
         // can be exploited as a DoS attack.
         // for any real tx this will be checked on AcceptToMemoryPool anyway
-        //        if (!CheckInputs(tx, state, view, false, MANDATORY_SCRIPT_VERIFY_FLAGS, true, precomTxData))
+        //        if (!CheckInputs(tx, state, view, false, MANDATORY_SCRIPT_VERIFY_FLAGS, true, false, precomTxData))
         //        {
         //            return error("AcceptableInputs: : BUG! PLEASE REPORT THIS! ConnectInputs failed against MANDATORY but not STANDARD flags %s", hash.ToString());
         //        }
@@ -1385,7 +1569,7 @@ bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos)
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
+static bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, bool fCheckHeader)
 {
     block.SetNull();
 
@@ -1402,7 +1586,7 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
     }
 
     // Check the header
-    if (block.IsProofOfWork()) {
+    if (fCheckHeader && block.IsProofOfWork()) {
         if (!CheckProofOfWork(block.GetHash(), block.nBits))
             return error("ReadBlockFromDisk : Errors in block header");
     }
@@ -1410,8 +1594,50 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
     return true;
 }
 
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
+{
+    return ReadBlockFromDisk(block, pos, true);
+}
+
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vchBlock, const CDiskBlockPos& pos)
+{
+    // The index header written by WriteBlockToDisk precedes the block
+    if (pos.nPos < MESSAGE_START_SIZE + sizeof(unsigned int))
+        return error("%s : no index header before block at file %d pos %u", __func__, pos.nFile, pos.nPos);
+    CDiskBlockPos posHeader(pos.nFile, pos.nPos - MESSAGE_START_SIZE - sizeof(unsigned int));
+
+    CAutoFile filein(OpenBlockFile(posHeader, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s : OpenBlockFile failed", __func__);
+
+    try {
+        CMessageHeader::MessageStartChars pchMessageStart;
+        unsigned int nSize;
+        filein >> FLATDATA(pchMessageStart) >> nSize;
+        if (memcmp(pchMessageStart, Params().MessageStart(), MESSAGE_START_SIZE))
+            return error("%s : bad message start before block at file %d pos %u", __func__, pos.nFile, pos.nPos);
+        if (nSize < 80 || nSize > MAX_BLOCK_SIZE_CURRENT)
+            return error("%s : bad block size %u at file %d pos %u", __func__, nSize, pos.nFile, pos.nPos);
+
+        vchBlock.resize(nSize);
+        filein.read((char*)vchBlock.data(), nSize);
+    } catch (const std::exception& e) {
+        return error("%s : I/O error - %s", __func__, e.what());
+    }
+
+    return true;
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex)
 {
+    if (!fCheckBlockReads) {
+        // the index entry was validated when the block was accepted, so its
+        // hash is trusted instead of running the legacy X11KVS chains again
+        if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), false))
+            return false;
+        block.SetCachedHash(pindex->GetBlockHash());
+        return true;
+    }
     if (!ReadBlockFromDisk(block, pindex->GetBlockPos()))
         return false;
     if (block.GetHash() != pindex->GetBlockHash()) {
@@ -1704,7 +1930,29 @@ bool CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoins
 }
 }// namespace Consensus
 
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheStore, PrecomputedTransactionData& precomTxData, std::vector<CScriptCheck> *pvChecks)
+namespace {
+/**
+ * Transactions whose scripts all passed with a given set of flags, to avoid
+ * running them twice (once when accepted into memory pool, and again when
+ * accepted into the block chain). Protected by cs_main.
+ */
+CuckooCache::cache<uint256, SignatureCacheHasher> scriptExecutionCache;
+//! Entries are SHA256(nonce || txid || flags)
+uint256 scriptExecutionCacheNonce;
+}
+
+void InitScriptExecutionCache()
+{
+    GetRandBytes(scriptExecutionCacheNonce.begin(), 32);
+    // nMaxCacheSize is unsigned. If -maxscriptcachesize is set to zero,
+    // setup_bytes creates the minimum possible cache (2 elements).
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, GetArg("-maxscriptcachesize", DEFAULT_MAX_SCRIPT_CACHE_SIZE)), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nElems = scriptExecutionCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for script execution cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+}
+
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& precomTxData, std::vector<CScriptCheck> *pvChecks)
 {
     if (!tx.IsCoinBase()) {
 
@@ -1722,6 +1970,15 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
         // before the last block chain checkpoint. This is safe because block merkle hashes are
         // still computed and checked, and any change will be caught at the next checkpoint.
         if (fScriptChecks) {
+            // First check if the scripts already passed with the same flags.
+            // The transaction hash commits to the prevouts, and so to the
+            // scriptPubKeys and amounts they are checked against.
+            uint256 hashCacheEntry;
+            CSHA256().Write(scriptExecutionCacheNonce.begin(), 32).Write(tx.GetHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
+            AssertLockHeld(cs_main);
+            if (scriptExecutionCache.contains(hashCacheEntry, !cacheFullScriptStore))
+                return true;
+
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 const COutPoint& prevout = tx.vin[i].prevout;
                 const Coin& coin = inputs.AccessCoin(prevout);
@@ -1736,7 +1993,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                 const CAmount amount = coin.out.nValue;
 
                 // Verify signature
-                CScriptCheck check(scriptPubKey, amount, tx, i, flags, cacheStore, &precomTxData);
+                CScriptCheck check(scriptPubKey, amount, tx, i, flags, cacheSigStore, &precomTxData);
                 if (pvChecks) {
                     pvChecks->push_back(CScriptCheck());
                     check.swap(pvChecks->back());
@@ -1749,7 +2006,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                         // avoid splitting the network between upgraded and
                         // non-upgraded nodes.
                         CScriptCheck check2(scriptPubKey, amount, tx, i,
-                            flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheStore, &precomTxData);
+                            flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheSigStore, &precomTxData);
                         if (check2())
                             return state.Invalid(false, REJECT_NONSTANDARD, strprintf("non-mandatory-script-verify-flag (%s)", ScriptErrorString(check.GetScriptError())));
                     }
@@ -1763,6 +2020,12 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                     return state.DoS(100, false, REJECT_INVALID, strprintf("mandatory-script-verify-flag-failed (%s)", ScriptErrorString(check.GetScriptError())));
                 }
             }
+
+            if (cacheFullScriptStore && !pvChecks) {
+                // We executed all of the provided scripts, and were told to
+                // cache the result. Do so now.
+                scriptExecutionCache.insert(hashCacheEntry);
+            }
         }
     }
 
@@ -1948,11 +2211,11 @@ DisconnectResult DisconnectBlock(CBlock& block, CBlockIndex* pindex, CCoinsViewC
         }
         for (unsigned int j = tx.vin.size(); j-- > 0;) {
             const COutPoint& out = tx.vin[j].prevout;
-            int res = ApplyTxInUndo(std::move(txundo.vprevout[j]), view, out);
+            // keep the undo data intact for the supply ledger
+            int res = ApplyTxInUndo(Coin(txundo.vprevout[j]), view, out);
             if (res == DISCONNECT_FAILED) return DISCONNECT_FAILED;
             fClean = fClean && res != DISCONNECT_UNCLEAN;
         }
-        // At this point, all of txundo.vprevout should have been moved out.
 
         if (view.HaveInputs(tx))
             nValueIn += view.GetValueIn(tx);
@@ -1962,8 +2225,10 @@ DisconnectResult DisconnectBlock(CBlock& block, CBlockIndex* pindex, CCoinsViewC
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
     // Clean lastPaid
+    pblocktree->ErasePayeeIndex(pindex->nHeight);
     auto amount = CMasternode::GetMasternodePayment(pindex->nHeight);
     auto paidPayee = block.GetPaidPayee(amount);
+    mnodeman.DisconnectPaidBlock(pindex, paidPayee);
     if(!paidPayee.empty()) {
         auto pmn = mnodeman.Find(paidPayee);
 
@@ -1973,7 +2238,7 @@ DisconnectResult DisconnectBlock(CBlock& block, CBlockIndex* pindex, CCoinsViewC
     }
 
     // Dynamic rewards management
-    if(!CRewards::DisconnectBlock(pindex)) return DISCONNECT_UNCLEAN;
+    if(!CRewards::DisconnectBlock(pindex, block, blockUndo)) return DISCONNECT_UNCLEAN;
 
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
@@ -2011,6 +2276,58 @@ void ThreadScriptCheck()
     scriptcheckqueue.Thread();
 }
 
+/** Closure computing the hash of a legacy block header, see PrecomputeBlockHashes. */
+class CHeaderHashCheck
+{
+private:
+    const CBlockHeader* pheader;
+
+public:
+    CHeaderHashCheck() : pheader(nullptr) {}
+    CHeaderHashCheck(const CBlockHeader* pheaderIn) : pheader(pheaderIn) {}
+
+    bool operator()()
+    {
+        pheader->PrecomputeHash();
+        return true;
+    }
+
+    void swap(CHeaderHashCheck& check)
+    {
+        std::swap(pheader, check.pheader);
+    }
+};
+
+static CCheckQueue<CHeaderHashCheck> headerhashqueue(16);
+//! The check queue supports a single master at a time
+static RecursiveMutex cs_headerhashqueue;
+
+void ThreadHeaderHash()
+{
+    util::ThreadRename("pivx-hdrhash");
+    headerhashqueue.Thread();
+}
+
+void PrecomputeBlockHashes(const std::vector<const CBlockHeader*>& vHeaders)
+{
+    if (!nScriptCheckThreads) return;
+
+    std::vector<CHeaderHashCheck> vChecks;
+    vChecks.reserve(vHeaders.size());
+    for (const CBlockHeader* pheader : vHeaders) {
+        if (pheader->IsLegacyHash()) vChecks.emplace_back(pheader);
+    }
+    if (vChecks.size() < 2) return;
+
+    // Another thread is already using the workers, let GetHash() do the work lazily
+    TRY_LOCK(cs_headerhashqueue, lockQueue);
+    if (!lockQueue) return;
+
+    CCheckQueueControl<CHeaderHashCheck> control(&headerhashqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
 static int64_t nTimeVerify = 0;
 static int64_t nTimeConnect = 0;
 static int64_t nTimeIndex = 0;
@@ -2128,7 +2445,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
                 flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
 
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
-            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, precomTxData[i], nScriptCheckThreads ? &vChecks : NULL))
+            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, precomTxData[i], nScriptCheckThreads ? &vChecks : NULL))
                 return error("%s: Check inputs on %s failed with %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
             control.Add(vChecks);
         }
@@ -2136,15 +2453,11 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         nUnspendableValue += tx.GetUnspendableValueOut();
 
         // ----------- burn address scanning -----------
-        if(nHeight > nLastCheckpointHeight) {
+        if(nHeight > nLastCheckpointHeight && !g_burn_addresses.empty()) {
             for (unsigned int i = 0; i < tx.vout.size(); i++) {
-                CTxDestination source;
-                if (tx.vout[i].scriptPubKey.IsNormalPaymentScript() && ExtractDestination(tx.vout[i].scriptPubKey, source)) {
-                    const std::string addr = EncodeDestination(source);
-                    if (consensus.mBurnAddresses.find(addr) != consensus.mBurnAddresses.end() &&
-                        consensus.mBurnAddresses.at(addr) < nHeight) {
-                        nUnspendableValue += tx.vout[i].nValue;
-                    }
+                if (tx.vout[i].scriptPubKey.IsNormalPaymentScript() &&
+                    g_burn_addresses.IsBurned(tx.vout[i].scriptPubKey, nHeight)) {
+                    nUnspendableValue += tx.vout[i].nValue;
                 }
             }
         }
@@ -2211,11 +2524,16 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!pblocktree->WriteTxIndex(vPos))
             return AbortNode(state, "Failed to write transaction index");
 
+    // Index the paid masternode so GetPaidPayee doesn't need to read the block back
+    auto paidPayee = block.GetPaidPayee(CMasternode::GetMasternodePayment(pindex->nHeight));
+    if (!pblocktree->WritePayeeIndex({std::make_pair(pindex->nHeight, CDiskPayee(pindex->GetBlockHash(), paidPayee))}))
+        return AbortNode(state, "Failed to write masternode payee index");
+
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
     // Recalculate the money supply taking in account the existent burn addresses
-    if(nHeight == nLastCheckpointHeight)
+    if(nHeight == nLastCheckpointHeight && !g_burn_addresses.empty())
     {
         std::unique_ptr<CCoinsViewCursor> pcursor(pcoinsTip->Cursor());
 
@@ -2225,16 +2543,11 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             Coin coin;
             if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
                 // ----------- burn address scanning -----------
-                CTxDestination source;
-                if (ExtractDestination(coin.out.scriptPubKey, source)) {
-                    const std::string addr = EncodeDestination(source);
-                    if (consensus.mBurnAddresses.find(addr) != consensus.mBurnAddresses.end() &&
-                        consensus.mBurnAddresses.at(addr) < nHeight) 
-                    {
-                        nUnspendableValue += coin.out.nValue;
-                        pcursor->Next();
-                        continue;
-                    }
+                if (g_burn_addresses.IsBurned(coin.out.scriptPubKey, nHeight))
+                {
+                    nUnspendableValue += coin.out.nValue;
+                    pcursor->Next();
+                    continue;
                 }
             }
             pcursor->Next();
@@ -2258,8 +2571,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     LogPrint(BCLog::BENCH, "    - Callbacks: %.2fms [%.2fs]\n", 0.001 * (nTime4 - nTime3), nTimeCallbacks * 0.000001);
 
     // Fill lastPaid
-    auto amount = CMasternode::GetMasternodePayment(pindex->nHeight);
-    auto paidPayee = block.GetPaidPayee(amount);
+    mnodeman.ConnectPaidBlock(pindex, paidPayee);
     if(!paidPayee.empty()) {
         auto pmn = mnodeman.Find(paidPayee);
 
@@ -2269,7 +2581,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     }
 
     // Dynamic rewards management
-    if(!CRewards::ConnectBlock(pindex, nMint, view)) return false;
+    if(!CRewards::ConnectBlock(pindex, nMint, view, block, blockundo)) return false;
 
     return true;
 }
@@ -2292,6 +2604,7 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
     static int64_t nLastWrite = 0;
     static int64_t nLastFlush = 0;
     static int64_t nLastSetChain = 0;
+    static int64_t nLastSnapshot = 0;
     try {
         int64_t nNow = GetTimeMicros();
         // Avoid writing/flushing immediately after startup.
@@ -2304,6 +2617,9 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
         if (nLastSetChain == 0) {
             nLastSetChain = nNow;
         }
+        if (nLastSnapshot == 0) {
+            nLastSnapshot = nNow;
+        }
         int64_t nMempoolSizeMax = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
         int64_t cacheSize = pcoinsTip->DynamicMemoryUsage() * DB_PEAK_USAGE_FACTOR;
         int64_t nTotalSpace = nCoinCacheUsage + std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
@@ -2346,6 +2662,12 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
                 }
             }
             nLastWrite = nNow;
+            // The block index database matches the memory now, a failed snapshot only slows down the next start.
+            // The shutdown writes its own snapshot after its final flush, see WriteBlockIndexSnapshot.
+            if (fBlockIndexSnapshot && mode != FLUSH_STATE_ALWAYS && nNow > nLastSnapshot + (int64_t)BLOCK_INDEX_SNAPSHOT_INTERVAL * 1000000) {
+                CBlockIndexSnapshot::Write();
+                nLastSnapshot = nNow;
+            }
         }
 
         // Flush best chain related state. This can only be done if the blocks / block index write was also done.
@@ -2361,6 +2683,9 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
             if (!pcoinsTip->Flush())
                 return AbortNode(state, "Failed to write to coin database");
             nLastFlush = nNow;
+            // Persist the supply ledger along the periodic flushes, it is rebuilt if a crash leaves it behind
+            if (mode == FLUSH_STATE_PERIODIC)
+                CRewards::FlushSupplyLedger();
         }
         if ((mode == FLUSH_STATE_ALWAYS || mode == FLUSH_STATE_PERIODIC) && nNow > nLastSetChain + (int64_t)DATABASE_WRITE_INTERVAL * 1000000) {
             // Update best block in wallet (so we can detect restored wallets).
@@ -2380,6 +2705,16 @@ void FlushStateToDisk()
     FlushStateToDisk(state, FLUSH_STATE_ALWAYS);
 }
 
+bool WriteBlockIndexSnapshot()
+{
+    AssertLockHeld(cs_main);
+    if (!fBlockIndexSnapshot)
+        return true;
+    if (!setDirtyBlockIndex.empty())
+        return error("%s: The block index is not flushed", __func__);
+    return CBlockIndexSnapshot::Write();
+}
+
 /** Update chainActive and related internal data structures. */
 void static UpdateTip(CBlockIndex* pindexNew)
 {
@@ -2819,6 +3154,8 @@ bool ActivateBestChain(CValidationState& state, const CBlock* pblock, bool fAlre
                 uint256 hashNewTip = pindexNewTip->GetBlockHash();
                 // Relay inventory, but don't relay old inventory during initial block download.
                 int nBlockEstimate = Checkpoints::GetTotalBlocksEstimate();
+                if (pblock && pblock->GetHash() == hashNewTip)
+                    SetMostRecentCompactBlock(*pblock);
                 {
                     if (connman) {
                         connman->ForEachNode([pindexNewTip, nBlockEstimate, hashNewTip](CNode* pnode) {
@@ -2925,6 +3262,20 @@ bool ReconsiderBlock(CValidationState& state, CBlockIndex* pindex)
     return true;
 }
 
+/** Compute the stake modifier of a new block index entry, which needs the block transactions. */
+void static SetBlockStakeModifier(CBlockIndex* pindexNew, const CBlock& block)
+{
+    const Consensus::Params& consensus = Params().GetConsensus();
+    if (!consensus.NetworkUpgradeActive(pindexNew->nHeight, Consensus::UPGRADE_STAKE_MODIFIER_V2)) {
+        // compute and set new V1 stake modifier (entropy bits)
+        pindexNew->SetNewStakeModifier();
+
+    } else {
+        // compute and set new V2 stake modifier (hash of prevout and prevModifier)
+        pindexNew->SetNewStakeModifier(block.vtx[1].vin[0].prevout.hash);
+    }
+}
+
 CBlockIndex* AddToBlockIndex(const CBlock& block)
 {
     // Check for duplicate
@@ -2934,8 +3285,7 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
-    assert(pindexNew);
+    CBlockIndex* pindexNew = blockIndexArena.New(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -2949,15 +3299,9 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
         pindexNew->nHeight = pindexNew->pprev->nHeight + 1;
         pindexNew->BuildSkip();
 
-        const Consensus::Params& consensus = Params().GetConsensus();
-        if (!consensus.NetworkUpgradeActive(pindexNew->nHeight, Consensus::UPGRADE_STAKE_MODIFIER_V2)) {
-            // compute and set new V1 stake modifier (entropy bits)
-            pindexNew->SetNewStakeModifier();
-
-        } else {
-            // compute and set new V2 stake modifier (hash of prevout and prevModifier)
-            pindexNew->SetNewStakeModifier(block.vtx[1].vin[0].prevout.hash);
-        }
+        // A header alone (headers first sync) gets it with the block, in AcceptBlock
+        if (!block.vtx.empty())
+            SetBlockStakeModifier(pindexNew, block);
     }
     pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew);
     pindexNew->RaiseValidity(BLOCK_VALID_TREE);
@@ -3160,36 +3504,38 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
     }
 
     // masternode payments / budgets
-    CBlockIndex* pindexPrev = chainActive.Tip();
-    int nHeight = 0;
-    if (pindexPrev != NULL) {
-        if (pindexPrev->GetBlockHash() == block.hashPrevBlock) {
-            nHeight = pindexPrev->nHeight + 1;
-        } else { // Out of order, blocks arrives in order, so if prev block is not the tip then we are on a fork.
-            BlockMap::iterator mi = mapBlockIndex.find(block.hashPrevBlock);
-            if (mi != mapBlockIndex.end() && (*mi).second) {
-                nHeight = (*mi).second->nHeight + 1;
+    // __Decenomy__
+    // It is entirely possible that we don't have enough data and this could fail
+    // (i.e. the block could indeed be valid). Store the block for later consideration
+    // but issue an initial reject message.
+    // The case also exists that the sending peer could not have enough data to see
+    // that this block is invalid, so don't issue an outright ban.
+    // The chain is only looked at for recent blocks once synced, the other
+    // checks are context-free and run on the import threads.
+    if (GetAdjustedTime() - block.GetBlockTime() < DEFAULT_BLOCK_PAYEE_VERIFICATION_TIMEOUT &&
+        !IsInitialBlockDownload())
+    {
+        LOCK(cs_main);
+        CBlockIndex* pindexPrev = chainActive.Tip();
+        int nHeight = 0;
+        if (pindexPrev != NULL) {
+            if (pindexPrev->GetBlockHash() == block.hashPrevBlock) {
+                nHeight = pindexPrev->nHeight + 1;
+            } else { // Out of order, blocks arrives in order, so if prev block is not the tip then we are on a fork.
+                BlockMap::iterator mi = mapBlockIndex.find(block.hashPrevBlock);
+                if (mi != mapBlockIndex.end() && (*mi).second) {
+                    nHeight = (*mi).second->nHeight + 1;
+                }
             }
         }
 
-        // __Decenomy__
-        // It is entirely possible that we don't have enough data and this could fail
-        // (i.e. the block could indeed be valid). Store the block for later consideration
-        // but issue an initial reject message.
-        // The case also exists that the sending peer could not have enough data to see
-        // that this block is invalid, so don't issue an outright ban.
-        if (nHeight != 0 && 
-            !IsInitialBlockDownload() &&
-            GetAdjustedTime() - block.GetBlockTime() < DEFAULT_BLOCK_PAYEE_VERIFICATION_TIMEOUT)
-        {
-            // check masternode payment
-            if (!IsBlockPayeeValid(block, nHeight)) {
-                mapRejectedBlocks.insert(std::make_pair(block.GetHash(), GetTime()));
-                return state.DoS(0, false, REJECT_INVALID, "bad-cb-payee", false, "Couldn't find masternode payment");
-            }
-        } else {
-            LogPrintf("%s: Masternode payment checks skipped on sync and second layer verification timeout\n", __func__);
+        // check masternode payment
+        if (nHeight != 0 && !IsBlockPayeeValid(block, nHeight)) {
+            mapRejectedBlocks.insert(std::make_pair(block.GetHash(), GetTime()));
+            return state.DoS(0, false, REJECT_INVALID, "bad-cb-payee", false, "Couldn't find masternode payment");
         }
+    } else {
+        LogPrintf("%s: Masternode payment checks skipped on sync and second layer verification timeout\n", __func__);
     }
 
     // Check transactions
@@ -3365,20 +3711,19 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, CBlockIn
     }
 
     // ----------- burn address scanning -----------
-    if (!consensus.mBurnAddresses.empty()) {
+    if (!g_burn_addresses.empty()) {
         for (const CTransaction& tx : block.vtx) {
             if (!tx.IsCoinBase()) {
                 for (unsigned int i = 0; i < tx.vin.size(); ++i) {
                     uint256 hashBlock;
                     CTransaction txPrev;
                     if (GetTransaction(tx.vin[i].prevout.hash, txPrev, hashBlock, true)) { // get the vin's previous transaction
-                        CTxDestination source;
-                        if (ExtractDestination(txPrev.vout[tx.vin[i].prevout.n].scriptPubKey, source)) { // extract the destination of the previous transaction's vout[n]
+                        const CScript& scriptPrev = txPrev.vout[tx.vin[i].prevout.n].scriptPubKey; // the destination of the previous transaction's vout[n]
+                        if (g_burn_addresses.IsBurned(scriptPrev, nHeight)) {
+                            CTxDestination source;
+                            ExtractDestination(scriptPrev, source);
                             const std::string addr = EncodeDestination(source);
-                            if (consensus.mBurnAddresses.find(addr) != consensus.mBurnAddresses.end() &&
-                                consensus.mBurnAddresses.at(addr) < nHeight) {
-                                return state.DoS(100, error("%s : Burned address %s tried to send a transaction %s (rejecting it).", __func__, addr.c_str(), txPrev.GetHash().ToString().c_str()), REJECT_INVALID, "bad-txns-banned");
-                            }
+                            return state.DoS(100, error("%s : Burned address %s tried to send a transaction %s (rejecting it).", __func__, addr.c_str(), txPrev.GetHash().ToString().c_str()), REJECT_INVALID, "bad-txns-banned");
                         }
                     }
                 }
@@ -3432,13 +3777,24 @@ bool AcceptBlockHeader(const CBlock& block, CValidationState& state, CBlockIndex
         return true;
     }
 
-    if (!CheckBlockHeader(block, state, !block.IsProofOfStake())) {
+    // A header received alone (headers first sync) has no coinstake to tell
+    // proof of stake, past the PoS upgrade blocks can only be proof of stake.
+    const Consensus::Params& consensus = Params().GetConsensus();
+    const bool fHeaderOnly = block.vtx.empty() && hash != consensus.hashGenesisBlock;
+    bool fProofOfStake = block.IsProofOfStake();
+    if (fHeaderOnly) {
+        BlockMap::iterator mi = mapBlockIndex.find(block.hashPrevBlock);
+        if (mi != mapBlockIndex.end())
+            fProofOfStake = consensus.NetworkUpgradeActive(mi->second->nHeight + 1, Consensus::UPGRADE_POS);
+    }
+
+    if (!CheckBlockHeader(block, state, !fProofOfStake)) {
         return error("%s: CheckBlockHeader failed for block %s: %s", __func__, hash.ToString(), FormatStateMessage(state));
     }
 
     // Get prev block index
     CBlockIndex* pindexPrev = NULL;
-    if (hash != Params().GetConsensus().hashGenesisBlock) {
+    if (hash != consensus.hashGenesisBlock) {
         BlockMap::iterator mi = mapBlockIndex.find(block.hashPrevBlock);
         if (mi == mapBlockIndex.end())
             return state.DoS(0, error("%s : prev block %s not found", __func__, block.hashPrevBlock.GetHex()), 0, "bad-prevblk");
@@ -3470,6 +3826,10 @@ bool AcceptBlockHeader(const CBlock& block, CValidationState& state, CBlockIndex
     if (!ContextualCheckBlockHeader(block, state, pindexPrev))
         return error("%s: ContextualCheckBlockHeader failed for block %s: %s", __func__, hash.ToString(), FormatStateMessage(state));
 
+    // AcceptBlock checks the difficulty of full blocks before getting here
+    if (fHeaderOnly && !CheckWork(block, pindexPrev))
+        return state.DoS(100, error("%s : incorrect difficulty for header %s", __func__, hash.ToString()), REJECT_INVALID, "bad-diffbits");
+
     if (pindex == NULL)
         pindex = AddToBlockIndex(block);
 
@@ -3520,6 +3880,9 @@ bool AcceptBlock(const CBlock& block, CValidationState& state, CBlockIndex** ppi
     if (block.GetHash() != consensus.hashGenesisBlock && !CheckWork(block, pindexPrev))
         return false;
 
+    // Whether the header came first, alone
+    const bool fKnownHeader = mapBlockIndex.count(block.GetHash());
+
     bool isPoS = block.IsProofOfStake();
     if (isPoS) {
         std::string strError;
@@ -3537,6 +3900,9 @@ bool AcceptBlock(const CBlock& block, CValidationState& state, CBlockIndex** ppi
         return true;
     }
 
+    if (fKnownHeader && pindex->pprev)
+        SetBlockStakeModifier(pindex, block);
+
     if ((!fAlreadyCheckedBlock && !CheckBlock(block, state)) || !ContextualCheckBlock(block, state, pindex->pprev)) {
         if (state.IsInvalid() && !state.CorruptionPossible()) {
             pindex->nStatus |= BLOCK_FAILED_VALID;
@@ -3889,9 +4255,7 @@ CBlockIndex* InsertBlockIndex(uint256 hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
-    if (!pindexNew)
-        throw std::runtime_error("LoadBlockIndex() : new CBlockIndex failed");
+    CBlockIndex* pindexNew = blockIndexArena.New();
     mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
 
     pindexNew->phashBlock = &((*mi).first);
@@ -3901,19 +4265,23 @@ CBlockIndex* InsertBlockIndex(uint256 hash)
 
 bool static LoadBlockIndexDB(std::string& strError)
 {
-    if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex))
-        return false;
+    // The snapshot comes already sorted by height
+    std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
+    if (!fBlockIndexSnapshot || !CBlockIndexSnapshot::Load(vSortedByHeight)) {
+        if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex))
+            return false;
 
-    boost::this_thread::interruption_point();
+        boost::this_thread::interruption_point();
 
-    // Calculate nChainWork
-    std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
-    vSortedByHeight.reserve(mapBlockIndex.size());
-    for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex) {
-        CBlockIndex* pindex = item.second;
-        vSortedByHeight.push_back(std::make_pair(pindex->nHeight, pindex));
+        vSortedByHeight.reserve(mapBlockIndex.size());
+        for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex) {
+            CBlockIndex* pindex = item.second;
+            vSortedByHeight.push_back(std::make_pair(pindex->nHeight, pindex));
+        }
+        std::sort(vSortedByHeight.begin(), vSortedByHeight.end());
     }
-    std::sort(vSortedByHeight.begin(), vSortedByHeight.end());
+
+    // Calculate nChainWork
     for (const PAIRTYPE(int, CBlockIndex*) & item : vSortedByHeight) {
         // Stop if shutdown was requested
         if (ShutdownRequested()) return false;
@@ -4110,7 +4478,12 @@ void ResyncSupply()
         return;
 
     CAmount nMoneySupply = 0;
-    auto& consensus = Params().GetConsensus();
+
+    // the supply ledger has it already if it follows the tip
+    if (CRewards::GetMoneySupply(chainActive.Tip(), nMoneySupply)) {
+        chainActive.Tip()->nMoneySupply = nMoneySupply;
+        return;
+    }
 
     std::unique_ptr<CCoinsViewCursor> pcursor(pcoinsTip->Cursor());
 
@@ -4120,14 +4493,9 @@ void ResyncSupply()
         Coin coin;
         if (pcursor->GetKey(key) && pcursor->GetValue(coin) && !coin.IsSpent()) {
             // ----------- burn address scanning -----------
-            CTxDestination source;
-            if (ExtractDestination(coin.out.scriptPubKey, source)) {
-                const std::string addr = EncodeDestination(source);
-                if (consensus.mBurnAddresses.find(addr) != consensus.mBurnAddresses.end() &&
-                    consensus.mBurnAddresses.at(addr) < chainActive.Height()) {
-                    pcursor->Next();
-                    continue;
-                }
+            if (g_burn_addresses.IsBurned(coin.out.scriptPubKey, chainActive.Height())) {
+                pcursor->Next();
+                continue;
             }
             nMoneySupply += coin.out.nValue;
         }
@@ -4137,6 +4505,43 @@ void ResyncSupply()
     chainActive.Tip()->nMoneySupply = nMoneySupply;
 }
 
+bool ReindexPayees()
+{
+    LOCK(cs_main);
+
+    if (chainActive.Tip() == NULL)
+        return true;
+
+    const int nTipHeight = chainActive.Height();
+    LogPrintf("Rebuilding the masternode payee index up to height %d...\n", nTipHeight);
+    uiInterface.ShowProgress(_("Indexing masternode payees..."), 0);
+
+    std::vector<std::pair<int, CDiskPayee> > vPayees;
+    for (CBlockIndex* pindex = chainActive.Genesis(); pindex; pindex = chainActive.Next(pindex)) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested()) break;
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex))
+            return error("%s: *** ReadBlockFromDisk failed at %d, hash=%s", __func__, pindex->nHeight, pindex->GetBlockHash().ToString());
+
+        auto paidPayee = block.GetPaidPayee(CMasternode::GetMasternodePayment(pindex->nHeight));
+        vPayees.emplace_back(pindex->nHeight, CDiskPayee(pindex->GetBlockHash(), paidPayee));
+
+        if (vPayees.size() >= 1000 || pindex == chainActive.Tip()) {
+            if (!pblocktree->WritePayeeIndex(vPayees))
+                return error("%s: failed to write the payee index at height %d", __func__, pindex->nHeight);
+            vPayees.clear();
+            uiInterface.ShowProgress(_("Indexing masternode payees..."), std::max(1, std::min(99, (int)((double)pindex->nHeight / (double)std::max(1, nTipHeight) * 100))));
+        }
+    }
+
+    uiInterface.ShowProgress("", 100);
+    LogPrintf("Masternode payee index rebuilt\n");
+
+    return true;
+}
+
 bool RewindBlockIndex(std::string param)
 {
     LOCK(cs_main);
@@ -4269,8 +4674,9 @@ bool RewindBlockIndex(std::string param)
     for (auto pindex : vBlocks) {
         auto ret = mapBlockIndex.find(*pindex->phashBlock);
         if (ret != mapBlockIndex.end()) {
+            CBlockIndex* pindexErase = ret->second;
             mapBlockIndex.erase(ret);
-            delete pindex;
+            blockIndexArena.Delete(pindexErase);
         }
     }
 
@@ -4297,6 +4703,10 @@ void UnloadBlockIndex()
     mapOrphanTransactionsByPrev.clear();
     nSyncStarted = 0;
     mapBlocksUnlinked.clear();
+    mapBlocksOutOfOrder.clear();
+    mapBlocksOutOfOrderByPrev.clear();
+    nBlocksOutOfOrderSize = 0;
+    servedBlockCache.Clear();
     vinfoBlockFile.clear();
     nLastBlockFile = 0;
     nBlockSequenceId = 1;
@@ -4310,7 +4720,7 @@ void UnloadBlockIndex()
     recentRejects.reset(nullptr);
 
     for (BlockMap::value_type& entry : mapBlockIndex) {
-        delete entry.second;
+        blockIndexArena.Delete(entry.second);
     }
     mapBlockIndex.clear();
 }
@@ -4366,88 +4776,288 @@ bool InitBlockIndex()
 }
 
 
-bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
+namespace {
+
+/** A block record of an external block file, on its way through CBlockFileImporter */
+struct CImportedBlock
 {
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
-    int64_t nStart = GetTimeMillis();
+    //! serialized block, until it is decoded
+    std::vector<char> vchBlock;
+    unsigned int nSize = 0;
+    CDiskBlockPos pos;
+    //! null if the block could not be decoded
+    std::shared_ptr<CBlock> pblock;
+    bool fDecoded = false;
+};
 
-    int nLoaded = 0;
-    try {
-        // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
-        CBufferedFile blkdat(fileIn, 2 * MAX_BLOCK_SIZE_CURRENT, MAX_BLOCK_SIZE_CURRENT + 8, SER_DISK, CLIENT_VERSION);
-        uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
-            boost::this_thread::interruption_point();
+/**
+ * Reads the blocks of an external block file for LoadExternalBlockFile, in
+ * stages running side by side:
+ * - a reader thread locates the block records and reads their bytes,
+ * - decoding threads deserialize them, hash their headers and run the
+ *   context-free checks of CheckBlock, whose result the block remembers,
+ * - Next() hands them out in file order, to be connected.
+ * At most IMPORT_BATCH_BLOCKS blocks, or IMPORT_BATCH_SIZE bytes, are read
+ * ahead of the block handed out last.
+ */
+class CBlockFileImporter
+{
+private:
+    CBufferedFile blkdat;
+    const CDiskBlockPos* const dbp;
+    uint64_t nFileSize;
+    std::atomic<uint64_t> nBytesRead{0};
+
+    std::mutex cs;
+    //! signaled when there is room to read ahead, or on stop
+    std::condition_variable condRead;
+    //! signaled when there is a block to decode, or the file is read
+    std::condition_variable condDecode;
+    //! signaled when a block is decoded, or the file is read
+    std::condition_variable condNext;
+    std::deque<std::shared_ptr<CImportedBlock> > queueDecode;
+    std::deque<std::shared_ptr<CImportedBlock> > queueNext;
+    uint64_t nBytesAhead = 0;
+    bool fReadDone = false;
+    bool fStop = false;
+
+    std::thread threadRead;
+    std::vector<std::thread> vThreadsDecode;
+
+    void ThreadRead();
+    void ThreadDecode();
 
-            blkdat.SetPos(nRewind);
-            nRewind++;         // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[MESSAGE_START_SIZE];
-                blkdat.FindByte(Params().MessageStart()[0]);
-                nRewind = blkdat.GetPos() + 1;
-                blkdat >> FLATDATA(buf);
-                if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SIZE_CURRENT)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                break;
-            }
-            try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                CBlock block;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
+public:
+    CBlockFileImporter(FILE* fileIn, const CDiskBlockPos* dbpIn, int nDecodeThreads);
+    ~CBlockFileImporter();
+
+    /** Wait for the next block of the file, false once they were all handed out */
+    bool Next(std::shared_ptr<CImportedBlock>& item);
+    /** Part of the file read so far, between 0 and 1 */
+    double GetProgress() const;
+    uint64_t GetBytesRead() const { return nBytesRead; }
+};
 
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                if (hash != Params().GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-                    LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__,
-                            hash.GetHex(), block.hashPrevBlock.GetHex());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                    continue;
-                }
+CBlockFileImporter::CBlockFileImporter(FILE* fileIn, const CDiskBlockPos* dbpIn, int nDecodeThreads) :
+    // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
+    blkdat(fileIn, 2 * MAX_BLOCK_SIZE_CURRENT, MAX_BLOCK_SIZE_CURRENT + 8, SER_DISK, CLIENT_VERSION),
+    dbp(dbpIn),
+    nFileSize(0)
+{
+    const long nStartPos = ftell(fileIn);
+    if (nStartPos >= 0 && fseek(fileIn, 0, SEEK_END) == 0) {
+        nFileSize = std::max(0L, ftell(fileIn) - nStartPos);
+        fseek(fileIn, nStartPos, SEEK_SET);
+    }
 
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    CValidationState state;
-                    if (ProcessNewBlock(state, nullptr, &block, dbp, nullptr))
-                        nLoaded++;
-                    if (state.IsError())
-                        break;
-                } else if (hash != Params().GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
-                }
+    threadRead = std::thread(&CBlockFileImporter::ThreadRead, this);
+    for (int i = 0; i < nDecodeThreads; i++) {
+        vThreadsDecode.emplace_back(&CBlockFileImporter::ThreadDecode, this);
+    }
+}
 
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        if (ReadBlockFromDisk(block, it->second)) {
-                            LogPrintf("%s: Processing out of order child %s of %s\n", __func__, block.GetHash().ToString(),
-                                head.ToString());
-                            CValidationState dummy;
-                            if (ProcessNewBlock(dummy, nullptr, &block, &it->second, nullptr)) {
-                                nLoaded++;
-                                queue.push_back(block.GetHash());
+CBlockFileImporter::~CBlockFileImporter()
+{
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        fStop = true;
+    }
+    condRead.notify_all();
+    condDecode.notify_all();
+    threadRead.join();
+    for (std::thread& thread : vThreadsDecode) {
+        thread.join();
+    }
+}
+
+void CBlockFileImporter::ThreadRead()
+{
+    util::ThreadRename("pivx-loadread");
+
+    uint64_t nRewind = blkdat.GetPos();
+    while (!blkdat.eof()) {
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            condRead.wait(lock, [this] {
+                return fStop || (queueNext.size() < IMPORT_BATCH_BLOCKS && nBytesAhead < IMPORT_BATCH_SIZE);
+            });
+            if (fStop) break;
+        }
+
+        blkdat.SetPos(nRewind);
+        nRewind++;         // start one byte further next time, in case of failure
+        blkdat.SetLimit(); // remove former limit
+        unsigned int nSize = 0;
+        try {
+            // locate a header
+            unsigned char buf[MESSAGE_START_SIZE];
+            blkdat.FindByte(Params().MessageStart()[0]);
+            nRewind = blkdat.GetPos() + 1;
+            blkdat >> FLATDATA(buf);
+            if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
+                continue;
+            // read size
+            blkdat >> nSize;
+            if (nSize < 80 || nSize > MAX_BLOCK_SIZE_CURRENT)
+                continue;
+        } catch (const std::exception&) {
+            // no valid block header found; don't complain
+            break;
+        }
+        try {
+            // read block, it is decoded by the other threads
+            std::shared_ptr<CImportedBlock> item = std::make_shared<CImportedBlock>();
+            uint64_t nBlockPos = blkdat.GetPos();
+            if (dbp) {
+                item->pos = *dbp;
+                item->pos.nPos = nBlockPos;
+            }
+            blkdat.SetLimit(nBlockPos + nSize);
+            item->vchBlock.resize(nSize);
+            blkdat.read(item->vchBlock.data(), nSize);
+            item->nSize = nSize;
+            nRewind = blkdat.GetPos();
+            nBytesRead = nRewind;
+
+            std::lock_guard<std::mutex> lock(cs);
+            queueDecode.push_back(item);
+            queueNext.push_back(item);
+            nBytesAhead += nSize;
+            condDecode.notify_one();
+        } catch (const std::exception& e) {
+            LogPrintf("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(cs);
+    fReadDone = true;
+    condDecode.notify_all();
+    condNext.notify_all();
+}
+
+void CBlockFileImporter::ThreadDecode()
+{
+    util::ThreadRename("pivx-loaddec");
+
+    while (true) {
+        std::shared_ptr<CImportedBlock> item;
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            condDecode.wait(lock, [this] { return fStop || fReadDone || !queueDecode.empty(); });
+            if (fStop || queueDecode.empty()) return;
+            item = queueDecode.front();
+            queueDecode.pop_front();
+        }
+
+        try {
+            std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+            CDataStream(item->vchBlock, SER_DISK, CLIENT_VERSION) >> *pblock;
+            pblock->GetHash();
+            // A failure is reported when the block is processed, CheckBlock
+            // runs again then
+            CValidationState state;
+            CheckBlock(*pblock, state);
+            item->pblock = pblock;
+        } catch (const std::exception& e) {
+            LogPrintf("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+
+        std::lock_guard<std::mutex> lock(cs);
+        item->vchBlock = std::vector<char>();
+        item->fDecoded = true;
+        condNext.notify_all();
+    }
+}
+
+bool CBlockFileImporter::Next(std::shared_ptr<CImportedBlock>& item)
+{
+    std::unique_lock<std::mutex> lock(cs);
+    condNext.wait(lock, [this] {
+        return queueNext.empty() ? fReadDone : queueNext.front()->fDecoded;
+    });
+    if (queueNext.empty()) return false;
+
+    item = queueNext.front();
+    queueNext.pop_front();
+    nBytesAhead -= item->nSize;
+    condRead.notify_one();
+    return true;
+}
+
+double CBlockFileImporter::GetProgress() const
+{
+    if (nFileSize == 0) return 0;
+    return std::min(1.0, (double)nBytesRead / nFileSize);
+}
+
+} // anon namespace
+
+bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
+{
+    // Map of disk positions for blocks with unknown parent (only used for reindex)
+    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
+    int64_t nStart = GetTimeMillis();
+    int64_t nLastReport = nStart;
+    uint64_t nBytesRead = 0;
+
+    int nLoaded = 0;
+    try {
+        CBlockFileImporter importer(fileIn, dbp, std::max(1, nScriptCheckThreads));
+        std::shared_ptr<CImportedBlock> item;
+        while (importer.Next(item)) {
+            boost::this_thread::interruption_point();
+
+            nBytesRead = importer.GetBytesRead();
+            if (GetTimeMillis() - nLastReport >= IMPORT_REPORT_INTERVAL * 1000) {
+                nLastReport = GetTimeMillis();
+                const double nSeconds = std::max<int64_t>(1, nLastReport - nStart) / 1000.0;
+                LogPrintf("Block import: %.1f%% of the file read, %i blocks loaded (%.1f blocks/s, %.2f MB/s read), height %d\n",
+                    importer.GetProgress() * 100, nLoaded, nLoaded / nSeconds, nBytesRead / nSeconds / 1000000,
+                    chainActive.Height());
+            }
+
+            if (!item->pblock) continue;
+            const CBlock& block = *item->pblock;
+            CDiskBlockPos* pblockpos = dbp ? &item->pos : nullptr;
+            try {
+                // detect out of order blocks, and store them for later
+                uint256 hash = block.GetHash();
+                if (hash != Params().GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
+                    LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__,
+                            hash.GetHex(), block.hashPrevBlock.GetHex());
+                    if (dbp)
+                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, item->pos));
+                    continue;
+                }
+
+                // process in case the block isn't known yet
+                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+                    CValidationState state;
+                    if (ProcessNewBlock(state, nullptr, &block, pblockpos, nullptr))
+                        nLoaded++;
+                    if (state.IsError())
+                        break;
+                } else if (hash != Params().GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
+                    LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+                }
+
+                // Recursively process earlier encountered successors of this block
+                std::deque<uint256> queue;
+                queue.push_back(hash);
+                while (!queue.empty()) {
+                    uint256 head = queue.front();
+                    queue.pop_front();
+                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+                    while (range.first != range.second) {
+                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+                        CBlock blockChild;
+                        if (ReadBlockFromDisk(blockChild, it->second)) {
+                            LogPrintf("%s: Processing out of order child %s of %s\n", __func__, blockChild.GetHash().ToString(),
+                                head.ToString());
+                            CValidationState dummy;
+                            if (ProcessNewBlock(dummy, nullptr, &blockChild, &it->second, nullptr)) {
+                                nLoaded++;
+                                queue.push_back(blockChild.GetHash());
                             }
                         }
                         range.first++;
@@ -4458,11 +5068,16 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
                 LogPrintf("%s : Deserialize or I/O error - %s", __func__, e.what());
             }
         }
+        nBytesRead = importer.GetBytesRead();
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
     }
-    if (nLoaded > 0)
-        LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+    if (nLoaded > 0) {
+        const int64_t nTime = GetTimeMillis() - nStart;
+        const double nSeconds = std::max<int64_t>(1, nTime) / 1000.0;
+        LogPrintf("Loaded %i blocks from external file in %dms (%.1f blocks/s, %.2f MB/s read)\n",
+            nLoaded, nTime, nLoaded / nSeconds, nBytesRead / nSeconds / 1000000);
+    }
     return nLoaded > 0;
 }
 
@@ -4728,6 +5343,113 @@ static void RelayAddress(const CAddress& addr, bool fReachable, CConnman& connma
     connman.ForEachNodeThen(std::move(sortfunc), std::move(pushfunc));
 }
 
+/** Send a requested block, read from disk (or the served block cache) without holding cs_main. */
+void static ProcessGetBlockData(CNode* pfrom, const CInv& inv, CConnman& connman)
+{
+    AssertLockNotHeld(cs_main);
+
+    CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    CDiskBlockPos pos;
+    uint256 hashContinueTip;
+    bool fSendCompact = false;
+    {
+        LOCK(cs_main);
+        bool send = false;
+        BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
+        if (mi != mapBlockIndex.end()) {
+            if (chainActive.Contains(mi->second)) {
+                send = true;
+            } else {
+                // To prevent fingerprinting attacks, only send blocks outside of the active
+                // chain if they are valid, and no more than a max reorg depth than the best header
+                // chain we know about.
+                send = mi->second->IsValid(BLOCK_VALID_SCRIPTS) && (pindexBestHeader != NULL) &&
+                       (chainActive.Height() - mi->second->nHeight < GetArg("-maxreorg", DEFAULT_MAX_REORG_DEPTH));
+                if (!send) {
+                    LogPrintf("ProcessGetData(): ignoring request from peer=%i for old block that isn't in the main chain\n", pfrom->GetId());
+                }
+            }
+        }
+        // Don't send not-validated blocks
+        if (!send || !(mi->second->nStatus & BLOCK_HAVE_DATA))
+            return;
+
+        // Block files are only appended to, the block stays where it is once stored,
+        // the index entry itself may be freed once cs_main is released
+        const CBlockIndex* pindex = mi->second;
+        pos = pindex->GetBlockPos();
+        if (inv.hash == pfrom->hashContinue)
+            hashContinueTip = chainActive.Tip()->GetBlockHash();
+        // Older blocks are sent in full, the mempool of the peer is of no use for them
+        fSendCompact = inv.type == MSG_CMPCT_BLOCK && pindex->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH;
+    }
+
+    if (fSendCompact) {
+        std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock = GetMostRecentCompactBlock(inv.hash);
+        if (!pcmpctblock) {
+            CBlock block;
+            if (!ReadBlockFromDisk(block, pos))
+                assert(!"cannot load block from disk");
+            pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs>(block);
+        }
+        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
+    } else if (inv.type == MSG_BLOCK || inv.type == MSG_CMPCT_BLOCK) {
+        // Blocks are serialized the same way on disk and on the network: send the stored bytes
+        std::shared_ptr<const std::vector<unsigned char> > pvchBlock = servedBlockCache.Get(inv.hash);
+        if (!pvchBlock) {
+            std::shared_ptr<std::vector<unsigned char> > pvchRead = std::make_shared<std::vector<unsigned char> >();
+            if (!ReadRawBlockFromDisk(*pvchRead, pos))
+                assert(!"cannot load block from disk");
+            pvchBlock = pvchRead;
+            if (nServedBlockCacheSize > 0)
+                servedBlockCache.Add(inv.hash, pvchBlock, nServedBlockCacheSize);
+        }
+        CSerializedNetMsg msg;
+        msg.command = NetMsgType::BLOCK;
+        msg.data = *pvchBlock;
+        connman.PushMessage(pfrom, std::move(msg));
+    } else // MSG_FILTERED_BLOCK)
+    {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pos))
+            assert(!"cannot load block from disk");
+        bool send = false;
+        CMerkleBlock merkleBlock;
+        {
+            LOCK(pfrom->cs_filter);
+            if (pfrom->pfilter) {
+                send = true;
+                merkleBlock = CMerkleBlock(block, *pfrom->pfilter);
+            }
+        }
+        if (send) {
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MERKLEBLOCK, merkleBlock));
+            // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
+            // This avoids hurting performance by pointlessly requiring a round-trip
+            // Note that there is currently no way for a node to request any single transactions we didnt send here -
+            // they must either disconnect and retry or request the full block.
+            // Thus, the protocol spec specified allows for us to provide duplicate txn here,
+            // however we MUST always provide at least what the remote peer needs
+            typedef std::pair<unsigned int, uint256> PairType;
+            for (PairType& pair : merkleBlock.vMatchedTxn)
+                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::TX, block.vtx[pair.first]));
+        }
+        // else
+        // no response
+    }
+
+    // Trigger them to send a getblocks request for the next batch of inventory
+    if (!hashContinueTip.IsNull()) {
+        // Bypass PushInventory, this must send even if redundant,
+        // and we want it right after the last block so they don't
+        // wait for other stuff first.
+        std::vector<CInv> vInv;
+        vInv.push_back(CInv(MSG_BLOCK, hashContinueTip));
+        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::INV, vInv));
+        pfrom->hashContinue.SetNull();
+    }
+}
+
 void static ProcessGetData(CNode* pfrom, CConnman& connman, std::atomic<bool>& interruptMsgProc)
 {
     AssertLockNotHeld(cs_main);
@@ -4735,83 +5457,24 @@ void static ProcessGetData(CNode* pfrom, CConnman& connman, std::atomic<bool>& i
     std::deque<CInv>::iterator it = pfrom->vRecvGetData.begin();
     std::vector<CInv> vNotFound;
     CNetMsgMaker msgMaker(pfrom->GetSendVersion());
-    LOCK(cs_main);
+    {
+        LOCK(cs_main);
 
-    while (it != pfrom->vRecvGetData.end()) {
-        // Don't bother if send buffer is too full to respond anyway
-        if (pfrom->fPauseSend)
-            break;
+        while (it != pfrom->vRecvGetData.end()) {
+            // Don't bother if send buffer is too full to respond anyway
+            if (pfrom->fPauseSend)
+                break;
+
+            const CInv& inv = *it;
+            // Blocks are sent below, without cs_main
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK)
+                break;
 
-        const CInv& inv = *it;
-        {
             if (interruptMsgProc)
                 return;
             it++;
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK) {
-                bool send = false;
-                BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
-                if (mi != mapBlockIndex.end()) {
-                    if (chainActive.Contains(mi->second)) {
-                        send = true;
-                    } else {
-                        // To prevent fingerprinting attacks, only send blocks outside of the active
-                        // chain if they are valid, and no more than a max reorg depth than the best header
-                        // chain we know about.
-                        send = mi->second->IsValid(BLOCK_VALID_SCRIPTS) && (pindexBestHeader != NULL) &&
-                               (chainActive.Height() - mi->second->nHeight < GetArg("-maxreorg", DEFAULT_MAX_REORG_DEPTH));
-                        if (!send) {
-                            LogPrintf("ProcessGetData(): ignoring request from peer=%i for old block that isn't in the main chain\n", pfrom->GetId());
-                        }
-                    }
-                }
-                // Don't send not-validated blocks
-                if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second))
-                        assert(!"cannot load block from disk");
-                    if (inv.type == MSG_BLOCK)
-                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, block));
-                    else // MSG_FILTERED_BLOCK)
-                    {
-                        bool send = false;
-                        CMerkleBlock merkleBlock;
-                        {
-                            LOCK(pfrom->cs_filter);
-                            if (pfrom->pfilter) {
-                                send = true;
-                                merkleBlock = CMerkleBlock(block, *pfrom->pfilter);
-                            }
-                        }
-                        if (send) {
-                            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MERKLEBLOCK, merkleBlock));
-                            // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
-                            // This avoids hurting performance by pointlessly requiring a round-trip
-                            // Note that there is currently no way for a node to request any single transactions we didnt send here -
-                            // they must either disconnect and retry or request the full block.
-                            // Thus, the protocol spec specified allows for us to provide duplicate txn here,
-                            // however we MUST always provide at least what the remote peer needs
-                            typedef std::pair<unsigned int, uint256> PairType;
-                            for (PairType& pair : merkleBlock.vMatchedTxn)
-                                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::TX, block.vtx[pair.first]));
-                        }
-                        // else
-                        // no response
-                    }
-
-                    // Trigger them to send a getblocks request for the next batch of inventory
-                    if (inv.hash == pfrom->hashContinue) {
-                        // Bypass PushInventory, this must send even if redundant,
-                        // and we want it right after the last block so they don't
-                        // wait for other stuff first.
-                        std::vector<CInv> vInv;
-                        vInv.push_back(CInv(MSG_BLOCK, chainActive.Tip()->GetBlockHash()));
-                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::INV, vInv));
-                        pfrom->hashContinue.SetNull();
-                    }
-                }
-            } else if (inv.IsKnownType()) {
+            if (inv.IsKnownType()) {
                 // Send stream from relay memory
                 bool pushed = false;
                 {
@@ -4876,9 +5539,17 @@ void static ProcessGetData(CNode* pfrom, CConnman& connman, std::atomic<bool>& i
                     vNotFound.push_back(inv);
                 }
             }
+        }
+    }
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
-                break;
+    // At most one block per call
+    if (it != pfrom->vRecvGetData.end() && !pfrom->fPauseSend) {
+        const CInv& inv = *it;
+        if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK) {
+            if (interruptMsgProc)
+                return;
+            it++;
+            ProcessGetBlockData(pfrom, inv, connman);
         }
     }
 
@@ -4896,6 +5567,149 @@ void static ProcessGetData(CNode* pfrom, CConnman& connman, std::atomic<bool>& i
     }
 }
 
+/**
+ * Whether blocks are synced from this peer by headers first, instead of getblocks.
+ * Only where it is active, whose nodes all run this version: older ones answer
+ * getheaders with an inv, so it has no protocol version of its own.
+ */
+bool static IsHeadersFirstPeer(const CNode* pfrom)
+{
+    return Params().HeadersFirstSyncingActive() && pfrom->nVersion >= GETHEADERS_VERSION;
+}
+
+bool static HaveBlockData(const uint256& hash)
+{
+    LOCK(cs_main);
+    BlockMap::iterator mi = mapBlockIndex.find(hash);
+    return mi != mapBlockIndex.end() && (mi->second->nStatus & BLOCK_HAVE_DATA);
+}
+
+/**
+ * Keep a block requested from the download window whose parent is not stored
+ * yet: blocks are validated in order, the proof of stake of a block needs the
+ * coins of its parent. Returns false if the block can be processed now.
+ */
+bool static BufferBlockOutOfOrder(NodeId nodeid, const CBlock& block)
+{
+    LOCK(cs_main);
+    if (!Params().HeadersFirstSyncingActive())
+        return false;
+    BlockMap::iterator mi = mapBlockIndex.find(block.hashPrevBlock);
+    if (mi == mapBlockIndex.end() || (mi->second->nStatus & BLOCK_HAVE_DATA))
+        return false;
+
+    // Only what was asked to this peer, so that a peer can't fill the buffer
+    const uint256 hash = block.GetHash();
+    std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
+    if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != nodeid) {
+        LogPrint(BCLog::NET, "%s : ignoring unrequested block %s before its parent, peer=%d\n", __func__, hash.ToString(), nodeid);
+        return true;
+    }
+    MarkBlockAsReceived(hash);
+
+    const size_t nSize = ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+    if (!mapBlocksOutOfOrder.count(hash) && !HaveRoomOutOfOrder(nSize))
+        ExpireBlocksOutOfOrder();
+    if (mapBlocksOutOfOrder.count(hash) || !HaveRoomOutOfOrder(nSize)) {
+        // It will be requested again when the window moves
+        return true;
+    }
+    LogPrint(BCLog::NET, "%s : buffering block %s until its parent %s is stored, peer=%d\n", __func__,
+        hash.ToString(), block.hashPrevBlock.ToString(), nodeid);
+    mapBlocksOutOfOrder.emplace(hash, OutOfOrderBlock{block, nodeid, nSize, GetTime()});
+    mapBlocksOutOfOrderByPrev.emplace(block.hashPrevBlock, hash);
+    nBlocksOutOfOrderSize += nSize;
+    return true;
+}
+
+/**
+ * Process the blocks waiting for hashParent, now that it was processed, and
+ * in turn the blocks waiting for those. If it failed, they are dropped.
+ */
+void static ProcessBlocksOutOfOrder(const uint256& hashParent, CConnman& connman)
+{
+    std::deque<uint256> queue;
+    queue.push_back(hashParent);
+    while (!queue.empty()) {
+        const uint256 hashPrev = queue.front();
+        queue.pop_front();
+
+        std::vector<OutOfOrderBlock> vChildren;
+        {
+            LOCK(cs_main);
+            BlockMap::iterator mi = mapBlockIndex.find(hashPrev);
+            const bool fHaveParent = mi != mapBlockIndex.end() && (mi->second->nStatus & BLOCK_HAVE_DATA);
+            auto range = mapBlocksOutOfOrderByPrev.equal_range(hashPrev);
+            for (auto it = range.first; it != range.second; ++it) {
+                auto itBlock = mapBlocksOutOfOrder.find(it->second);
+                if (itBlock == mapBlocksOutOfOrder.end())
+                    continue;
+                nBlocksOutOfOrderSize -= itBlock->second.nSize;
+                if (fHaveParent) {
+                    vChildren.push_back(std::move(itBlock->second));
+                } else {
+                    // drop the descendants too
+                    queue.push_back(it->second);
+                }
+                mapBlocksOutOfOrder.erase(itBlock);
+            }
+            mapBlocksOutOfOrderByPrev.erase(range.first, range.second);
+        }
+
+        for (const OutOfOrderBlock& child : vChildren) {
+            // the peer may be gone, it is only needed to punish an invalid block
+            CValidationState state;
+            ProcessNewBlock(state, nullptr, &child.block, nullptr, &connman);
+            int nDoS;
+            if (state.IsInvalid(nDoS) && nDoS > 0) {
+                LOCK(cs_main);
+                Misbehaving(child.nodeid, nDoS);
+            }
+            queue.push_back(child.block.GetHash());
+        }
+    }
+}
+
+/** Validate a block downloaded from a peer, in full or rebuilt from a compact block. */
+void static ProcessReceivedBlock(CNode* pfrom, const CBlock& block, const std::string& strCommand, CConnman& connman)
+{
+    const uint256 hashBlock = block.GetHash();
+    pfrom->AddInventoryKnown(CInv(MSG_BLOCK, hashBlock));
+
+    // Headers first: blocks of the download window can come before their parent
+    if (BufferBlockOutOfOrder(pfrom->GetId(), block))
+        return;
+
+    if (HaveBlockData(hashBlock)) {
+        LogPrint(BCLog::NET, "%s : Already processed block %s, skipping ProcessNewBlock()\n", __func__, hashBlock.GetHex());
+        return;
+    }
+
+    CValidationState state;
+    ProcessNewBlock(state, pfrom, &block, nullptr, &connman);
+    int nDoS;
+    if (state.IsInvalid(nDoS)) {
+        assert(state.GetRejectCode() < REJECT_INTERNAL); // Blocks are never rejected with internal reject codes
+        connman.PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::REJECT, strCommand, state.GetRejectCode(),
+                                       state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), hashBlock));
+        if (nDoS > 0) {
+            TRY_LOCK(cs_main, lockMain);
+            if (lockMain) Misbehaving(pfrom->GetId(), nDoS);
+        }
+    }
+    //disconnect this node if its old protocol version
+    pfrom->DisconnectOldProtocol(pfrom->nVersion, ActiveProtocol(), strCommand);
+
+    ProcessBlocksOutOfOrder(hashBlock, connman);
+
+    // The peers that give us new tips first are asked to send the next ones as compact blocks straight away
+    if (GetBoolArg("-cmpcthighbandwidth", fMasterNode)) {
+        LOCK(cs_main);
+        if (chainActive.Tip()->GetBlockHash() == hashBlock)
+            MaybeSetPeerAsAnnouncingHeaderAndIDs(State(pfrom->GetId()), pfrom, connman);
+    }
+}
+
 bool fRequestedSporksIDB = false;
 bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vRecv, int64_t nTimeReceived, CConnman& connman, std::atomic<bool>& interruptMsgProc)
 {
@@ -5107,6 +5921,11 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             LOCK(cs_main);
             State(pfrom->GetId())->fCurrentlyConnected = true;
         }
+        if (pfrom->nVersion >= SHORT_IDS_BLOCKS_VERSION) {
+            // Tell our peer we are willing to provide cmpctblocks,
+            // but don't ask them to announce new blocks with them yet.
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDCMPCT, false, CMPCTBLOCKS_VERSION));
+        }
         pfrom->fSuccessfullyConnected = true;
     }
 
@@ -5186,9 +6005,27 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             if (inv.type == MSG_BLOCK) {
                 UpdateBlockAvailability(pfrom->GetId(), inv.hash);
                 if (!fAlreadyHave && !fImporting && !fReindex && !mapBlocksInFlight.count(inv.hash)) {
-                    // Add this to the list of blocks to request
-                    vToFetch.push_back(inv);
-                    LogPrint(BCLog::NET, "getblocks (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->id);
+                    if (IsHeadersFirstPeer(pfrom)) {
+                        // First request the headers preceding the announced block. In the normal fully-synced
+                        // case where a new block is announced that succeeds the current tip (no reorganization),
+                        // there are no such headers.
+                        // Secondly, and only when we are close to being synced, we request the announced block directly,
+                        // to avoid an extra round-trip. Note that we must *first* ask for the headers, so by the
+                        // time the block arrives, the header chain leading up to it is already validated. Not
+                        // doing this will result in the received block being rejected as an orphan in case it is
+                        // not a direct successor.
+                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexBestHeader), inv.hash));
+                        if (CanDirectFetch()) {
+                            // Peers providing compact blocks send it as one, rebuilt from our mempool
+                            vToFetch.push_back(State(pfrom->GetId())->fProvidesHeaderAndIDs ? CInv(MSG_CMPCT_BLOCK, inv.hash) : inv);
+                            MarkBlockAsInFlight(pfrom->GetId(), inv.hash);
+                        }
+                        LogPrint(BCLog::NET, "getheaders (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->id);
+                    } else {
+                        // Add this to the list of blocks to request
+                        vToFetch.push_back(inv);
+                        LogPrint(BCLog::NET, "getblocks (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->id);
+                    }
                 }
             }
         }
@@ -5218,6 +6055,46 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
     }
 
 
+    else if (strCommand == NetMsgType::GETHEADERS && IsHeadersFirstPeer(pfrom)) {
+        CBlockLocator locator;
+        uint256 hashStop;
+        vRecv >> locator >> hashStop;
+
+        if (locator.vHave.size() > MAX_LOCATOR_SZ) {
+            LogPrint(BCLog::NET, "getheaders locator size %lld > %d, disconnect peer=%d\n", locator.vHave.size(), MAX_LOCATOR_SZ, pfrom->GetId());
+            pfrom->fDisconnect = true;
+            return true;
+        }
+
+        LOCK(cs_main);
+
+        CBlockIndex* pindex = NULL;
+        if (locator.IsNull()) {
+            // If locator is null, return the hashStop block
+            BlockMap::iterator mi = mapBlockIndex.find(hashStop);
+            if (mi == mapBlockIndex.end())
+                return true;
+            pindex = (*mi).second;
+        } else {
+            // Find the last block the caller has in the main chain
+            pindex = FindForkInGlobalIndex(chainActive, locator);
+            if (pindex)
+                pindex = chainActive.Next(pindex);
+        }
+
+        // we must use CBlocks, as CBlockHeaders won't include the 0x00 nTx count at the end
+        std::vector<CBlock> vHeaders;
+        int nLimit = MAX_HEADERS_RESULTS;
+        LogPrint(BCLog::NET, "getheaders %d to %s from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.ToString(), pfrom->id);
+        for (; pindex; pindex = chainActive.Next(pindex)) {
+            vHeaders.push_back(pindex->GetBlockHeader());
+            if (--nLimit <= 0 || pindex->GetBlockHash() == hashStop)
+                break;
+        }
+        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::HEADERS, vHeaders));
+    }
+
+
     else if (strCommand == NetMsgType::GETBLOCKS || strCommand == NetMsgType::GETHEADERS) {
         CBlockLocator locator;
         uint256 hashStop;
@@ -5256,49 +6133,6 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
     }
 
 
-    else if (strCommand == NetMsgType::HEADERS && Params().HeadersFirstSyncingActive()) {
-        CBlockLocator locator;
-        uint256 hashStop;
-        vRecv >> locator >> hashStop;
-
-        if (locator.vHave.size() > MAX_LOCATOR_SZ) {
-            LogPrint(BCLog::NET, "getblocks locator size %lld > %d, disconnect peer=%d\n", locator.vHave.size(), MAX_LOCATOR_SZ, pfrom->GetId());
-            pfrom->fDisconnect = true;
-            return true;
-        }
-
-        LOCK(cs_main);
-
-        if (IsInitialBlockDownload())
-            return true;
-
-        CBlockIndex* pindex = NULL;
-        if (locator.IsNull()) {
-            // If locator is null, return the hashStop block
-            BlockMap::iterator mi = mapBlockIndex.find(hashStop);
-            if (mi == mapBlockIndex.end())
-                return true;
-            pindex = (*mi).second;
-        } else {
-            // Find the last block the caller has in the main chain
-            pindex = FindForkInGlobalIndex(chainActive, locator);
-            if (pindex)
-                pindex = chainActive.Next(pindex);
-        }
-
-        // we must use CBlocks, as CBlockHeaders won't include the 0x00 nTx count at the end
-        std::vector<CBlock> vHeaders;
-        int nLimit = MAX_HEADERS_RESULTS;
-        LogPrintf("getheaders %d to %s from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.ToString(), pfrom->id);
-        for (; pindex; pindex = chainActive.Next(pindex)) {
-            vHeaders.push_back(pindex->GetBlockHeader());
-            if (--nLimit <= 0 || pindex->GetBlockHash() == hashStop)
-                break;
-        }
-        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::HEADERS, vHeaders));
-    }
-
-
     else if (strCommand == NetMsgType::TX) {
         std::vector<uint256> vWorkQueue;
         std::vector<uint256> vEraseQueue;
@@ -5420,7 +6254,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
     }
 
 
-    else if (strCommand == NetMsgType::HEADERS && Params().HeadersFirstSyncingActive() && !fImporting && !fReindex) // Ignore headers received while importing
+    else if (strCommand == NetMsgType::HEADERS && IsHeadersFirstPeer(pfrom) && !fImporting && !fReindex) // Ignore headers received while importing
     {
         std::vector<CBlockHeader> headers;
 
@@ -5437,6 +6271,14 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
         }
 
+        // Hash the whole batch in parallel before taking cs_main
+        std::vector<const CBlockHeader*> vHeaders;
+        vHeaders.reserve(headers.size());
+        for (const CBlockHeader& header : headers) {
+            vHeaders.push_back(&header);
+        }
+        PrecomputeBlockHashes(vHeaders);
+
         LOCK(cs_main);
 
         if (nCount == 0) {
@@ -5499,27 +6341,237 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
                 pfrom->vBlockRequested.push_back(hashBlock);
             }
         } else {
-            pfrom->AddInventoryKnown(inv);
+            ProcessReceivedBlock(pfrom, block, strCommand, connman);
+        }
+    }
 
-            CValidationState state;
-            if (!mapBlockIndex.count(block.GetHash())) {
-                ProcessNewBlock(state, pfrom, &block, nullptr, &connman);
-                int nDoS;
-                if (state.IsInvalid(nDoS)) {
-                    assert(state.GetRejectCode() < REJECT_INTERNAL); // Blocks are never rejected with internal reject codes
-                    connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::REJECT, strCommand, state.GetRejectCode(),
-                                                   state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash));
-                    if (nDoS > 0) {
-                        TRY_LOCK(cs_main, lockMain);
-                        if (lockMain) Misbehaving(pfrom->GetId(), nDoS);
+
+    else if (strCommand == NetMsgType::SENDCMPCT) {
+        bool fAnnounceUsingCMPCTBLOCK = false;
+        uint64_t nCMPCTBLOCKVersion = 0;
+        vRecv >> fAnnounceUsingCMPCTBLOCK >> nCMPCTBLOCKVersion;
+        if (nCMPCTBLOCKVersion == CMPCTBLOCKS_VERSION) {
+            LOCK(cs_main);
+            State(pfrom->GetId())->fProvidesHeaderAndIDs = true;
+            State(pfrom->GetId())->fPreferHeaderAndIDs = fAnnounceUsingCMPCTBLOCK;
+        }
+    }
+
+
+    else if (strCommand == NetMsgType::CMPCTBLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        vRecv >> cmpctblock;
+        const uint256 hash = cmpctblock.header.GetHash();
+        LogPrint(BCLog::NET, "received cmpctblock %s peer=%d\n", hash.ToString(), pfrom->id);
+
+        // Without headers first, the header is only accepted along with the rebuilt block, as the proof of
+        // stake of a header can't be checked alone. The announcement replaced the inv: a block that is not
+        // rebuilt here is requested in full, as the inv would have done.
+        const bool fHeadersFirst = IsHeadersFirstPeer(pfrom);
+        const std::vector<CInv> vGetBlock(1, CInv(MSG_BLOCK, hash));
+
+        CBlock block;
+        bool fBlockReconstructed = false;
+        {
+            LOCK(cs_main);
+
+            BlockMap::iterator miPrev = mapBlockIndex.find(cmpctblock.header.hashPrevBlock);
+            if (miPrev == mapBlockIndex.end()) {
+                // Doesn't connect (or is genesis), instead of DoSing in AcceptBlockHeader, request deeper headers
+                if (fHeadersFirst && !IsInitialBlockDownload())
+                    connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexBestHeader), UINT256_ZERO));
+                else if (!fHeadersFirst)
+                    connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETBLOCKS, chainActive.GetLocator(), hash));
+                return true;
+            }
+
+            CBlockIndex* pindex = NULL;
+            if (fHeadersFirst) {
+                CValidationState state;
+                if (!AcceptBlockHeader(CBlock(cmpctblock.header), state, &pindex)) {
+                    int nDoS;
+                    if (state.IsInvalid(nDoS)) {
+                        if (nDoS > 0)
+                            Misbehaving(pfrom->GetId(), nDoS);
+                        LogPrintf("Peer %d sent us invalid header via cmpctblock\n", pfrom->id);
+                        return true;
                     }
                 }
-                //disconnect this node if its old protocol version
-                pfrom->DisconnectOldProtocol(pfrom->nVersion, ActiveProtocol(), strCommand);
+                if (pindex == NULL)
+                    return true;
+            }
+
+            UpdateBlockAvailability(pfrom->GetId(), hash);
+            pfrom->AddInventoryKnown(CInv(MSG_BLOCK, hash));
+
+            // Nothing to do here
+            BlockMap::iterator mi = mapBlockIndex.find(hash);
+            if (mi != mapBlockIndex.end() && (mi->second->nStatus & BLOCK_HAVE_DATA))
+                return true;
+
+            std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator blockInFlightIt = mapBlocksInFlight.find(hash);
+            const bool fAlreadyInFlight = blockInFlightIt != mapBlocksInFlight.end();
+
+            // We know something better, or the block is too far ahead of the tip for our mempool to be of use:
+            // request it normally if we asked this peer for it, else it is downloaded with the window
+            const bool fBetterKnown = fHeadersFirst && pindex->nChainWork <= chainActive.Tip()->nChainWork;
+            if (fBetterKnown || miPrev->second->nHeight + 1 > chainActive.Height() + 2) {
+                if ((fAlreadyInFlight && blockInFlightIt->second.first == pfrom->GetId()) || (!fHeadersFirst && !fAlreadyInFlight))
+                    connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETDATA, vGetBlock));
+                return true;
+            }
+
+            // If we're not close to tip yet, give up and let the download window work its magic
+            if (!fAlreadyInFlight && !CanDirectFetch()) {
+                if (!fHeadersFirst)
+                    connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETDATA, vGetBlock));
+                return true;
+            }
+
+            if (fAlreadyInFlight && blockInFlightIt->second.first != pfrom->GetId()) {
+                LogPrint(BCLog::NET, "Peer %d sent us compact block %s in flight from peer=%d\n", pfrom->id, hash.ToString(), blockInFlightIt->second.first);
+                return true;
+            }
+            if (!fAlreadyInFlight) {
+                if (State(pfrom->GetId())->nBlocksInFlight >= MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+                    if (!fHeadersFirst)
+                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETDATA, vGetBlock));
+                    return true;
+                }
+                MarkBlockAsInFlight(pfrom->GetId(), hash, pindex);
+                blockInFlightIt = mapBlocksInFlight.find(hash);
+            }
+
+            QueuedBlock& queuedBlock = *blockInFlightIt->second.second;
+            if (queuedBlock.partialBlock) {
+                // The block was already in flight using compact blocks from the same peer
+                LogPrint(BCLog::NET, "Peer sent us compact block we were already syncing!\n");
+                return true;
+            }
+            queuedBlock.partialBlock.reset(new PartiallyDownloadedBlock(&mempool));
+            PartiallyDownloadedBlock& partialBlock = *queuedBlock.partialBlock;
+            ReadStatus status = partialBlock.InitData(cmpctblock);
+            if (status == READ_STATUS_INVALID) {
+                MarkBlockAsReceived(hash); // Reset in-flight state in case of whitelist
+                Misbehaving(pfrom->GetId(), 100);
+                LogPrintf("Peer %d sent us invalid compact block\n", pfrom->id);
+                return true;
+            }
+
+            BlockTransactionsRequest req;
+            if (status == READ_STATUS_OK) {
+                for (size_t i = 0; i < cmpctblock.BlockTxCount(); i++) {
+                    if (!partialBlock.IsTxAvailable(i))
+                        req.indexes.push_back(i);
+                }
+                if (req.indexes.empty()) {
+                    // Every transaction was in our mempool, no round trip
+                    status = partialBlock.FillBlock(block, std::vector<CTransaction>());
+                    fBlockReconstructed = status == READ_STATUS_OK;
+                }
+            }
+            if (status != READ_STATUS_OK) {
+                // Short id collision, the block is still in flight from this peer, so just request it
+                queuedBlock.partialBlock.reset();
+                std::vector<CInv> vInv(1, CInv(MSG_BLOCK, hash));
+                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETDATA, vInv));
+                return true;
+            }
+            if (!fBlockReconstructed) {
+                req.blockhash = hash;
+                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETBLOCKTXN, req));
+            }
+        }
+
+        if (fBlockReconstructed)
+            ProcessReceivedBlock(pfrom, block, strCommand, connman);
+    }
+
+
+    else if (strCommand == NetMsgType::GETBLOCKTXN) {
+        BlockTransactionsRequest req;
+        vRecv >> req;
+
+        CDiskBlockPos pos;
+        bool fSendBlock = false;
+        {
+            LOCK(cs_main);
+            BlockMap::iterator it = mapBlockIndex.find(req.blockhash);
+            if (it == mapBlockIndex.end() || !(it->second->nStatus & BLOCK_HAVE_DATA)) {
+                LogPrint(BCLog::NET, "Peer %d sent us a getblocktxn for a block we don't have\n", pfrom->id);
+                return true;
+            }
+            // If an older block is requested (should never happen in practice,
+            // but can happen in tests) send a block response instead of a
+            // blocktxn response. Sending a full block response instead of a
+            // small blocktxn response is preferable in the case where a peer
+            // might maliciously send lots of getblocktxn requests to trigger
+            // expensive disk reads, because it will require the peer to
+            // actually receive all the data read from disk over the network.
+            fSendBlock = it->second->nHeight < chainActive.Height() - MAX_BLOCKTXN_DEPTH;
+            pos = it->second->GetBlockPos();
+        }
+        if (fSendBlock) {
+            LogPrint(BCLog::NET, "Peer %d sent us a getblocktxn for a block > %i deep\n", pfrom->id, MAX_BLOCKTXN_DEPTH);
+            pfrom->vRecvGetData.push_back(CInv(MSG_BLOCK, req.blockhash));
+            ProcessGetData(pfrom, connman, interruptMsgProc);
+            return true;
+        }
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pos))
+            assert(!"cannot load block from disk");
+
+        BlockTransactions resp(req);
+        for (size_t i = 0; i < req.indexes.size(); i++) {
+            if (req.indexes[i] >= block.vtx.size()) {
+                LOCK(cs_main);
+                Misbehaving(pfrom->GetId(), 100);
+                LogPrintf("Peer %d sent us a getblocktxn with out-of-bounds tx indices\n", pfrom->id);
+                return true;
+            }
+            resp.txn[i] = block.vtx[req.indexes[i]];
+        }
+        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCKTXN, resp));
+    }
+
+
+    else if (strCommand == NetMsgType::BLOCKTXN && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        BlockTransactions resp;
+        vRecv >> resp;
+
+        CBlock block;
+        bool fBlockRead = false;
+        {
+            LOCK(cs_main);
+            std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator it = mapBlocksInFlight.find(resp.blockhash);
+            if (it == mapBlocksInFlight.end() || !it->second.second->partialBlock ||
+                    it->second.first != pfrom->GetId()) {
+                LogPrint(BCLog::NET, "Peer %d sent us block transactions for block we weren't expecting\n", pfrom->id);
+                return true;
+            }
+
+            PartiallyDownloadedBlock& partialBlock = *it->second.second->partialBlock;
+            ReadStatus status = partialBlock.FillBlock(block, resp.txn);
+            if (status == READ_STATUS_INVALID) {
+                MarkBlockAsReceived(resp.blockhash); // Reset in-flight state in case of whitelist
+                Misbehaving(pfrom->GetId(), 100);
+                LogPrintf("Peer %d sent us invalid compact block/non-matching block transactions\n", pfrom->id);
+                return true;
+            } else if (status == READ_STATUS_FAILED) {
+                // Might have collided, fall back to getdata now :(
+                it->second.second->partialBlock.reset();
+                std::vector<CInv> vInv(1, CInv(MSG_BLOCK, resp.blockhash));
+                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETDATA, vInv));
             } else {
-                LogPrint(BCLog::NET, "%s : Already processed block %s, skipping ProcessNewBlock()\n", __func__, block.GetHash().GetHex());
+                fBlockRead = true;
             }
         }
+
+        if (fBlockRead)
+            ProcessReceivedBlock(pfrom, block, strCommand, connman);
     }
 
     // This asymmetric behavior for inbound and outbound connections was introduced
@@ -5953,10 +7005,14 @@ bool SendMessages(CNode* pto, CConnman& connman, std::atomic<bool>& interruptMsg
             if ((nSyncStarted == 0 && fFetch) || pindexBestHeader->GetBlockTime() > GetAdjustedTime() - 6 * 60 * 60) { // NOTE: was "close to today" and 24h in Bitcoin
                 state.fSyncStarted = true;
                 nSyncStarted++;
-                //CBlockIndex *pindexStart = pindexBestHeader->pprev ? pindexBestHeader->pprev : pindexBestHeader;
-                //LogPrint(BCLog::NET, "initial getheaders (%d) to peer=%d (startheight:%d)\n", pindexStart->nHeight, pto->id, pto->nStartingHeight);
-                //pto->PushMessage(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexStart), UINT256_ZERO);
-                connman.PushMessage(pto, msgMaker.Make(NetMsgType::GETBLOCKS, chainActive.GetLocator(chainActive.Tip()), UINT256_ZERO));
+                if (IsHeadersFirstPeer(pto)) {
+                    // The blocks are then downloaded from every peer that has them, see FindNextBlocksToDownload
+                    CBlockIndex *pindexStart = pindexBestHeader->pprev ? pindexBestHeader->pprev : pindexBestHeader;
+                    LogPrint(BCLog::NET, "initial getheaders (%d) to peer=%d (startheight:%d)\n", pindexStart->nHeight, pto->id, pto->nStartingHeight);
+                    connman.PushMessage(pto, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexStart), UINT256_ZERO));
+                } else {
+                    connman.PushMessage(pto, msgMaker.Make(NetMsgType::GETBLOCKS, chainActive.GetLocator(chainActive.Tip()), UINT256_ZERO));
+                }
             }
         }
 
@@ -5986,6 +7042,16 @@ bool SendMessages(CNode* pto, CConnman& connman, std::atomic<bool>& interruptMsg
                 if (inv.type == MSG_TX && pto->filterInventoryKnown.contains(inv.hash))
                     continue;
 
+                // Peers in high bandwidth mode get a new tip as a compact block, without an inv/getdata round trip
+                if (inv.type == MSG_BLOCK && state.fPreferHeaderAndIDs && !pto->filterInventoryKnown.contains(inv.hash)) {
+                    std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock = GetMostRecentCompactBlock(inv.hash);
+                    if (pcmpctblock) {
+                        pto->filterInventoryKnown.insert(inv.hash);
+                        connman.PushMessage(pto, msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
+                        continue;
+                    }
+                }
+
                 // trickle out tx inv to protect privacy
                 if (inv.type == MSG_TX && !fSendTrickle) {
                     // 1/4 of tx invs blast to all immediately
@@ -6094,7 +7160,7 @@ public:
         // block headers
         BlockMap::iterator it1 = mapBlockIndex.begin();
         for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
+            blockIndexArena.Delete((*it1).second);
         mapBlockIndex.clear();
 
         // orphan transactions
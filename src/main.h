@@ -73,6 +73,10 @@ static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 72;
 /** Default for -txindex */
 static const bool DEFAULT_TXINDEX = true;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
+/** Default for -checkblockreads */
+static const bool DEFAULT_CHECK_BLOCK_READS = true;
+/** Default for -blockindexsnapshot */
+static const bool DEFAULT_BLOCK_INDEX_SNAPSHOT = false;
 /** Default for -testsafemode */
 static const bool DEFAULT_TESTSAFEMODE = false;
 /** Default for -relaypriority */
@@ -107,10 +111,32 @@ static const unsigned int MAX_HEADERS_RESULTS = 2000;
  *  degree of disordering of blocks on disk (which make reindexing and in the future perhaps pruning
  *  harder). We'll probably want to make this a per-peer adaptive value at some point. */
 static const unsigned int BLOCK_DOWNLOAD_WINDOW = 1024;
+/** Maximum size of the blocks of the download window kept in memory until their parent is stored.
+ *  Blocks are validated in order, as proof of stake checks need the coins of the parent. */
+static const unsigned int MAX_BLOCKS_OUT_OF_ORDER_SIZE = 64 * 1024 * 1024;
+/** Maximum number of blocks kept in memory until their parent is stored. */
+static const unsigned int MAX_BLOCKS_OUT_OF_ORDER = BLOCK_DOWNLOAD_WINDOW;
+/** Time in seconds after which a block still waiting for its parent is dropped, to be requested again. */
+static const int64_t BLOCK_OUT_OF_ORDER_EXPIRY = 10 * 60;
+/** Maximum depth of blocks we're willing to serve as compact blocks to peers when requested. */
+static const int MAX_CMPCTBLOCK_DEPTH = 5;
+/** Maximum depth of blocks we're willing to respond to GETBLOCKTXN requests for. */
+static const int MAX_BLOCKTXN_DEPTH = 10;
+/** Number of peers asked to announce their new blocks as compact blocks without waiting for a getdata. */
+static const unsigned int MAX_CMPCTBLOCK_HIGH_BANDWIDTH_PEERS = 3;
+/** Version of the compact block encoding sent in sendcmpct. */
+static const uint64_t CMPCTBLOCKS_VERSION = 1;
+/** Maximum number of blocks, and of their bytes, read ahead by LoadExternalBlockFile while the earlier ones are connected. */
+static const unsigned int IMPORT_BATCH_BLOCKS = 128;
+static const unsigned int IMPORT_BATCH_SIZE = 16 * 1024 * 1024;
+/** Time (in seconds) between two progress reports of LoadExternalBlockFile. */
+static const int64_t IMPORT_REPORT_INTERVAL = 10;
 /** Time to wait (in seconds) between writing blocks/block index to disk. */
 static const unsigned int DATABASE_WRITE_INTERVAL = 60 * 60;
 /** Time to wait (in seconds) between flushing chainstate to disk. */
 static const unsigned int DATABASE_FLUSH_INTERVAL = 24 * 60 * 60;
+/** Time to wait (in seconds) between two block index snapshots written along the block index writes. */
+static const unsigned int BLOCK_INDEX_SNAPSHOT_INTERVAL = 6 * 60 * 60;
 /** Maximum length of reject messages. */
 static const unsigned int MAX_REJECT_MESSAGE_LENGTH = 111;
 /** Average delay between local address broadcasts in seconds. */
@@ -135,6 +161,10 @@ static const unsigned int DEFAULT_BLOCK_SPAM_FILTER_MAX_SIZE = 100;
 static const unsigned int DEFAULT_BLOCK_SPAM_FILTER_MAX_AVG = 10;
 /** Default for block payee verification timeout */
 static const unsigned int DEFAULT_BLOCK_PAYEE_VERIFICATION_TIMEOUT = 5 * MINUTE_IN_SECONDS;
+/** Default for -servedblockcache, size in MiB of the cache of serialized blocks recently served to peers */
+static const unsigned int DEFAULT_SERVED_BLOCK_CACHE_SIZE = 16;
+/** Default for -maxscriptcachesize, size in MiB of the cache of transactions whose scripts passed */
+static const unsigned int DEFAULT_MAX_SCRIPT_CACHE_SIZE = 32;
 
 struct BlockHasher {
     size_t operator()(const uint256& hash) const { return hash.GetCheapHash(); }
@@ -145,6 +175,8 @@ extern RecursiveMutex cs_main;
 extern CTxMemPool mempool;
 typedef boost::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
 extern BlockMap mapBlockIndex;
+/** Storage of the mapBlockIndex entries */
+extern CBlockIndexArena blockIndexArena;
 extern uint64_t nLastBlockTx;
 extern uint64_t nLastBlockSize;
 extern const std::string strMessageMagic;
@@ -161,7 +193,12 @@ extern std::atomic<bool> fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
 extern bool fCheckBlockIndex;
+/** Whether blocks read for an index entry are rehashed rather than trusted to match it */
+extern bool fCheckBlockReads;
+/** Whether the block index is loaded from, and saved to, a snapshot file besides its database */
+extern bool fBlockIndexSnapshot;
 extern size_t nCoinCacheUsage;
+extern size_t nServedBlockCacheSize;
 extern CFeeRate minRelayTxFee;
 extern int64_t nMaxTipAge;
 extern bool fVerifyingBlocks;
@@ -225,6 +262,14 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, std::atomic<bool>& interru
 bool SendMessages(CNode* pto, CConnman& connman, std::atomic<bool>& interrupt);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the header hashing thread */
+void ThreadHeaderHash();
+/**
+ * Hash a batch of legacy (X11KVS) block headers on the header hashing threads,
+ * so that the GetHash() calls made on them during validation are served from
+ * memory. The headers must outlive the call; it returns once all are hashed.
+ */
+void PrecomputeBlockHashes(const std::vector<const CBlockHeader*>& vHeaders);
 
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
@@ -250,6 +295,8 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats& stats);
 void Misbehaving(NodeId nodeid, int howmuch) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 /** Flush all state, indexes and buffers to disk. */
 void FlushStateToDisk();
+/** Write the block index snapshot, if enabled, once the block index is flushed to its database. */
+bool WriteBlockIndexSnapshot() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
 
 /** (try to) add transaction to memory pool **/
@@ -281,12 +328,18 @@ CAmount GetMinRelayFee(const CTransaction& tx, const CTxMemPool& pool, unsigned
  *   DUP CHECKSIG DROP ... repeated 100 times... OP_1
  */
 
+/** Initialize the script execution cache, sized by -maxscriptcachesize */
+void InitScriptExecutionCache();
+
 /**
  * Check whether all inputs of this transaction are valid (no double spends, scripts & sigs, amounts)
  * This does not modify the UTXO set. If pvChecks is not NULL, script checks are pushed onto it
  * instead of being performed inline.
+ * Scripts that already passed with the same flags are not run again. With cacheFullScriptStore,
+ * scripts run inline that pass are remembered; without it, a remembered result that is found
+ * becomes the first to be evicted when the cache needs room.
  */
-bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& view, bool fScriptChecks, unsigned int flags, bool cacheStore, PrecomputedTransactionData& precomTxData, std::vector<CScriptCheck>* pvChecks = NULL);
+bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& view, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& precomTxData, std::vector<CScriptCheck>* pvChecks = NULL);
 
 /** Apply the effects of this transaction on the UTXO set represented by view */
 void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight);
@@ -354,6 +407,8 @@ public:
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex);
+/** Read the serialized block at pos as stored, without deserializing it */
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vchBlock, const CDiskBlockPos& pos);
 
 
 /** Functions for validating blocks and updating the block tree */
@@ -400,6 +455,9 @@ public:
 // Resync the supply with the txout set
 void ResyncSupply();
 
+/** Rebuild the masternode payee index from the active chain blocks */
+bool ReindexPayees();
+
 /** Rewind chain.
  *  param can contain a number of blocks to rewind or a block hash to rewind to */
 bool RewindBlockIndex(std::string param = "");
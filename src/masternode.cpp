@@ -7,6 +7,7 @@
 #include "masternode.h"
 
 #include "addrman.h"
+#include "burnaddresses.h"
 #include "init.h"
 #include "masternode-payments.h"
 #include "masternode-sync.h"
@@ -232,19 +233,11 @@ void CMasternode::Check(bool forceCheck)
             }
         }
 
-        const auto& consensus = Params().GetConsensus();
-
         // ----------- burn address scanning -----------
-        if (!consensus.mBurnAddresses.empty()) {
-
-            std::string addr = EncodeDestination(pubKeyCollateralAddress.GetID());
-
-            if (consensus.mBurnAddresses.find(addr) != consensus.mBurnAddresses.end() &&
-                consensus.mBurnAddresses.at(addr) < chainActive.Height()
-            ) {
-                activeState = MASTERNODE_VIN_SPENT;
-                return;
-            }
+        if (!g_burn_addresses.empty() &&
+            g_burn_addresses.IsBurned(GetScriptForDestination(pubKeyCollateralAddress.GetID()), chainActive.Height())) {
+            activeState = MASTERNODE_VIN_SPENT;
+            return;
         }
     }
 
@@ -312,12 +305,16 @@ int64_t CMasternode::GetLastPaidV2(CBlockIndex* pblockindex, const CScript& mnpa
     if(lastPaid != INT64_MAX) return lastPaid;
 
     int max_depth = mnodeman.CountEnabled() * 2;
+
+    // the paid heights tracked at block connection spare the chain walk
+    if (mnodeman.GetLastPaidTime(pblockindex, mnpayee, sigTime, max_depth, lastPaid)) return lastPaid;
+
     int n = 0;
 
     do
     {
         auto paidpayee = pblockindex->GetPaidPayee();
-        if(paidpayee && mnpayee == *paidpayee) {
+        if(!paidpayee.empty() && mnpayee == paidpayee) {
             lastPaid = pblockindex->nTime;
             return lastPaid;
         }
@@ -411,6 +408,14 @@ std::pair<int, CAmount> CMasternode::GetNextMasternodeCollateral(int nHeight) {
     return std::make_pair(-1, -1);
 }
 
+std::set<CAmount> CMasternode::GetMasternodeCollaterals() {
+    std::set<CAmount> setCollaterals;
+    for(auto p : vecCollaterals) {
+        setCollaterals.insert(p.second);
+    }
+    return setCollaterals;
+}
+
 CMasternodeBroadcast::CMasternodeBroadcast() :
         CMasternode()
 { }
@@ -312,6 +312,7 @@ public:
     static CAmount GetMasternodePayment(int nHeight);
     static void InitMasternodeCollateralList();
     static std::pair<int, CAmount> GetNextMasternodeCollateral(int nHeight);
+    static std::set<CAmount> GetMasternodeCollaterals();
 };
 
 //
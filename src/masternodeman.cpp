@@ -17,6 +17,8 @@
 #include "spork.h"
 #include "util.h"
 
+#include <algorithm>
+
 #include <boost/thread/thread.hpp>
 
 #define MN_WINNER_MINIMUM_AGE 8000    // Age in seconds. This should be > MASTERNODE_REMOVAL_SECONDS to avoid misconfigured new nodes in the list.
@@ -417,6 +419,123 @@ void CMasternodeMan::Clear()
     mapSeenMasternodeBroadcast.clear();
     mapSeenMasternodePing.clear();
     nDsqCount = 0;
+
+    LOCK(cs_paid);
+    mapPaidHeights.clear();
+    hashPaidHeightsBlock.SetNull();
+    pindexPaidHeights = nullptr;
+    nPaidHeightsFrom = std::numeric_limits<int>::max();
+    pindexPaidTimes = nullptr;
+    vPaidMinTimes.clear();
+}
+
+void CMasternodeMan::ConnectPaidBlock(const CBlockIndex* pindex, const CScript& payee)
+{
+    LOCK(cs_paid);
+
+    if (pindex->pprev == nullptr || pindex->pprev->GetBlockHash() != hashPaidHeightsBlock) {
+        // not following the tracked chain, start over from this block
+        mapPaidHeights.clear();
+        nPaidHeightsFrom = pindex->nHeight;
+    }
+
+    hashPaidHeightsBlock = pindex->GetBlockHash();
+    pindexPaidHeights = pindex;
+
+    if (!payee.empty() && pindex->nHeight > 0) {
+        mapPaidHeights[payee].push_back(pindex->nHeight);
+    }
+
+    // forget the payments that are too old for any lookback
+    if (pindex->nHeight % 1000 == 0) {
+        const int nKeep = std::max(10000, (int)vMasternodes.size() * 4);
+        const int nFrom = pindex->nHeight - nKeep;
+        if (nFrom > nPaidHeightsFrom) {
+            auto it = mapPaidHeights.begin();
+            while (it != mapPaidHeights.end()) {
+                auto& vHeights = it->second;
+                vHeights.erase(vHeights.begin(), std::lower_bound(vHeights.begin(), vHeights.end(), nFrom));
+                if (vHeights.empty()) {
+                    it = mapPaidHeights.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            nPaidHeightsFrom = nFrom;
+        }
+    }
+}
+
+void CMasternodeMan::DisconnectPaidBlock(const CBlockIndex* pindex, const CScript& payee)
+{
+    LOCK(cs_paid);
+
+    if (pindex->GetBlockHash() != hashPaidHeightsBlock || pindex->pprev == nullptr) {
+        mapPaidHeights.clear();
+        hashPaidHeightsBlock.SetNull();
+        pindexPaidHeights = nullptr;
+        nPaidHeightsFrom = std::numeric_limits<int>::max();
+        return;
+    }
+
+    hashPaidHeightsBlock = pindex->pprev->GetBlockHash();
+    pindexPaidHeights = pindex->pprev;
+
+    auto it = mapPaidHeights.find(payee);
+    if (it != mapPaidHeights.end() && !it->second.empty() && it->second.back() == pindex->nHeight) {
+        it->second.pop_back();
+        if (it->second.empty()) mapPaidHeights.erase(it);
+    }
+}
+
+bool CMasternodeMan::GetLastPaidTime(const CBlockIndex* pindex, const CScript& payee, int64_t sigTime, int nMaxDepth, int64_t& nTimeRet)
+{
+    LOCK(cs_paid);
+
+    if (pindex == nullptr || hashPaidHeightsBlock.IsNull()) return false;
+
+    if (pindexPaidHeights == nullptr) {
+        // just loaded from mncache.dat
+        const CBlockIndex* pindexTip = chainActive.Tip();
+        if (pindexTip == nullptr || pindexTip->GetBlockHash() != hashPaidHeightsBlock) return false;
+        pindexPaidHeights = pindexTip;
+    }
+
+    const int nHeight = pindex->nHeight;
+    if (nHeight < nPaidHeightsFrom || pindexPaidHeights->GetAncestor(nHeight) != pindex) return false;
+
+    // the chain walk goes back while the blocks are newer than sigTime, up to nMaxDepth blocks,
+    // so find how deep it reaches with the running minimum of the block times
+    if (pindexPaidTimes != pindex) {
+        pindexPaidTimes = pindex;
+        vPaidMinTimes.clear();
+    }
+    const int nDepth = std::max(0, std::min(nMaxDepth, nHeight - 1));
+    if ((int)vPaidMinTimes.size() < nDepth) {
+        const CBlockIndex* pwalk = pindex->GetAncestor(nHeight - 1 - vPaidMinTimes.size());
+        while ((int)vPaidMinTimes.size() < nDepth) {
+            int64_t nTime = pwalk->GetBlockTime();
+            if (!vPaidMinTimes.empty()) nTime = std::min(nTime, vPaidMinTimes.back());
+            vPaidMinTimes.push_back(nTime);
+            pwalk = pwalk->pprev;
+        }
+    }
+    const int nReach = std::partition_point(vPaidMinTimes.begin(), vPaidMinTimes.begin() + nDepth,
+        [sigTime](int64_t nTime) { return nTime > sigTime; }) - vPaidMinTimes.begin();
+    const int nLowest = nHeight - nReach;
+    if (nLowest < nPaidHeightsFrom) return false;
+
+    nTimeRet = 0;
+    auto it = mapPaidHeights.find(payee);
+    if (it != mapPaidHeights.end()) {
+        const auto& vHeights = it->second;
+        auto itHeight = std::upper_bound(vHeights.begin(), vHeights.end(), nHeight);
+        if (itHeight != vHeights.begin() && *(--itHeight) >= nLowest) {
+            nTimeRet = pindex->GetAncestor(*itHeight)->GetBlockTime();
+        }
+    }
+
+    return true;
 }
 
 int CMasternodeMan::stable_size ()
@@ -17,6 +17,8 @@
 #include "sync.h"
 #include "util.h"
 
+#include <limits>
+
 #include <boost/unordered_map.hpp>
 
 #define MASTERNODES_DUMP_SECONDS (15 * 60)
@@ -82,6 +84,19 @@ private:
     // which Masternodes we've asked for
     std::map<COutPoint, int64_t> mWeAskedForMasternodeListEntry;
 
+    // critical section to protect the paid heights
+    mutable RecursiveMutex cs_paid;
+    // heights of the active chain blocks that paid each payee, ascending
+    std::map<CScript, std::vector<int>> mapPaidHeights;
+    // block the paid heights are up to date with
+    uint256 hashPaidHeightsBlock;
+    const CBlockIndex* pindexPaidHeights = nullptr;
+    // the paid heights are complete from this height up to hashPaidHeightsBlock
+    int nPaidHeightsFrom = std::numeric_limits<int>::max();
+    // running minimum of the block times going back from pindexPaidTimes
+    const CBlockIndex* pindexPaidTimes = nullptr;
+    std::vector<int64_t> vPaidMinTimes;
+
     // find an entry in the masternode list that is next to be paid (internally)
     CMasternode* GetNextMasternodeInQueueForPayment(
         int nBlockHeight, bool fFilterSigTime, 
@@ -148,6 +163,28 @@ public:
 
         READWRITE(mapSeenMasternodeBroadcast);
         READWRITE(mapSeenMasternodePing);
+
+        LOCK(cs_paid);
+        READWRITE(hashPaidHeightsBlock);
+        READWRITE(nPaidHeightsFrom);
+        uint64_t nPayees = (uint64_t)mapPaidHeights.size();
+        READWRITE(COMPACTSIZE(nPayees));
+        if(ser_action.ForRead()) {
+            mapPaidHeights.clear();
+            pindexPaidHeights = nullptr;
+            for(uint64_t i = 0; i < nPayees; i++) {
+                CScript payee;
+                std::vector<int> vHeights;
+                READWRITE(*(CScriptBase*)(&payee));
+                READWRITE(vHeights);
+                mapPaidHeights.emplace(payee, vHeights);
+            }
+        } else {
+            for(auto& it : mapPaidHeights) {
+                READWRITE(*(CScriptBase*)(&it.first));
+                READWRITE(it.second);
+            }
+        }
     }
 
     CMasternodeMan();
@@ -200,6 +237,14 @@ public:
         return std::pair<CMasternode*, std::vector<CTxIn>>(mn, vEligibleTxIns);
     }
 
+    /// Track the masternode paid by a block connected to or disconnected from the active chain
+    void ConnectPaidBlock(const CBlockIndex* pindex, const CScript& payee);
+    void DisconnectPaidBlock(const CBlockIndex* pindex, const CScript& payee);
+
+    /// Time of the last payment CMasternode::GetLastPaidV2 would find walking back from pindex,
+    /// answered from the paid heights. Returns false if they don't cover that walk.
+    bool GetLastPaidTime(const CBlockIndex* pindex, const CScript& payee, int64_t sigTime, int nMaxDepth, int64_t& nTimeRet);
+
     /// Get the current winner for this block
     CMasternode* GetCurrentMasterNode(int mod = 1, int64_t nBlockHeight = 0);
 
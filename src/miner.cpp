@@ -36,7 +36,6 @@
 
 
 #include <boost/thread.hpp>
-#include <boost/tuple/tuple.hpp>
 
 
 //////////////////////////////////////////////////////////////////////////////
@@ -44,52 +43,574 @@
 // Miner
 //
 
-//
-// Unconfirmed transactions in the memory pool often depend on other
-// transactions in the memory pool. When we select transactions from the
-// pool, we select by highest priority or fee rate, so we might consider
-// transactions that depend on transactions that aren't yet in the block.
-// The COrphan class keeps track of these 'temporary orphans' while
-// CreateBlock is figuring out which transactions to include.
-//
-class COrphan
+uint64_t nLastBlockTx = 0;
+uint64_t nLastBlockSize = 0;
+
+namespace {
+
+// Container for tracking updates to ancestor feerate as we include (parent)
+// transactions in a block
+struct CTxMemPoolModifiedEntry {
+    CTxMemPoolModifiedEntry(CTxMemPool::txiter entry)
+    {
+        iter = entry;
+        nSizeWithAncestors = entry->GetSizeWithAncestors();
+        nModFeesWithAncestors = entry->GetModFeesWithAncestors();
+        nSigOpCountWithAncestors = entry->GetSigOpCountWithAncestors();
+    }
+
+    CTxMemPool::txiter iter;
+    uint64_t nSizeWithAncestors;
+    CAmount nModFeesWithAncestors;
+    unsigned int nSigOpCountWithAncestors;
+};
+
+// Comparator for CTxMemPool::txiter objects.
+// It simply compares the internal memory address of the CTxMemPoolEntry object
+// pointed to. This means it has no meaning, and is only useful for using them
+// as key in other indexes.
+struct CompareCTxMemPoolIter {
+    bool operator()(const CTxMemPool::txiter& a, const CTxMemPool::txiter& b) const
+    {
+        return &(*a) < &(*b);
+    }
+};
+
+struct modifiedentry_iter {
+    typedef CTxMemPool::txiter result_type;
+    result_type operator() (const CTxMemPoolModifiedEntry &entry) const
+    {
+        return entry.iter;
+    }
+};
+
+// This matches the calculation in CompareTxMemPoolEntryByAncestorFee,
+// except operating on CTxMemPoolModifiedEntry.
+struct CompareModifiedEntry {
+    bool operator()(const CTxMemPoolModifiedEntry &a, const CTxMemPoolModifiedEntry &b) const
+    {
+        double f1 = (double)a.nModFeesWithAncestors * b.nSizeWithAncestors;
+        double f2 = (double)b.nModFeesWithAncestors * a.nSizeWithAncestors;
+        if (f1 == f2) {
+            return CTxMemPool::CompareIteratorByHash()(a.iter, b.iter);
+        }
+        return f1 > f2;
+    }
+};
+
+// A comparator that sorts transactions based on number of ancestors.
+// This is sufficient to sort an ancestor package in an order that is valid
+// to appear in a block.
+struct CompareTxIterByAncestorCount {
+    bool operator()(const CTxMemPool::txiter &a, const CTxMemPool::txiter &b) const
+    {
+        if (a->GetCountWithAncestors() != b->GetCountWithAncestors())
+            return a->GetCountWithAncestors() < b->GetCountWithAncestors();
+        return CTxMemPool::CompareIteratorByHash()(a, b);
+    }
+};
+
+typedef boost::multi_index_container<
+    CTxMemPoolModifiedEntry,
+    boost::multi_index::indexed_by<
+        boost::multi_index::ordered_unique<
+            modifiedentry_iter,
+            CompareCTxMemPoolIter
+        >,
+        // sorted by modified ancestor fee rate
+        boost::multi_index::ordered_non_unique<
+            boost::multi_index::identity<CTxMemPoolModifiedEntry>,
+            CompareModifiedEntry
+        >
+    >
+> indexed_modified_transaction_set;
+
+typedef indexed_modified_transaction_set::nth_index<0>::type::iterator modtxiter;
+typedef indexed_modified_transaction_set::nth_index<1>::type::iterator modtxscoreiter;
+
+struct update_for_parent_inclusion
 {
-public:
-    const CTransaction* ptx;
-    std::set<uint256> setDependsOn;
-    CFeeRate feeRate;
-    double dPriority;
+    update_for_parent_inclusion(CTxMemPool::txiter it) : iter(it) {}
 
-    COrphan(const CTransaction* ptxIn) : ptx(ptxIn), feeRate(0), dPriority(0)
+    void operator() (CTxMemPoolModifiedEntry &e)
     {
+        e.nModFeesWithAncestors -= iter->GetModifiedFee();
+        e.nSizeWithAncestors -= iter->GetTxSize();
+        e.nSigOpCountWithAncestors -= iter->GetSigOpCount();
     }
+
+    CTxMemPool::txiter iter;
 };
 
-uint64_t nLastBlockTx = 0;
-uint64_t nLastBlockSize = 0;
+/**
+ * The mempool transactions picked for the last block, with the limits and the
+ * tip they were picked for. A staker builds a block each time it finds a
+ * kernel: the body is only picked again when the mempool or the tip changed,
+ * and while every mempool transaction fits in it, new transactions are just
+ * appended and the ones mined by the new tip dropped.
+ */
+struct CBlockBody
+{
+    uint256 hashPrevBlock;
+    int nHeight = 0;
+    unsigned int nTransactionsUpdated = 0;
+    unsigned int nBlockMaxSize = 0;
+    unsigned int nBlockPrioritySize = 0;
+    unsigned int nBlockMinSize = 0;
+
+    //! every transaction of the mempool is in the body
+    bool fComplete = false;
+    //! a transaction was left out for its lock time, which expires with the clock
+    bool fHasNonFinal = false;
+
+    std::vector<CTransaction> vtx;
+    std::vector<CAmount> vTxFees;
+    std::vector<int64_t> vTxSigOps;
+    uint64_t nBlockSize = 1000;
+    int nBlockSigOps = 100;
+    CAmount nFees = 0;
+};
+
+CBlockBody cachedBlockBody; // protected by cs_main
 
-// We want to sort transactions by priority and fee rate, so:
-typedef boost::tuple<double, CFeeRate, const CTransaction*> TxPriority;
-class TxPriorityCompare
+/** Picks the mempool transactions of a block body */
+class BlockBodyAssembler
 {
-    bool byFee;
+private:
+    CBlockBody& body;
+    const int nHeight;
+    const bool fPrintPriority;
+    CTxMemPool::setEntries inBlock;
+
+    bool TestPackage(uint64_t packageSize, unsigned int packageSigOps) const;
+    bool TestPackageTransactions(const CTxMemPool::setEntries& package);
+    bool TestInputs(const CTransaction& tx, CCoinsViewCache& view) const;
+    void AddToBlock(CTxMemPool::txiter iter, const CCoinsViewCache& view);
+    bool IsStillDependent(CTxMemPool::txiter iter) const;
+    void UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set& mapModifiedTx) const;
+    bool SkipMapTxEntry(CTxMemPool::txiter it, indexed_modified_transaction_set& mapModifiedTx, CTxMemPool::setEntries& failedTx) const;
+
+    void AddPriorityTxs(CCoinsViewCache& view);
+    void AddPackageTxs(CCoinsViewCache& view);
 
 public:
-    TxPriorityCompare(bool _byFee) : byFee(_byFee) {}
+    BlockBodyAssembler(CBlockBody& bodyIn, int nHeightIn) :
+        body(bodyIn), nHeight(nHeightIn), fPrintPriority(GetBoolArg("-printpriority", DEFAULT_PRINTPRIORITY)) {}
+
+    /** Pick the transactions of an empty body */
+    void Assemble();
+    /** Drop what left the mempool and append what entered it. False if the
+     *  body has to be picked again. */
+    bool Update();
+};
 
-    bool operator()(const TxPriority& a, const TxPriority& b)
-    {
-        if (byFee) {
-            if (a.get<1>() == b.get<1>())
-                return a.get<0>() < b.get<0>();
-            return a.get<1>() < b.get<1>();
+bool BlockBodyAssembler::TestPackage(uint64_t packageSize, unsigned int packageSigOps) const
+{
+    if (body.nBlockSize + packageSize >= body.nBlockMaxSize)
+        return false;
+    if (body.nBlockSigOps + packageSigOps >= MAX_BLOCK_SIGOPS_CURRENT)
+        return false;
+    return true;
+}
+
+bool BlockBodyAssembler::TestPackageTransactions(const CTxMemPool::setEntries& package)
+{
+    for (const CTxMemPool::txiter& it : package) {
+        const CTransaction& tx = it->GetTx();
+        if (tx.IsCoinBase() || tx.IsCoinStake())
+            return false;
+        if (!IsFinalTx(tx, nHeight)) {
+            body.fHasNonFinal = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BlockBodyAssembler::TestInputs(const CTransaction& tx, CCoinsViewCache& view) const
+{
+    if (!view.HaveInputs(tx))
+        return false;
+
+    // Note that flags: we don't want to set mempool/IsStandard()
+    // policy here, but we still have to ensure that the block we
+    // create only contains transactions that are valid in new blocks.
+    CValidationState state;
+    PrecomputedTransactionData precomTxData(tx);
+    if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true, false, precomTxData))
+        return false;
+
+    UpdateCoins(tx, view, nHeight);
+    return true;
+}
+
+void BlockBodyAssembler::AddToBlock(CTxMemPool::txiter iter, const CCoinsViewCache& view)
+{
+    const CTransaction& tx = iter->GetTx();
+    // The fees paid go to the coinbase, not the modified ones
+    const CAmount nTxFees = view.GetValueIn(tx) - tx.GetValueOut();
+    const unsigned int nTxSigOps = GetLegacySigOpCount(tx) + GetP2SHSigOpCount(tx, view);
+
+    body.vtx.push_back(tx);
+    body.vTxFees.push_back(nTxFees);
+    body.vTxSigOps.push_back(nTxSigOps);
+    body.nBlockSize += iter->GetTxSize();
+    body.nBlockSigOps += nTxSigOps;
+    body.nFees += nTxFees;
+    inBlock.insert(iter);
+
+    if (fPrintPriority) {
+        double dPriority = iter->GetPriority(nHeight);
+        CAmount dummy;
+        mempool.ApplyDeltas(tx.GetHash(), dPriority, dummy);
+        LogPrintf("priority %.1f fee %s txid %s\n",
+                  dPriority,
+                  CFeeRate(iter->GetModifiedFee(), iter->GetTxSize()).ToString(),
+                  tx.GetHash().ToString());
+    }
+}
+
+bool BlockBodyAssembler::IsStillDependent(CTxMemPool::txiter iter) const
+{
+    for (const CTxMemPool::txiter& parent : mempool.GetMemPoolParents(iter)) {
+        if (!inBlock.count(parent))
+            return true;
+    }
+    return false;
+}
+
+void BlockBodyAssembler::AddPriorityTxs(CCoinsViewCache& view)
+{
+    if (body.nBlockPrioritySize == 0)
+        return;
+
+    // This vector will be sorted into a priority queue:
+    std::vector<TxCoinAgePriority> vecPriority;
+    TxCoinAgePriorityCompare pricomparer;
+    std::map<CTxMemPool::txiter, double, CTxMemPool::CompareIteratorByHash> waitPriMap;
+    double actualPriority = -1;
+
+    vecPriority.reserve(mempool.mapTx.size());
+    for (CTxMemPool::indexed_transaction_set::iterator mi = mempool.mapTx.begin();
+         mi != mempool.mapTx.end(); ++mi) {
+        double dPriority = mi->GetPriority(nHeight);
+        CAmount dummy;
+        mempool.ApplyDeltas(mi->GetTx().GetHash(), dPriority, dummy);
+        vecPriority.push_back(TxCoinAgePriority(dPriority, mi));
+    }
+    std::make_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+
+    while (!vecPriority.empty()) {
+        // add a tx from priority queue to fill the blockprioritysize
+        CTxMemPool::txiter iter = vecPriority.front().second;
+        actualPriority = vecPriority.front().first;
+        std::pop_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+        vecPriority.pop_back();
+
+        // The rest is left to the fees it pays
+        if (!AllowFree(actualPriority))
+            break;
+
+        // If tx is dependent on other mempool txs which haven't yet been included
+        // then put it in the waitSet
+        if (IsStillDependent(iter)) {
+            waitPriMap.insert(std::make_pair(iter, actualPriority));
+            continue;
+        }
+
+        // If this tx fits in the block add it, otherwise keep looping
+        CTxMemPool::setEntries package;
+        package.insert(iter);
+        if (!TestPackage(iter->GetTxSize(), iter->GetSigOpCount()) || !TestPackageTransactions(package) ||
+            !TestInputs(iter->GetTx(), view))
+            continue;
+
+        AddToBlock(iter, view);
+
+        // If now that this txs is added we've surpassed our desired priority size
+        // then we're done adding priority txs
+        if (body.nBlockSize >= body.nBlockPrioritySize)
+            break;
+
+        // This tx was successfully added, so
+        // add transactions that depend on this one to the priority queue to try again
+        for (const CTxMemPool::txiter& child : mempool.GetMemPoolChildren(iter)) {
+            auto wpiter = waitPriMap.find(child);
+            if (wpiter != waitPriMap.end()) {
+                vecPriority.push_back(TxCoinAgePriority(wpiter->second, child));
+                std::push_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+                waitPriMap.erase(wpiter);
+            }
+        }
+    }
+}
+
+// Add descendants of given transactions to mapModifiedTx with ancestor
+// state updated assuming given transactions are inBlock.
+void BlockBodyAssembler::UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded,
+        indexed_modified_transaction_set& mapModifiedTx) const
+{
+    for (const CTxMemPool::txiter& it : alreadyAdded) {
+        CTxMemPool::setEntries descendants;
+        mempool.CalculateDescendants(it, descendants);
+        // Insert all descendants (not yet in block) into the modified set
+        for (const CTxMemPool::txiter& desc : descendants) {
+            if (alreadyAdded.count(desc))
+                continue;
+            modtxiter mit = mapModifiedTx.find(desc);
+            if (mit == mapModifiedTx.end()) {
+                CTxMemPoolModifiedEntry modEntry(desc);
+                modEntry.nSizeWithAncestors -= it->GetTxSize();
+                modEntry.nModFeesWithAncestors -= it->GetModifiedFee();
+                modEntry.nSigOpCountWithAncestors -= it->GetSigOpCount();
+                mapModifiedTx.insert(modEntry);
+            } else {
+                mapModifiedTx.modify(mit, update_for_parent_inclusion(it));
+            }
+        }
+    }
+}
+
+// Skip entries in mapTx that are already in a block or are present
+// in mapModifiedTx (which implies that the mapTx ancestor state is
+// stale due to ancestor inclusion in the block), or that failed before
+bool BlockBodyAssembler::SkipMapTxEntry(CTxMemPool::txiter it, indexed_modified_transaction_set& mapModifiedTx, CTxMemPool::setEntries& failedTx) const
+{
+    assert(it != mempool.mapTx.end());
+    return mapModifiedTx.count(it) || inBlock.count(it) || failedTx.count(it);
+}
+
+// Packages are picked by the feerate of the transaction with all its
+// ancestors not in the block yet, so a child paying for its parents gets
+// them in, then the ancestor state of the descendants of what was added is
+// recomputed in mapModifiedTx.
+void BlockBodyAssembler::AddPackageTxs(CCoinsViewCache& view)
+{
+    // mapModifiedTx will store sorted packages after they are modified
+    // because some of their txs are already in the block
+    indexed_modified_transaction_set mapModifiedTx;
+    // Keep track of entries that failed inclusion, to avoid duplicate work
+    CTxMemPool::setEntries failedTx;
+
+    // Start by adding all descendants of previously added txs to mapModifiedTx
+    // and modifying them for their already included ancestors
+    UpdatePackagesForAdded(inBlock, mapModifiedTx);
+
+    CTxMemPool::indexed_transaction_set::nth_index<4>::type::iterator mi = mempool.mapTx.get<4>().begin();
+    CTxMemPool::txiter iter;
+    while (mi != mempool.mapTx.get<4>().end() || !mapModifiedTx.empty()) {
+        // First try to find a new transaction in mapTx to evaluate.
+        if (mi != mempool.mapTx.get<4>().end() &&
+                SkipMapTxEntry(mempool.mapTx.project<0>(mi), mapModifiedTx, failedTx)) {
+            ++mi;
+            continue;
+        }
+
+        // Now that mi is not stale, determine which transaction to evaluate:
+        // the next entry from mapTx, or the best from mapModifiedTx?
+        bool fUsingModified = false;
+
+        modtxscoreiter modit = mapModifiedTx.get<1>().begin();
+        if (mi == mempool.mapTx.get<4>().end()) {
+            // We're out of entries in mapTx; use the entry from mapModifiedTx
+            iter = modit->iter;
+            fUsingModified = true;
         } else {
-            if (a.get<0>() == b.get<0>())
-                return a.get<1>() < b.get<1>();
-            return a.get<0>() < b.get<0>();
+            // Try to compare the mapTx entry to the mapModifiedTx entry
+            iter = mempool.mapTx.project<0>(mi);
+            if (modit != mapModifiedTx.get<1>().end() &&
+                    CompareModifiedEntry()(*modit, CTxMemPoolModifiedEntry(iter))) {
+                // The best entry in mapModifiedTx has higher score
+                // than the one from mapTx.
+                // Switch which transaction (package) to consider
+                iter = modit->iter;
+                fUsingModified = true;
+            } else {
+                // Either no entry in mapModifiedTx, or it's worse than mapTx.
+                // Increment mi for the next loop iteration.
+                ++mi;
+            }
+        }
+
+        // We skip mapTx entries that are inBlock, and mapModifiedTx shouldn't
+        // contain anything that is inBlock.
+        assert(!inBlock.count(iter));
+
+        uint64_t packageSize = iter->GetSizeWithAncestors();
+        CAmount packageFees = iter->GetModFeesWithAncestors();
+        unsigned int packageSigOps = iter->GetSigOpCountWithAncestors();
+        if (fUsingModified) {
+            packageSize = modit->nSizeWithAncestors;
+            packageFees = modit->nModFeesWithAncestors;
+            packageSigOps = modit->nSigOpCountWithAncestors;
+        }
+
+        // Skip free transactions if we're past the minimum block size,
+        // everything else we might consider has a lower fee rate
+        if (packageFees < ::minRelayTxFee.GetFee(packageSize) && body.nBlockSize + packageSize >= body.nBlockMinSize)
+            return;
+
+        CTxMemPool::setEntries ancestors;
+        bool fFailed = !TestPackage(packageSize, packageSigOps);
+        if (!fFailed) {
+            uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+            std::string dummy;
+            mempool.CalculateMemPoolAncestors(*iter, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
+            for (CTxMemPool::setEntries::iterator it = ancestors.begin(); it != ancestors.end(); ) {
+                // Only test txs not already in the block
+                if (inBlock.count(*it)) {
+                    ancestors.erase(it++);
+                } else {
+                    it++;
+                }
+            }
+            ancestors.insert(iter);
+            fFailed = !TestPackageTransactions(ancestors);
+        }
+
+        // Package can be added if all its inputs check out. Sort the entries
+        // in a valid order.
+        std::vector<CTxMemPool::txiter> sortedEntries;
+        if (!fFailed) {
+            sortedEntries.insert(sortedEntries.begin(), ancestors.begin(), ancestors.end());
+            std::sort(sortedEntries.begin(), sortedEntries.end(), CompareTxIterByAncestorCount());
+            CCoinsViewCache viewPackage(&view);
+            for (const CTxMemPool::txiter& it : sortedEntries) {
+                if (!TestInputs(it->GetTx(), viewPackage)) {
+                    fFailed = true;
+                    break;
+                }
+            }
+            if (!fFailed)
+                viewPackage.Flush();
+        }
+
+        if (fFailed) {
+            if (fUsingModified) {
+                // Since we always look at the best entry in mapModifiedTx,
+                // we must erase failed entries so that we can consider the
+                // next best entry on the next loop iteration
+                mapModifiedTx.get<1>().erase(modit);
+            }
+            failedTx.insert(iter);
+            continue;
         }
+
+        for (const CTxMemPool::txiter& it : sortedEntries) {
+            AddToBlock(it, view);
+            // Erase from the modified set, if present
+            mapModifiedTx.erase(it);
+        }
+
+        // Update transactions that depend on each of these
+        UpdatePackagesForAdded(ancestors, mapModifiedTx);
     }
-};
+}
+
+void BlockBodyAssembler::Assemble()
+{
+    inBlock.clear();
+    CCoinsViewCache view(pcoinsTip);
+    AddPriorityTxs(view);
+    AddPackageTxs(view);
+}
+
+bool BlockBodyAssembler::Update()
+{
+    // Drop what was mined or left the mempool. A transaction is only taken
+    // out of the mempool along with its descendants, unless it was mined.
+    CBlockBody kept(body);
+    kept.vtx.clear();
+    kept.vTxFees.clear();
+    kept.vTxSigOps.clear();
+    inBlock.clear();
+    for (size_t i = 0; i < body.vtx.size(); i++) {
+        CTxMemPool::txiter it = mempool.mapTx.find(body.vtx[i].GetHash());
+        if (it == mempool.mapTx.end()) {
+            kept.nBlockSize -= ::GetSerializeSize(body.vtx[i], SER_NETWORK, PROTOCOL_VERSION);
+            kept.nBlockSigOps -= body.vTxSigOps[i];
+            kept.nFees -= body.vTxFees[i];
+            continue;
+        }
+        kept.vtx.push_back(body.vtx[i]);
+        kept.vTxFees.push_back(body.vTxFees[i]);
+        kept.vTxSigOps.push_back(body.vTxSigOps[i]);
+        inBlock.insert(it);
+    }
+    body = std::move(kept);
+
+    // Everything else in the mempool is new, look for it from the most recent
+    const size_t nNew = mempool.mapTx.size() - inBlock.size();
+    std::vector<CTxMemPool::txiter> vNew;
+    CTxMemPool::indexed_transaction_set::nth_index<2>::type::iterator ti = mempool.mapTx.get<2>().end();
+    while (vNew.size() < nNew && ti != mempool.mapTx.get<2>().begin()) {
+        --ti;
+        CTxMemPool::txiter it = mempool.mapTx.project<0>(ti);
+        if (!inBlock.count(it))
+            vNew.push_back(it);
+    }
+    std::sort(vNew.begin(), vNew.end(), CompareTxIterByAncestorCount());
+
+    // Append them in the order they can be mined, as long as any of them
+    // would have been picked anyway
+    CCoinsViewMemPool viewMemPool(pcoinsTip, mempool);
+    CCoinsViewCache view(&viewMemPool);
+    for (const CTxMemPool::txiter& it : vNew) {
+        // After a reorg, transactions of the disconnected blocks come back
+        // before the ones spending them
+        if (IsStillDependent(it))
+            return false;
+        for (const CTxMemPool::txiter& child : mempool.GetMemPoolChildren(it)) {
+            if (inBlock.count(child))
+                return false;
+        }
+        CTxMemPool::setEntries package;
+        package.insert(it);
+        if (it->GetModifiedFee() < ::minRelayTxFee.GetFee(it->GetTxSize()) && body.nBlockSize + it->GetTxSize() >= body.nBlockMinSize)
+            return false;
+        if (!TestPackage(it->GetTxSize(), it->GetSigOpCount()) || !TestPackageTransactions(package) ||
+            !TestInputs(it->GetTx(), view))
+            return false;
+        AddToBlock(it, view);
+    }
+    return true;
+}
+
+/** Bring the cached body up to date for a block on top of pindexPrev */
+const CBlockBody& GetBlockBody(const CBlockIndex* pindexPrev, unsigned int nBlockMaxSize, unsigned int nBlockPrioritySize, unsigned int nBlockMinSize)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(mempool.cs);
+
+    CBlockBody& body = cachedBlockBody;
+    const int nHeight = pindexPrev->nHeight + 1;
+    const unsigned int nTransactionsUpdated = mempool.GetTransactionsUpdated();
+    const bool fSameLimits = body.nBlockMaxSize == nBlockMaxSize &&
+                             body.nBlockPrioritySize == nBlockPrioritySize &&
+                             body.nBlockMinSize == nBlockMinSize;
+    const bool fSameTip = body.hashPrevBlock == pindexPrev->GetBlockHash() && body.nHeight == nHeight;
+    const bool fNextTip = pindexPrev->pprev && body.hashPrevBlock == pindexPrev->pprev->GetBlockHash() &&
+                          body.nHeight + 1 == nHeight;
+
+    if (fSameLimits && fSameTip && !body.fHasNonFinal && body.nTransactionsUpdated == nTransactionsUpdated)
+        return body;
+
+    BlockBodyAssembler assembler(body, nHeight);
+    if (!(fSameLimits && body.fComplete && (fSameTip || fNextTip) && assembler.Update())) {
+        body = CBlockBody();
+        body.nBlockMaxSize = nBlockMaxSize;
+        body.nBlockPrioritySize = nBlockPrioritySize;
+        body.nBlockMinSize = nBlockMinSize;
+        assembler.Assemble();
+    }
+    body.hashPrevBlock = pindexPrev->GetBlockHash();
+    body.nHeight = nHeight;
+    body.nTransactionsUpdated = nTransactionsUpdated;
+    body.fComplete = !body.fHasNonFinal && body.vtx.size() == mempool.mapTx.size();
+    return body;
+}
+
+} // anon namespace
 
 void UpdateTime(CBlockHeader* pblock, const CBlockIndex* pindexPrev)
 {
@@ -206,193 +727,26 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
     unsigned int nBlockMinSize = GetArg("-blockminsize", DEFAULT_BLOCK_MIN_SIZE);
     nBlockMinSize = std::min(nBlockMaxSize, nBlockMinSize);
 
-    // Collect memory pool transactions into the block
-    CAmount nFees = 0;
-
     LOCK(cs_main);
 
     {
         LOCK(mempool.cs);
 
-        CCoinsViewCache view(pcoinsTip);
-
-        // Priority order to process transactions
-        std::list<COrphan> vOrphan; // list memory doesn't move
-        std::map<uint256, std::vector<COrphan*> > mapDependers;
-        bool fPrintPriority = GetBoolArg("-printpriority", DEFAULT_PRINTPRIORITY);
-
-        // This vector will be sorted into a priority queue:
-        std::vector<TxPriority> vecPriority;
-        vecPriority.reserve(mempool.mapTx.size());
-        for (CTxMemPool::indexed_transaction_set::iterator mi = mempool.mapTx.begin();
-             mi != mempool.mapTx.end(); ++mi) {
-            const CTransaction& tx = mi->GetTx();
-            if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, nHeight)){
-                continue;
-            }
-
-            COrphan* porphan = NULL;
-            double dPriority = 0;
-            CAmount nTotalIn = 0;
-            bool fMissingInputs = false;
-
-            for (const CTxIn& txin : tx.vin) {
-                // Read prev transaction
-                if (!view.HaveCoin(txin.prevout)) {
-                    // This should never happen; all transactions in the memory
-                    // pool should connect to either transactions in the chain
-                    // or other transactions in the memory pool.
-                    if (!mempool.mapTx.count(txin.prevout.hash)) {
-                        LogPrintf("ERROR: mempool transaction missing input\n");
-                        fMissingInputs = true;
-                        if (porphan)
-                            vOrphan.pop_back();
-                        break;
-                    }
-
-                    // Has to wait for dependencies
-                    if (!porphan) {
-                        // Use list for automatic deletion
-                        vOrphan.push_back(COrphan(&tx));
-                        porphan = &vOrphan.back();
-                    }
-                    mapDependers[txin.prevout.hash].push_back(porphan);
-                    porphan->setDependsOn.insert(txin.prevout.hash);
-                    nTotalIn += mempool.mapTx.find(txin.prevout.hash)->GetTx().vout[txin.prevout.n].nValue;
-                    continue;
-                }
-
-                const Coin& coin = view.AccessCoin(txin.prevout);
-                assert(!coin.IsSpent());
-
-                CAmount nValueIn = coin.out.nValue;
-                nTotalIn += nValueIn;
-
-                int nConf = nHeight - coin.nHeight;
-
-                dPriority = double_safe_addition(dPriority, ((double)nValueIn * nConf));
-            }
-            if (fMissingInputs) continue;
-
-            // Priority is sum(valuein * age) / modified_txsize
-            unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-            dPriority = tx.ComputePriority(dPriority, nTxSize);
-
-            uint256 hash = tx.GetHash();
-            mempool.ApplyDeltas(hash, dPriority, nTotalIn);
-
-            CFeeRate feeRate(nTotalIn - tx.GetValueOut(), nTxSize);
-
-            if (porphan) {
-                porphan->dPriority = dPriority;
-                porphan->feeRate = feeRate;
-            } else
-                vecPriority.push_back(TxPriority(dPriority, feeRate, &mi->GetTx()));
-        }
-
-        // Collect transactions into block
-        uint64_t nBlockSize = 1000;
-        uint64_t nBlockTx = 0;
-        int nBlockSigOps = 100;
-        bool fSortedByFee = (nBlockPrioritySize <= 0);
-
-        TxPriorityCompare comparer(fSortedByFee);
-        std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
-
-        while (!vecPriority.empty()) {
-            // Take highest priority transaction off the priority queue:
-            double dPriority = vecPriority.front().get<0>();
-            CFeeRate feeRate = vecPriority.front().get<1>();
-            const CTransaction& tx = *(vecPriority.front().get<2>());
-
-            std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
-            vecPriority.pop_back();
-
-            // Size limits
-            unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-            if (nBlockSize + nTxSize >= nBlockMaxSize)
-                continue;
-
-            // Legacy limits on sigOps:
-            unsigned int nMaxBlockSigOps = MAX_BLOCK_SIGOPS_CURRENT;
-            unsigned int nTxSigOps = GetLegacySigOpCount(tx);
-            if (nBlockSigOps + nTxSigOps >= nMaxBlockSigOps)
-                continue;
-
-            // Skip free transactions if we're past the minimum block size:
-            const uint256& hash = tx.GetHash();
-            double dPriorityDelta = 0;
-            CAmount nFeeDelta = 0;
-            mempool.ApplyDeltas(hash, dPriorityDelta, nFeeDelta);
-            if (fSortedByFee && (dPriorityDelta <= 0) && (nFeeDelta <= 0) && (feeRate < ::minRelayTxFee) && (nBlockSize + nTxSize >= nBlockMinSize))
-                continue;
-
-            // Prioritise by fee once past the priority size or we run out of high-priority
-            // transactions:
-            if (!fSortedByFee &&
-                ((nBlockSize + nTxSize >= nBlockPrioritySize) || !AllowFree(dPriority))) {
-                fSortedByFee = true;
-                comparer = TxPriorityCompare(fSortedByFee);
-                std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
-            }
-
-            if (!view.HaveInputs(tx))
-                continue;
-
-            CAmount nTxFees = view.GetValueIn(tx) - tx.GetValueOut();
-
-            nTxSigOps += GetP2SHSigOpCount(tx, view);
-            if (nBlockSigOps + nTxSigOps >= nMaxBlockSigOps)
-                continue;
-
-            // Note that flags: we don't want to set mempool/IsStandard()
-            // policy here, but we still have to ensure that the block we
-            // create only contains transactions that are valid in new blocks.
-
-            CValidationState state;
-            PrecomputedTransactionData precomTxData(tx);
-            if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true, precomTxData))
-                continue;
-
-            UpdateCoins(tx, view, nHeight);
-
-            // Added
-            pblock->vtx.push_back(tx);
-            pblocktemplate->vTxFees.push_back(nTxFees);
-            pblocktemplate->vTxSigOps.push_back(nTxSigOps);
-            nBlockSize += nTxSize;
-            ++nBlockTx;
-            nBlockSigOps += nTxSigOps;
-            nFees += nTxFees;
-
-            if (fPrintPriority) {
-                LogPrintf("priority %.1f fee %s txid %s\n",
-                    dPriority, feeRate.ToString(), tx.GetHash().ToString());
-            }
-
-            // Add transactions that depend on this one to the priority queue
-            if (mapDependers.count(hash)) {
-                for (COrphan* porphan : mapDependers[hash]) {
-                    if (!porphan->setDependsOn.empty()) {
-                        porphan->setDependsOn.erase(hash);
-                        if (porphan->setDependsOn.empty()) {
-                            vecPriority.push_back(TxPriority(porphan->dPriority, porphan->feeRate, porphan->ptx));
-                            std::push_heap(vecPriority.begin(), vecPriority.end(), comparer);
-                        }
-                    }
-                }
-            }
-        }
+        // Collect memory pool transactions into the block
+        const CBlockBody& body = GetBlockBody(pindexPrev, nBlockMaxSize, nBlockPrioritySize, nBlockMinSize);
+        pblock->vtx.insert(pblock->vtx.end(), body.vtx.begin(), body.vtx.end());
+        pblocktemplate->vTxFees.insert(pblocktemplate->vTxFees.end(), body.vTxFees.begin(), body.vTxFees.end());
+        pblocktemplate->vTxSigOps.insert(pblocktemplate->vTxSigOps.end(), body.vTxSigOps.begin(), body.vTxSigOps.end());
 
         if (!fProofOfStake) {
             // Coinbase can get the fees.
-            pblock->vtx[0].vout[0].nValue += nFees;
-            pblocktemplate->vTxFees[0] = -nFees;
+            pblock->vtx[0].vout[0].nValue += body.nFees;
+            pblocktemplate->vTxFees[0] = -body.nFees;
         }
 
-        nLastBlockTx = nBlockTx;
-        nLastBlockSize = nBlockSize;
-        LogPrintf("%s : total size %u\n", __func__, nBlockSize);
+        nLastBlockTx = body.vtx.size();
+        nLastBlockSize = body.nBlockSize;
+        LogPrintf("%s : total size %u\n", __func__, body.nBlockSize);
 
         // Fill in header
         pblock->hashPrevBlock = pindexPrev->GetBlockHash();
@@ -417,6 +771,7 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
     if (!TestBlockValidity(state, *pblock, pindexPrev, false, false)) {
         LogPrintf("CreateNewBlock() : TestBlockValidity failed\n");
         mempool.clear();
+        cachedBlockBody = CBlockBody();
         return nullptr;
     }
 
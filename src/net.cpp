@@ -31,6 +31,14 @@
 #include <string.h>
 #else
 #include <fcntl.h>
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#define USE_POLL
+#endif
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#define USE_EPOLL
+#endif
 #endif
 
 #ifdef USE_UPNP
@@ -55,6 +63,9 @@
 // We add a random period time (0 to 1 seconds) to feeler connections to prevent synchronization.
 #define FEELER_SLEEP_WINDOW 1
 
+// Maximum number of socket events returned by one epoll_wait call, the others are returned by the next ones
+#define MAX_EPOLL_EVENTS 1024
+
 #if !defined(HAVE_MSG_NOSIGNAL) && !defined(MSG_NOSIGNAL)
 #define MSG_NOSIGNAL 0
 #endif
@@ -164,6 +175,62 @@ CAddress GetLocalAddress(const CNetAddr* paddrPeer, ServiceFlags nLocalServices)
     return ret;
 }
 
+std::string SocketEventsModeToString(SocketEventsMode mode)
+{
+    switch (mode) {
+    case SOCKETEVENTS_SELECT:
+        return "select";
+    case SOCKETEVENTS_POLL:
+        return "poll";
+    case SOCKETEVENTS_EPOLL:
+        return "epoll";
+    }
+    return "unknown";
+}
+
+bool SocketEventsModeFromString(const std::string& strMode, SocketEventsMode& mode)
+{
+    if (strMode == "select") {
+        mode = SOCKETEVENTS_SELECT;
+        return true;
+    }
+#ifdef USE_POLL
+    if (strMode == "poll") {
+        mode = SOCKETEVENTS_POLL;
+        return true;
+    }
+#endif
+#ifdef USE_EPOLL
+    if (strMode == "epoll") {
+        mode = SOCKETEVENTS_EPOLL;
+        return true;
+    }
+#endif
+    return false;
+}
+
+SocketEventsMode GetDefaultSocketEventsMode()
+{
+#if defined(USE_EPOLL)
+    return SOCKETEVENTS_EPOLL;
+#elif defined(USE_POLL)
+    return SOCKETEVENTS_POLL;
+#else
+    return SOCKETEVENTS_SELECT;
+#endif
+}
+
+std::string GetSupportedSocketEventsModes()
+{
+    std::string strModes;
+    for (SocketEventsMode mode : {SOCKETEVENTS_SELECT, SOCKETEVENTS_POLL, SOCKETEVENTS_EPOLL}) {
+        SocketEventsMode modeParsed;
+        if (SocketEventsModeFromString(SocketEventsModeToString(mode), modeParsed))
+            strModes += (strModes.empty() ? "" : ", ") + SocketEventsModeToString(mode);
+    }
+    return strModes;
+}
+
 bool RecvLine(SOCKET hSocket, std::string& strLine)
 {
     strLine = "";
@@ -419,7 +486,7 @@ CNode* CConnman::ConnectNode(CAddress addrConnect, const char* pszDest, bool fCo
     bool proxyConnectionFailed = false;
     if (pszDest ? ConnectSocketByName(addrConnect, hSocket, pszDest, Params().GetDefaultPort(), nConnectTimeout, &proxyConnectionFailed, sHostIp) :
                   ConnectSocket(addrConnect, hSocket, nConnectTimeout, &proxyConnectionFailed, sHostIp)) {
-        if (!IsSelectableSocket(hSocket)) {
+        if (!IsSelectableSocket(hSocket, socketEventsMode == SOCKETEVENTS_SELECT)) {
             LogPrintf("Cannot create connection: non-selectable socket created (fd >= FD_SETSIZE ?)\n");
             CloseSocket(hSocket);
             return NULL;
@@ -1113,7 +1180,7 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
         return;
     }
 
-    if (!IsSelectableSocket(hSocket)) {
+    if (!IsSelectableSocket(hSocket, socketEventsMode == SOCKETEVENTS_SELECT)) {
         LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
         CloseSocket(hSocket);
         return;
@@ -1166,6 +1233,277 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
     }
 }
 
+bool CConnman::GenerateSelectSet(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    for (const ListenSocket& hListenSocket : vhListenSocket) {
+        recv_set.insert(hListenSocket.socket);
+    }
+
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodes) {
+            // Implement the following logic:
+            // * If there is data to send, select() for sending data. As this only
+            //   happens when optimistic write failed, we choose to first drain the
+            //   write buffer in this case before receiving more. This avoids
+            //   needlessly queueing received data, if the remote peer is not themselves
+            //   receiving data. This means properly utilizing TCP flow control signalling.
+            // * Otherwise, if there is space left in the receive buffer, select() for
+            //   receiving data.
+            // * Hand off all complete messages to the processor, to be handled without
+            //   blocking here.
+
+            bool select_recv = !pnode->fPauseRecv;
+            bool select_send;
+            {
+                LOCK(pnode->cs_vSend);
+                select_send = !pnode->vSendMsg.empty();
+            }
+
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+
+            error_set.insert(pnode->hSocket);
+            if (select_send) {
+                send_set.insert(pnode->hSocket);
+                continue;
+            }
+            if (select_recv) {
+                recv_set.insert(pnode->hSocket);
+            }
+        }
+    }
+
+#ifndef WIN32
+    if (wakeupPipe[0] != -1)
+        recv_set.insert(wakeupPipe[0]);
+#endif
+
+    return !recv_set.empty() || !send_set.empty() || !error_set.empty();
+}
+
+void CConnman::SocketEventsSelect(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, int nTimeoutMillis)
+{
+    std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
+    if (!GenerateSelectSet(recv_select_set, send_select_set, error_select_set)) {
+        interruptNet.sleep_for(std::chrono::milliseconds(nTimeoutMillis));
+        return;
+    }
+
+    struct timeval timeout = MillisToTimeval(nTimeoutMillis);
+
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+
+    for (SOCKET hSocket : recv_select_set) {
+        FD_SET(hSocket, &fdsetRecv);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+    for (SOCKET hSocket : send_select_set) {
+        FD_SET(hSocket, &fdsetSend);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+    for (SOCKET hSocket : error_select_set) {
+        FD_SET(hSocket, &fdsetError);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+
+    int nSelect = select(hSocketMax + 1, &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+    if (interruptNet)
+        return;
+
+    if (nSelect == SOCKET_ERROR) {
+        int nErr = WSAGetLastError();
+        LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+        // try to receive from all the sockets, to find the failing ones
+        recv_set.insert(recv_select_set.begin(), recv_select_set.end());
+        recv_set.insert(error_select_set.begin(), error_select_set.end());
+        interruptNet.sleep_for(std::chrono::milliseconds(nTimeoutMillis));
+        return;
+    }
+
+    for (SOCKET hSocket : recv_select_set) {
+        if (FD_ISSET(hSocket, &fdsetRecv))
+            recv_set.insert(hSocket);
+    }
+    for (SOCKET hSocket : send_select_set) {
+        if (FD_ISSET(hSocket, &fdsetSend))
+            send_set.insert(hSocket);
+    }
+    for (SOCKET hSocket : error_select_set) {
+        if (FD_ISSET(hSocket, &fdsetError))
+            error_set.insert(hSocket);
+    }
+}
+
+#ifdef USE_POLL
+void CConnman::SocketEventsPoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, int nTimeoutMillis)
+{
+    std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
+    if (!GenerateSelectSet(recv_select_set, send_select_set, error_select_set)) {
+        interruptNet.sleep_for(std::chrono::milliseconds(nTimeoutMillis));
+        return;
+    }
+
+    // not limited to FD_SETSIZE sockets, but still built for every wait
+    std::map<SOCKET, struct pollfd> mapPollFds;
+    for (SOCKET hSocket : recv_select_set) {
+        mapPollFds[hSocket].fd = hSocket;
+        mapPollFds[hSocket].events |= POLLIN;
+    }
+    for (SOCKET hSocket : send_select_set) {
+        mapPollFds[hSocket].fd = hSocket;
+        mapPollFds[hSocket].events |= POLLOUT;
+    }
+    for (SOCKET hSocket : error_select_set) {
+        // errors and hang ups are always reported
+        mapPollFds[hSocket].fd = hSocket;
+    }
+
+    std::vector<struct pollfd> vPollFds;
+    vPollFds.reserve(mapPollFds.size());
+    for (const auto& it : mapPollFds) {
+        vPollFds.push_back(it.second);
+    }
+
+    int nPoll = poll(vPollFds.data(), vPollFds.size(), nTimeoutMillis);
+    if (interruptNet)
+        return;
+
+    if (nPoll < 0) {
+        if (errno != EINTR) {
+            LogPrintf("socket poll error %s\n", NetworkErrorString(errno));
+            interruptNet.sleep_for(std::chrono::milliseconds(nTimeoutMillis));
+        }
+        return;
+    }
+
+    for (const struct pollfd& pollFd : vPollFds) {
+        if (pollFd.revents & POLLIN)
+            recv_set.insert(pollFd.fd);
+        if (pollFd.revents & POLLOUT)
+            send_set.insert(pollFd.fd);
+        if (pollFd.revents & (POLLERR | POLLHUP | POLLNVAL))
+            error_set.insert(pollFd.fd);
+    }
+}
+#else
+void CConnman::SocketEventsPoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, int nTimeoutMillis)
+{
+    SocketEventsSelect(recv_set, send_set, error_set, nTimeoutMillis);
+}
+#endif
+
+#ifdef USE_EPOLL
+void CConnman::SocketEventsEpoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, int nTimeoutMillis)
+{
+    // The sockets are added to the epoll set once, the events they wait for
+    // are only changed when the logic of GenerateSelectSet asks for others
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodes) {
+            int nEvents = 0;
+            {
+                LOCK(pnode->cs_vSend);
+                if (!pnode->vSendMsg.empty())
+                    nEvents = EPOLLOUT;
+            }
+            if (nEvents == 0 && !pnode->fPauseRecv)
+                nEvents = EPOLLIN;
+
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET || pnode->nSocketEvents == nEvents)
+                continue;
+
+            struct epoll_event event;
+            event.events = nEvents;
+            event.data.fd = pnode->hSocket;
+            if (epoll_ctl(epollfd, pnode->nSocketEvents == -1 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, pnode->hSocket, &event) != 0) {
+                LogPrintf("epoll_ctl failed for peer=%d: %s\n", pnode->GetId(), NetworkErrorString(errno));
+                pnode->fDisconnect = true;
+                continue;
+            }
+            pnode->nSocketEvents = nEvents;
+        }
+    }
+
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int nReady = epoll_wait(epollfd, events, MAX_EPOLL_EVENTS, nTimeoutMillis);
+    if (interruptNet)
+        return;
+
+    if (nReady < 0) {
+        if (errno != EINTR) {
+            LogPrintf("socket epoll_wait error %s\n", NetworkErrorString(errno));
+            interruptNet.sleep_for(std::chrono::milliseconds(nTimeoutMillis));
+        }
+        return;
+    }
+
+    for (int i = 0; i < nReady; i++) {
+        const struct epoll_event& event = events[i];
+        if (event.events & EPOLLIN)
+            recv_set.insert(event.data.fd);
+        if (event.events & EPOLLOUT)
+            send_set.insert(event.data.fd);
+        if (event.events & (EPOLLERR | EPOLLHUP))
+            error_set.insert(event.data.fd);
+    }
+}
+#else
+void CConnman::SocketEventsEpoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, int nTimeoutMillis)
+{
+    SocketEventsPoll(recv_set, send_set, error_set, nTimeoutMillis);
+}
+#endif
+
+void CConnman::SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    // Without a wakeup pipe the wait also paces the sending of queued data
+    const int nTimeoutMillis = wakeupPipe[0] != -1 ? SOCKET_EVENTS_TIMEOUT_MILLISECONDS : SELECT_TIMEOUT_MILLISECONDS;
+
+    switch (socketEventsMode) {
+    case SOCKETEVENTS_EPOLL:
+        SocketEventsEpoll(recv_set, send_set, error_set, nTimeoutMillis);
+        break;
+    case SOCKETEVENTS_POLL:
+        SocketEventsPoll(recv_set, send_set, error_set, nTimeoutMillis);
+        break;
+    default:
+        SocketEventsSelect(recv_set, send_set, error_set, nTimeoutMillis);
+        break;
+    }
+
+#ifndef WIN32
+    if (wakeupPipe[0] != -1 && recv_set.count(wakeupPipe[0])) {
+        // reset before draining, so that a later wakeup writes to the pipe again
+        fWakeupPending = false;
+        char buf[128];
+        while (read(wakeupPipe[0], buf, sizeof(buf)) > 0) {}
+        recv_set.erase(wakeupPipe[0]);
+    }
+#endif
+}
+
+void CConnman::WakeSelect()
+{
+#ifndef WIN32
+    if (wakeupPipe[1] == -1 || fWakeupPending.exchange(true))
+        return;
+
+    char buf = 0;
+    if (write(wakeupPipe[1], &buf, sizeof(buf)) != 1) {
+        LogPrint(BCLog::NET, "write to wakeupPipe failed: %s\n", NetworkErrorString(errno));
+    }
+#endif
+}
+
 void CConnman::ThreadSocketHandler()
 {
     unsigned int nPrevNodeCount = 0;
@@ -1246,87 +1584,17 @@ void CConnman::ThreadSocketHandler()
         //
         // Find which sockets have data to receive
         //
-        struct timeval timeout;
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
+        std::set<SOCKET> recv_set, send_set, error_set;
+        SocketEvents(recv_set, send_set, error_set);
 
-        for (const ListenSocket& hListenSocket : vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = std::max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
-
-        {
-            LOCK(cs_vNodes);
-            for (CNode* pnode : vNodes) {
-                // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
-                //   happens when optimistic write failed, we choose to first drain the
-                //   write buffer in this case before receiving more. This avoids
-                //   needlessly queueing received data, if the remote peer is not themselves
-                //   receiving data. This means properly utilizing TCP flow control signalling.
-                // * Otherwise, if there is space left in the receive buffer, select() for
-                //   receiving data.
-                // * Hand off all complete messages to the processor, to be handled without
-                //   blocking here.
-
-                bool select_recv = !pnode->fPauseRecv;
-                bool select_send;
-                {
-                    LOCK(pnode->cs_vSend);
-                    select_send = !pnode->vSendMsg.empty();
-                }
-
-                LOCK(pnode->cs_hSocket);
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = std::max(hSocketMax, pnode->hSocket);
-                have_fds = true;
-
-                if (select_send) {
-                    FD_SET(pnode->hSocket, &fdsetSend);
-                    continue;
-                }
-                if (select_recv) {
-                    FD_SET(pnode->hSocket, &fdsetRecv);
-                }
-            }
-        }
-
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
         if (interruptNet)
             return;
 
-        if (nSelect == SOCKET_ERROR) {
-            if (have_fds) {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            if (!interruptNet.sleep_for(std::chrono::milliseconds(timeout.tv_usec/1000)))
-                return;
-        }
-
         //
         // Accept new connections
         //
         for (const ListenSocket& hListenSocket : vhListenSocket) {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv)) {
+            if (hListenSocket.socket != INVALID_SOCKET && recv_set.count(hListenSocket.socket) > 0) {
                 AcceptConnection(hListenSocket);
             }
         }
@@ -1355,9 +1623,9 @@ void CConnman::ThreadSocketHandler()
                 LOCK(pnode->cs_hSocket);
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
-                recvSet = FD_ISSET(pnode->hSocket, &fdsetRecv);
-                sendSet = FD_ISSET(pnode->hSocket, &fdsetSend);
-                errorSet = FD_ISSET(pnode->hSocket, &fdsetError);
+                recvSet = recv_set.count(pnode->hSocket) > 0;
+                sendSet = send_set.count(pnode->hSocket) > 0;
+                errorSet = error_set.count(pnode->hSocket) > 0;
             }
             if (recvSet || errorSet) {
                 {
@@ -1951,6 +2219,8 @@ bool CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
     }
+    // start waiting for its data
+    WakeSelect();
 
     return true;
 }
@@ -1968,16 +2238,20 @@ void CConnman::ThreadMessageHandler()
         }
 
         bool fMoreWork = false;
+        bool fWakeSelect = false;
 
         for (CNode* pnode : vNodesCopy) {
             if (pnode->fDisconnect)
                 continue;
 
             // Receive messages
+            const bool fPausedRecv = pnode->fPauseRecv;
             bool fMoreNodeWork = GetNodeSignals().ProcessMessages(pnode, *this, flagInterruptMsgProc);
             fMoreWork |= (fMoreNodeWork && !pnode->fPauseSend);
             if (flagInterruptMsgProc)
                 return;
+            // the socket handler waits for its data again, or disconnects it
+            fWakeSelect |= (fPausedRecv && !pnode->fPauseRecv) || pnode->fDisconnect;
 
             // Send messages
             {
@@ -1995,6 +2269,9 @@ void CConnman::ThreadMessageHandler()
                 pnode->Release();
         }
 
+        if (fWakeSelect)
+            WakeSelect();
+
         std::unique_lock<std::mutex> lock(mutexMsgProc);
         if (!fMoreWork) {
             condMsgProc.wait_until(lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(100), [this] { return fMsgProcWake; });
@@ -2147,6 +2424,10 @@ CConnman::CConnman(uint64_t nSeed0In, uint64_t nSeed1In) : nSeed0(nSeed0In), nSe
     nBestHeight = 0;
     clientInterface = NULL;
     flagInterruptMsgProc = false;
+    socketEventsMode = SOCKETEVENTS_SELECT;
+    epollfd = -1;
+    wakeupPipe[0] = wakeupPipe[1] = -1;
+    fWakeupPending = false;
 }
 
 NodeId CConnman::GetNewNodeId()
@@ -2167,9 +2448,51 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
 
     nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
     nReceiveFloodSize = connOptions.nReceiveFloodSize;
+    socketEventsMode = connOptions.socketEventsMode;
 
     SetBestHeight(connOptions.nBestHeight);
 
+#ifndef WIN32
+    // Interrupts the wait for socket events when there is something to send
+    if (pipe(wakeupPipe) != 0) {
+        wakeupPipe[0] = wakeupPipe[1] = -1;
+        LogPrint(BCLog::NET, "pipe() for wakeupPipe failed, sending queued data periodically\n");
+    } else {
+        for (int fd : wakeupPipe) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        }
+    }
+#endif
+
+#ifdef USE_EPOLL
+    if (socketEventsMode == SOCKETEVENTS_EPOLL) {
+        epollfd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollfd == -1) {
+            strNodeError = strprintf(_("Failed to create the epoll set of sockets: %s"), NetworkErrorString(errno));
+            LogPrintf("%s\n", strNodeError);
+            return false;
+        }
+
+        // the peer sockets are added by the socket handler
+        std::vector<SOCKET> vSockets;
+        for (const ListenSocket& hListenSocket : vhListenSocket)
+            vSockets.push_back(hListenSocket.socket);
+        if (wakeupPipe[0] != -1)
+            vSockets.push_back(wakeupPipe[0]);
+        for (SOCKET hSocket : vSockets) {
+            struct epoll_event event;
+            event.events = EPOLLIN;
+            event.data.fd = hSocket;
+            if (epoll_ctl(epollfd, EPOLL_CTL_ADD, hSocket, &event) != 0) {
+                strNodeError = strprintf(_("Failed to add a socket to the epoll set: %s"), NetworkErrorString(errno));
+                LogPrintf("%s\n", strNodeError);
+                return false;
+            }
+        }
+    }
+#endif
+    LogPrintf("Using %s for socket events\n", SocketEventsModeToString(socketEventsMode));
+
     clientInterface = connOptions.uiInterface;
     if (clientInterface)
         clientInterface->InitMessage(_("Loading addresses..."));
@@ -2343,6 +2666,19 @@ void CConnman::Stop()
     vNodes.clear();
     vNodesDisconnected.clear();
     vhListenSocket.clear();
+
+#ifdef USE_EPOLL
+    if (epollfd != -1)
+        close(epollfd);
+    epollfd = -1;
+#endif
+#ifndef WIN32
+    for (int& fd : wakeupPipe) {
+        if (fd != -1)
+            close(fd);
+        fd = -1;
+    }
+#endif
     delete semOutbound;
     semOutbound = NULL;
     if(pnodeLocalHost)
@@ -2580,6 +2916,7 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     fPauseRecv = false;
     fPauseSend = false;
     nProcessQueueSize = 0;
+    nSocketEvents = -1;
 
     for (const std::string &msg : getAllNetMessageTypes())
         mapRecvBytesPerMsgCmd[msg] = 0;
@@ -2649,6 +2986,7 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
     CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, serializedHeader, 0, hdr};
 
     size_t nBytesSent = 0;
+    bool fWakeSelect = false;
     {
         LOCK(pnode->cs_vSend);
         bool optimisticSend(pnode->vSendMsg.empty());
@@ -2664,11 +3002,16 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
             pnode->vSendMsg.push_back(std::move(msg.data));
 
         // If write queue empty, attempt "optimistic write"
-        if (optimisticSend == true)
+        if (optimisticSend == true) {
             nBytesSent = SocketSendData(pnode);
+            // the socket handler sends the rest, as soon as the socket is writable
+            fWakeSelect = !pnode->vSendMsg.empty();
+        }
     }
     if (nBytesSent)
         RecordBytesSent(nBytesSent);
+    if (fWakeSelect)
+        WakeSelect();
 }
 
 bool CConnman::ForNode(NodeId id, std::function<bool(CNode* pnode)> func)
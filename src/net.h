@@ -29,6 +29,7 @@
 #include <stdint.h>
 #include <thread>
 #include <memory>
+#include <set>
 #include <condition_variable>
 
 #ifndef WIN32
@@ -93,6 +94,26 @@ static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
 // NOTE: When adjusting this, update rpcnet:setban's help ("24h")
 static const unsigned int DEFAULT_MISBEHAVING_BANTIME = 60 * 60 * 24;  // Default 24-hour ban
 
+/** Time to wait for socket events, where the wait can't be interrupted (Windows), to send queued data (in milliseconds) */
+static const int SELECT_TIMEOUT_MILLISECONDS = 50;
+/** Time to wait for socket events otherwise, between the connection checks (in milliseconds) */
+static const int SOCKET_EVENTS_TIMEOUT_MILLISECONDS = 1000;
+
+/** How the socket handler waits for socket events */
+enum SocketEventsMode {
+    SOCKETEVENTS_SELECT,
+    SOCKETEVENTS_POLL,
+    SOCKETEVENTS_EPOLL,
+};
+
+/** Parse a -socketevents mode, false if unknown or not supported by this build */
+bool SocketEventsModeFromString(const std::string& strMode, SocketEventsMode& mode);
+std::string SocketEventsModeToString(SocketEventsMode mode);
+/** The most scalable mode supported by this build */
+SocketEventsMode GetDefaultSocketEventsMode();
+/** Comma separated list of the modes supported by this build */
+std::string GetSupportedSocketEventsModes();
+
 bool RecvLine(SOCKET hSocket, std::string& strLine);
 
 typedef int NodeId;
@@ -145,6 +166,7 @@ public:
         CClientUIInterface* uiInterface = nullptr;
         unsigned int nSendBufferMaxSize = 0;
         unsigned int nReceiveFloodSize = 0;
+        SocketEventsMode socketEventsMode = SOCKETEVENTS_SELECT;
     };
     CConnman(uint64_t seed0, uint64_t seed1);
     ~CConnman();
@@ -294,6 +316,15 @@ private:
     void ThreadDNSAddressSeed();
 
     void WakeMessageHandler();
+    /** Interrupt the socket handler wait for socket events, to pick up new data to send or connections */
+    void WakeSelect();
+
+    bool GenerateSelectSet(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+    /** Wait for socket events, returning the sockets ready to receive, to send, or with errors */
+    void SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+    void SocketEventsSelect(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, int nTimeoutMillis);
+    void SocketEventsPoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, int nTimeoutMillis);
+    void SocketEventsEpoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, int nTimeoutMillis);
 
     uint64_t CalculateKeyedNetGroup(const CAddress& ad);
 
@@ -382,6 +413,13 @@ private:
 
     CThreadInterrupt interruptNet;
 
+    SocketEventsMode socketEventsMode;
+    /** The epoll set of the listening and peer sockets, in the epoll mode. */
+    int epollfd;
+    /** Pipe written by WakeSelect, and whether a byte is in it already. Not available on Windows. */
+    int wakeupPipe[2];
+    std::atomic<bool> fWakeupPending;
+
     std::thread threadDNSAddressSeed;
     std::thread threadSocketHandler;
     std::thread threadOpenAddedConnections;
@@ -652,6 +690,7 @@ private:
     const int nMyStartingHeight;
     int nSendVersion;
     std::list<CNetMessage> vRecvMsg;  // Used only by SocketHandler thread
+    int nSocketEvents;                // Events registered in the epoll set, -1 if not registered. Used only by SocketHandler thread
 
     mutable RecursiveMutex cs_addrName;
     std::string addrName;
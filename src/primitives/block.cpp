@@ -14,28 +14,131 @@
 #include "utilstrencodings.h"
 #include "util.h"
 
+#include <array>
+#include <deque>
+#include <map>
+#include <mutex>
+
+namespace {
+
+typedef std::array<unsigned char, 80> HeaderData;
+
+//! Guards the legacy hashes computed ahead of validation
+std::mutex csPrecomputedHashes;
+std::map<HeaderData, uint256> mapPrecomputedHashes;
+std::deque<std::map<HeaderData, uint256>::iterator> queuePrecomputedHashes;
+
+void GetHeaderData(const CBlockHeader& header, HeaderData& data)
+{
+    WriteLE32(&data[0], header.nVersion);
+    memcpy(&data[4], header.hashPrevBlock.begin(), header.hashPrevBlock.size());
+    memcpy(&data[36], header.hashMerkleRoot.begin(), header.hashMerkleRoot.size());
+    WriteLE32(&data[68], header.nTime);
+    WriteLE32(&data[72], header.nBits);
+    WriteLE32(&data[76], header.nNonce);
+}
+
+} // anon namespace
+
+CBlockHeader::CBlockHeader(const CBlockHeader& other)
+{
+    *this = other;
+}
+
+CBlockHeader& CBlockHeader::operator=(const CBlockHeader& other)
+{
+    nVersion = other.nVersion;
+    hashPrevBlock = other.hashPrevBlock;
+    hashMerkleRoot = other.hashMerkleRoot;
+    nTime = other.nTime;
+    nBits = other.nBits;
+    nNonce = other.nNonce;
+    nAccumulatorCheckpoint = other.nAccumulatorCheckpoint;
+    CopyCachedHash(other);
+    return *this;
+}
+
+void CBlockHeader::CopyCachedHash(const CBlockHeader& other) const
+{
+    if (&other == this) return;
+    if (other.nHashCacheState.load(std::memory_order_acquire) != HASH_CACHE_READY) return;
+
+    StoreCachedHash(other.vchHashedHeader, other.hashCached);
+}
+
+void CBlockHeader::StoreCachedHash(const HeaderData& data, const uint256& hash) const
+{
+    // the threads racing to fill it computed the same hash: only one writes it,
+    // and a filled cache that already holds it is left alone for its readers
+    int nState = nHashCacheState.load(std::memory_order_acquire);
+    if (nState == HASH_CACHE_WRITING ||
+        (nState == HASH_CACHE_READY && data == vchHashedHeader && hash == hashCached) ||
+        !nHashCacheState.compare_exchange_strong(nState, HASH_CACHE_WRITING, std::memory_order_acquire))
+        return;
+
+    vchHashedHeader = data;
+    hashCached = hash;
+    nHashCacheState.store(HASH_CACHE_READY, std::memory_order_release);
+}
+
 // TODO: Change X11KVS algorithm call to whatever the coin being adapted is used.
 uint256 CBlockHeader::GetHash() const
 {
-     if (nVersion < 4)  { // nVersion = 1, 2, 3
-#if defined(WORDS_BIGENDIAN)
-        uint8_t data[80];
-        WriteLE32(&data[0], nVersion);
-        memcpy(&data[4], hashPrevBlock.begin(), hashPrevBlock.size());
-        memcpy(&data[36], hashMerkleRoot.begin(), hashMerkleRoot.size());
-        WriteLE32(&data[68], nTime);
-        WriteLE32(&data[72], nBits);
-        WriteLE32(&data[76], nNonce);
-
-        return HashX11KVS(data, data + 80);
-#else // Can take shortcut for little endian
-        return HashX11KVS(BEGIN(nVersion), END(nNonce));
-#endif
+    if (IsLegacyHash()) { // nVersion = 1, 2, 3
+        HeaderData data;
+        GetHeaderData(*this, data);
+        if (nHashCacheState.load(std::memory_order_acquire) == HASH_CACHE_READY && data == vchHashedHeader)
+            return hashCached;
+
+        uint256 hash;
+        {
+            std::lock_guard<std::mutex> lock(csPrecomputedHashes);
+            const auto it = mapPrecomputedHashes.find(data);
+            if (it != mapPrecomputedHashes.end()) hash = it->second;
+        }
+        if (hash.IsNull()) hash = HashX11KVS(data.data(), data.data() + data.size());
+
+        StoreCachedHash(data, hash);
+        return hash;
     }
-	
+
     return SerializeHash(*this); // nVersion >= 4
 }
 
+void CBlockHeader::PrecomputeHash() const
+{
+    if (!IsLegacyHash()) return;
+
+    HeaderData data;
+    GetHeaderData(*this, data);
+    {
+        std::lock_guard<std::mutex> lock(csPrecomputedHashes);
+        if (mapPrecomputedHashes.count(data)) return;
+    }
+
+    // hash outside the lock, this is what the callers parallelize
+    const uint256 hash = HashX11KVS(data.data(), data.data() + data.size());
+
+    std::lock_guard<std::mutex> lock(csPrecomputedHashes);
+    const auto ret = mapPrecomputedHashes.emplace(data, hash);
+    if (!ret.second) return;
+    queuePrecomputedHashes.push_back(ret.first);
+    if (queuePrecomputedHashes.size() > MAX_PRECOMPUTED_HEADER_HASHES) {
+        mapPrecomputedHashes.erase(queuePrecomputedHashes.front());
+        queuePrecomputedHashes.pop_front();
+    }
+}
+
+void CBlockHeader::SetCachedHash(const uint256& hash) const
+{
+    // the other versions hash with a single SHA256d, not worth remembering
+    if (!IsLegacyHash()) return;
+
+    HeaderData data;
+    GetHeaderData(*this, data);
+    StoreCachedHash(data, hash);
+}
+
 CScript CBlock::GetPaidPayee(CAmount nAmount) const
 {
     const auto& tx = vtx[IsProofOfWork() ? 0 : 1];
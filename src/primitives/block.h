@@ -13,6 +13,9 @@
 #include "serialize.h"
 #include "uint256.h"
 
+#include <array>
+#include <atomic>
+
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
  * requirements.  When they solve the proof-of-work, they broadcast the block
@@ -33,11 +36,25 @@ public:
     uint32_t nNonce;
     uint256 nAccumulatorCheckpoint;             // only for version 4, 5 and 6.
 
+    // memory only
+    //! Bytes of the header the last legacy hash was computed from, and that
+    //! hash. A header changed since then no longer matches and is rehashed.
+    //! GetHash() fills them on const headers shared between threads: a single
+    //! thread writes them at a time, and they are read once nHashCacheState
+    //! is HASH_CACHE_READY (release/acquire).
+    mutable std::array<unsigned char, 80> vchHashedHeader;
+    mutable uint256 hashCached;
+    enum HashCacheState { HASH_CACHE_EMPTY, HASH_CACHE_WRITING, HASH_CACHE_READY };
+    mutable std::atomic<int> nHashCacheState{HASH_CACHE_EMPTY};
+
     CBlockHeader()
     {
         SetNull();
     }
 
+    CBlockHeader(const CBlockHeader& other);
+    CBlockHeader& operator=(const CBlockHeader& other);
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -63,6 +80,8 @@ public:
         nBits = 0;
         nNonce = 0;
         nAccumulatorCheckpoint.SetNull();
+        hashCached.SetNull();
+        nHashCacheState.store(HASH_CACHE_EMPTY, std::memory_order_relaxed);
     }
 
     bool IsNull() const
@@ -72,12 +91,41 @@ public:
 
     uint256 GetHash() const;
 
+    //! Whether GetHash() runs the expensive X11KVS chains (nVersion 1, 2 and 3)
+    bool IsLegacyHash() const
+    {
+        return nVersion < 4;
+    }
+
+    /**
+     * Compute the hash of a legacy header ahead of time and remember it, so
+     * the following GetHash() calls on an identical header are served from
+     * memory. Safe to call from any thread.
+     */
+    void PrecomputeHash() const;
+
+    /**
+     * Remember a hash known to belong to this header, e.g. the one of its
+     * block index entry, so that GetHash() does not compute it again.
+     */
+    void SetCachedHash(const uint256& hash) const;
+
+    //! Take over the cached hash of another header, if it has one
+    void CopyCachedHash(const CBlockHeader& other) const;
+
     int64_t GetBlockTime() const
     {
         return (int64_t)nTime;
     }
+
+private:
+    //! Fill the cached hash, unless another thread is filling it
+    void StoreCachedHash(const std::array<unsigned char, 80>& data, const uint256& hash) const;
 };
 
+//! Number of legacy header hashes kept by CBlockHeader::PrecomputeHash()
+static const size_t MAX_PRECOMPUTED_HEADER_HASHES = 8192;
+
 
 class CBlock : public CBlockHeader
 {
@@ -131,6 +179,7 @@ public:
         block.nNonce         = nNonce;
         if(nVersion > 3 && nVersion < 7)
             block.nAccumulatorCheckpoint = nAccumulatorCheckpoint;
+        block.CopyCachedHash(*this);
         return block;
     }
 
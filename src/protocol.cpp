@@ -39,6 +39,10 @@ const char* FILTERADD = "filteradd";
 const char* FILTERCLEAR = "filterclear";
 const char* REJECT = "reject";
 const char* SENDHEADERS = "sendheaders";
+const char* SENDCMPCT = "sendcmpct";
+const char* CMPCTBLOCK = "cmpctblock";
+const char* GETBLOCKTXN = "getblocktxn";
+const char* BLOCKTXN = "blocktxn";
 const char* IX = "ix";
 const char* IXLOCKVOTE = "txlvote";
 const char* SPORK = "spork";
@@ -73,7 +77,8 @@ static const char* ppszTypeName[] = {
     NetMsgType::BUDGETPROPOSAL,
     NetMsgType::BUDGETVOTE,
     NetMsgType::FINALBUDGET,
-    NetMsgType::FINALBUDGETVOTE
+    NetMsgType::FINALBUDGETVOTE,
+    NetMsgType::CMPCTBLOCK
 };
 
 /** All known message types. Keep this in the same order as the list of
@@ -102,6 +107,10 @@ const static std::string allNetMessageTypes[] = {
     NetMsgType::FILTERCLEAR,
     NetMsgType::REJECT,
     NetMsgType::SENDHEADERS,
+    NetMsgType::SENDCMPCT,
+    NetMsgType::CMPCTBLOCK,
+    NetMsgType::GETBLOCKTXN,
+    NetMsgType::BLOCKTXN,
     NetMsgType::IX,
     NetMsgType::IXLOCKVOTE,
     NetMsgType::SPORK,
@@ -223,7 +232,8 @@ bool CInv::IsKnownType() const
 }
 
 bool CInv::IsMasterNodeType() const{
-     return (type >= 6);
+     // MSG_CMPCT_BLOCK comes after them, and is a block
+     return (type >= MSG_SPORK && type <= MSG_DSTX);
 }
 
 const char* CInv::GetCommand() const
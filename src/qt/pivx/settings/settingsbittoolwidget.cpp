@@ -313,7 +313,14 @@ void SettingsBitToolWidget::importAddressFromDecKey()
 
         // whenever a key is imported, we need to scan the whole chain
         pwalletMain->nTimeFirstKey = 1; // 0 would be considered 'no value'
-        pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true);
+        const int nResult = pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true);
+        if (nResult == WALLET_RESCAN_RUNNING || nResult == WALLET_RESCAN_ABORTED) {
+            ui->statusLabel_DEC->setStyleSheet("QLabel { color: red; }");
+            ui->statusLabel_DEC->setText(nResult == WALLET_RESCAN_RUNNING ?
+                    tr("Private key added, but the wallet is already rescanning. Rescan it once done") :
+                    tr("Private key added, but the rescan was aborted"));
+            return;
+        }
     }
 
     ui->statusLabel_DEC->setStyleSheet("QLabel { color: green; }");
@@ -4,6 +4,7 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "burnaddresses.h"
 #include "fs.h"
 #include "logging.h"
 #include "main.h"
@@ -22,6 +23,7 @@
 #include <boost/unordered_map.hpp>
 
 boost::unordered_map<int, CAmount> mDynamicRewards;
+CSupplyLedger supplyLedger;
 
 sqlite3* db = nullptr;
 sqlite3_stmt* insertStmt = nullptr;
@@ -131,6 +133,22 @@ bool CRewards::Init(bool fReindex)
                 }
             }
 
+            if(ok) { // Loads the supply ledger
+                const auto setCollaterals = CMasternode::GetMasternodeCollaterals();
+                const auto pathLedger = GetDataDir() / "chainstate" / "supply.dat";
+                if (
+                    !fReindex && 
+                    fs::exists(pathLedger) && 
+                    supplyLedger.Read(pathLedger) && 
+                    supplyLedger.GetCollaterals() == setCollaterals
+                ) {
+                    oss << "Loaded supply ledger at block " << supplyLedger.GetBestBlock().GetHex() << std::endl;
+                } else {
+                    // start from the empty UTXO set, it gets rebuilt on the next epoch if the chain is already further
+                    supplyLedger.Clear(setCollaterals, Params().GetConsensus().hashGenesisBlock);
+                }
+            }
+
             if(ok && mDynamicRewards.size() > 0) { // Printing the map
                 oss << "Dynamic Rewards:" << std::endl;
                 for (const auto& pair : mDynamicRewards) {
@@ -161,6 +179,8 @@ bool CRewards::Init(bool fReindex)
 
 void CRewards::Shutdown()
 {
+    FlushSupplyLedger();
+
     if(insertStmt != nullptr) sqlite3_finalize(insertStmt);
     if(deleteStmt != nullptr) sqlite3_finalize(deleteStmt);
     if(db != nullptr) sqlite3_close(db);
@@ -187,12 +207,15 @@ bool CRewards::IsDynamicRewardsEpochHeight(int nHeight)
     return GetDynamicRewardsEpochHeight(nHeight) == nHeight;
 }
 
-bool CRewards::ConnectBlock(CBlockIndex* pindex, CAmount nSubsidy, CCoinsViewCache& coins)
+bool CRewards::ConnectBlock(CBlockIndex* pindex, CAmount nSubsidy, CCoinsViewCache& coins, const CBlock& block, const CBlockUndo& blockundo)
 {
     auto& params = Params();
     auto& consensus = params.GetConsensus();
     const auto nHeight = pindex->nHeight;
     const auto nEpochHeight = GetDynamicRewardsEpochHeight(nHeight);
+    const auto nBlocksPerMonth = MONTH_IN_SECONDS / consensus.nTargetSpacing;
+    // the ledger must reflect the UTXO set of the previous block, like the chainstate does at this point
+    auto fLedgerSynced = supplyLedger.GetBestBlock() == pindex->pprev->GetBlockHash();
     std::ostringstream oss;
     auto ok = true;
 
@@ -206,7 +229,6 @@ bool CRewards::ConnectBlock(CBlockIndex* pindex, CAmount nSubsidy, CCoinsViewCac
         ) {
             auto nBlocksPerDay = DAY_IN_SECONDS / consensus.nTargetSpacing;
             auto nBlocksPerWeek = WEEK_IN_SECONDS / consensus.nTargetSpacing;
-            auto nBlocksPerMonth = MONTH_IN_SECONDS / consensus.nTargetSpacing;
 
             // get total money supply
             const auto nMoneySupply = pindex->nMoneySupply.get();
@@ -218,52 +240,16 @@ bool CRewards::ConnectBlock(CBlockIndex* pindex, CAmount nSubsidy, CCoinsViewCac
 
             // calculate the current circulating supply
             CAmount nCirculatingSupply = 0;
-            FlushStateToDisk();
-            std::unique_ptr<CCoinsViewCursor> pcursor(coins.Cursor());
-
-            while (pcursor->Valid()) {
-                COutPoint key;
-                Coin coin;
-                if (pcursor->GetKey(key) && pcursor->GetValue(coin) && !coin.IsSpent()) {
-                    // ----------- burn address scanning -----------
-                    CTxDestination source;
-                    if (ExtractDestination(coin.out.scriptPubKey, source)) {
-                        const std::string addr = EncodeDestination(source);
-                        if (consensus.mBurnAddresses.find(addr) != consensus.mBurnAddresses.end() &&
-                            consensus.mBurnAddresses.at(addr) < nHeight
-                        ) {
-                            pcursor->Next(); // Skip
-                            continue;
-                        }
-                    }
-
-                    // ----------- masternode collaterals scanning ----------- 
-                    if(
-                        coin.out.nValue == nCollateralAmount || 
-                        coin.out.nValue == nNextWeekCollateralAmount
-                    ) {
-                        pcursor->Next(); // Skip
-                        continue;
-                    }
-
-                    // ----------- UTXOs age related scanning -----------
-                    auto nBlocksDiff = static_cast<int64_t>(nHeight - coin.nHeight);
-                    const auto nMultiplier = 100000000LL;
-
-                    // y = mx + b 
-                    // 3 months old or less => 100%
-                    // 12 months old or greater => 0%
-                    const auto nSupplyWeightRatio = 
-                        std::min(
-                            std::max(
-                                (100LL * nMultiplier - (((100LL * nMultiplier)/(9LL * nBlocksPerMonth)) * (nBlocksDiff - 3LL * nBlocksPerMonth))) / nMultiplier, 
-                            0LL), 
-                        100LL);
-
-                    nCirculatingSupply += coin.out.nValue * nSupplyWeightRatio / 100LL;
-                }
-
-                pcursor->Next();
+            if (
+                !fLedgerSynced ||
+                !supplyLedger.GetCirculatingSupply(nHeight, nBlocksPerMonth, nCollateralAmount, nNextWeekCollateralAmount, nCirculatingSupply)
+            ) {
+                // the supply ledger can't serve this epoch, rebuild it with a full chainstate walk
+                oss << "Rebuilding the supply ledger" << std::endl;
+                FlushStateToDisk();
+                supplyLedger.Clear(CMasternode::GetMasternodeCollaterals(), UINT256_ZERO);
+                nCirculatingSupply = ScanCirculatingSupply(coins, nHeight, nCollateralAmount, nNextWeekCollateralAmount, &supplyLedger);
+                fLedgerSynced = supplyLedger.GetBestBlock() == pindex->pprev->GetBlockHash();
             }
             oss << "nCirculatingSupply: " << FormatMoney(nCirculatingSupply) << std::endl;
 
@@ -345,6 +331,25 @@ bool CRewards::ConnectBlock(CBlockIndex* pindex, CAmount nSubsidy, CCoinsViewCac
         }
     }
 
+    // Supply ledger management
+    if (fLedgerSynced) {
+        for (unsigned int i = 0; i < block.vtx.size(); i++) {
+            const CTransaction& tx = block.vtx[i];
+            if (i > 0) {
+                for (const Coin& coin : blockundo.vtxundo[i - 1].vprevout) {
+                    supplyLedger.SpendCoin(coin.out, coin.nHeight);
+                }
+            }
+            for (const CTxOut& out : tx.vout) {
+                if (!out.scriptPubKey.IsUnspendable()) {
+                    supplyLedger.AddCoin(out, nHeight);
+                }
+            }
+        }
+        supplyLedger.SetBestBlock(pindex->GetBlockHash());
+        supplyLedger.Fold(nHeight, nBlocksPerMonth);
+    }
+
     std::string log = oss.str();
     if (!log.empty()) {
         std::istringstream iss(log);
@@ -357,7 +362,7 @@ bool CRewards::ConnectBlock(CBlockIndex* pindex, CAmount nSubsidy, CCoinsViewCac
     return ok;
 }
 
-bool CRewards::DisconnectBlock(CBlockIndex* pindex)
+bool CRewards::DisconnectBlock(CBlockIndex* pindex, const CBlock& block, const CBlockUndo& blockUndo)
 {
     auto& consensus = Params().GetConsensus();
     const auto nHeight = pindex->nHeight;
@@ -383,6 +388,25 @@ bool CRewards::DisconnectBlock(CBlockIndex* pindex)
                 sqlite3_reset(deleteStmt);
             }
         }
+
+        // Supply ledger management
+        if (supplyLedger.GetBestBlock() == pindex->GetBlockHash()) {
+            // undo in reverse order, as an output created earlier in the block may be spent by a later transaction
+            for (int i = block.vtx.size() - 1; i >= 0; i--) {
+                const CTransaction& tx = block.vtx[i];
+                for (const CTxOut& out : tx.vout) {
+                    if (!out.scriptPubKey.IsUnspendable()) {
+                        supplyLedger.SpendCoin(out, nHeight);
+                    }
+                }
+                if (i > 0) {
+                    for (const Coin& coin : blockUndo.vtxundo[i - 1].vprevout) {
+                        supplyLedger.AddCoin(coin.out, coin.nHeight);
+                    }
+                }
+            }
+            supplyLedger.SetBestBlock(pindex->pprev->GetBlockHash());
+        }
     } 
     catch(const std::exception& e)
     {
@@ -444,6 +468,68 @@ CAmount CRewards::GetBlockValue(int nHeight)
     return nSubsidy;
 }
 
+CAmount CRewards::ScanCirculatingSupply(CCoinsView& coins, int nHeight, CAmount nCollateralAmount, CAmount nNextWeekCollateralAmount, CSupplyLedger* pledger)
+{
+    auto& consensus = Params().GetConsensus();
+    const auto nBlocksPerMonth = MONTH_IN_SECONDS / consensus.nTargetSpacing;
+
+    CAmount nCirculatingSupply = 0;
+    std::unique_ptr<CCoinsViewCursor> pcursor(coins.Cursor());
+
+    while (pcursor->Valid()) {
+        COutPoint key;
+        Coin coin;
+        if (pcursor->GetKey(key) && pcursor->GetValue(coin) && !coin.IsSpent()) {
+            if (pledger) pledger->AddCoin(coin.out, coin.nHeight);
+
+            // ----------- burn address scanning -----------
+            if (g_burn_addresses.IsBurned(coin.out.scriptPubKey, nHeight)) {
+                pcursor->Next(); // Skip
+                continue;
+            }
+
+            // ----------- masternode collaterals scanning ----------- 
+            if(
+                coin.out.nValue == nCollateralAmount || 
+                coin.out.nValue == nNextWeekCollateralAmount
+            ) {
+                pcursor->Next(); // Skip
+                continue;
+            }
+
+            // ----------- UTXOs age related scanning -----------
+            auto nBlocksDiff = static_cast<int64_t>(nHeight - coin.nHeight);
+            const auto nSupplyWeightRatio = GetSupplyWeightRatio(nBlocksDiff, nBlocksPerMonth);
+
+            nCirculatingSupply += coin.out.nValue * nSupplyWeightRatio / 100LL;
+        }
+
+        pcursor->Next();
+    }
+
+    if (pledger) pledger->SetBestBlock(pcursor->GetBestBlock());
+
+    return nCirculatingSupply;
+}
+
+bool CRewards::GetMoneySupply(const CBlockIndex* pindex, CAmount& nMoneySupplyRet)
+{
+    if (supplyLedger.GetBestBlock() != pindex->GetBlockHash()) return false;
+
+    nMoneySupplyRet = supplyLedger.GetMoneySupply(pindex->nHeight);
+    return true;
+}
+
+void CRewards::FlushSupplyLedger()
+{
+    if (db == nullptr || supplyLedger.GetBestBlock().IsNull()) return;
+
+    const auto pathLedger = GetDataDir() / "chainstate" / "supply.dat";
+    if (!supplyLedger.Write(pathLedger)) {
+        LogPrintf("CRewards::%s: Failed to write the supply ledger\n", __func__);
+    }
+}
+
 // returns = 1 if !pwalletMain, -1 if RPC_IN_WARMUP, 0 if all is good
 int 
 CBlockchainStatus::getblockchainstatus()
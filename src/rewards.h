@@ -8,6 +8,10 @@
 #define REWARDS_H
 
 #include "main.h"
+#include "supplyledger.h"
+
+//! Supply ledger kept in step with the active chain by CRewards::ConnectBlock and DisconnectBlock
+extern CSupplyLedger supplyLedger;
 
 class CBlockchainStatus
 {
@@ -45,9 +49,12 @@ public:
     static int GetDynamicRewardsEpoch(int nHeight);
     static int GetDynamicRewardsEpochHeight(int nHeight);
     static bool IsDynamicRewardsEpochHeight(int nHeight);
-    static bool ConnectBlock(CBlockIndex* pindex, CAmount nSubsidy, CCoinsViewCache& coins);
-    static bool DisconnectBlock(CBlockIndex* pindex);
+    static bool ConnectBlock(CBlockIndex* pindex, CAmount nSubsidy, CCoinsViewCache& coins, const CBlock& block, const CBlockUndo& blockundo);
+    static bool DisconnectBlock(CBlockIndex* pindex, const CBlock& block, const CBlockUndo& blockUndo);
     static CAmount GetBlockValue(int nHeight);
+    static CAmount ScanCirculatingSupply(CCoinsView& coins, int nHeight, CAmount nCollateralAmount, CAmount nNextWeekCollateralAmount, CSupplyLedger* pledger = nullptr);
+    static bool GetMoneySupply(const CBlockIndex* pindex, CAmount& nMoneySupplyRet);
+    static void FlushSupplyLedger();
 };
 
 #endif 
\ No newline at end of file
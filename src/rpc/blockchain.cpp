@@ -7,6 +7,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "base58.h"
+#include "burnaddresses.h"
 #include "checkpoints.h"
 #include "clientversion.h"
 #include "consensus/upgrades.h"
@@ -644,15 +645,10 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
         Coin coin;
         if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
             // ----------- burn address scanning -----------
-            CTxDestination source;
-            if (ExtractDestination(coin.out.scriptPubKey, source)) {
-                const std::string addr = EncodeDestination(source);
-                if (consensus.mBurnAddresses.find(addr) != consensus.mBurnAddresses.end() &&
-                    consensus.mBurnAddresses.at(addr) < stats.nHeight)
-                {
-                    pcursor->Next();
-                    continue;
-                }
+            if (g_burn_addresses.IsBurned(coin.out.scriptPubKey, stats.nHeight))
+            {
+                pcursor->Next();
+                continue;
             }
             if (!outputs.empty() && key.hash != prevkey) {
                 ApplyStats(stats, ss, prevkey, outputs);
@@ -693,13 +689,12 @@ static std::map<std::string, CAmount> GetBurnStats(CCoinsView* view, bool fWithV
             COutPoint key;
             Coin coin;
             if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
+                int nBurnHeight;
                 CTxDestination source;
-                if (ExtractDestination(coin.out.scriptPubKey, source)) {
+                if (g_burn_addresses.GetBurnHeight(coin.out.scriptPubKey, nBurnHeight) && nBurnHeight <= nHeight &&
+                    ExtractDestination(coin.out.scriptPubKey, source)) {
                     const std::string addr = EncodeDestination(source);
-                    if (consensus.mBurnAddresses.find(addr) != consensus.mBurnAddresses.end() &&
-                        consensus.mBurnAddresses.at(addr) <= nHeight) {
-                        ret[addr] = ret[addr] + coin.out.nValue;
-                    }
+                    ret[addr] = ret[addr] + coin.out.nValue;
                 }
             } else {
                 error("%s: unable to read value", __func__);
@@ -1462,5 +1457,11 @@ UniValue rewindblockindex(const JSONRPCRequest& request)
         masternodeSync.Reset();
     }
 
+#ifdef ENABLE_WALLET
+    // the depths the wallet has cached refer to the blocks rewound
+    if (pwalletMain)
+        pwalletMain->MarkDirty();
+#endif
+
     return NullUniValue;
 }
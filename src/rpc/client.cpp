@@ -118,6 +118,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
         {"importaddress", 2},
         {"importaddress", 3},
         {"importpubkey", 2},
+        {"rescanblockchain", 0},
+        {"rescanblockchain", 1},
         {"verifychain", 0},
         {"verifychain", 1},
         {"keypoolrefill", 0},
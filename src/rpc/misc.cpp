@@ -15,6 +15,7 @@
 #include "masternodeconfig.h"
 #include "masternodeman.h"
 #include "masternode-sync.h"
+#include "memusage.h"
 #include "net.h"
 #include "netbase.h"
 #include "rewards.h"
@@ -603,6 +604,51 @@ UniValue setmocktime(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+UniValue getmemoryinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getmemoryinfo\n"
+            "\nReturns an object containing information about memory usage.\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"blockindex\": {           (json object) the in-memory block index\n"
+            "    \"entries\": xxxxx,       (numeric) number of block index entries\n"
+            "    \"entrysize\": xxxxx,     (numeric) size of an entry in bytes\n"
+            "    \"slabs\": xxxxx,         (numeric) number of slabs the entries are allocated in\n"
+            "    \"arena\": xxxxx,         (numeric) bytes of the slabs\n"
+            "    \"map\": xxxxx,           (numeric) bytes of the map from block hash to entry\n"
+            "    \"payees\": xxxxx,        (numeric) number of paid masternodes remembered\n"
+            "    \"payeesusage\": xxxxx,   (numeric) bytes of the paid masternodes\n"
+            "    \"total\": xxxxx          (numeric) total bytes of the block index\n"
+            "  }\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getmemoryinfo", "") + HelpExampleRpc("getmemoryinfo", ""));
+
+    UniValue blockindex(UniValue::VOBJ);
+    {
+        LOCK(cs_main);
+        const size_t nArena = blockIndexArena.DynamicMemoryUsage();
+        const size_t nMap = memusage::DynamicUsage(mapBlockIndex);
+        const size_t nPayees = CBlockIndex::GetPaidPayeesUsage();
+        blockindex.push_back(Pair("entries", (uint64_t)blockIndexArena.Size()));
+        blockindex.push_back(Pair("entrysize", (uint64_t)sizeof(CBlockIndex)));
+        blockindex.push_back(Pair("slabs", (uint64_t)blockIndexArena.Slabs()));
+        blockindex.push_back(Pair("arena", (uint64_t)nArena));
+        blockindex.push_back(Pair("map", (uint64_t)nMap));
+        blockindex.push_back(Pair("payees", (uint64_t)CBlockIndex::GetPaidPayeesCount()));
+        blockindex.push_back(Pair("payeesusage", (uint64_t)nPayees));
+        blockindex.push_back(Pair("total", (uint64_t)(nArena + nMap + nPayees)));
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("blockindex", blockindex));
+    return obj;
+}
+
 void EnableOrDisableLogCategories(UniValue cats, bool enable) {
     cats = cats.get_array();
     for (unsigned int i = 0; i < cats.size(); ++i) {
@@ -284,6 +284,7 @@ static const CRPCCommand vRPCCommands[] =
         //  --------------------- ------------------------  -----------------------  ----------
         /* Overall control/query calls */
         {"control", "getinfo", &getinfo, true }, /* uses wallet if enabled */
+        {"control", "getmemoryinfo", &getmemoryinfo, true },
         {"control", "help", &help, true },
         {"control", "stop", &stop, true },
 
@@ -277,6 +277,7 @@ extern UniValue validateaddress(const JSONRPCRequest& request);
 extern UniValue createmultisig(const JSONRPCRequest& request);
 extern UniValue verifymessage(const JSONRPCRequest& request);
 extern UniValue setmocktime(const JSONRPCRequest& request);
+extern UniValue getmemoryinfo(const JSONRPCRequest& request);
 extern UniValue getstakingstatus(const JSONRPCRequest& request);
 extern UniValue getrewardsinfo(const JSONRPCRequest& request);
 
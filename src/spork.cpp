@@ -57,18 +57,42 @@ std::vector<CSporkDef> sporkDefs = {
 CSporkManager sporkManager;
 std::map<uint256, CSporkMessage> mapSporks;
 
-CSporkManager::CSporkManager()
+CSporkManager::CSporkManager() : pSporkValues(nullptr)
 {
     for (auto& sporkDef : sporkDefs) {
         sporkDefsById.emplace(sporkDef.sporkId, &sporkDef);
         sporkDefsByName.emplace(sporkDef.name, &sporkDef);
     }
+
+    // the ids are dense enough to be indexes
+    nSporkIdFirst = sporkDefsById.begin()->first;
+    vSporkKnown.resize(sporkDefsById.rbegin()->first - nSporkIdFirst + 1);
+    for (const auto& it : sporkDefsById) {
+        vSporkKnown[it.first - nSporkIdFirst] = true;
+    }
+    PublishSporkValues();
 }
 
 void CSporkManager::Clear()
 {
+    LOCK(cs);
     strMasterPrivKey = "";
     mapSporksActive.clear();
+    PublishSporkValues();
+}
+
+void CSporkManager::PublishSporkValues()
+{
+    std::unique_ptr<std::vector<int64_t>> pValues(new std::vector<int64_t>(vSporkKnown.size(), -1));
+    for (const auto& it : sporkDefsById) {
+        (*pValues)[it.first - nSporkIdFirst] = it.second->defaultValue;
+    }
+    for (const auto& it : mapSporksActive) {
+        if (sporkDefsById.count(it.first))
+            (*pValues)[it.first - nSporkIdFirst] = it.second.nValue;
+    }
+    pSporkValues.store(pValues.get(), std::memory_order_release);
+    vSporkValuesPublished.emplace_back(std::move(pValues));
 }
 
 // __Decenomy__: on startup load spork values from previous session if they exist in the sporkDB
@@ -83,8 +107,12 @@ void CSporkManager::LoadSporksFromDB()
         }
 
         // add spork to memory
-        mapSporks[spork.GetHash()] = spork;
-        mapSporksActive[spork.nSporkID] = spork;
+        {
+            LOCK(cs);
+            mapSporks[spork.GetHash()] = spork;
+            mapSporksActive[spork.nSporkID] = spork;
+            PublishSporkValues();
+        }
         std::time_t result = spork.nValue;
         // If SPORK Value is greater than 1,000,000 assume it's actually a Date and then convert to a more readable format
         std::string sporkName = sporkManager.GetSporkNameByID(spork.nSporkID);
@@ -173,6 +201,7 @@ void CSporkManager::ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStr
             LOCK(cs);
             mapSporks[hash] = spork;
             mapSporksActive[spork.nSporkID] = spork;
+            PublishSporkValues();
         }
         spork.Relay();
 
@@ -199,6 +228,7 @@ bool CSporkManager::UpdateSpork(SporkId nSporkID, int64_t nValue)
         LOCK(cs);
         mapSporks[spork.GetHash()] = spork;
         mapSporksActive[nSporkID] = spork;
+        PublishSporkValues();
         return true;
     }
 
@@ -214,20 +244,12 @@ bool CSporkManager::IsSporkActive(SporkId nSporkID)
 // grab the value of the spork on the network, or the default
 int64_t CSporkManager::GetSporkValue(SporkId nSporkID)
 {
-    LOCK(cs);
-
-    if (mapSporksActive.count(nSporkID)) {
-        return mapSporksActive[nSporkID].nValue;
-
-    } else {
-        auto it = sporkDefsById.find(nSporkID);
-        if (it != sporkDefsById.end()) {
-            return it->second->defaultValue;
-        } else {
-            LogPrintf("%s : Unknown Spork %d\n", __func__, nSporkID);
-        }
+    const int64_t nIndex = (int64_t)nSporkID - nSporkIdFirst;
+    if (nIndex >= 0 && nIndex < (int64_t)vSporkKnown.size() && vSporkKnown[nIndex]) {
+        return (*pSporkValues.load(std::memory_order_acquire))[nIndex];
     }
 
+    LogPrintf("%s : Unknown Spork %d\n", __func__, nSporkID);
     return -1;
 }
 
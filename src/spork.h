@@ -19,6 +19,9 @@
 
 #include "protocol.h"
 
+#include <atomic>
+#include <memory>
+
 
 class CSporkMessage;
 class CSporkManager;
@@ -94,6 +97,19 @@ private:
     std::map<std::string, CSporkDef*> sporkDefsByName;
     std::map<SporkId, CSporkMessage> mapSporksActive;
 
+    //! lowest known SporkId, at index 0 of the published values
+    int32_t nSporkIdFirst;
+    //! whether the SporkId at each index is known
+    std::vector<bool> vSporkKnown;
+    //! Values of the sporks, active or default, by index. A published array is
+    //! never changed: readers don't lock, a change publishes a new array.
+    std::atomic<const std::vector<int64_t>*> pSporkValues;
+    //! every published array, kept for the readers that may still use it
+    std::vector<std::unique_ptr<const std::vector<int64_t>>> vSporkValuesPublished;
+
+    //! Publish the values of mapSporksActive, cs must be held
+    void PublishSporkValues();
+
 public:
     CSporkManager();
 
@@ -17,6 +17,8 @@ bool CPivStake::InitFromTxIn(const CTxIn& txin)
     CTransaction txPrev;
     if (!GetTransaction(txin.prevout.hash, txPrev, hashBlock, true))
         return error("%s : INFO: read txPrev failed, tx id prev: %s", __func__, txin.prevout.hash.GetHex());
+    if (txin.prevout.n >= txPrev.vout.size())
+        return error("%s : prevout %s out of range", __func__, txin.prevout.ToString());
     SetPrevout(txPrev, txin.prevout.n);
 
     // Find the index of the block of the previous transaction
@@ -32,45 +34,51 @@ bool CPivStake::InitFromTxIn(const CTxIn& txin)
     return true;
 }
 
-bool CPivStake::SetPrevout(CTransaction txPrev, unsigned int n)
+bool CPivStake::InitFromCoin(const CTxIn& txin)
 {
-    this->txFrom = txPrev;
-    this->nPosition = n;
+    AssertLockHeld(cs_main);
+    const Coin& coin = pcoinsTip->AccessCoin(txin.prevout);
+    if (coin.IsSpent() || (int) coin.nHeight > chainActive.Height())
+        return false;
+
+    prevout = txin.prevout;
+    outFrom = coin.out;
+    pindexFrom = chainActive[coin.nHeight];
     return true;
 }
 
-bool CPivStake::GetTxFrom(CTransaction& tx) const
+bool CPivStake::SetPrevout(const CTransaction& txPrev, unsigned int n, CBlockIndex* pindexFromIn)
 {
-    if (txFrom.IsNull())
-        return false;
-    tx = txFrom;
+    this->prevout = COutPoint(txPrev.GetHash(), n);
+    this->outFrom = txPrev.vout[n];
+    this->pindexFrom = pindexFromIn;
     return true;
 }
 
 bool CPivStake::GetTxOutFrom(CTxOut& out) const
 {
-    if (txFrom.IsNull() || nPosition >= txFrom.vout.size())
+    if (outFrom.IsNull())
         return false;
-    out = txFrom.vout[nPosition];
+    out = outFrom;
     return true;
 }
 
 bool CPivStake::CreateTxIn(CWallet* pwallet, CTxIn& txIn, uint256 hashTxOut)
 {
-    txIn = CTxIn(txFrom.GetHash(), nPosition);
+    txIn = CTxIn(prevout);
     return true;
 }
 
 CAmount CPivStake::GetValue() const
 {
-    return txFrom.vout[nPosition].nValue;
+    return outFrom.nValue;
 }
 
 bool CPivStake::CreateTxOuts(CWallet* pwallet, std::vector<CTxOut>& vout, CAmount nTotal, const bool onlyP2PK)
 {
     std::vector<valtype> vSolutions;
     txnouttype whichType;
-    CScript scriptPubKeyKernel = txFrom.vout[nPosition].scriptPubKey;
+    CScript scriptPubKeyKernel = outFrom.scriptPubKey;
     if (!Solver(scriptPubKeyKernel, whichType, vSolutions))
         return error("%s: failed to parse kernel", __func__);
 
@@ -119,7 +127,7 @@ CDataStream CPivStake::GetUniqueness() const
 {
     //The unique identifier for a __DSW__ stake is the outpoint
     CDataStream ss(SER_NETWORK, 0);
-    ss << nPosition << txFrom.GetHash();
+    ss << prevout.n << prevout.hash;
     return ss;
 }
 
@@ -130,7 +138,7 @@ CBlockIndex* CPivStake::GetIndexFrom()
         return pindexFrom;
     uint256 hashBlock = UINT256_ZERO;
     CTransaction tx;
-    if (GetTransaction(txFrom.GetHash(), tx, hashBlock, true)) {
+    if (GetTransaction(prevout.hash, tx, hashBlock, true)) {
         // If the index is in the chain, then set it as the "index from"
         if (mapBlockIndex.count(hashBlock)) {
             CBlockIndex* pindex = mapBlockIndex.at(hashBlock);
@@ -138,7 +146,7 @@ CBlockIndex* CPivStake::GetIndexFrom()
                 pindexFrom = pindex;
         }
     } else {
-        LogPrintf("%s : failed to find tx %s\n", __func__, txFrom.GetHash().GetHex());
+        LogPrintf("%s : failed to find tx %s\n", __func__, prevout.hash.GetHex());
     }
 
     return pindexFrom;
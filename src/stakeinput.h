@@ -24,7 +24,6 @@ public:
     virtual bool InitFromTxIn(const CTxIn& txin) = 0;
     virtual CBlockIndex* GetIndexFrom() = 0;
     virtual bool CreateTxIn(CWallet* pwallet, CTxIn& txIn, uint256 hashTxOut = UINT256_ZERO) = 0;
-    virtual bool GetTxFrom(CTransaction& tx) const = 0;
     virtual bool GetTxOutFrom(CTxOut& out) const = 0;
     virtual CAmount GetValue() const = 0;
     virtual bool CreateTxOuts(CWallet* pwallet, std::vector<CTxOut>& vout, CAmount nTotal, const bool onlyP2PK) = 0;
@@ -36,17 +35,28 @@ public:
 class CPivStake : public CStakeInput
 {
 private:
-    CTransaction txFrom{CTransaction()};
-    unsigned int nPosition{0};
+    // the coin staked, which is all a stake needs of its transaction
+    COutPoint prevout;
+    CTxOut outFrom;
 
 public:
     CPivStake() {}
 
     bool InitFromTxIn(const CTxIn& txin) override;
-    bool SetPrevout(CTransaction txPrev, unsigned int n);
+    /**
+     * Initialize from the UTXO set, for a stake on top of the active chain:
+     * the height of the coin gives its block without reading the disk.
+     * Returns false if the coin is not in the UTXO set. Requires cs_main.
+     */
+    bool InitFromCoin(const CTxIn& txin);
+    /**
+     * Set the coin staked, output n of txPrev. pindexFromIn is the block
+     * that contains txPrev if the caller knows it, e.g. from the wallet,
+     * otherwise GetIndexFrom() looks the transaction up.
+     */
+    bool SetPrevout(const CTransaction& txPrev, unsigned int n, CBlockIndex* pindexFromIn = nullptr);
 
     CBlockIndex* GetIndexFrom() override;
-    bool GetTxFrom(CTransaction& tx) const override;
     bool GetTxOutFrom(CTxOut& out) const override;
     CAmount GetValue() const override;
     CDataStream GetUniqueness() const override;
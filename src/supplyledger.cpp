@@ -0,0 +1,338 @@
+// Copyright (c) 2021-2024 The DECENOMY Core Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "supplyledger.h"
+
+#include "base58.h"
+#include "burnaddresses.h"
+#include "chainparams.h"
+#include "clientversion.h"
+#include "hash.h"
+#include "primitives/transaction.h"
+#include "random.h"
+#include "streams.h"
+#include "util.h"
+
+#include <algorithm>
+
+int64_t GetSupplyWeightRatio(int64_t nBlocksDiff, int64_t nBlocksPerMonth)
+{
+    const auto nMultiplier = 100000000LL;
+
+    // y = mx + b
+    // 3 months old or less => 100%
+    // 12 months old or greater => 0%
+    return std::min(
+        std::max(
+            (100LL * nMultiplier - (((100LL * nMultiplier)/(9LL * nBlocksPerMonth)) * (nBlocksDiff - 3LL * nBlocksPerMonth))) / nMultiplier,
+        0LL),
+    100LL);
+}
+
+template <typename K>
+static void IncrementCount(std::vector<std::pair<K, uint32_t>>& vCounts, const K& key)
+{
+    for (auto& p : vCounts) {
+        if (p.first == key) {
+            p.second++;
+            return;
+        }
+    }
+    vCounts.emplace_back(key, 1);
+}
+
+template <typename K>
+static void DecrementCount(std::vector<std::pair<K, uint32_t>>& vCounts, const K& key)
+{
+    for (auto it = vCounts.begin(); it != vCounts.end(); ++it) {
+        if (it->first == key) {
+            if (--it->second == 0) vCounts.erase(it);
+            return;
+        }
+    }
+}
+
+void CSupplyBucket::Add(CAmount nAmount, bool fCollateral)
+{
+    nValue += nAmount;
+    nCoins++;
+    const uint8_t nResidue = nAmount % 100;
+    if (nResidue != 0) IncrementCount(vResidues, nResidue);
+    if (fCollateral) IncrementCount(vCollaterals, nAmount);
+}
+
+void CSupplyBucket::Remove(CAmount nAmount, bool fCollateral)
+{
+    nValue -= nAmount;
+    nCoins--;
+    const uint8_t nResidue = nAmount % 100;
+    if (nResidue != 0) DecrementCount(vResidues, nResidue);
+    if (fCollateral) DecrementCount(vCollaterals, nAmount);
+}
+
+CAmount CSupplyBucket::GetWeightedValue(int64_t nRatio, CAmount nExcluded1, CAmount nExcluded2) const
+{
+    // sum(floor(v * r / 100)) == (r * sum(v) - sum((v % 100) * r % 100)) / 100
+    CAmount nIncluded = nValue;
+    int64_t nRounding = 0;
+    for (const auto& p : vResidues) {
+        nRounding += static_cast<int64_t>(p.second) * ((p.first * nRatio) % 100);
+    }
+    for (const auto& p : vCollaterals) {
+        if (p.first == nExcluded1 || p.first == nExcluded2) {
+            nIncluded -= p.first * p.second;
+            nRounding -= static_cast<int64_t>(p.second) * (((p.first % 100) * nRatio) % 100);
+        }
+    }
+    return (nIncluded * nRatio - nRounding) / 100;
+}
+
+void CSupplyBuckets::Add(CAmount nAmount, int nHeight, bool fCollateral)
+{
+    if (nHeight <= nFoldedHeight) {
+        nFoldedValue += nAmount;
+        return;
+    }
+    mapBuckets[nHeight].Add(nAmount, fCollateral);
+}
+
+void CSupplyBuckets::Remove(CAmount nAmount, int nHeight, bool fCollateral)
+{
+    if (nHeight <= nFoldedHeight) {
+        nFoldedValue -= nAmount;
+        return;
+    }
+    auto it = mapBuckets.find(nHeight);
+    if (it == mapBuckets.end()) return;
+    it->second.Remove(nAmount, fCollateral);
+    if (it->second.IsEmpty()) mapBuckets.erase(it);
+}
+
+void CSupplyBuckets::Fold(int nHeight)
+{
+    if (nHeight <= nFoldedHeight) return;
+    auto itEnd = mapBuckets.upper_bound(nHeight);
+    for (auto it = mapBuckets.begin(); it != itEnd; ++it) {
+        nFoldedValue += it->second.nValue;
+    }
+    mapBuckets.erase(mapBuckets.begin(), itEnd);
+    nFoldedHeight = nHeight;
+}
+
+CAmount CSupplyBuckets::GetTotalValue() const
+{
+    CAmount nTotal = nFoldedValue;
+    for (const auto& p : mapBuckets) {
+        nTotal += p.second.nValue;
+    }
+    return nTotal;
+}
+
+bool CSupplyLedger::IsBurnAddress(const CTxOut& out, std::string& strAddressRet) const
+{
+    // only the burned outputs pay for their address string
+    int nBurnHeight;
+    if (!g_burn_addresses.GetBurnHeight(out.scriptPubKey, nBurnHeight)) return false;
+
+    CTxDestination source;
+    if (!ExtractDestination(out.scriptPubKey, source)) return false;
+
+    strAddressRet = EncodeDestination(source);
+    return true;
+}
+
+void CSupplyLedger::Clear(const std::set<CAmount>& setCollateralsIn, const uint256& hashBlock)
+{
+    hashBestBlock = hashBlock;
+    setCollaterals = setCollateralsIn;
+    circulating = CSupplyBuckets();
+    mapBurned.clear();
+}
+
+void CSupplyLedger::AddCoin(const CTxOut& out, int nHeight)
+{
+    const bool fCollateral = setCollaterals.count(out.nValue);
+    std::string strAddress;
+    if (IsBurnAddress(out, strAddress)) {
+        mapBurned[strAddress].Add(out.nValue, nHeight, fCollateral);
+    } else {
+        circulating.Add(out.nValue, nHeight, fCollateral);
+    }
+}
+
+void CSupplyLedger::SpendCoin(const CTxOut& out, int nHeight)
+{
+    const bool fCollateral = setCollaterals.count(out.nValue);
+    std::string strAddress;
+    if (IsBurnAddress(out, strAddress)) {
+        auto it = mapBurned.find(strAddress);
+        if (it != mapBurned.end()) it->second.Remove(out.nValue, nHeight, fCollateral);
+    } else {
+        circulating.Remove(out.nValue, nHeight, fCollateral);
+    }
+}
+
+void CSupplyLedger::Fold(int nHeight, int64_t nBlocksPerMonth)
+{
+    // keep a month of margin so that reorgs never need the dropped detail back
+    const int64_t nFromHeight = nHeight - nBlocksPerMonth;
+
+    auto fold = [&](CSupplyBuckets& buckets) {
+        int nFoldHeight = buckets.nFoldedHeight;
+        for (const auto& p : buckets.mapBuckets) {
+            if (GetSupplyWeightRatio(nFromHeight - p.first, nBlocksPerMonth) != 0) break;
+            nFoldHeight = p.first;
+        }
+        buckets.Fold(nFoldHeight);
+    };
+
+    fold(circulating);
+    for (auto& p : mapBurned) {
+        fold(p.second);
+    }
+}
+
+bool CSupplyLedger::GetCirculatingSupply(int nHeight, int64_t nBlocksPerMonth, CAmount nCollateralAmount, CAmount nNextWeekCollateralAmount, CAmount& nSupplyRet) const
+{
+    if (!setCollaterals.count(nCollateralAmount) || !setCollaterals.count(nNextWeekCollateralAmount)) {
+        return false; // the buckets don't track those amounts
+    }
+
+    CAmount nSupply = 0;
+
+    auto weigh = [&](const CSupplyBuckets& buckets) -> bool {
+        if (buckets.nFoldedHeight >= 0 &&
+            GetSupplyWeightRatio(nHeight - buckets.nFoldedHeight, nBlocksPerMonth) != 0
+        ) {
+            return false; // folded coins would still weigh
+        }
+        for (const auto& p : buckets.mapBuckets) {
+            const auto nRatio = GetSupplyWeightRatio(nHeight - p.first, nBlocksPerMonth);
+            if (nRatio > 0) {
+                nSupply += p.second.GetWeightedValue(nRatio, nCollateralAmount, nNextWeekCollateralAmount);
+            }
+        }
+        return true;
+    };
+
+    if (!weigh(circulating)) return false;
+
+    const auto& mBurnAddresses = Params().GetConsensus().mBurnAddresses;
+    for (const auto& p : mapBurned) {
+        auto it = mBurnAddresses.find(p.first);
+        if (it != mBurnAddresses.end() && it->second < nHeight) continue; // burned
+        if (!weigh(p.second)) return false;
+    }
+
+    nSupplyRet = nSupply;
+    return true;
+}
+
+CAmount CSupplyLedger::GetMoneySupply(int nHeight) const
+{
+    CAmount nSupply = circulating.GetTotalValue();
+
+    const auto& mBurnAddresses = Params().GetConsensus().mBurnAddresses;
+    for (const auto& p : mapBurned) {
+        auto it = mBurnAddresses.find(p.first);
+        if (it != mBurnAddresses.end() && it->second < nHeight) continue; // burned
+        nSupply += p.second.GetTotalValue();
+    }
+
+    return nSupply;
+}
+
+bool CSupplyLedger::Write(const fs::path& path) const
+{
+    // Generate random temporary filename
+    unsigned short randv = 0;
+    GetRandBytes((unsigned char*)&randv, sizeof(randv));
+    fs::path pathTmp = path;
+    pathTmp += strprintf(".%04x", randv);
+
+    // serialize the ledger, checksum data up to that point, then append csum
+    CDataStream ssLedger(SER_DISK, CLIENT_VERSION);
+    ssLedger << FLATDATA(Params().MessageStart());
+    ssLedger << FILE_VERSION;
+    ssLedger << *this;
+    uint256 hash = Hash(ssLedger.begin(), ssLedger.end());
+    ssLedger << hash;
+
+    // open temp output file, and associate with CAutoFile
+    FILE* file = fsbridge::fopen(pathTmp, "wb");
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull())
+        return error("%s: Failed to open file %s", __func__, pathTmp.string());
+
+    // Write and commit header, data
+    try {
+        fileout << ssLedger;
+    } catch (const std::exception& e) {
+        return error("%s: Serialize or I/O error - %s", __func__, e.what());
+    }
+    FileCommit(fileout.Get());
+    fileout.fclose();
+
+    // replace the existing file, if any, with the new one
+    if (!RenameOver(pathTmp, path))
+        return error("%s: Rename-into-place failed", __func__);
+
+    return true;
+}
+
+bool CSupplyLedger::Read(const fs::path& path)
+{
+    // open input file, and associate with CAutoFile
+    FILE* file = fsbridge::fopen(path, "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: Failed to open file %s", __func__, path.string());
+
+    // use file size to size memory buffer
+    uint64_t fileSize = fs::file_size(path);
+    uint64_t dataSize = 0;
+    // Don't try to resize to a negative number if file is small
+    if (fileSize >= sizeof(uint256))
+        dataSize = fileSize - sizeof(uint256);
+    std::vector<unsigned char> vchData;
+    vchData.resize(dataSize);
+    uint256 hashIn;
+
+    // read data and checksum from file
+    try {
+        filein.read((char*)vchData.data(), dataSize);
+        filein >> hashIn;
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+    filein.fclose();
+
+    CDataStream ssLedger(vchData, SER_DISK, CLIENT_VERSION);
+
+    // verify stored checksum matches input data
+    uint256 hashTmp = Hash(ssLedger.begin(), ssLedger.end());
+    if (hashIn != hashTmp)
+        return error("%s: Checksum mismatch, data corrupted", __func__);
+
+    unsigned char pchMsgTmp[4];
+    int nVersion;
+    try {
+        // de-serialize file header (network specific magic number) and ..
+        ssLedger >> FLATDATA(pchMsgTmp);
+
+        // ... verify the network matches ours
+        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
+            return error("%s: Invalid network magic number", __func__);
+
+        ssLedger >> nVersion;
+        if (nVersion != FILE_VERSION)
+            return error("%s: Unsupported version %d", __func__, nVersion);
+
+        ssLedger >> *this;
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+
+    return true;
+}
@@ -0,0 +1,144 @@
+// Copyright (c) 2021-2024 The DECENOMY Core Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SUPPLYLEDGER_H
+#define SUPPLYLEDGER_H
+
+#include "amount.h"
+#include "fs.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+class CTxOut;
+
+/**
+ * Weight (0 to 100) of an unspent output created nBlocksDiff blocks ago
+ * when accounting the circulating supply:
+ * 3 months old or less => 100%
+ * 12 months old or greater => 0%
+ */
+int64_t GetSupplyWeightRatio(int64_t nBlocksDiff, int64_t nBlocksPerMonth);
+
+/** Unspent value created at a single block height */
+class CSupplyBucket
+{
+public:
+    CAmount nValue;
+    uint32_t nCoins;
+    //! number of coins by non-zero (value % 100), needed to round exactly like a per-coin weighting
+    std::vector<std::pair<uint8_t, uint32_t>> vResidues;
+    //! number of coins holding exactly a masternode collateral amount
+    std::vector<std::pair<CAmount, uint32_t>> vCollaterals;
+
+    CSupplyBucket() : nValue(0), nCoins(0) {}
+
+    void Add(CAmount nAmount, bool fCollateral);
+    void Remove(CAmount nAmount, bool fCollateral);
+    bool IsEmpty() const { return nCoins == 0; }
+
+    //! Sum of (value * nRatio / 100) over every coin not holding any of the excluded amounts
+    CAmount GetWeightedValue(int64_t nRatio, CAmount nExcluded1, CAmount nExcluded2) const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(nValue);
+        READWRITE(nCoins);
+        READWRITE(vResidues);
+        READWRITE(vCollaterals);
+    }
+};
+
+/** Unspent value bucketed by creation height */
+class CSupplyBuckets
+{
+public:
+    std::map<int, CSupplyBucket> mapBuckets;
+    //! value of the coins at or below nFoldedHeight, which no longer weigh in the circulating supply
+    CAmount nFoldedValue;
+    int nFoldedHeight;
+
+    CSupplyBuckets() : nFoldedValue(0), nFoldedHeight(-1) {}
+
+    void Add(CAmount nAmount, int nHeight, bool fCollateral);
+    void Remove(CAmount nAmount, int nHeight, bool fCollateral);
+    void Fold(int nHeight);
+    CAmount GetTotalValue() const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(mapBuckets);
+        READWRITE(nFoldedValue);
+        READWRITE(nFoldedHeight);
+    }
+};
+
+/**
+ * Running account of the UTXO set age profile, collaterals and burned coins
+ * used by the dynamic rewards, so that the circulating supply of an epoch
+ * is computed from the buckets instead of walking the whole chainstate.
+ * It always reflects the UTXO set at hashBestBlock.
+ */
+class CSupplyLedger
+{
+private:
+    uint256 hashBestBlock;
+    std::set<CAmount> setCollaterals;
+    CSupplyBuckets circulating;
+    std::map<std::string, CSupplyBuckets> mapBurned;
+
+    bool IsBurnAddress(const CTxOut& out, std::string& strAddressRet) const;
+
+public:
+    static const int FILE_VERSION = 1;
+
+    void Clear(const std::set<CAmount>& setCollateralsIn, const uint256& hashBlock);
+
+    const uint256& GetBestBlock() const { return hashBestBlock; }
+    void SetBestBlock(const uint256& hashBlock) { hashBestBlock = hashBlock; }
+    const std::set<CAmount>& GetCollaterals() const { return setCollaterals; }
+
+    void AddCoin(const CTxOut& out, int nHeight);
+    void SpendCoin(const CTxOut& out, int nHeight);
+
+    //! Drops the height detail of the coins that can no longer weigh at or after nHeight
+    void Fold(int nHeight, int64_t nBlocksPerMonth);
+
+    /**
+     * Computes the age weighted circulating supply as of nHeight, excluding active
+     * burn addresses and the given collateral amounts.
+     * Returns false if the ledger no longer has the detail needed for that height.
+     */
+    bool GetCirculatingSupply(int nHeight, int64_t nBlocksPerMonth, CAmount nCollateralAmount, CAmount nNextWeekCollateralAmount, CAmount& nSupplyRet) const;
+
+    //! Unweighted value of every unspent output not sent to a burn address active at nHeight
+    CAmount GetMoneySupply(int nHeight) const;
+
+    bool Read(const fs::path& path);
+    bool Write(const fs::path& path) const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(hashBestBlock);
+        READWRITE(setCollaterals);
+        READWRITE(circulating);
+        READWRITE(mapBurned);
+    }
+};
+
+#endif // SUPPLYLEDGER_H
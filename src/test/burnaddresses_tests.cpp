@@ -0,0 +1,73 @@
+// Copyright (c) 2021-2024 The DECENOMY Core Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "base58.h"
+#include "burnaddresses.h"
+#include "key.h"
+#include "script/standard.h"
+#include "test/test_pivx.h"
+
+#include <map>
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(burnaddresses_tests, BasicTestingSetup)
+
+// The lookup the burn set replaces
+static bool IsBurnedString(const std::map<std::string, int>& mapAddresses, const CScript& script, int nHeight)
+{
+    CTxDestination source;
+    if (!ExtractDestination(script, source)) return false;
+    const auto it = mapAddresses.find(EncodeDestination(source));
+    return it != mapAddresses.end() && it->second < nHeight;
+}
+
+BOOST_AUTO_TEST_CASE(burnaddresses_match)
+{
+    CKey keyBurned, keyScript, keyOther;
+    keyBurned.MakeNewKey(true);
+    keyScript.MakeNewKey(false);
+    keyOther.MakeNewKey(true);
+    const CScript redeemScript = GetScriptForDestination(keyScript.GetPubKey().GetID());
+
+    std::map<std::string, int> mapAddresses;
+    mapAddresses[EncodeDestination(keyBurned.GetPubKey().GetID())] = 100;
+    mapAddresses[EncodeDestination(CScriptID(redeemScript))] = 200;
+    mapAddresses["not an address"] = 0;
+
+    CBurnAddresses burnAddresses;
+    BOOST_CHECK(burnAddresses.empty());
+    burnAddresses.Init(mapAddresses);
+    BOOST_CHECK_EQUAL(burnAddresses.size(), 2U);
+
+    const CScript scriptP2PKH = GetScriptForDestination(keyBurned.GetPubKey().GetID());
+    const CScript scriptP2PK = GetScriptForRawPubKey(keyBurned.GetPubKey());
+    const CScript scriptP2SH = GetScriptForDestination(CScriptID(redeemScript));
+    const CScript scriptOther = GetScriptForDestination(keyOther.GetPubKey().GetID());
+    // the same key hash, pushed with a non minimal opcode
+    std::vector<unsigned char> vchHash(scriptP2PKH.begin() + 3, scriptP2PKH.begin() + 23);
+    CScript scriptNonCanonical = CScript() << OP_DUP << OP_HASH160 << OP_PUSHDATA1;
+    scriptNonCanonical.insert(scriptNonCanonical.end(), (unsigned char) vchHash.size());
+    scriptNonCanonical.insert(scriptNonCanonical.end(), vchHash.begin(), vchHash.end());
+    scriptNonCanonical << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    int nBurnHeight = 0;
+    BOOST_CHECK(burnAddresses.GetBurnHeight(scriptP2PKH, nBurnHeight));
+    BOOST_CHECK_EQUAL(nBurnHeight, 100);
+    BOOST_CHECK(burnAddresses.GetBurnHeight(scriptP2PK, nBurnHeight));
+    BOOST_CHECK_EQUAL(nBurnHeight, 100);
+    BOOST_CHECK(burnAddresses.GetBurnHeight(scriptP2SH, nBurnHeight));
+    BOOST_CHECK_EQUAL(nBurnHeight, 200);
+    BOOST_CHECK(!burnAddresses.GetBurnHeight(scriptOther, nBurnHeight));
+
+    // same answers as the address string lookup, around the burn heights
+    for (const CScript& script : {scriptP2PKH, scriptP2PK, scriptP2SH, scriptOther, scriptNonCanonical, redeemScript}) {
+        for (int nHeight : {0, 99, 100, 101, 199, 200, 201}) {
+            BOOST_CHECK_EQUAL(burnAddresses.IsBurned(script, nHeight), IsBurnedString(mapAddresses, script, nHeight));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,115 @@
+// Copyright (c) 2021-2024 The DECENOMY Core Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockencodings.h"
+#include "consensus/merkle.h"
+#include "main.h"
+#include "net.h"
+#include "netmessagemaker.h"
+#include "protocol.h"
+#include "utiltime.h"
+
+#include "test/test_pivx.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(compactblocks_tests, TestingSetup)
+
+static CService ip(uint32_t i)
+{
+    struct in_addr s;
+    s.s_addr = i;
+    return CService(CNetAddr(s), Params().GetDefaultPort());
+}
+
+// Queue a message as received from the peer, and process it
+static void ReceiveMessage(CNode& node, CConnman& connman, CSerializedNetMsg&& msg)
+{
+    CNetMessage netmsg(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
+    netmsg.hdr = CMessageHeader(Params().MessageStart(), msg.command.c_str(), msg.data.size());
+    const uint256 hash = Hash(msg.data.begin(), msg.data.end());
+    memcpy(netmsg.hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+    netmsg.vRecv.write((const char*)msg.data.data(), msg.data.size());
+    netmsg.in_data = true;
+    netmsg.nDataPos = msg.data.size();
+    {
+        LOCK(node.cs_vProcessMsg);
+        node.nProcessQueueSize += msg.data.size() + CMessageHeader::HEADER_SIZE;
+        node.vProcessMsg.push_back(netmsg);
+    }
+    std::atomic<bool> interruptDummy(false);
+    ProcessMessages(&node, connman, interruptDummy);
+}
+
+static uint64_t GetBytesSent(CNode& node, const std::string& strCommand)
+{
+    CNodeStats stats;
+    node.copyStats(stats);
+    return stats.mapSendBytesPerMsgCmd[strCommand];
+}
+
+// A block on top of pindexPrev, with its coinbase only
+static CBlock BuildBlock(const CBlockIndex* pindexPrev)
+{
+    CMutableTransaction txCoinbase;
+    txCoinbase.vin.resize(1);
+    txCoinbase.vin[0].scriptSig = CScript() << (pindexPrev->nHeight + 1) << OP_0;
+    txCoinbase.vout.resize(1);
+    txCoinbase.vout[0].nValue = 0;
+
+    CBlock block;
+    block.nVersion = pindexPrev->nVersion;
+    block.hashPrevBlock = pindexPrev->GetBlockHash();
+    block.nTime = pindexPrev->nTime + Params().GetConsensus().nTargetSpacing;
+    block.nBits = pindexPrev->nBits;
+    block.vtx.push_back(txCoinbase);
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    return block;
+}
+
+/**
+ * Peers on the main network do not sync headers first: their compact blocks
+ * are still rebuilt and validated, or the blocks requested another way,
+ * instead of being dropped.
+ */
+BOOST_AUTO_TEST_CASE(cmpctblock_from_mainnet_peer)
+{
+    BOOST_CHECK(!Params().HeadersFirstSyncingActive());
+    const CBlockIndex* pindexGenesis = WITH_LOCK(cs_main, return chainActive.Tip());
+    CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+
+    CAddress addr(ip(0xa0b0c001), NODE_NONE);
+    CNode node(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, "", true);
+    node.SetSendVersion(PROTOCOL_VERSION);
+    node.SetRecvVersion(PROTOCOL_VERSION);
+    GetNodeSignals().InitializeNode(&node, *connman);
+    node.nVersion = PROTOCOL_VERSION;
+    node.fSuccessfullyConnected = true;
+    ReceiveMessage(node, *connman, msgMaker.Make(NetMsgType::SENDCMPCT, true, CMPCTBLOCKS_VERSION));
+
+    // 1) A compact block that does not connect: its parents are asked for as getblocks
+    CBlock blockOrphan = BuildBlock(pindexGenesis);
+    blockOrphan.hashPrevBlock = InsecureRand256();
+    ReceiveMessage(node, *connman, msgMaker.Make(NetMsgType::CMPCTBLOCK, CBlockHeaderAndShortTxIDs(blockOrphan)));
+    BOOST_CHECK(GetBytesSent(node, NetMsgType::GETBLOCKS) > 0);
+    BOOST_CHECK(WITH_LOCK(cs_main, return !mapBlockIndex.count(blockOrphan.GetHash())));
+
+    // 2) While the tip is old, the block is requested in full, as its inv would have been
+    const CBlock block = BuildBlock(pindexGenesis);
+    ReceiveMessage(node, *connman, msgMaker.Make(NetMsgType::CMPCTBLOCK, CBlockHeaderAndShortTxIDs(block)));
+    BOOST_CHECK(GetBytesSent(node, NetMsgType::GETDATA) > 0);
+    // the header alone is not accepted
+    BOOST_CHECK(WITH_LOCK(cs_main, return !mapBlockIndex.count(block.GetHash())));
+
+    // 3) Near the tip, the block is rebuilt and validated, which rejects it here as it was not mined
+    SetMockTime(block.nTime + 60);
+    ReceiveMessage(node, *connman, msgMaker.Make(NetMsgType::CMPCTBLOCK, CBlockHeaderAndShortTxIDs(block)));
+    BOOST_CHECK(GetBytesSent(node, NetMsgType::REJECT) > 0);
+    SetMockTime(0);
+
+    bool fUpdateConnectionTime = false;
+    GetNodeSignals().FinalizeNode(node.GetId(), fUpdateConnectionTime);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
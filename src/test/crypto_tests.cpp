@@ -13,6 +13,10 @@
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "crypto/sph_cubehash.h"
+#include "crypto/sph_echo.h"
+#include "crypto/sph_groestl.h"
+#include "hash.h"
 #include "random.h"
 #include "utilstrencodings.h"
 #include "test/test_pivx.h"
@@ -58,6 +62,30 @@ void TestSHA256(const std::string &in, const std::string &hexout) { TestVector(C
 void TestSHA512(const std::string &in, const std::string &hexout) { TestVector(CSHA512(), in, ParseHex(hexout));}
 void TestRIPEMD160(const std::string &in, const std::string &hexout) { TestVector(CRIPEMD160(), in, ParseHex(hexout));}
 
+/** Test one of the sph hash functions, writing its input in random pieces. */
+template<typename Context>
+void TestSph(void (*init)(void*), void (*update)(void*, const void*, size_t), void (*close)(void*, void*),
+             const std::string &in, const std::string &hexout) {
+    std::vector<unsigned char> out = ParseHex(hexout);
+    std::vector<unsigned char> hash(out.size());
+    for (int i=0; i<8; i++) {
+        Context ctx;
+        init(&ctx);
+        size_t pos = 0;
+        while (pos < in.size()) {
+            size_t len = i == 0 ? in.size() : InsecureRandRange((in.size() - pos + 1) / 2 + 1);
+            update(&ctx, &in[pos], len);
+            pos += len;
+        }
+        close(&ctx, &hash[0]);
+        BOOST_CHECK(hash == out);
+    }
+}
+
+void TestGroestl512(const std::string &in, const std::string &hexout) { TestSph<sph_groestl512_context>(sph_groestl512_init, sph_groestl512, sph_groestl512_close, in, hexout);}
+void TestEcho512(const std::string &in, const std::string &hexout) { TestSph<sph_echo512_context>(sph_echo512_init, sph_echo512, sph_echo512_close, in, hexout);}
+void TestCubeHash512(const std::string &in, const std::string &hexout) { TestSph<sph_cubehash512_context>(sph_cubehash512_init, sph_cubehash512, sph_cubehash512_close, in, hexout);}
+
 void TestHMACSHA256(const std::string &hexkey, const std::string &hexin, const std::string &hexout) {
     std::vector<unsigned char> key = ParseHex(hexkey);
     TestVector(CHMAC_SHA256(&key[0], key.size()), ParseHex(hexin), ParseHex(hexout));
@@ -270,6 +298,25 @@ BOOST_AUTO_TEST_CASE(sha256_testvectors) {
     TestSHA256(test1, "a316d55510b49662420f49d145d42fb83f31ef8dc016aa4e32df049991a91e26");
 }
 
+BOOST_AUTO_TEST_CASE(sha256d64)
+{
+    for (int i = 0; i <= 32; ++i) {
+        unsigned char in[64 * 32];
+        unsigned char out1[32 * 32], out2[32 * 32];
+        for (int j = 0; j < 64 * i; ++j) {
+            in[j] = InsecureRandBits(8);
+        }
+        for (int j = 0; j < i; ++j) {
+            CHash256().Write(in + 64 * j, 64).Finalize(out1 + 32 * j);
+        }
+        SHA256D64(out2, in, i);
+        BOOST_CHECK(memcmp(out1, out2, 32 * i) == 0);
+        // hashing in place, as the merkle root computation does
+        SHA256D64(in, in, i);
+        BOOST_CHECK(memcmp(out1, in, 32 * i) == 0);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(sha512_testvectors) {
     TestSHA512("",
                "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
@@ -307,6 +354,46 @@ BOOST_AUTO_TEST_CASE(sha512_testvectors) {
                "37de8c3ef5459d76a52cedc02dc499a3c9ed9dedbfb3281afd9653b8a112fafc");
 }
 
+// The X11KV functions that may run on accelerated implementations, see SphAutoDetect
+BOOST_AUTO_TEST_CASE(groestl512_testvectors) {
+    TestGroestl512("",
+                   "6d3ad29d279110eef3adbd66de2a0345a77baede1557f5d099fce0c03d6dc2ba8e6d4a6633dfbd66053c20faa87d1a11f39a7fbe4a6c2f009801370308fc4ad8");
+    TestGroestl512("abc",
+                   "70e1c68c60df3b655339d67dc291cc3f1dde4ef343f11b23fdd44957693815a75a8339c682fc28322513fd1f283c18e53cff2b264e06bf83a2f0ac8c1f6fbff6");
+    TestGroestl512("This is exactly 64 bytes long, not counting the terminating byte",
+                   "dc4ecc30a5c167e6c1316ff48e74fc4bf18b43fef713e3162e6849c424d24eaa436d4847441b7f18f577d9159e348643eb3187ed90c2e7be46669b21661e5106");
+    TestGroestl512("As Bitcoin relies on 80 byte header hashes, we want to have an example for that.",
+                   "768841c01c647aed2fea62272d3a09a80f1c0e966672205705ca5538d0131551b8e4454c196435b90cd3a6bba3ec8f1056099a161cfb64bbaaffd4529aeb9535");
+    TestGroestl512(std::string(1000, 'a'),
+                   "6b56210c6c9d70b7ef00755209d52aae60c9e9e71224ba6b0ee2b13d08930785b92b64965499d81699b5b3268f089116afacd3b1b78c919af7dff9794eb8a561");
+}
+
+BOOST_AUTO_TEST_CASE(echo512_testvectors) {
+    TestEcho512("",
+                "158f58cc79d300a9aa292515049275d051a28ab931726d0ec44bdd9faef4a702c36db9e7922fff077402236465833c5cc76af4efc352b4b44c7fa15aa0ef234e");
+    TestEcho512("abc",
+                "3bf04ec89d67e0dafd1b8ab26b176abaead6b3cdc706ff7198c3c6045e77d4eaf64cd90af9c5a7674919b90ff8c9b4a7554d6cfeffb334406ec233fb0b0dd6bc");
+    TestEcho512("This is exactly 64 bytes long, not counting the terminating byte",
+                "72717c9da6351820d2ea705f7b81e4ba46bb86ee1f75e4822ea497345c895ef9ce7f0e07050a5a00ce989f6541571bde52a3b50fdc47b104901c1b9a307e9f80");
+    TestEcho512("As Bitcoin relies on 80 byte header hashes, we want to have an example for that.",
+                "9fa158b33de2ff52bf92dc591521d74fe4d3e52a3ccef7dc691b0feacda41f3fa32966b9da28f05ba5b83188c0707f0eff9ab622e2f4fdd8be35751c11cf28e8");
+    TestEcho512(std::string(1000, 'a'),
+                "98f2a071cd149a3ace6544c8647ebf19bd9e66a7fb7fdc8cc52eec74aebad87d3133617913ec7d22e3f03499338b9f7a2590944bd3e47e786213e43515f6e679");
+}
+
+BOOST_AUTO_TEST_CASE(cubehash512_testvectors) {
+    TestCubeHash512("",
+                    "4a1d00bbcfcb5a9562fb981e7f7db3350fe2658639d948b9d57452c22328bb32f468b072208450bad5ee178271408be0b16e5633ac8a1e3cf9864cfbfc8e043a");
+    TestCubeHash512("abc",
+                    "f63d6fa89ca9fe7ab2e171be52cf193f0c8ac9f62bad297032c1e7571046791a7e8964e5c8d91880d6f9c2a54176b05198901047438e05ac4ef38d45c0282673");
+    TestCubeHash512("This is exactly 64 bytes long, not counting the terminating byte",
+                    "8b6aa5b98ed4c67471e8cfbccaaecb05a9eeb7f270fc944d8b8b19ccb58ede4953dd951fb902e76aba0c5323ebd97dd9c5e6a741cbf4ae53378d8d2ba90b0d2e");
+    TestCubeHash512("As Bitcoin relies on 80 byte header hashes, we want to have an example for that.",
+                    "a2774fdf8ea5778bc4eed98989a077ae58cc8fd2b5289b6288c55a8c284958e2148d74df47cd18718cbf1b7d2f5e1d2b4b6382788aba663ad95962226027d1e3");
+    TestCubeHash512(std::string(1000, 'a'),
+                    "71da8b6ab94908c45ea6d51ce4ce23d7356e54d83e7880fc74d56fdb2d7a5942d44022b4b676e21cf02bf7e87fd6d2e157cccdf3cf8fbdb783f97689f316eee7");
+}
+
 BOOST_AUTO_TEST_CASE(hmac_sha256_testvectors) {
     // test cases 1, 2, 3, 4, 6 and 7 of RFC 4231
     TestHMACSHA256("0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b",
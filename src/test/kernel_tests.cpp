@@ -0,0 +1,102 @@
+// Copyright (c) 2021-2024 The DECENOMY Core Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chain.h"
+#include "hash.h"
+#include "kernel.h"
+#include "primitives/transaction.h"
+#include "stakeinput.h"
+#include "streams.h"
+#include "test/test_pivx.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(kernel_tests, TestingSetup)
+
+// The kernel hash as computed before the midstate, serializing the whole message
+static uint256 GetStreamKernelHash(const CDataStream& stakeModifier, int nTimeBlockFrom, const CDataStream& stakeUniqueness, int nTime)
+{
+    CDataStream ss(stakeModifier);
+    ss << nTimeBlockFrom << stakeUniqueness << nTime;
+    return Hash(ss.begin(), ss.end());
+}
+
+// The weighted target as computed before the midstate
+static uint256 GetStreamKernelTarget(unsigned int nBits, CAmount stakeValue)
+{
+    uint256 bnTarget;
+    bnTarget.SetCompact(nBits);
+    bnTarget *= (uint256(stakeValue) / 100);
+    return bnTarget;
+}
+
+BOOST_AUTO_TEST_CASE(kernel_midstate_matches_stream)
+{
+    for (int i = 0; i < 32; i++) {
+        // both stake modifier versions, and outpoints of varying index
+        CDataStream stakeModifier(SER_GETHASH, 0);
+        if (i % 2)
+            stakeModifier << InsecureRand256();
+        else
+            stakeModifier << (uint64_t) InsecureRandBits(64);
+        const int nTimeBlockFrom = 1500000000 + InsecureRandRange(100000000);
+        CDataStream stakeUniqueness(SER_NETWORK, 0);
+        stakeUniqueness << (unsigned int) InsecureRandRange(1000) << InsecureRand256();
+
+        // a target about half of the hashes meet, or a real one, to exercise both outcomes
+        const uint256 bnTarget = i % 4 ? uint256S("0x7fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff") : GetStreamKernelTarget(0x1b0404cb, 1000 * COIN);
+
+        CDataStream ss(SER_GETHASH, 0);
+        ss << stakeModifier << nTimeBlockFrom << stakeUniqueness;
+        const CStakeKernelMidstate midstate(ss, bnTarget);
+        BOOST_CHECK(midstate.GetTarget() == bnTarget);
+
+        for (int j = 0; j < 16; j++) {
+            const int nTime = nTimeBlockFrom + InsecureRandRange(1000000);
+            const uint256 hash = GetStreamKernelHash(stakeModifier, nTimeBlockFrom, stakeUniqueness, nTime);
+            BOOST_CHECK(midstate.GetHash(nTime) == hash);
+            BOOST_CHECK_EQUAL(midstate.CheckKernelHash(nTime), hash < bnTarget);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(kernel_stake_matches_stream)
+{
+    const int nHeightPrev = Params().GetConsensus().vUpgrades[Consensus::UPGRADE_STAKE_MODIFIER_V2].nActivationHeight + 100;
+
+    for (int i = 0; i < 8; i++) {
+        CBlockIndex indexFrom;
+        indexFrom.nHeight = nHeightPrev - 60;
+        indexFrom.nTime = 1600000000 + InsecureRandRange(1000000);
+
+        CBlockIndex indexPrev;
+        indexPrev.nHeight = nHeightPrev;
+        indexPrev.nTime = indexFrom.nTime + 3600;
+        indexPrev.SetStakeModifier(InsecureRand256());
+
+        CMutableTransaction txPrev;
+        txPrev.vin.resize(1);
+        txPrev.vin[0].prevout = COutPoint(InsecureRand256(), 0);
+        const unsigned int n = InsecureRandRange(4);
+        txPrev.vout.resize(n + 1);
+        txPrev.vout[n].nValue = (1 + InsecureRandRange(10000)) * COIN;
+        CPivStake stakeInput;
+        BOOST_CHECK(stakeInput.SetPrevout(CTransaction(txPrev), n, &indexFrom));
+
+        CDataStream stakeModifier(SER_GETHASH, 0);
+        stakeModifier << indexPrev.GetStakeModifierV2();
+        const unsigned int nBits = 0x1e0ffff0;
+        const uint256 bnTarget = GetStreamKernelTarget(nBits, stakeInput.GetValue());
+
+        for (int j = 0; j < 8; j++) {
+            const int nTime = indexPrev.nTime + 15 * j;
+            const uint256 hash = GetStreamKernelHash(stakeModifier, indexFrom.nTime, stakeInput.GetUniqueness(), nTime);
+            const CStakeKernel kernel(&indexPrev, &stakeInput, nBits, nTime);
+            BOOST_CHECK(kernel.GetHash() == hash);
+            BOOST_CHECK_EQUAL(kernel.CheckKernelHash(true), hash < bnTarget);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
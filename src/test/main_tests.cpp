@@ -14,6 +14,8 @@
 #include "masternode.h"
 #include "rewards.h"
 
+#include <thread>
+
 BOOST_FIXTURE_TEST_SUITE(main_tests, TestingSetup)
 
 enum BlockSignatureType{
@@ -173,4 +175,136 @@ BOOST_AUTO_TEST_CASE(test_combiner_all)
     BOOST_CHECK(Test());
 }
 
+BOOST_AUTO_TEST_CASE(precompute_block_hashes)
+{
+    std::vector<CBlockHeader> headers(16);
+    std::vector<uint256> hashes;
+    for (CBlockHeader& header : headers) {
+        header.nVersion = 1 + InsecureRandRange(7);
+        header.hashPrevBlock = InsecureRand256();
+        header.hashMerkleRoot = InsecureRand256();
+        header.nTime = InsecureRand32();
+        header.nBits = InsecureRand32();
+        header.nNonce = InsecureRand32();
+
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << header;
+        const unsigned char* data = (const unsigned char*)&ss[0];
+        hashes.push_back(header.nVersion < 4 ? HashX11KVS(data, data + 80) : Hash(ss.begin(), ss.end()));
+    }
+
+    std::vector<const CBlockHeader*> vHeaders;
+    for (const CBlockHeader& header : headers) {
+        vHeaders.push_back(&header);
+    }
+    PrecomputeBlockHashes(vHeaders);
+
+    for (unsigned int i = 0; i < headers.size(); i++) {
+        BOOST_CHECK(headers[i].GetHash() == hashes[i]);
+        // a copy of the header is served too
+        CBlock block(headers[i]);
+        BOOST_CHECK(block.GetHash() == hashes[i]);
+        // and a different one is not
+        block.nNonce++;
+        BOOST_CHECK(block.GetHash() != hashes[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(cached_block_hash)
+{
+    CBlock block;
+    block.nVersion = 1;
+    block.hashPrevBlock = InsecureRand256();
+    block.hashMerkleRoot = InsecureRand256();
+    block.nTime = InsecureRand32();
+    block.nBits = InsecureRand32();
+    block.nNonce = InsecureRand32();
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block.GetBlockHeader();
+    const unsigned char* data = (const unsigned char*)&ss[0];
+    const uint256 hash = HashX11KVS(data, data + 80);
+
+    // computed once, then remembered along with the header it belongs to
+    BOOST_CHECK(block.GetHash() == hash);
+    BOOST_CHECK(block.hashCached == hash);
+    BOOST_CHECK(block.GetHash() == hash);
+    BOOST_CHECK(block.GetBlockHeader().hashCached == hash);
+
+    // any change to the header is a different hash
+    block.nNonce++;
+    const uint256 hashMutated = block.GetHash();
+    BOOST_CHECK(hashMutated != hash);
+    block.nNonce--;
+    BOOST_CHECK(block.GetHash() == hash);
+
+    // a hash set from the outside is trusted for this header only
+    const uint256 hashTrusted = InsecureRand256();
+    block.SetCachedHash(hashTrusted);
+    BOOST_CHECK(block.GetHash() == hashTrusted);
+    block.nTime++;
+    BOOST_CHECK(block.GetHash() != hashTrusted);
+
+    // and cleared with the rest of the block
+    block.SetNull();
+    BOOST_CHECK(block.hashCached.IsNull());
+}
+
+BOOST_AUTO_TEST_CASE(cached_block_hash_threads)
+{
+    CBlockHeader header;
+    header.nVersion = 1;
+    header.hashPrevBlock = InsecureRand256();
+    header.hashMerkleRoot = InsecureRand256();
+    header.nTime = InsecureRand32();
+    header.nBits = InsecureRand32();
+    header.nNonce = InsecureRand32();
+    const CBlockHeader headerCopy(header);
+    const uint256 hash = headerCopy.GetHash();
+
+    // a const header shared between threads is filled by one of them, and
+    // read by all the others
+    const CBlockHeader& shared = header;
+    std::vector<uint256> vHashes(8);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < vHashes.size(); i++) {
+        threads.emplace_back([&shared, &vHashes, i] {
+            for (int n = 0; n < 10; n++)
+                vHashes[i] = shared.GetHash();
+        });
+    }
+    for (std::thread& t : threads)
+        t.join();
+
+    for (const uint256& h : vHashes)
+        BOOST_CHECK(h == hash);
+    BOOST_CHECK(header.hashCached == hash);
+}
+
+BOOST_AUTO_TEST_CASE(raw_block_read)
+{
+    CDiskBlockPos pos;
+    {
+        LOCK(cs_main);
+        pos = chainActive.Genesis()->GetBlockPos();
+    }
+
+    // the stored bytes are the block as sent on the network
+    std::vector<unsigned char> vchBlock;
+    BOOST_CHECK(ReadRawBlockFromDisk(vchBlock, pos));
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << Params().GenesisBlock();
+    BOOST_CHECK(std::vector<unsigned char>(ss.begin(), ss.end()) == vchBlock);
+
+    CBlock block;
+    CDataStream(vchBlock, SER_NETWORK, PROTOCOL_VERSION) >> block;
+    BOOST_CHECK(block.GetHash() == Params().GenesisBlock().GetHash());
+
+    // no index header where a block does not start
+    CDiskBlockPos posBad(pos.nFile, pos.nPos + 1);
+    BOOST_CHECK(!ReadRawBlockFromDisk(vchBlock, posBad));
+    posBad.nPos = 0;
+    BOOST_CHECK(!ReadRawBlockFromDisk(vchBlock, posBad));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,114 @@
+// Copyright (c) 2021-2024 The DECENOMY Core Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternodeman.h"
+#include "script/standard.h"
+#include "streams.h"
+#include "test/test_pivx.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#define PAID_CHAIN_LENGTH 3000
+
+BOOST_FIXTURE_TEST_SUITE(masternodeman_tests, BasicTestingSetup)
+
+// same walk as CMasternode::GetLastPaidV2
+static int64_t WalkLastPaid(const CBlockIndex* pblockindex, const std::vector<CScript>& vPayees, const CScript& mnpayee, int64_t sigTime, int max_depth)
+{
+    int n = 0;
+    do
+    {
+        if (vPayees[pblockindex->nHeight] == mnpayee) {
+            return pblockindex->nTime;
+        }
+
+        pblockindex = pblockindex->pprev;
+
+        if (pblockindex == nullptr || pblockindex->nHeight <= 0) {
+            break;
+        }
+
+        n++;
+    }
+    while(pblockindex->GetBlockTime() > sigTime && n <= max_depth);
+
+    return 0;
+}
+
+BOOST_AUTO_TEST_CASE(paid_heights_match_chain_walk)
+{
+    std::vector<CScript> vScripts;
+    for (int i = 0; i < 20; i++) {
+        vScripts.push_back(GetScriptForDestination(CKeyID(uint160(InsecureRandBytes(20)))));
+    }
+
+    std::vector<uint256> vHashes(PAID_CHAIN_LENGTH);
+    std::vector<CBlockIndex> vIndex(PAID_CHAIN_LENGTH);
+    std::vector<CScript> vPayees(PAID_CHAIN_LENGTH);
+    for (int i = 0; i < PAID_CHAIN_LENGTH; i++) {
+        vHashes[i] = InsecureRand256();
+        vIndex[i].nHeight = i;
+        vIndex[i].pprev = i ? &vIndex[i - 1] : nullptr;
+        vIndex[i].phashBlock = &vHashes[i];
+        // block times are not monotonic
+        vIndex[i].nTime = 1000000 + i * 60 + InsecureRandRange(240);
+        vIndex[i].BuildSkip();
+        if (InsecureRandRange(10) != 0) vPayees[i] = vScripts[InsecureRandRange(vScripts.size())];
+    }
+
+    CMasternodeMan mnman;
+    for (int i = 0; i < PAID_CHAIN_LENGTH; i++) {
+        mnman.ConnectPaidBlock(&vIndex[i], vPayees[i]);
+    }
+
+    auto check = [&](CMasternodeMan& man, int nTipHeight) {
+        for (int i = 0; i < 500; i++) {
+            const CBlockIndex* pindex = &vIndex[1 + InsecureRandRange(nTipHeight)];
+            const CScript& payee = vScripts[InsecureRandRange(vScripts.size())];
+            const int64_t sigTime = 1000000 + InsecureRandRange(nTipHeight * 60);
+            const int nMaxDepth = InsecureRandRange(600);
+
+            int64_t nTime = -1;
+            BOOST_CHECK(man.GetLastPaidTime(pindex, payee, sigTime, nMaxDepth, nTime));
+            BOOST_CHECK_EQUAL(nTime, WalkLastPaid(pindex, vPayees, payee, sigTime, nMaxDepth));
+        }
+    };
+
+    check(mnman, PAID_CHAIN_LENGTH - 1);
+
+    // blocks beyond the tracked tip aren't covered
+    int64_t nTime = 0;
+    mnman.DisconnectPaidBlock(&vIndex[PAID_CHAIN_LENGTH - 1], vPayees[PAID_CHAIN_LENGTH - 1]);
+    BOOST_CHECK(!mnman.GetLastPaidTime(&vIndex[PAID_CHAIN_LENGTH - 1], vScripts[0], 0, 10, nTime));
+
+    // disconnecting rolls the payments back
+    for (int i = PAID_CHAIN_LENGTH - 2; i >= PAID_CHAIN_LENGTH - 100; i--) {
+        mnman.DisconnectPaidBlock(&vIndex[i], vPayees[i]);
+    }
+    check(mnman, PAID_CHAIN_LENGTH - 101);
+
+    // and reconnecting brings them back
+    for (int i = PAID_CHAIN_LENGTH - 100; i < PAID_CHAIN_LENGTH - 1; i++) {
+        mnman.ConnectPaidBlock(&vIndex[i], vPayees[i]);
+    }
+    check(mnman, PAID_CHAIN_LENGTH - 2);
+
+    // they survive mncache.dat
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << mnman;
+    CMasternodeMan mnmanLoaded;
+    ss >> mnmanLoaded;
+    mnmanLoaded.ConnectPaidBlock(&vIndex[PAID_CHAIN_LENGTH - 1], vPayees[PAID_CHAIN_LENGTH - 1]);
+    check(mnmanLoaded, PAID_CHAIN_LENGTH - 1);
+
+    // a block not following the tracked chain starts the tracking over
+    CMasternodeMan mnmanFork;
+    mnmanFork.ConnectPaidBlock(&vIndex[2000], vPayees[2000]);
+    BOOST_CHECK(!mnmanFork.GetLastPaidTime(&vIndex[2000], vScripts[0], 0, 10, nTime));
+    BOOST_CHECK(mnmanFork.GetLastPaidTime(&vIndex[2000], vScripts[0], vIndex[2000].nTime + 1000, 10, nTime));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
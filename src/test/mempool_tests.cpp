@@ -319,6 +319,108 @@ BOOST_AUTO_TEST_CASE(MempoolIndexingTest)
 }
 
 
+BOOST_AUTO_TEST_CASE(MempoolAncestorIndexingTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    TestMemPoolEntryHelper entry;
+    entry.hadNoDependencies = true;
+
+    /* 3rd highest fee */
+    CMutableTransaction tx1 = CMutableTransaction();
+    tx1.vout.resize(1);
+    tx1.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(tx1.GetHash(), entry.Fee(10000LL).Priority(10.0).FromTx(tx1));
+
+    /* highest fee */
+    CMutableTransaction tx2 = CMutableTransaction();
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx2.vout[0].nValue = 2 * COIN;
+    pool.addUnchecked(tx2.GetHash(), entry.Fee(20000LL).Priority(9.0).FromTx(tx2));
+
+    /* lowest fee */
+    CMutableTransaction tx3 = CMutableTransaction();
+    tx3.vout.resize(1);
+    tx3.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx3.vout[0].nValue = 5 * COIN;
+    pool.addUnchecked(tx3.GetHash(), entry.Fee(0LL).Priority(100.0).FromTx(tx3));
+
+    /* 2nd highest fee */
+    CMutableTransaction tx4 = CMutableTransaction();
+    tx4.vout.resize(1);
+    tx4.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx4.vout[0].nValue = 6 * COIN;
+    pool.addUnchecked(tx4.GetHash(), entry.Fee(15000LL).Priority(1.0).FromTx(tx4));
+
+    /* equal fee rate to tx1, but newer */
+    CMutableTransaction tx5 = CMutableTransaction();
+    tx5.vout.resize(1);
+    tx5.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx5.vout[0].nValue = 11 * COIN;
+    pool.addUnchecked(tx5.GetHash(), entry.Fee(10000LL).FromTx(tx5));
+    BOOST_CHECK_EQUAL(pool.size(), 5);
+
+    std::vector<std::string> sortedOrder;
+    sortedOrder.resize(5);
+    sortedOrder[0] = tx2.GetHash().ToString(); // 20000
+    sortedOrder[1] = tx4.GetHash().ToString(); // 15000
+    // tx1 and tx5 are both 10000
+    // Ties are broken by hash, not timestamp, so determine which
+    // hash comes first.
+    if (tx1.GetHash() < tx5.GetHash()) {
+        sortedOrder[2] = tx1.GetHash().ToString();
+        sortedOrder[3] = tx5.GetHash().ToString();
+    } else {
+        sortedOrder[2] = tx5.GetHash().ToString();
+        sortedOrder[3] = tx1.GetHash().ToString();
+    }
+    sortedOrder[4] = tx3.GetHash().ToString(); // 0
+    CheckSort<4>(pool, sortedOrder);
+
+    /* low fee parent with high fee child */
+    /* tx3 -> tx6 */
+    CMutableTransaction tx6 = CMutableTransaction();
+    tx6.vin.resize(1);
+    tx6.vin[0].prevout = COutPoint(tx3.GetHash(), 0);
+    tx6.vin[0].scriptSig = CScript() << OP_11;
+    tx6.vout.resize(1);
+    tx6.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx6.vout[0].nValue = 4 * COIN;
+    pool.addUnchecked(tx6.GetHash(), entry.Fee(2000000LL).HadNoDependencies(false).FromTx(tx6));
+    BOOST_CHECK_EQUAL(pool.size(), 6);
+
+    // The child carries its parent
+    CTxMemPool::txiter it3 = pool.mapTx.find(tx3.GetHash());
+    CTxMemPool::txiter it6 = pool.mapTx.find(tx6.GetHash());
+    BOOST_CHECK_EQUAL(it6->GetCountWithAncestors(), 2);
+    BOOST_CHECK_EQUAL(it6->GetSizeWithAncestors(), it3->GetTxSize() + it6->GetTxSize());
+    BOOST_CHECK_EQUAL(it6->GetModFeesWithAncestors(), 2000000LL);
+    BOOST_CHECK_EQUAL(it6->GetSigOpCountWithAncestors(), 2);
+    BOOST_CHECK_EQUAL(it3->GetCountWithAncestors(), 1);
+    sortedOrder.insert(sortedOrder.begin(), tx6.GetHash().ToString());
+    CheckSort<4>(pool, sortedOrder);
+
+    // Fee deltas of the parent are counted for the child
+    pool.PrioritiseTransaction(tx3.GetHash(), tx3.GetHash().ToString(), 0, 30000LL);
+    BOOST_CHECK_EQUAL(it6->GetModFeesWithAncestors(), 2030000LL);
+    BOOST_CHECK_EQUAL(it3->GetModFeesWithAncestors(), 30000LL);
+    sortedOrder.erase(sortedOrder.end() - 1);
+    sortedOrder.insert(sortedOrder.begin() + 1, tx3.GetHash().ToString());
+    CheckSort<4>(pool, sortedOrder);
+
+    // Mining the parent leaves the child on its own
+    std::list<CTransaction> removed;
+    pool.remove(tx3, removed, false);
+    BOOST_CHECK_EQUAL(removed.size(), 1);
+    BOOST_CHECK_EQUAL(it6->GetCountWithAncestors(), 1);
+    BOOST_CHECK_EQUAL(it6->GetSizeWithAncestors(), it6->GetTxSize());
+    BOOST_CHECK_EQUAL(it6->GetModFeesWithAncestors(), 2000000LL);
+    BOOST_CHECK_EQUAL(it6->GetSigOpCountWithAncestors(), 1);
+    sortedOrder.erase(sortedOrder.begin() + 1);
+    CheckSort<4>(pool, sortedOrder);
+}
+
 BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
 {
     CTxMemPool pool(CFeeRate(1000));
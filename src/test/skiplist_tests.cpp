@@ -101,4 +101,41 @@ BOOST_AUTO_TEST_CASE(getlocator_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(blockindex_arena_test)
+{
+    CBlockIndexArena arena;
+    std::vector<CBlockIndex*> vIndex;
+    for (int i = 0; i < 5000; i++) {
+        vIndex.push_back(arena.New());
+        vIndex.back()->nHeight = i;
+    }
+    BOOST_CHECK_EQUAL(arena.Size(), 5000U);
+    BOOST_CHECK_EQUAL(arena.Slabs(), 2U);
+    for (int i = 0; i < 5000; i++) {
+        BOOST_CHECK_EQUAL(vIndex[i]->nHeight, i);
+    }
+
+    // A deleted entry is handed out again, constructed anew
+    CBlockIndex* pindexDeleted = vIndex[10];
+    arena.Delete(pindexDeleted);
+    BOOST_CHECK_EQUAL(arena.Size(), 4999U);
+    CBlockIndex* pindexNew = arena.New();
+    BOOST_CHECK(pindexNew == pindexDeleted);
+    BOOST_CHECK_EQUAL(pindexNew->nHeight, 0);
+    BOOST_CHECK_EQUAL(arena.Slabs(), 2U);
+
+    // Both stake modifier versions fit in the entry
+    pindexNew->SetStakeModifier(InsecureRand256());
+    BOOST_CHECK_EQUAL(pindexNew->vStakeModifier.size(), 32U);
+    BOOST_CHECK_EQUAL(pindexNew->vStakeModifier.allocated_memory(), 0U);
+    pindexNew->SetStakeModifier((uint64_t)InsecureRand32(), false);
+    BOOST_CHECK_EQUAL(pindexNew->vStakeModifier.size(), 8U);
+    BOOST_CHECK_EQUAL(pindexNew->vStakeModifier.allocated_memory(), 0U);
+
+    for (CBlockIndex* pindex : vIndex) {
+        arena.Delete(pindex);
+    }
+    BOOST_CHECK_EQUAL(arena.Size(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,193 @@
+// Copyright (c) 2021-2024 The DECENOMY Core Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chain.h"
+#include "clientversion.h"
+#include "coins.h"
+#include "rewards.h"
+#include "script/standard.h"
+#include "supplyledger.h"
+#include "timedata.h"
+#include "txdb.h"
+#include "undo.h"
+#include "util.h"
+#include "test/test_pivx.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(supplyledger_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(supplyledger_weight_ratio)
+{
+    const int64_t nBlocksPerMonth = MONTH_IN_SECONDS / Params().GetConsensus().nTargetSpacing;
+
+    BOOST_CHECK_EQUAL(GetSupplyWeightRatio(0, nBlocksPerMonth), 100);
+    BOOST_CHECK_EQUAL(GetSupplyWeightRatio(3 * nBlocksPerMonth, nBlocksPerMonth), 100);
+    BOOST_CHECK_EQUAL(GetSupplyWeightRatio(12 * nBlocksPerMonth, nBlocksPerMonth), 0);
+    BOOST_CHECK_EQUAL(GetSupplyWeightRatio(24 * nBlocksPerMonth, nBlocksPerMonth), 0);
+
+    for (int64_t nDiff = 1; nDiff < 13 * nBlocksPerMonth; nDiff += 97) {
+        BOOST_CHECK(GetSupplyWeightRatio(nDiff, nBlocksPerMonth) <= GetSupplyWeightRatio(nDiff - 1, nBlocksPerMonth));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(supplyledger_matches_scan)
+{
+    const int64_t nBlocksPerMonth = MONTH_IN_SECONDS / Params().GetConsensus().nTargetSpacing;
+    const int nTipHeight = 14 * nBlocksPerMonth;
+    const std::vector<CAmount> vCollaterals = {15000 * COIN, 17500 * COIN, 20000 * COIN};
+    const std::set<CAmount> setCollaterals(vCollaterals.begin(), vCollaterals.end());
+
+    CCoinsViewDB coinsdb(1 << 20, true);
+    CCoinsViewCache coins(&coinsdb);
+    CSupplyLedger ledger;
+    ledger.Clear(setCollaterals, UINT256_ZERO);
+
+    std::vector<std::pair<COutPoint, Coin>> vCoins;
+    for (int i = 0; i < 5000; i++) {
+        CTxOut out;
+        out.nValue = InsecureRandRange(10) == 0 ?
+            vCollaterals[InsecureRandRange(vCollaterals.size())] :
+            static_cast<CAmount>(InsecureRandRange(1000 * COIN));
+        out.scriptPubKey = GetScriptForDestination(CKeyID(uint160(InsecureRandBytes(20))));
+        const int nHeight = 1 + InsecureRandRange(nTipHeight - 1);
+
+        COutPoint outpoint(InsecureRand256(), 0);
+        coins.AddCoin(outpoint, Coin(out, nHeight, false, false), false);
+        ledger.AddCoin(out, nHeight);
+        vCoins.emplace_back(outpoint, Coin(out, nHeight, false, false));
+    }
+
+    // spend a third of them
+    CAmount nMoneySupply = 0;
+    for (unsigned int i = 0; i < vCoins.size(); i++) {
+        const Coin& coin = vCoins[i].second;
+        if (i % 3 == 0) {
+            coins.SpendCoin(vCoins[i].first);
+            ledger.SpendCoin(coin.out, coin.nHeight);
+        } else {
+            nMoneySupply += coin.out.nValue;
+        }
+    }
+
+    const uint256 hashBlock = InsecureRand256();
+    coins.SetBestBlock(hashBlock);
+    BOOST_CHECK(coins.Flush());
+    ledger.SetBestBlock(hashBlock);
+
+    BOOST_CHECK_EQUAL(ledger.GetMoneySupply(nTipHeight), nMoneySupply);
+
+    auto check = [&](const CSupplyLedger& l, int nHeight) {
+        for (const CAmount nCollateral : vCollaterals) {
+            for (const CAmount nNextWeekCollateral : vCollaterals) {
+                CAmount nSupply = 0;
+                BOOST_CHECK(l.GetCirculatingSupply(nHeight, nBlocksPerMonth, nCollateral, nNextWeekCollateral, nSupply));
+                BOOST_CHECK_EQUAL(nSupply, CRewards::ScanCirculatingSupply(coins, nHeight, nCollateral, nNextWeekCollateral));
+            }
+        }
+    };
+
+    for (int nHeight = nTipHeight; nHeight < nTipHeight + 2 * nBlocksPerMonth; nHeight += nBlocksPerMonth / 3) {
+        check(ledger, nHeight);
+    }
+
+    // dropping the detail of the coins that no longer weigh doesn't change the results
+    ledger.Fold(nTipHeight, nBlocksPerMonth);
+    check(ledger, nTipHeight);
+    check(ledger, nTipHeight + nBlocksPerMonth);
+    BOOST_CHECK_EQUAL(ledger.GetMoneySupply(nTipHeight), nMoneySupply);
+
+    // but the ledger refuses to serve heights that would need it
+    CAmount nSupply = 0;
+    BOOST_CHECK(!ledger.GetCirculatingSupply(nTipHeight - 6 * nBlocksPerMonth, nBlocksPerMonth, vCollaterals[0], vCollaterals[1], nSupply));
+
+    // amounts that aren't tracked can't be excluded from the buckets
+    BOOST_CHECK(!ledger.GetCirculatingSupply(nTipHeight, nBlocksPerMonth, 1 * COIN, vCollaterals[1], nSupply));
+
+    // a ledger rebuilt from the chainstate walk is equivalent
+    CSupplyLedger rebuilt;
+    rebuilt.Clear(setCollaterals, UINT256_ZERO);
+    CRewards::ScanCirculatingSupply(coins, nTipHeight, vCollaterals[0], vCollaterals[1], &rebuilt);
+    BOOST_CHECK(rebuilt.GetBestBlock() == hashBlock);
+    check(rebuilt, nTipHeight);
+
+    // and so is one read back from disk
+    const fs::path path = GetDataDir() / "supply.dat";
+    BOOST_CHECK(ledger.Write(path));
+    CSupplyLedger loaded;
+    BOOST_CHECK(loaded.Read(path));
+    BOOST_CHECK(loaded.GetBestBlock() == hashBlock);
+    BOOST_CHECK(loaded.GetCollaterals() == setCollaterals);
+    check(loaded, nTipHeight);
+}
+
+BOOST_AUTO_TEST_CASE(supplyledger_connect_disconnect)
+{
+    const int nHeight = 1000;
+    BOOST_CHECK(!Params().GetConsensus().NetworkUpgradeActive(nHeight, Consensus::UPGRADE_DYNAMIC_REWARDS));
+
+    auto makeOut = [](CAmount nValue) {
+        return CTxOut(nValue, GetScriptForDestination(CKeyID(uint160(InsecureRandBytes(20)))));
+    };
+
+    // the ledger as of the parent block, with a coin of an earlier block
+    const CTxOut prevOut = makeOut(50 * COIN);
+    supplyLedger.Clear({15000 * COIN}, UINT256_ZERO);
+    supplyLedger.AddCoin(prevOut, nHeight - 10);
+
+    CBlockIndex indexPrev;
+    const uint256 hashPrev = InsecureRand256();
+    indexPrev.phashBlock = &hashPrev;
+    indexPrev.nHeight = nHeight - 1;
+    supplyLedger.SetBestBlock(hashPrev);
+
+    CBlockIndex index;
+    const uint256 hash = InsecureRand256();
+    index.phashBlock = &hash;
+    index.pprev = &indexPrev;
+    index.nHeight = nHeight;
+
+    CDataStream ssBefore(SER_DISK, CLIENT_VERSION);
+    ssBefore << supplyLedger;
+
+    // tx1 spends the earlier coin, tx2 spends an output of tx1 in the same block
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vout.push_back(makeOut(10 * COIN));
+    CMutableTransaction tx1;
+    tx1.vin.emplace_back(COutPoint(InsecureRand256(), 0));
+    tx1.vout.push_back(makeOut(30 * COIN));
+    tx1.vout.push_back(makeOut(20 * COIN));
+    CMutableTransaction tx2;
+    tx2.vin.emplace_back(COutPoint(tx1.GetHash(), 0));
+    tx2.vout.push_back(makeOut(30 * COIN));
+
+    CBlock block;
+    block.vtx.push_back(coinbase);
+    block.vtx.push_back(tx1);
+    block.vtx.push_back(tx2);
+    CBlockUndo blockundo;
+    blockundo.vtxundo.resize(2);
+    blockundo.vtxundo[0].vprevout.emplace_back(prevOut, nHeight - 10, false, false);
+    blockundo.vtxundo[1].vprevout.emplace_back(tx1.vout[0], nHeight, false, false);
+
+    CCoinsViewDB coinsdb(1 << 20, true);
+    CCoinsViewCache coins(&coinsdb);
+    BOOST_CHECK(CRewards::ConnectBlock(&index, 10 * COIN, coins, block, blockundo));
+    BOOST_CHECK(supplyLedger.GetBestBlock() == hash);
+    BOOST_CHECK_EQUAL(supplyLedger.GetMoneySupply(nHeight), 60 * COIN);
+
+    BOOST_CHECK(CRewards::DisconnectBlock(&index, block, blockundo));
+    BOOST_CHECK(supplyLedger.GetBestBlock() == hashPrev);
+    BOOST_CHECK_EQUAL(supplyLedger.GetMoneySupply(nHeight), 50 * COIN);
+
+    CDataStream ssAfter(SER_DISK, CLIENT_VERSION);
+    ssAfter << supplyLedger;
+    BOOST_CHECK(ssBefore.str() == ssAfter.str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -8,6 +8,8 @@
 
 #include "test_pivx.h"
 
+#include "crypto/sha256.h"
+#include "crypto/sph_autodetect.h"
 #include "main.h"
 #include "random.h"
 #include "script/sigcache.h"
@@ -28,10 +30,13 @@ extern void noui_connect();
 
 BasicTestingSetup::BasicTestingSetup()
 {
+        SHA256AutoDetect();
+        SphAutoDetect();
         RandomInit();
         ECC_Start();
         SetupEnvironment();
         InitSignatureCache();
+        InitScriptExecutionCache();
         fCheckBlockIndex = true;
         SelectParams(CBaseChainParams::MAIN);
 }
@@ -59,6 +64,8 @@ TestingSetup::TestingSetup()
         nScriptCheckThreads = 3;
         for (int i=0; i < nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        for (int i=0; i < nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadHeaderHash);
         g_connman = std::unique_ptr<CConnman>(new CConnman(0x1337, 0x1337)); // Deterministic randomness for tests.
         connman = g_connman.get();
         RegisterNodeSignals(GetNodeSignals());
@@ -0,0 +1,64 @@
+// Copyright (c) 2011-2016 The Bitcoin Core developers
+// Copyright (c) 2021-2022 The DECENOMY Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coins.h"
+#include "consensus/validation.h"
+#include "main.h"
+#include "random.h"
+#include "script/interpreter.h"
+
+#include "test/test_pivx.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txvalidationcache_tests, TestingSetup)
+
+static void AddSpentCoin(CCoinsViewCache& view, const COutPoint& prevout, const CScript& scriptPubKey)
+{
+    LOCK(cs_main);
+    view.SetBestBlock(chainActive.Tip()->GetBlockHash());
+    view.AddCoin(prevout, Coin(CTxOut(COIN, scriptPubKey), 1, false, false), false);
+}
+
+BOOST_AUTO_TEST_CASE(script_execution_cache)
+{
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout = COutPoint(InsecureRand256(), 0);
+    mtx.vout.resize(1);
+    mtx.vout[0].nValue = COIN / 2;
+    mtx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    const CTransaction tx(mtx);
+    PrecomputedTransactionData txdata(tx);
+
+    // The same transaction spending a coin its script passes for, and one it fails for
+    CCoinsView coinsDummy;
+    CCoinsViewCache viewGood(&coinsDummy), viewBad(&coinsDummy);
+    AddSpentCoin(viewGood, tx.vin[0].prevout, CScript() << OP_TRUE);
+    AddSpentCoin(viewBad, tx.vin[0].prevout, CScript() << OP_FALSE);
+
+    LOCK(cs_main);
+    CValidationState state;
+    const unsigned int flags = SCRIPT_VERIFY_P2SH;
+
+    // Checked in parallel: the result is not known here, so not remembered
+    std::vector<CScriptCheck> vChecks;
+    BOOST_CHECK(CheckInputs(tx, state, viewGood, true, flags, true, true, txdata, &vChecks));
+    BOOST_CHECK_EQUAL(vChecks.size(), 1);
+    BOOST_CHECK(!CheckInputs(tx, state, viewBad, true, flags, true, true, txdata));
+
+    // Checked with the mempool: the scripts are not run again for the same flags
+    BOOST_CHECK(CheckInputs(tx, state, viewGood, true, flags, true, true, txdata));
+    BOOST_CHECK(CheckInputs(tx, state, viewBad, true, flags, true, true, txdata));
+    vChecks.clear();
+    BOOST_CHECK(CheckInputs(tx, state, viewBad, true, flags, true, true, txdata, &vChecks));
+    BOOST_CHECK(vChecks.empty());
+    BOOST_CHECK(!CheckInputs(tx, state, viewBad, true, flags | SCRIPT_VERIFY_DERSIG, true, true, txdata));
+
+    // Connected in a block: the entry is found, and only marked as the first to evict
+    BOOST_CHECK(CheckInputs(tx, state, viewBad, true, flags, false, false, txdata));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
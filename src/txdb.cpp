@@ -19,7 +19,9 @@ static const char DB_COIN = 'C';
 static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
+static const char DB_PAYEEINDEX = 'p';
 static const char DB_BLOCK_INDEX = 'b';
+static const char DB_BLOCK_INDEX_SNAPSHOT = 'S';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_FLAG = 'F';
@@ -111,7 +113,10 @@ CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWra
 
 bool CBlockTreeDB::WriteBlockIndex(const CDiskBlockIndex& blockindex)
 {
-    return Write(std::make_pair(DB_BLOCK_INDEX, blockindex.GetBlockHash()), blockindex);
+    CDBBatch batch;
+    batch.Write(std::make_pair(DB_BLOCK_INDEX, blockindex.GetBlockHash()), blockindex);
+    batch.Erase(DB_BLOCK_INDEX_SNAPSHOT);
+    return WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo& info)
@@ -202,6 +207,9 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     for (std::vector<const CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
         batch.Write(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), CDiskBlockIndex(*it));
     }
+    // The block index snapshot no longer matches the database
+    if (!blockinfo.empty())
+        batch.Erase(DB_BLOCK_INDEX_SNAPSHOT);
     return WriteBatch(batch, true);
 }
 
@@ -210,6 +218,8 @@ bool CBlockTreeDB::EraseBatchSync(const std::vector<const CBlockIndex*>& blockin
     for (std::vector<const CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
         batch.Erase(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()));
     }
+    if (!blockinfo.empty())
+        batch.Erase(DB_BLOCK_INDEX_SNAPSHOT);
     return WriteBatch(batch, true);
 }
 
@@ -226,6 +236,24 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::ReadPayeeIndex(int nHeight, CDiskPayee& payee)
+{
+    return Read(std::make_pair(DB_PAYEEINDEX, nHeight), payee);
+}
+
+bool CBlockTreeDB::WritePayeeIndex(const std::vector<std::pair<int, CDiskPayee> >& vect)
+{
+    CDBBatch batch;
+    for (std::vector<std::pair<int, CDiskPayee> >::const_iterator it = vect.begin(); it != vect.end(); it++)
+        batch.Write(std::make_pair(DB_PAYEEINDEX, it->first), it->second);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ErasePayeeIndex(int nHeight)
+{
+    return Erase(std::make_pair(DB_PAYEEINDEX, nHeight));
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string& name, bool fValue)
 {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
@@ -250,6 +278,16 @@ bool CBlockTreeDB::ReadInt(const std::string& name, int& nValue)
     return Read(std::make_pair('I', name), nValue);
 }
 
+bool CBlockTreeDB::WriteBlockIndexSnapshot(const uint256& hashSnapshot)
+{
+    return Write(DB_BLOCK_INDEX_SNAPSHOT, hashSnapshot, true);
+}
+
+bool CBlockTreeDB::ReadBlockIndexSnapshot(uint256& hashSnapshot)
+{
+    return Read(DB_BLOCK_INDEX_SNAPSHOT, hashSnapshot);
+}
+
 bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex)
 {
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
@@ -266,30 +304,13 @@ bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256
                 // Construct block index object
                 CBlockIndex* pindexNew = insertBlockIndex(key.second); // use the hash already registered on the key index
                 pindexNew->pprev = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight = diskindex.nHeight;
-                pindexNew->nFile = diskindex.nFile;
-                pindexNew->nDataPos = diskindex.nDataPos;
-                pindexNew->nUndoPos = diskindex.nUndoPos;
-                pindexNew->nVersion = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime = diskindex.nTime;
-                pindexNew->nBits = diskindex.nBits;
-                pindexNew->nNonce = diskindex.nNonce;
-                pindexNew->nStatus = diskindex.nStatus;
-                pindexNew->nTx = diskindex.nTx;
-
-
-                //Proof Of Stake
-                pindexNew->nFlags = diskindex.nFlags;
-                pindexNew->vStakeModifier = diskindex.vStakeModifier;
+                diskindex.CopyTo(pindexNew);
 
                 // if (!Params().GetConsensus().NetworkUpgradeActive(pindexNew->nHeight, Consensus::UPGRADE_POS)) {
                 //     if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits))
                 //         return error("LoadBlockIndex() : CheckProofOfWork failed: %s", pindexNew->ToString());
                 // }
 
-                pindexNew->nMoneySupply = diskindex.nMoneySupply;
-
                 pcursor->Next();
             } else {
                 return error("%s : failed to read value", __func__);
@@ -63,6 +63,28 @@ struct CDiskTxPos : public CDiskBlockPos
     }
 };
 
+/** Masternode payee of an active chain block, as kept in the payee index */
+struct CDiskPayee
+{
+    uint256 hashBlock;
+    CScript payee;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(hashBlock);
+        READWRITE(*(CScriptBase*)(&payee));
+    }
+
+    CDiskPayee(const uint256& hashBlockIn, const CScript& payeeIn) : hashBlock(hashBlockIn), payee(payeeIn)
+    {
+    }
+
+    CDiskPayee() {}
+};
+
 /** CCoinsView backed by the LevelDB coin database (chainstate/) */
 class CCoinsViewDB : public CCoinsView
 {
@@ -125,10 +147,16 @@ public:
     bool ReadReindexing(bool& fReindex);
     bool ReadTxIndex(const uint256& txid, CDiskTxPos& pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >& list);
+    bool ReadPayeeIndex(int nHeight, CDiskPayee& payee);
+    bool WritePayeeIndex(const std::vector<std::pair<int, CDiskPayee> >& list);
+    bool ErasePayeeIndex(int nHeight);
     bool WriteFlag(const std::string& name, bool fValue);
     bool ReadFlag(const std::string& name, bool& fValue);
     bool WriteInt(const std::string& name, int nValue);
     bool ReadInt(const std::string& name, int& nValue);
+    //! Id of the block index snapshot file that matches the database, erased by any later write of the block index
+    bool WriteBlockIndexSnapshot(const uint256& hashSnapshot);
+    bool ReadBlockIndexSnapshot(uint256& hashSnapshot);
     bool LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex);
 };
 
@@ -75,6 +75,14 @@ std::string DecodeDumpString(const std::string& str)
     return ret.str();
 }
 
+void static CheckRescanResult(int nResult)
+{
+    if (nResult == WALLET_RESCAN_RUNNING)
+        throw JSONRPCError(RPC_WALLET_ERROR, "Wallet is currently rescanning. Abort existing rescan or wait.");
+    if (nResult == WALLET_RESCAN_ABORTED)
+        throw JSONRPCError(RPC_WALLET_ERROR, "Rescan aborted");
+}
+
 UniValue importprivkey(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 1 || request.params.size() > 4)
@@ -128,13 +136,12 @@ UniValue importprivkey(const JSONRPCRequest& request)
 
         // whenever a key is imported, we need to scan the whole chain
         pwalletMain->nTimeFirstKey = 1; // 0 would be considered 'no value'
-
-        if (fRescan) {
-            CBlockIndex *pindex = chainActive.Genesis();
-            pwalletMain->ScanForWalletTransactions(pindex, true);
-        }
     }
 
+    // the rescan takes the locks between its batches of blocks
+    if (fRescan)
+        CheckRescanResult(pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true));
+
     return NullUniValue;
 }
 
@@ -197,25 +204,27 @@ UniValue importaddress(const JSONRPCRequest& request)
     // Whether to import a p2sh version, too
     const bool fP2SH = (request.params.size() > 3 ? request.params[3].get_bool() : false);
 
-    LOCK2(cs_main, pwalletMain->cs_wallet);
+    {
+        LOCK2(cs_main, pwalletMain->cs_wallet);
 
-    CTxDestination dest = DecodeDestination(request.params[0].get_str());
+        CTxDestination dest = DecodeDestination(request.params[0].get_str());
 
-    if (IsValidDestination(dest)) {
-        if (fP2SH)
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Cannot use the p2sh flag with an address - use a script instead");
-        ImportAddress(dest, strLabel, AddressBook::AddressBookPurpose::RECEIVE);
+        if (IsValidDestination(dest)) {
+            if (fP2SH)
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Cannot use the p2sh flag with an address - use a script instead");
+            ImportAddress(dest, strLabel, AddressBook::AddressBookPurpose::RECEIVE);
 
-    } else if (IsHex(request.params[0].get_str())) {
-        std::vector<unsigned char> data(ParseHex(request.params[0].get_str()));
-        ImportScript(CScript(data.begin(), data.end()), strLabel, fP2SH);
+        } else if (IsHex(request.params[0].get_str())) {
+            std::vector<unsigned char> data(ParseHex(request.params[0].get_str()));
+            ImportScript(CScript(data.begin(), data.end()), strLabel, fP2SH);
 
-    } else {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid  address or script");
+        } else {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid  address or script");
+        }
     }
 
     if (fRescan) {
-        pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true);
+        CheckRescanResult(pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true));
         pwalletMain->ReacceptWalletTransactions();
     }
 
@@ -253,19 +262,91 @@ UniValue importpubkey(const JSONRPCRequest& request)
     if (!pubKey.IsFullyValid())
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Pubkey is not a valid public key");
 
-    LOCK2(cs_main, pwalletMain->cs_wallet);
+    {
+        LOCK2(cs_main, pwalletMain->cs_wallet);
 
-    ImportAddress(pubKey.GetID(), strLabel, "receive");
-    ImportScript(GetScriptForRawPubKey(pubKey), strLabel, false);
+        ImportAddress(pubKey.GetID(), strLabel, "receive");
+        ImportScript(GetScriptForRawPubKey(pubKey), strLabel, false);
+    }
 
     if (fRescan) {
-        pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true);
+        CheckRescanResult(pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true));
         pwalletMain->ReacceptWalletTransactions();
     }
 
     return NullUniValue;
 }
 
+UniValue rescanblockchain(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 2)
+        throw std::runtime_error(
+            "rescanblockchain ( start_height stop_height )\n"
+            "\nRescan the local blockchain for wallet related transactions.\n"
+            "\nArguments:\n"
+            "1. start_height    (numeric, optional, default=0) block height where the rescan should start\n"
+            "2. stop_height     (numeric, optional) the last block height that should be scanned. If none is provided it will rescan up to the tip at return time.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"start_height\"     (numeric) The block height where the rescan has started.\n"
+            "  \"stop_height\"      (numeric) The height of the last rescanned block.\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("rescanblockchain", "100000 120000") +
+            HelpExampleRpc("rescanblockchain", "100000, 120000"));
+
+    if (pwalletMain->IsScanning())
+        throw JSONRPCError(RPC_WALLET_ERROR, "Wallet is currently rescanning. Abort existing rescan or wait.");
+
+    CBlockIndex* pindexStart = nullptr;
+    CBlockIndex* pindexStop = nullptr;
+    {
+        LOCK(cs_main);
+        const int nStartHeight = request.params.size() > 0 && !request.params[0].isNull() ? request.params[0].get_int() : 0;
+        if (nStartHeight < 0 || nStartHeight > chainActive.Height())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid start_height");
+        pindexStart = chainActive[nStartHeight];
+
+        if (request.params.size() > 1 && !request.params[1].isNull()) {
+            const int nStopHeight = request.params[1].get_int();
+            if (nStopHeight < 0 || nStopHeight > chainActive.Height())
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid stop_height");
+            if (nStopHeight < nStartHeight)
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "stop_height must be greater than start_height");
+            pindexStop = chainActive[nStopHeight];
+        }
+    }
+
+    const int nResult = pwalletMain->ScanForWalletTransactions(pindexStart, true, false, pindexStop);
+    if (nResult == WALLET_RESCAN_ABORTED)
+        throw JSONRPCError(RPC_MISC_ERROR, "Rescan aborted by user.");
+    CheckRescanResult(nResult);
+
+    UniValue response(UniValue::VOBJ);
+    response.push_back(Pair("start_height", pindexStart->nHeight));
+    LOCK(cs_main);
+    response.push_back(Pair("stop_height", pindexStop ? pindexStop->nHeight : chainActive.Height()));
+    return response;
+}
+
+UniValue abortrescan(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 0)
+        throw std::runtime_error(
+            "abortrescan\n"
+            "\nStops current wallet rescan triggered e.g. by an importprivkey call.\n"
+            "\nResult:\n"
+            "true|false    (boolean) Whether a rescan was running and is now aborting\n"
+            "\nExamples:\n" +
+            HelpExampleCli("abortrescan", "") +
+            HelpExampleRpc("abortrescan", ""));
+
+    if (!pwalletMain->IsScanning())
+        return false;
+    pwalletMain->AbortRescan();
+    return true;
+}
+
 // TODO: Needs further review over the HD flow, staking addresses and multisig import.
 UniValue importwallet(const JSONRPCRequest& request)
 {
@@ -363,8 +444,9 @@ UniValue importwallet(const JSONRPCRequest& request)
         pwalletMain->nTimeFirstKey = nTimeBegin;
 
     LogPrintf("Rescanning last %i blocks\n", chainActive.Height() - pindex->nHeight + 1);
-    pwalletMain->ScanForWalletTransactions(pindex);
+    const int nResult = pwalletMain->ScanForWalletTransactions(pindex);
     pwalletMain->MarkDirty();
+    CheckRescanResult(nResult);
 
     if (!fGood)
         throw JSONRPCError(RPC_WALLET_ERROR, "Error adding some keys to wallet");
@@ -645,7 +727,7 @@ UniValue bip38decrypt(const JSONRPCRequest& request)
 
         // whenever a key is imported, we need to scan the whole chain
         pwalletMain->nTimeFirstKey = 1; // 0 would be considered 'no value'
-        pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true);
+        CheckRescanResult(pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true));
     }
 
     return result;
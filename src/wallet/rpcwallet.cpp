@@ -1385,6 +1385,7 @@ UniValue addmultisigaddress(const JSONRPCRequest& request)
     CScript inner = _createmultisig_redeemScript(request.params);
     CScriptID innerID(inner);
     pwalletMain->AddCScript(inner);
+    pwalletMain->MarkDirty();
 
     pwalletMain->SetAddressBook(innerID, label, AddressBook::AddressBookPurpose::SEND);
     return EncodeDestination(innerID);
@@ -3258,6 +3259,8 @@ extern UniValue importaddress(const JSONRPCRequest& request);
 extern UniValue importpubkey(const JSONRPCRequest& request);
 extern UniValue dumpwallet(const JSONRPCRequest& request);
 extern UniValue importwallet(const JSONRPCRequest& request);
+extern UniValue rescanblockchain(const JSONRPCRequest& request);
+extern UniValue abortrescan(const JSONRPCRequest& request);
 
 const CRPCCommand vWalletRPCCommands[] =
 {       //  category              name                        actor (function)           okSafeMode
@@ -3267,6 +3270,7 @@ const CRPCCommand vWalletRPCCommands[] =
         { "wallet",             "setautocombinethreshold",  &setautocombinethreshold,  false },
         { "wallet",             "getautocombinethreshold",  &getautocombinethreshold,  false },
         {"wallet",              "abandontransaction",       &abandontransaction,       false },
+        { "wallet",             "abortrescan",              &abortrescan,              false },
         { "wallet",             "addmultisigaddress",       &addmultisigaddress,       true  },
         { "wallet",             "backupwallet",             &backupwallet,             true  },
         { "wallet",             "dumpprivkey",              &dumpprivkey,              true  },
@@ -3294,6 +3298,7 @@ const CRPCCommand vWalletRPCCommands[] =
         { "wallet",             "listtransactions",         &listtransactions,         false },
         { "wallet",             "listunspent",              &listunspent,              false },
         { "wallet",             "lockunspent",              &lockunspent,              true  },
+        { "wallet",             "rescanblockchain",         &rescanblockchain,         false },
         { "wallet",             "sendmany",                 &sendmany,                 false },
         { "wallet",             "sendtoaddress",            &sendtoaddress,            false },
         { "wallet",             "settxfee",                 &settxfee,                 true  },
@@ -324,7 +324,7 @@ CBlockIndex* SimpleFakeMine(CWalletTx& wtx, CBlockIndex* pprev = nullptr)
     block.vtx.push_back(wtx);
     block.hashMerkleRoot = BlockMerkleRoot(block);
     if (pprev) block.hashPrevBlock = pprev->GetBlockHash();
-    CBlockIndex* fakeIndex = new CBlockIndex(block);
+    CBlockIndex* fakeIndex = blockIndexArena.New(block);
     fakeIndex->pprev = pprev;
     mapBlockIndex.insert(std::make_pair(block.GetHash(), fakeIndex));
     fakeIndex->phashBlock = &mapBlockIndex.find(block.GetHash())->first;
@@ -335,6 +335,32 @@ CBlockIndex* SimpleFakeMine(CWalletTx& wtx, CBlockIndex* pprev = nullptr)
     return fakeIndex;
 }
 
+/**
+ * Mimic the connection of a block with the given transactions on top of pprev.
+ */
+CBlockIndex* FakeConnectBlock(const std::vector<CWalletTx*>& vwtx, CBlockIndex* pprev)
+{
+    static uint32_t nNonce = 0;
+    CBlock block;
+    for (CWalletTx* pwtx : vwtx)
+        block.vtx.push_back(*pwtx);
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    block.nNonce = nNonce++;        // so blocks with the same parent get different hashes
+    if (pprev) block.hashPrevBlock = pprev->GetBlockHash();
+    CBlockIndex* fakeIndex = blockIndexArena.New(block);
+    fakeIndex->pprev = pprev;
+    fakeIndex->nHeight = pprev ? pprev->nHeight + 1 : 0;
+    mapBlockIndex.insert(std::make_pair(block.GetHash(), fakeIndex));
+    fakeIndex->phashBlock = &mapBlockIndex.find(block.GetHash())->first;
+    chainActive.SetTip(fakeIndex);
+    BOOST_CHECK(chainActive.Contains(fakeIndex));
+    for (size_t i = 0; i < vwtx.size(); i++) {
+        vwtx[i]->SetMerkleBranch(fakeIndex, i);
+        removeTxFromMempool(*vwtx[i]);
+    }
+    return fakeIndex;
+}
+
 void fakeMempoolInsertion(const CWalletTx& wtxCredit)
 {
     CTxMemPoolEntry entry(wtxCredit, 0, 0, 0, 0, false, 0, false, 0);
@@ -471,4 +497,318 @@ BOOST_AUTO_TEST_CASE(cached_balances_tests)
 
 }
 
+void CheckLedger(const CWallet& wallet,
+                 const CAmount& nAvailable,
+                 const CAmount& nUnconfirmed,
+                 const CAmount& nLocked)
+{
+    const CWalletBalances balances = wallet.GetBalances();
+    BOOST_CHECK(balances == wallet.ScanBalances());
+    BOOST_CHECK_EQUAL(balances.nAvailable, nAvailable);
+    BOOST_CHECK_EQUAL(balances.nUnconfirmed, nUnconfirmed);
+    BOOST_CHECK_EQUAL(balances.nLocked, nLocked);
+}
+
+/**
+ * Validates that the balances kept by the wallet follow its events, and
+ * always match a full scan of its transactions.
+ *
+ * 1) Receive balance from an external source in the mempool.
+ * 2) Confirm the receiving tx.
+ * 3) Spend one of its outputs.
+ * 4) Lock the other output, then unlock it.
+ */
+BOOST_AUTO_TEST_CASE(balance_ledger_tests)
+{
+    CAmount nCredit = 20 * COIN;
+
+    // Setup wallet
+    CWallet &wallet = *pwalletMain;
+    LOCK2(cs_main, wallet.cs_wallet);
+    wallet.SetMinVersion(FEATURE_PRE_SPLIT_KEYPOOL);
+    wallet.SetupSPKM(false);
+    CheckLedger(wallet, 0, 0, 0);
+
+    // 1) Receive balance from an external source
+    CTxDestination receivingAddr;
+    BOOST_ASSERT(wallet.getNewAddress(receivingAddr, "receiving_address").result);
+    CTxOut creditOut(nCredit/2, GetScriptForDestination(receivingAddr));
+    CWalletTx& wtxCredit = ReceiveBalanceWith({creditOut, creditOut},wallet);
+    fakeMempoolInsertion(wtxCredit);
+    CheckLedger(wallet, 0, nCredit, 0);
+
+    // 2) Confirm tx and verify
+    SimpleFakeMine(wtxCredit);
+    CheckLedger(wallet, nCredit, 0, 0);
+
+    // 3) Spend one of the two outputs to an external source
+    std::vector<CTxIn> vinDebit = {CTxIn(COutPoint(wtxCredit.GetHash(), 0))};
+    CKey key;
+    key.MakeNewKey(true);
+    std::vector<CTxOut> voutDebit = {CTxOut(nCredit/2, GetScriptForDestination(key.GetPubKey().GetID()))};
+    BuildAndLoadTxToWallet(vinDebit, voutDebit, wallet);
+    CheckLedger(wallet, nCredit/2, 0, 0);
+
+    // 4) Lock and unlock the unspent output
+    COutPoint output(wtxCredit.GetHash(), 1);
+    wallet.LockCoin(output);
+    CheckLedger(wallet, nCredit/2, 0, nCredit/2);
+    wallet.UnlockCoin(output);
+    CheckLedger(wallet, nCredit/2, 0, 0);
+}
+
+/**
+ * Validates that the balances kept by the wallet follow the maturity of the
+ * coinbase and coinstake outputs, which changes only with new tips.
+ *
+ * 1) Receive a coinbase and a coinstake output, and confirm them.
+ * 2) Connect blocks until they mature.
+ */
+BOOST_AUTO_TEST_CASE(balance_ledger_maturity_tests)
+{
+    CAmount nCredit = 20 * COIN;
+    const int nMaturity = Params().GetConsensus().nCoinbaseMaturity + 1;
+
+    // Setup wallet
+    CWallet &wallet = *pwalletMain;
+    LOCK2(cs_main, wallet.cs_wallet);
+    wallet.SetMinVersion(FEATURE_PRE_SPLIT_KEYPOOL);
+    wallet.SetupSPKM(false);
+    CBlockIndex* pindexTip = FakeConnectBlock({}, nullptr);
+    CheckLedger(wallet, 0, 0, 0);
+
+    // 1) Receive a coinbase and a coinstake output and confirm them
+    CTxDestination receivingAddr;
+    BOOST_ASSERT(wallet.getNewAddress(receivingAddr, "receiving_address").result);
+    CTxOut creditOut(nCredit/2, GetScriptForDestination(receivingAddr));
+    CWalletTx& wtxCoinbase = BuildAndLoadTxToWallet({CTxIn()}, {creditOut}, wallet);
+    BOOST_CHECK(wtxCoinbase.IsCoinBase());
+    CTxOut emptyOut;
+    emptyOut.SetEmpty();
+    CWalletTx& wtxCoinstake = BuildAndLoadTxToWallet({CTxIn(COutPoint(InsecureRand256(), 0))}, {emptyOut, creditOut}, wallet);
+    BOOST_CHECK(wtxCoinstake.IsCoinStake());
+    pindexTip = FakeConnectBlock({&wtxCoinbase, &wtxCoinstake}, pindexTip);
+    CheckLedger(wallet, 0, 0, 0);
+    BOOST_CHECK_EQUAL(wallet.GetImmatureBalance(), nCredit);
+
+    // 2) Connect empty blocks, the outputs mature without their transactions being marked dirty
+    for (int nDepth = 2; nDepth <= nMaturity; nDepth++) {
+        pindexTip = FakeConnectBlock({}, pindexTip);
+        BOOST_CHECK_EQUAL(wtxCoinbase.GetDepthInMainChain(), nDepth);
+        const bool fMature = nDepth >= nMaturity;
+        CheckLedger(wallet, fMature ? nCredit : 0, 0, 0);
+        BOOST_CHECK_EQUAL(wallet.GetImmatureBalance(), fMature ? 0 : nCredit);
+    }
+}
+
+/**
+ * Validates that the balances kept by the wallet are rebuilt when the active
+ * chain is reorganized.
+ *
+ * 1) Receive balance from an external source and confirm it.
+ * 2) Reorganize to a longer branch without the receiving tx.
+ * 3) Put the receiving tx back in the mempool, then confirm it on the new branch.
+ */
+BOOST_AUTO_TEST_CASE(balance_ledger_reorg_tests)
+{
+    CAmount nCredit = 20 * COIN;
+
+    // Setup wallet
+    CWallet &wallet = *pwalletMain;
+    LOCK2(cs_main, wallet.cs_wallet);
+    wallet.SetMinVersion(FEATURE_PRE_SPLIT_KEYPOOL);
+    wallet.SetupSPKM(false);
+    CBlockIndex* pindexFork = FakeConnectBlock({}, nullptr);
+    CheckLedger(wallet, 0, 0, 0);
+
+    // 1) Receive balance from an external source and confirm it
+    CTxDestination receivingAddr;
+    BOOST_ASSERT(wallet.getNewAddress(receivingAddr, "receiving_address").result);
+    CTxOut creditOut(nCredit/2, GetScriptForDestination(receivingAddr));
+    CWalletTx& wtxCredit = ReceiveBalanceWith({creditOut, creditOut},wallet);
+    CBlockIndex* pindexOld = FakeConnectBlock({&wtxCredit}, pindexFork);
+    FakeConnectBlock({}, pindexOld);
+    CheckLedger(wallet, nCredit, 0, 0);
+
+    // 2) Reorganize to a longer branch without the receiving tx
+    CBlockIndex* pindexNew = pindexFork;
+    for (int i = 0; i < 3; i++)
+        pindexNew = FakeConnectBlock({}, pindexNew);
+    BOOST_CHECK(!chainActive.Contains(pindexOld));
+    BOOST_CHECK_EQUAL(wtxCredit.GetDepthInMainChain(), 0);
+    CheckLedger(wallet, 0, 0, 0);
+
+    // 3) Back in the mempool, then confirmed on the new branch
+    fakeMempoolInsertion(wtxCredit);
+    CheckLedger(wallet, 0, nCredit, 0);
+    FakeConnectBlock({&wtxCredit}, pindexNew);
+    CheckLedger(wallet, nCredit, 0, 0);
+}
+
+static bool HasCoin(const CWallet& wallet, const COutPoint& outpoint)
+{
+    std::vector<COutput> vCoins;
+    wallet.AvailableCoins(&vCoins);
+    bool fAvailable = false;
+    for (const COutput& out : vCoins)
+        fAvailable |= out.tx->GetHash() == outpoint.hash && (unsigned int) out.i == outpoint.n;
+    BOOST_CHECK_EQUAL(fAvailable, wallet.coinIndex.GetCoin(outpoint) != nullptr);
+    return fAvailable;
+}
+
+/**
+ * Validates that the wallet coin index gives a coin back when its spender
+ * no longer spends it.
+ *
+ * 1) Receive two outputs from an external source and confirm them.
+ * 2) Spend the first one along with an external input, then confirm another
+ *    spend of that external input, which conflicts the spender.
+ * 3) Spend the second one, then abandon the spender.
+ */
+BOOST_AUTO_TEST_CASE(coin_index_spender_tests)
+{
+    CAmount nCredit = 20 * COIN;
+
+    // Setup wallet
+    CWallet &wallet = *pwalletMain;
+    LOCK2(cs_main, wallet.cs_wallet);
+    wallet.SetMinVersion(FEATURE_PRE_SPLIT_KEYPOOL);
+    wallet.SetupSPKM(false);
+    CBlockIndex* pindexTip = FakeConnectBlock({}, nullptr);
+
+    // 1) Receive balance from an external source and confirm it
+    CTxDestination receivingAddr;
+    BOOST_ASSERT(wallet.getNewAddress(receivingAddr, "receiving_address").result);
+    CTxOut creditOut(nCredit/2, GetScriptForDestination(receivingAddr));
+    CWalletTx& wtxCredit = ReceiveBalanceWith({creditOut, creditOut},wallet);
+    pindexTip = FakeConnectBlock({&wtxCredit}, pindexTip);
+    const COutPoint output0(wtxCredit.GetHash(), 0);
+    const COutPoint output1(wtxCredit.GetHash(), 1);
+    BOOST_CHECK(HasCoin(wallet, output0));
+    BOOST_CHECK(HasCoin(wallet, output1));
+
+    // 2) Spend the first output along with an external one, then conflict the spender
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript scriptExternal = GetScriptForDestination(key.GetPubKey().GetID());
+    const COutPoint outputExternal(InsecureRand256(), 0);
+    BuildAndLoadTxToWallet({CTxIn(output0), CTxIn(outputExternal)}, {CTxOut(nCredit/2, scriptExternal)}, wallet);
+    BOOST_CHECK(!HasCoin(wallet, output0));
+
+    CMutableTransaction txConflict;
+    txConflict.vin = {CTxIn(outputExternal)};
+    txConflict.vout = {CTxOut(nCredit/2, scriptExternal)};
+    CWalletTx wtxConflict(&wallet, txConflict);
+    pindexTip = FakeConnectBlock({&wtxConflict}, pindexTip);
+    wallet.SyncTransaction(wtxConflict, pindexTip, 0);
+    BOOST_CHECK(HasCoin(wallet, output0));
+
+    // 3) Spend the second output, then abandon the spender
+    CWalletTx& wtxDebit = BuildAndLoadTxToWallet({CTxIn(output1)}, {CTxOut(nCredit/2, scriptExternal)}, wallet);
+    BOOST_CHECK(!HasCoin(wallet, output1));
+    BOOST_CHECK(wallet.AbandonTransaction(wtxDebit.GetHash()));
+    BOOST_CHECK(HasCoin(wallet, output1));
+}
+
+/**
+ * Validates that the wallet coin index leaves the fully spent transactions in
+ * setWallet until their spends are deeper than the given reorg depth.
+ *
+ * 1) Receive an output from an external source, spend it, and confirm both.
+ * 2) Prune while the spend is not deep enough, then once it is.
+ */
+BOOST_AUTO_TEST_CASE(coin_index_prune_tests)
+{
+    CAmount nCredit = 20 * COIN;
+    const int nMaxReorgDepth = 2;
+
+    // Setup wallet
+    CWallet &wallet = *pwalletMain;
+    LOCK2(cs_main, wallet.cs_wallet);
+    wallet.SetMinVersion(FEATURE_PRE_SPLIT_KEYPOOL);
+    wallet.SetupSPKM(false);
+    CBlockIndex* pindexTip = FakeConnectBlock({}, nullptr);
+
+    // 1) Receive an output, spend it, and confirm both
+    CTxDestination receivingAddr;
+    BOOST_ASSERT(wallet.getNewAddress(receivingAddr, "receiving_address").result);
+    CWalletTx& wtxCredit = ReceiveBalanceWith({CTxOut(nCredit, GetScriptForDestination(receivingAddr))},wallet);
+    pindexTip = FakeConnectBlock({&wtxCredit}, pindexTip);
+    CKey key;
+    key.MakeNewKey(true);
+    CWalletTx& wtxDebit = BuildAndLoadTxToWallet({CTxIn(COutPoint(wtxCredit.GetHash(), 0))}, {CTxOut(nCredit, GetScriptForDestination(key.GetPubKey().GetID()))}, wallet);
+    pindexTip = FakeConnectBlock({&wtxDebit}, pindexTip);
+    BOOST_CHECK(!HasCoin(wallet, COutPoint(wtxCredit.GetHash(), 0)));
+
+    // 2) The spend can still be reorganized out until it is deeper than nMaxReorgDepth
+    for (int nDepth = 1; nDepth <= nMaxReorgDepth; nDepth++) {
+        BOOST_CHECK_EQUAL(wtxDebit.GetDepthInMainChain(), nDepth);
+        wallet.coinIndex.Update(wallet);
+        wallet.coinIndex.PruneSpent(wallet, nMaxReorgDepth);
+        BOOST_CHECK(wallet.setWallet.count(wtxCredit.GetHash()));
+        pindexTip = FakeConnectBlock({}, pindexTip);
+    }
+    wallet.coinIndex.Update(wallet);
+    wallet.coinIndex.PruneSpent(wallet, nMaxReorgDepth);
+    BOOST_CHECK(!wallet.setWallet.count(wtxCredit.GetHash()));
+    BOOST_CHECK(wallet.setWallet.count(wtxDebit.GetHash()));
+    CheckLedger(wallet, 0, 0, 0);
+
+    // a pruned transaction stays out of a rebuilt index
+    wallet.MarkDirty();
+    BOOST_CHECK(!HasCoin(wallet, COutPoint(wtxCredit.GetHash(), 0)));
+    BOOST_CHECK(!wallet.setWallet.count(wtxCredit.GetHash()));
+}
+
+/**
+ * Validates that the wallet coin index is rebuilt after MarkDirty, with what
+ * changed in the wallet without marking its transactions dirty.
+ *
+ * 1) Receive an output to a key the wallet does not have, and confirm it.
+ * 2) Add the key, then mark the wallet dirty.
+ */
+BOOST_AUTO_TEST_CASE(coin_index_dirty_tests)
+{
+    CAmount nCredit = 20 * COIN;
+
+    // Setup wallet
+    CWallet &wallet = *pwalletMain;
+    LOCK2(cs_main, wallet.cs_wallet);
+    wallet.SetMinVersion(FEATURE_PRE_SPLIT_KEYPOOL);
+    wallet.SetupSPKM(false);
+    CBlockIndex* pindexTip = FakeConnectBlock({}, nullptr);
+
+    // 1) Receive an output to a key the wallet does not have yet
+    CKey key;
+    key.MakeNewKey(true);
+    const CKeyID keyID = key.GetPubKey().GetID();
+    CWalletTx& wtxCredit = ReceiveBalanceWith({CTxOut(nCredit, GetScriptForDestination(keyID))},wallet);
+    pindexTip = FakeConnectBlock({&wtxCredit}, pindexTip);
+    const COutPoint output(wtxCredit.GetHash(), 0);
+    BOOST_CHECK(!HasCoin(wallet, output));
+
+    // 2) Add the key, and index the transactions again
+    BOOST_CHECK(wallet.AddKeyPubKey(key, key.GetPubKey()));
+    wallet.MarkDirty();
+    BOOST_CHECK(HasCoin(wallet, output));
+    const CWalletCoin* coin = wallet.coinIndex.GetCoin(output);
+    BOOST_CHECK(coin->mine == ISMINE_SPENDABLE);
+    BOOST_CHECK(coin->fSolvable);
+    BOOST_CHECK(coin->fHasDestination);
+    BOOST_CHECK(coin->destination == CTxDestination(keyID));
+    CheckLedger(wallet, nCredit, 0, 0);
+
+    // 3) Same for a multisig script added as addmultisigaddress does
+    const CScript redeemScript = GetScriptForMultisig(1, {key.GetPubKey()});
+    CWalletTx& wtxMultisig = ReceiveBalanceWith({CTxOut(nCredit, GetScriptForDestination(CScriptID(redeemScript)))},wallet);
+    FakeConnectBlock({&wtxMultisig}, pindexTip);
+    const COutPoint outputMultisig(wtxMultisig.GetHash(), 0);
+    BOOST_CHECK(!HasCoin(wallet, outputMultisig));
+    BOOST_CHECK(wallet.AddCScript(redeemScript));
+    wallet.MarkDirty();
+    BOOST_CHECK(HasCoin(wallet, outputMultisig));
+    BOOST_CHECK(wallet.coinIndex.GetCoin(outputMultisig)->mine == ISMINE_SPENDABLE);
+    CheckLedger(wallet, 2 * nCredit, 0, 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
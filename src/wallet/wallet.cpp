@@ -21,6 +21,8 @@
 #include "util.h"
 #include "utilmoneystr.h"
 
+#include <thread>
+
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
 
@@ -35,6 +37,7 @@ bool bdisableSystemnotifications = false; // Those bubbles can be annoying and s
 bool fSendFreeTransactions = false;
 bool fPayAtLeastCustomFee = true;
 bool bSpendZeroConfChange = DEFAULT_SPEND_ZEROCONF_CHANGE;
+bool fCheckWalletBalances = false;
 
 const char * DEFAULT_WALLET_DAT = "wallet.dat";
 
@@ -561,6 +564,7 @@ bool CWallet::ParameterInteraction()
     }
     nTxConfirmTarget = GetArg("-txconfirmtarget", 1);
     bSpendZeroConfChange = GetBoolArg("-spendzeroconfchange", DEFAULT_SPEND_ZEROCONF_CHANGE);
+    fCheckWalletBalances = GetBoolArg("-checkwalletbalances", Params().DefaultConsistencyChecks());
     bdisableSystemnotifications = GetBoolArg("-disablesystemnotifications", false);
     fSendFreeTransactions = GetBoolArg("-sendfreetransactions", DEFAULT_SEND_FREE_TRANSACTIONS);
 
@@ -615,6 +619,9 @@ void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.insert(std::make_pair(outpoint, wtxid));
     setLockedCoins.erase(outpoint);
+    // the spent transaction has less credit left
+    balanceLedger.MarkDirty(outpoint.hash);
+    coinIndex.MarkDirty(outpoint.hash);
 
     std::pair<TxSpends::iterator, TxSpends::iterator> range;
     range = mapTxSpends.equal_range(outpoint);
@@ -814,6 +821,8 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         for (PAIRTYPE(const uint256, CWalletTx) & item : mapWallet)
             item.second.MarkDirty();
+        balanceLedger.MarkAllDirty();
+        coinIndex.MarkAllDirty();
     }
 }
 
@@ -1097,6 +1106,8 @@ void CWallet::EraseFromWallet(const uint256& hash)
         LOCK(cs_wallet);
         if (mapWallet.erase(hash)) {
             setWallet.erase(hash);
+            balanceLedger.MarkDirty(hash);
+            coinIndex.MarkDirty(hash);
             CWalletDB(strWalletFile).EraseTx(hash);
         }
         LogPrintf("%s: Erased wtx %s from wallet\n", __func__, hash.GetHex());
@@ -1403,57 +1414,294 @@ bool CWallet::Upgrade(std::string& error, const int& prevVersion)
     return true;
 }
 
+bool CWalletScanFilter::IsMine(const CScript& script) const
+{
+    if (setWatchOnly.count(script))
+        return true;
+
+    // Same solutions as ::IsMine, matched against the copied key store
+    std::vector<std::vector<unsigned char> > vSolutions;
+    txnouttype whichType;
+    if (!Solver(script, whichType, vSolutions))
+        return false;
+
+    switch (whichType) {
+    case TX_PUBKEY:
+        return setKeys.count(CPubKey(vSolutions[0]).GetID()) > 0;
+    case TX_PUBKEYHASH:
+        return setKeys.count(CKeyID(uint160(vSolutions[0]))) > 0;
+    case TX_SCRIPTHASH:
+        return setScripts.count(CScriptID(uint160(vSolutions[0]))) > 0;
+    case TX_MULTISIG:
+        for (size_t i = 1; i + 1 < vSolutions.size(); i++) {
+            if (setKeys.count(CPubKey(vSolutions[i]).GetID()))
+                return true;
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+bool CWalletScanFilter::IsRelevant(const CTransaction& tx) const
+{
+    if (setTxids.count(tx.GetHash()))
+        return true;
+    if (!tx.IsCoinBase()) {
+        for (const CTxIn& txin : tx.vin) {
+            // spends a wallet transaction, or conflicts with one
+            if (setTxids.count(txin.prevout.hash) || setSpent.count(txin.prevout))
+                return true;
+        }
+    }
+    for (const CTxOut& txout : tx.vout) {
+        if (IsMine(txout.scriptPubKey))
+            return true;
+    }
+    return false;
+}
+
+size_t CWallet::GetKeyStoreSize() const
+{
+    LOCK(cs_KeyStore);
+    return mapKeys.size() + mapCryptedKeys.size() + mapWatchKeys.size() + mapScripts.size() + setWatchOnly.size();
+}
+
+void CWallet::GetScanFilter(CWalletScanFilter& filter) const
+{
+    AssertLockHeld(cs_wallet);
+    {
+        LOCK(cs_KeyStore);
+        GetKeys(filter.setKeys);
+        for (const auto& item : mapWatchKeys)
+            filter.setKeys.insert(item.first);
+        filter.setScripts.clear();
+        for (const auto& item : mapScripts)
+            filter.setScripts.insert(item.first);
+        filter.setWatchOnly = setWatchOnly;
+        filter.nKeyStoreSize = GetKeyStoreSize();
+    }
+
+    filter.setTxids.clear();
+    filter.setTxids.reserve(mapWallet.size());
+    for (const auto& item : mapWallet)
+        filter.setTxids.insert(item.first);
+    filter.setSpent.clear();
+    for (const auto& item : mapTxSpends)
+        filter.setSpent.insert(item.first);
+    filter.nWalletSize = mapWallet.size() + mapTxSpends.size();
+}
+
+/** Marks the wallet as scanning while in scope, if no other rescan already does */
+class CWalletScanReserver
+{
+private:
+    std::atomic<bool>& fScanning;
+    bool fReserved;
+
+public:
+    explicit CWalletScanReserver(std::atomic<bool>& fScanningIn) : fScanning(fScanningIn)
+    {
+        bool fExpected = false;
+        fReserved = fScanning.compare_exchange_strong(fExpected, true);
+    }
+    ~CWalletScanReserver()
+    {
+        if (fReserved)
+            fScanning = false;
+    }
+    bool IsReserved() const { return fReserved; }
+};
+
+/** Joins its threads when going out of scope, so that they never outlive the batch they read */
+class CWalletScanThreads
+{
+public:
+    std::vector<std::thread> vThreads;
+
+    ~CWalletScanThreads() { Join(); }
+    void Join()
+    {
+        for (std::thread& t : vThreads) {
+            if (t.joinable())
+                t.join();
+        }
+        vThreads.clear();
+    }
+};
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
- * @returns -1 if process was cancelled or the number of tx added to the wallet.
+ * The blocks are read and filtered by several threads, in batches of
+ * WALLET_RESCAN_BATCH_BLOCKS, the locks are only held to apply the matches.
+ * The scan stops after pindexStop, if any, or when aborted.
+ * @returns WALLET_RESCAN_ABORTED if process was cancelled, WALLET_RESCAN_RUNNING
+ * if another rescan is running, or the number of tx added to the wallet.
  */
-int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate, bool fromStartup)
+int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate, bool fromStartup, CBlockIndex* pindexStop)
 {
     int ret = 0;
     int64_t nNow = GetTime();
 
-    const Consensus::Params& consensus = Params().GetConsensus();
+    CWalletScanReserver reserver(fScanningWallet);
+    if (!reserver.IsReserved()) {
+        LogPrintf("%s: A rescan is already running\n", __func__);
+        return WALLET_RESCAN_RUNNING;
+    }
+    fAbortRescan = false;
 
     CBlockIndex* pindex = pindexStart;
+    double dProgressStart;
+    double dProgressTip;
     {
         LOCK2(cs_main, cs_wallet);
 
         // no need to read and scan block, if block was created before
         // our wallet birthday (as adjusted for block time variability)
-        while (pindex && nTimeFirstKey && (pindex->GetBlockTime() < (nTimeFirstKey - 7200)) &&
+        while (pindex && pindex != pindexStop && nTimeFirstKey && (pindex->GetBlockTime() < (nTimeFirstKey - 7200)) &&
                 (pindex->nHeight < 1))
             pindex = chainActive.Next(pindex);
 
         ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
-        double dProgressStart = Checkpoints::GuessVerificationProgress(pindex, false);
-        double dProgressTip = Checkpoints::GuessVerificationProgress(chainActive.Tip(), false);
-        std::set<uint256> setAddedToWallet;
-        while (pindex) {
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
+        dProgressStart = Checkpoints::GuessVerificationProgress(pindex, false);
+        dProgressTip = Checkpoints::GuessVerificationProgress(chainActive.Tip(), false);
+    }
+
+    const int nThreads = std::max(1, nScriptCheckThreads);
+    const int64_t nBatchDelay = GetArg("-rescanbatchdelay", 0);
+    CWalletScanFilter filter;
+    bool fFilter = false;
+    while (pindex) {
+        if (nBatchDelay > 0)
+            MilliSleep(nBatchDelay);
+        if ((fromStartup && ShutdownRequested()) || fAbortRescan) {
+            LogPrintf("%s: Rescan aborted at block %d\n", __func__, pindex->nHeight);
+            ShowProgress(_("Rescanning..."), 100);
+            return WALLET_RESCAN_ABORTED;
+        }
+
+        // The next blocks of the active chain, from the fork if a reorg took the next one out
+        std::vector<CBlockIndex*> vIndex;
+        {
+            LOCK2(cs_main, cs_wallet);
+            if (!chainActive.Contains(pindex)) {
+                const CBlockIndex* pindexFork = chainActive.FindFork(pindex);
+                pindex = pindexFork ? chainActive.Next(pindexFork) : chainActive.Genesis();
+            }
+            for (CBlockIndex* pindexBatch = pindex; pindexBatch && vIndex.size() < WALLET_RESCAN_BATCH_BLOCKS; pindexBatch = chainActive.Next(pindexBatch)) {
+                vIndex.push_back(pindexBatch);
+                if (pindexBatch == pindexStop)
+                    break;
+            }
+            if (vIndex.empty())
+                break;
+
+            if (dProgressTip - dProgressStart > 0.0)
                 ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
 
-            if (fromStartup && ShutdownRequested()) {
-                return -1;
+            // the wallet learns keys and transactions while the locks are released
+            if (!fFilter || filter.nKeyStoreSize != GetKeyStoreSize() || filter.nWalletSize != mapWallet.size() + mapTxSpends.size()) {
+                GetScanFilter(filter);
+                fFilter = true;
             }
+        }
 
-            CBlock block;
-            ReadBlockFromDisk(block, pindex);
-            int posInBlock;
-            for (posInBlock = 0; posInBlock < (int)block.vtx.size(); posInBlock++) {
-                if (AddToWalletIfInvolvingMe(block.vtx[posInBlock], pindex, posInBlock, fUpdate))
-                    ret++;
+        // Read and filter the blocks of the batch in parallel
+        std::vector<CBlock> vBlocks(vIndex.size());
+        std::vector<std::vector<int> > vMatches(vIndex.size());
+        std::vector<char> vRead(vIndex.size(), false);
+        std::atomic<size_t> nNextBlock{0};
+        auto readBlocks = [&]() {
+            for (size_t i = nNextBlock++; i < vIndex.size(); i = nNextBlock++) {
+                vRead[i] = ReadBlockFromDisk(vBlocks[i], vIndex[i]);
+                if (!vRead[i])
+                    continue;
+                for (int posInBlock = 0; posInBlock < (int)vBlocks[i].vtx.size(); posInBlock++) {
+                    if (filter.IsRelevant(vBlocks[i].vtx[posInBlock]))
+                        vMatches[i].push_back(posInBlock);
+                }
             }
+        };
+        {
+            CWalletScanThreads threads;
+            for (int i = 1; i < std::min<int>(nThreads, vIndex.size()); i++)
+                threads.vThreads.emplace_back(readBlocks);
+            readBlocks();
+            threads.Join();
+        }
 
-            pindex = chainActive.Next(pindex);
-            if (GetTime() >= nNow + 60) {
+        // Apply the matches in chain order
+        {
+            LOCK2(cs_main, cs_wallet);
+            // whether the wallet changed only through this batch since the filter was copied
+            const bool fFilterCurrent = filter.nWalletSize == mapWallet.size() + mapTxSpends.size();
+            // what the filter misses once the batch adds to the wallet
+            std::set<uint256> setAddedTxids;
+            std::set<COutPoint> setAddedSpent;
+            bool fKeysAdded = false;
+            for (size_t i = 0; i < vIndex.size(); i++) {
+                CBlockIndex* pindexBlock = vIndex[i];
+                pindex = pindexBlock;
+                if (!chainActive.Contains(pindexBlock))
+                    break;
+                if (!vRead[i])
+                    LogPrintf("%s: Failed to read block %s, skipped\n", __func__, pindexBlock->GetBlockHash().ToString());
+
+                const CBlock& block = vBlocks[i];
+                size_t nMatch = 0;
+                for (int posInBlock = 0; posInBlock < (int)block.vtx.size(); posInBlock++) {
+                    const CTransaction& tx = block.vtx[posInBlock];
+                    const bool fCheckAll = fKeysAdded || !setAddedTxids.empty();
+                    const bool fMatch = nMatch < vMatches[i].size() && vMatches[i][nMatch] == posInBlock;
+                    if (fMatch) {
+                        nMatch++;
+                    } else if (!fCheckAll) {
+                        if (nMatch == vMatches[i].size())
+                            break;
+                        continue;
+                    } else if (!fKeysAdded) {
+                        bool fSpendsAdded = false;
+                        for (const CTxIn& txin : tx.vin) {
+                            if (setAddedTxids.count(txin.prevout.hash) || setAddedSpent.count(txin.prevout)) {
+                                fSpendsAdded = true;
+                                break;
+                            }
+                        }
+                        if (!fSpendsAdded)
+                            continue;
+                    }
+
+                    if (AddToWalletIfInvolvingMe(tx, pindexBlock, posInBlock, fUpdate)) {
+                        ret++;
+                        setAddedTxids.insert(tx.GetHash());
+                        for (const CTxIn& txin : tx.vin)
+                            setAddedSpent.insert(txin.prevout);
+                        // new keys from the keypool, the rest of the batch is checked by the wallet
+                        if (!fKeysAdded && GetKeyStoreSize() != filter.nKeyStoreSize)
+                            fKeysAdded = true;
+                    }
+                }
+                pindex = chainActive.Next(pindexBlock);
+                if (pindexBlock == pindexStop)
+                    pindex = nullptr;
+            }
+
+            // the next batches are filtered with what this one added, new keys copy the filter again
+            if (fFilterCurrent) {
+                filter.setTxids.insert(setAddedTxids.begin(), setAddedTxids.end());
+                filter.setSpent.insert(setAddedSpent.begin(), setAddedSpent.end());
+                filter.nWalletSize = mapWallet.size() + mapTxSpends.size();
+            }
+
+            if (pindex && GetTime() >= nNow + 60) {
                 nNow = GetTime();
                 LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, Checkpoints::GuessVerificationProgress(pindex));
             }
         }
-        ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
     }
+    ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
     return ret;
 }
 
@@ -1644,10 +1892,241 @@ CAmount CWallet::loopTxsBalance(std::function<void(const uint256&, const CWallet
     return nTotal;
 }
 
-CAmount CWallet::GetAvailableBalance() const
+bool CWalletBalances::IsNull() const
+{
+    return *this == CWalletBalances();
+}
+
+CWalletBalances& CWalletBalances::operator+=(const CWalletBalances& other)
+{
+    nAvailable += other.nAvailable;
+    nUnconfirmed += other.nUnconfirmed;
+    nImmature += other.nImmature;
+    nWatchOnly += other.nWatchOnly;
+    nUnconfirmedWatchOnly += other.nUnconfirmedWatchOnly;
+    nImmatureWatchOnly += other.nImmatureWatchOnly;
+    nLocked += other.nLocked;
+    nStakeable += other.nStakeable;
+    return *this;
+}
+
+CWalletBalances& CWalletBalances::operator-=(const CWalletBalances& other)
+{
+    nAvailable -= other.nAvailable;
+    nUnconfirmed -= other.nUnconfirmed;
+    nImmature -= other.nImmature;
+    nWatchOnly -= other.nWatchOnly;
+    nUnconfirmedWatchOnly -= other.nUnconfirmedWatchOnly;
+    nImmatureWatchOnly -= other.nImmatureWatchOnly;
+    nLocked -= other.nLocked;
+    nStakeable -= other.nStakeable;
+    return *this;
+}
+
+bool CWalletBalances::operator==(const CWalletBalances& other) const
+{
+    return nAvailable == other.nAvailable &&
+           nUnconfirmed == other.nUnconfirmed &&
+           nImmature == other.nImmature &&
+           nWatchOnly == other.nWatchOnly &&
+           nUnconfirmedWatchOnly == other.nUnconfirmedWatchOnly &&
+           nImmatureWatchOnly == other.nImmatureWatchOnly &&
+           nLocked == other.nLocked &&
+           nStakeable == other.nStakeable;
+}
+
+std::string CWalletBalances::ToString() const
+{
+    return strprintf("CWalletBalances(available=%s, unconfirmed=%s, immature=%s, watchonly=%s, unconfirmedwatchonly=%s, immaturewatchonly=%s, locked=%s, stakeable=%s)",
+        FormatMoney(nAvailable), FormatMoney(nUnconfirmed), FormatMoney(nImmature), FormatMoney(nWatchOnly),
+        FormatMoney(nUnconfirmedWatchOnly), FormatMoney(nImmatureWatchOnly), FormatMoney(nLocked), FormatMoney(nStakeable));
+}
+
+static int GetStakeMinDepth(int nHeight)
+{
+    const Consensus::Params& consensus = Params().GetConsensus();
+    return consensus.NetworkUpgradeActive(nHeight, Consensus::UPGRADE_STAKE_MIN_DEPTH_V2) ?
+        consensus.nStakeMinDepthV2 :
+        consensus.nStakeMinDepth;
+}
+
+void CWalletBalanceLedger::MarkDirty(const uint256& hash)
+{
+    LOCK(cs_dirty);
+    if (!fAllDirty)
+        setDirty.insert(hash);
+}
+
+void CWalletBalanceLedger::MarkAllDirty()
+{
+    LOCK(cs_dirty);
+    fAllDirty = true;
+    setDirty.clear();
+}
+
+void CWalletBalanceLedger::UpdateTx(const CWallet& wallet, const uint256& hash, int nStableDepth)
+{
+    auto it = mapShares.find(hash);
+    if (it != mapShares.end()) {
+        total -= it->second;
+        mapShares.erase(it);
+    }
+    setUnconfirmed.erase(hash);
+    setMaturing.erase(hash);
+
+    // Same transactions as loopTxsBalance
+    if (!wallet.setWallet.count(hash))
+        return;
+    auto mi = wallet.mapWallet.find(hash);
+    if (mi == wallet.mapWallet.end())
+        return;
+    const CWalletTx& wtx = mi->second;
+
+    // Same conditions as the scans of ScanBalances
+    CWalletBalances share;
+    bool fConflicted;
+    int nTrustedDepth;
+    const bool fTrusted = wtx.IsTrusted(nTrustedDepth, fConflicted);
+    const int nDepth = wtx.GetDepthInMainChain();
+    if (fTrusted) {
+        share.nAvailable = wtx.GetAvailableCredit();
+        share.nWatchOnly = wtx.GetAvailableWatchOnlyCredit();
+        if (nDepth > 0)
+            share.nLocked = wtx.GetLockedCredit();
+        if (nDepth >= nStakeMinDepth)
+            share.nStakeable = wtx.GetAvailableCredit() - wtx.GetLockedCredit();
+    } else if (nDepth == 0 && wtx.InMempool()) {
+        share.nUnconfirmed = wtx.GetAvailableCredit();
+        share.nUnconfirmedWatchOnly = wtx.GetAvailableWatchOnlyCredit();
+    }
+    share.nImmature = wtx.GetImmatureCredit(false);
+    share.nImmatureWatchOnly = wtx.GetImmatureWatchOnlyCredit();
+
+    if (!share.IsNull()) {
+        total += share;
+        mapShares.emplace(hash, share);
+    }
+
+    // The mempool is not followed, the unconfirmed ones are looked at on every update
+    if (nDepth == 0 && !wtx.isAbandoned())
+        setUnconfirmed.insert(hash);
+    else if (nDepth > 0 && nDepth < nStableDepth)
+        setMaturing.insert(hash);
+}
+
+const CWalletBalances& CWalletBalanceLedger::Update(const CWallet& wallet)
 {
+    AssertLockHeld(cs_main);
+    AssertLockHeld(wallet.cs_wallet);
+
+    const int nHeight = chainActive.Height();
+    const uint256 hashTipNew = chainActive.Tip() ? chainActive.Tip()->GetBlockHash() : UINT256_ZERO;
+    const int nStakeMinDepthNew = GetStakeMinDepth(nHeight);
+    const CAmount nCollateralNew = fMasterNode ? CMasternode::GetMasternodeNodeCollateral(nHeight) : 0;
+
+    // Past this depth, a share changes only when its transaction is marked dirty
+    const Consensus::Params& consensus = Params().GetConsensus();
+    const int nStableDepth = std::max(consensus.nCoinbaseMaturity + 1, std::max(consensus.nStakeMinDepth, consensus.nStakeMinDepthV2));
+
+    const bool fNewTip = hashTipNew != hashTip;
+    // A tip that does not extend the previous one took blocks away: depths went down
+    const bool fReorg = fNewTip && nTipHeight >= 0 &&
+        (nTipHeight > nHeight || chainActive[nTipHeight]->GetBlockHash() != hashTip);
+
+    std::set<uint256> setUpdate;
+    bool fRebuild;
+    {
+        LOCK(cs_dirty);
+        fRebuild = fAllDirty || fReorg || nStakeMinDepthNew != nStakeMinDepth || nCollateralNew != nCollateral;
+        fAllDirty = false;
+        setUpdate.swap(setDirty);
+    }
+
+    hashTip = hashTipNew;
+    nTipHeight = nHeight;
+    nStakeMinDepth = nStakeMinDepthNew;
+    nCollateral = nCollateralNew;
+
+    if (fRebuild) {
+        mapShares.clear();
+        setUnconfirmed.clear();
+        setMaturing.clear();
+        total = CWalletBalances();
+        for (const uint256& hash : wallet.setWallet)
+            UpdateTx(wallet, hash, nStableDepth);
+        return total;
+    }
+
+    setUpdate.insert(setUnconfirmed.begin(), setUnconfirmed.end());
+    if (fNewTip)
+        setUpdate.insert(setMaturing.begin(), setMaturing.end());
+    for (const uint256& hash : setUpdate)
+        UpdateTx(wallet, hash, nStableDepth);
+
+    return total;
+}
+
+CWalletBalances CWallet::ScanBalances() const
+{
+    CWalletBalances balances;
     isminefilter filter = ISMINE_SPENDABLE;
-    return GetAvailableBalance(filter, true, 0);
+    balances.nAvailable = GetAvailableBalance(filter, true, 0);
+
+    const int nStakeMinDepth = GetStakeMinDepth(chainActive.Height());
+    balances.nStakeable = loopTxsBalance([nStakeMinDepth](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
+            if (pcoin.IsTrusted() && pcoin.GetDepthInMainChain() >= nStakeMinDepth) {
+                nTotal += pcoin.GetAvailableCredit();       // available coins
+                nTotal -= pcoin.GetLockedCredit();          // minus locked coins, if any
+            }
+    });
+
+    balances.nLocked = loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
+            if (pcoin.IsTrusted() && pcoin.GetDepthInMainChain() > 0)
+                nTotal += pcoin.GetLockedCredit();
+    });
+
+    balances.nUnconfirmed = loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
+            if (!pcoin.IsTrusted() && pcoin.GetDepthInMainChain() == 0 && pcoin.InMempool())
+                nTotal += pcoin.GetAvailableCredit();
+    });
+
+    balances.nImmature = loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
+            nTotal += pcoin.GetImmatureCredit(false);
+    });
+
+    balances.nWatchOnly = loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
+            if (pcoin.IsTrusted())
+                nTotal += pcoin.GetAvailableWatchOnlyCredit();
+    });
+
+    balances.nUnconfirmedWatchOnly = loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
+            if (!pcoin.IsTrusted() && pcoin.GetDepthInMainChain() == 0 && pcoin.InMempool())
+                nTotal += pcoin.GetAvailableWatchOnlyCredit();
+    });
+
+    balances.nImmatureWatchOnly = loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
+            nTotal += pcoin.GetImmatureWatchOnlyCredit();
+    });
+
+    return balances;
+}
+
+CWalletBalances CWallet::GetBalances() const
+{
+    LOCK2(cs_main, cs_wallet);
+    const CWalletBalances balances = balanceLedger.Update(*this);
+    if (fCheckWalletBalances) {
+        const CWalletBalances scanned = ScanBalances();
+        if (!(balances == scanned))
+            LogPrintf("%s: Balances ledger mismatch\n ledger: %s\n scan:   %s\n", __func__, balances.ToString(), scanned.ToString());
+        assert(balances == scanned);
+    }
+    return balances;
+}
+
+CAmount CWallet::GetAvailableBalance() const
+{
+    return GetBalances().nAvailable;
 }
 
 CAmount CWallet::GetAvailableBalance(isminefilter& filter, bool useCache, int minDepth) const
@@ -1663,76 +2142,39 @@ CAmount CWallet::GetAvailableBalance(isminefilter& filter, bool useCache, int mi
 
 CAmount CWallet::GetStakingBalance() const
 {
-    const auto& nHeight = chainActive.Height();
-    const auto& params = Params();
-    const auto& consensus = params.GetConsensus();
-    const auto& nStakeMinDepth = 
-        consensus.NetworkUpgradeActive(nHeight, Consensus::UPGRADE_STAKE_MIN_DEPTH_V2) ?
-        consensus.nStakeMinDepthV2 : 
-        consensus.nStakeMinDepth;
- 
-    return 
-        std::max(
-            CAmount(0), 
-            loopTxsBalance(
-                [nStakeMinDepth](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) 
-                {
-                    if (pcoin.IsTrusted() && pcoin.GetDepthInMainChain() >= nStakeMinDepth) 
-                    {
-                        nTotal += pcoin.GetAvailableCredit();       // available coins
-                        nTotal -= pcoin.GetLockedCredit();          // minus locked coins, if any
-                    }
-                }
-            )
-        );
+    return std::max(CAmount(0), GetBalances().nStakeable);
 }
 
 CAmount CWallet::GetLockedCoins() const
 {
     if (fLiteMode) return 0;
 
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-            if (pcoin.IsTrusted() && pcoin.GetDepthInMainChain() > 0)
-                nTotal += pcoin.GetLockedCredit();
-    });
+    return GetBalances().nLocked;
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-            if (!pcoin.IsTrusted() && pcoin.GetDepthInMainChain() == 0 && pcoin.InMempool())
-                nTotal += pcoin.GetAvailableCredit();
-    });
+    return GetBalances().nUnconfirmed;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-            nTotal += pcoin.GetImmatureCredit(false);
-    });
+    return GetBalances().nImmature;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-            if (pcoin.IsTrusted())
-                nTotal += pcoin.GetAvailableWatchOnlyCredit();
-    });
+    return GetBalances().nWatchOnly;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-            if (!pcoin.IsTrusted() && pcoin.GetDepthInMainChain() == 0 && pcoin.InMempool())
-                nTotal += pcoin.GetAvailableWatchOnlyCredit();
-    });
+    return GetBalances().nUnconfirmedWatchOnly;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-            nTotal += pcoin.GetImmatureWatchOnlyCredit();
-    });
+    return GetBalances().nImmatureWatchOnly;
 }
 
 // Calculate total balance in a different way from GetBalance. The biggest
@@ -1876,6 +2318,131 @@ bool CWallet::GetMasternodeVinAndKeys(CTxIn& txinRet, CPubKey& pubKeyRet, CKey&
             keyRet);
 }
 
+void CWalletCoinIndex::MarkDirty(const uint256& hash)
+{
+    LOCK(cs_dirty);
+    if (!fAllDirty)
+        setDirty.insert(hash);
+}
+
+void CWalletCoinIndex::MarkAllDirty()
+{
+    LOCK(cs_dirty);
+    fAllDirty = true;
+    setDirty.clear();
+}
+
+void CWalletCoinIndex::UpdateTx(const CWallet& wallet, const uint256& hash)
+{
+    mapCoins.erase(hash);
+    setSpent.erase(hash);
+
+    if (!wallet.setWallet.count(hash))
+        return;
+    auto mi = wallet.mapWallet.find(hash);
+    if (mi == wallet.mapWallet.end())
+        return;
+    const CWalletTx& wtx = mi->second;
+
+    bool fMine = false;
+    std::vector<CWalletCoin> vCoins;
+    for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+        const CTxOut& txout = wtx.vout[i];
+        const isminetype mine = wallet.IsMine(txout);
+        if (mine == ISMINE_NO) continue;
+        fMine = true;
+
+        int nSpendDepth;
+        if (wallet.IsSpent(hash, i, nSpendDepth)) continue;
+        if (txout.nValue <= 0) continue;
+
+        CWalletCoin coin;
+        coin.n = i;
+        coin.mine = mine;
+        coin.fSolvable = IsSolvable(wallet, txout.scriptPubKey);
+        coin.fHasDestination = ExtractDestination(txout.scriptPubKey, coin.destination);
+        vCoins.push_back(coin);
+    }
+
+    if (!vCoins.empty())
+        mapCoins.emplace(hash, std::move(vCoins));
+    else if (fMine)
+        setSpent.insert(hash);
+}
+
+void CWalletCoinIndex::Update(const CWallet& wallet)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(wallet.cs_wallet);
+
+    std::set<uint256> setUpdate;
+    bool fRebuild;
+    {
+        LOCK(cs_dirty);
+        fRebuild = fAllDirty;
+        fAllDirty = false;
+        setUpdate.swap(setDirty);
+    }
+
+    if (fRebuild) {
+        mapCoins.clear();
+        setSpent.clear();
+        for (const uint256& hash : wallet.setWallet)
+            UpdateTx(wallet, hash);
+        return;
+    }
+
+    for (const uint256& hash : setUpdate)
+        UpdateTx(wallet, hash);
+}
+
+void CWalletCoinIndex::PruneSpent(const CWallet& wallet, int nMaxReorgDepth)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(wallet.cs_wallet);
+
+    std::vector<uint256> vErase;
+    for (const uint256& hash : setSpent) {
+        auto mi = wallet.mapWallet.find(hash);
+        if (mi == wallet.mapWallet.end())
+            continue;
+        const CWalletTx& wtx = mi->second;
+        int nDepth;
+        if (!CheckTXAvailability(&wtx, true, nDepth) || nDepth <= 0)
+            continue;
+
+        bool fDeeplySpent = true;
+        for (unsigned int i = 0; i < wtx.vout.size() && fDeeplySpent; i++) {
+            if (wallet.IsMine(wtx.vout[i]) == ISMINE_NO) continue;
+            int nSpendDepth;
+            fDeeplySpent = wallet.IsSpent(hash, i, nSpendDepth) && nSpendDepth > nMaxReorgDepth;
+        }
+        if (fDeeplySpent)
+            vErase.push_back(hash);
+    }
+
+    if (vErase.size() > 0) {
+        for (auto& h : vErase) {
+            setSpent.erase(h);
+            wallet.setWallet.erase(h);
+            wallet.balanceLedger.MarkDirty(h);
+        }
+        wallet.setWallet.rehash(0);
+    }
+}
+
+const CWalletCoin* CWalletCoinIndex::GetCoin(const COutPoint& outpoint) const
+{
+    auto it = mapCoins.find(outpoint.hash);
+    if (it == mapCoins.end())
+        return nullptr;
+    for (const CWalletCoin& coin : it->second) {
+        if (coin.n == outpoint.n)
+            return &coin;
+    }
+    return nullptr;
+}
+
 /**
  * populate vCoins with vector of available COutputs.
  */
@@ -1899,11 +2466,11 @@ bool CWallet::AvailableCoins(std::vector<COutput>* pCoins,      // --> populates
 
     LOCK2(cs_main, cs_wallet);
 
-    std::vector<uint256> vErase;
+    coinIndex.Update(*this);
 
-    for (auto it = setWallet.begin(); it != setWallet.end(); ++it) {
+    for (const auto& entry : coinIndex.GetCoins()) {
 
-        const uint256& wtxid = *it;
+        const uint256& wtxid = entry.first;
 
         auto it2 = mapWallet.find(wtxid);
         if(it2 != mapWallet.end()) {
@@ -1917,25 +2484,14 @@ bool CWallet::AvailableCoins(std::vector<COutput>* pCoins,      // --> populates
             // Check min depth requirement for stake inputs
             if (nCoinType == STAKEABLE_COINS && nDepth < nStakeMinDepth) continue;
 
-            int nMine = 0;
-            int nMineSpent = 0;
+            for (const CWalletCoin& coin : entry.second) {
 
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
+                const unsigned int i = coin.n;
+                const isminetype mine = coin.mine;
 
+                // Check if the utxo was spent since it was indexed
                 int nSpendDepth;
-                bool spent = IsSpent(wtxid, i, nSpendDepth);
-                isminetype mine = IsMine(pcoin->vout[i]);
-
-                // Check If not mine
-                if (mine == ISMINE_NO) continue;
-
-                nMine++;
-
-                // Check if the utxo was spent.
-                if (spent) {
-                    if(nSpendDepth > nMaxReorgDepth) nMineSpent++;
-                    continue;
-                }
+                if (IsSpent(wtxid, i, nSpendDepth)) continue;
 
                 // Check for only 10k utxo
                 if (nCoinType == ONLY_10000 && !CMasternode::CheckMasternodeCollateral(pcoin->vout[i].nValue)) continue;
@@ -1949,13 +2505,10 @@ bool CWallet::AvailableCoins(std::vector<COutput>* pCoins,      // --> populates
                 // Skip configured masternode collaterals
                 if (masternodeConfig.contains(COutPoint(wtxid, i)) && nCoinType != ONLY_10000) continue;
 
-                // Check if we should include zero value utxo
-                if (pcoin->vout[i].nValue <= 0) continue;
-
                 if (fCoinsSelected && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(wtxid, i)))
                     continue;
 
-                bool solvable = IsSolvable(*this, pcoin->vout[i].scriptPubKey);
+                bool solvable = coin.fSolvable;
 
                 bool spendable = ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
                         (((mine & ISMINE_WATCH_ONLY) != ISMINE_NO) && (coinControl && coinControl->fAllowWatchOnly && solvable));
@@ -1964,19 +2517,10 @@ bool CWallet::AvailableCoins(std::vector<COutput>* pCoins,      // --> populates
                 if (!pCoins) return true;
                 pCoins->emplace_back(COutput(pcoin, i, nDepth, spendable, solvable));
             }
-
-            if(nDepth > 0 && nMine > 0 && nMine == nMineSpent) {
-                vErase.push_back(wtxid);
-            }
         }
     }
 
-    if(vErase.size() > 0) {
-        for (auto& h : vErase) {
-            setWallet.erase(h);
-        }
-        setWallet.rehash(0);
-    }
+    coinIndex.PruneSpent(*this, nMaxReorgDepth);
 
     return (pCoins && pCoins->size() > 0);
 }
@@ -1989,17 +2533,19 @@ std::map<CTxDestination , std::vector<COutput> > CWallet::AvailableCoinsByAddres
             ALL_COINS,          // coin type
             fConfirmed);        // only confirmed
 
+    LOCK(cs_wallet);
     std::map<CTxDestination, std::vector<COutput> > mapCoins;
     for (COutput& out : vCoins) {
         if (maxCoinValue > 0 && out.tx->vout[out.i].nValue > maxCoinValue)
             continue;
 
-        CTxDestination address;
-        if (!ExtractDestination(out.tx->vout[out.i].scriptPubKey, address)) {
+        // the destination was extracted when the coin was indexed
+        const CWalletCoin* coin = coinIndex.GetCoin(COutPoint(out.tx->GetHash(), out.i));
+        if (!coin || !coin->fHasDestination) {
             continue;
         }
 
-        mapCoins[address].push_back(out);
+        mapCoins[coin->destination].push_back(out);
     }
 
     return mapCoins;
@@ -2542,7 +3088,6 @@ bool CWallet::CreateCoinStake(
 
     // Kernel Search
     CAmount nCredit;
-    CScript scriptPubKeyKernel;
     bool fKernelFound = false;
     int nAttempts = 0;
 
@@ -2552,30 +3097,46 @@ bool CWallet::CreateCoinStake(
     }
     pStakerStatus->SetLastValue(nStakedValue);
 
-    for (const COutput &out : *availableCoins) {
-        CPivStake stakeInput;
-        stakeInput.SetPrevout((CTransaction) *out.tx, out.i);
-
-        //new block came in, move on
-        if (WITH_LOCK(cs_main, return chainActive.Height()) != pindexPrev->nHeight) return false;
+    // The kernel data of the coins is computed once for this tip, the search
+    // keeps pointers to the inputs. The wallet knows the block of each coin,
+    // so no transaction is looked up on disk.
+    std::vector<CPivStake> vStakeInputs(availableCoins->size());
+    CStakeKernelSearch kernelSearch(pindexPrev, nBits);
+    {
+        LOCK(cs_main);
+        for (size_t i = 0; i < availableCoins->size(); i++) {
+            const COutput& out = (*availableCoins)[i];
+            CBlockIndex* pindexFrom = out.tx->GetBlockIndex();
+            if (pindexFrom && !chainActive.Contains(pindexFrom)) pindexFrom = nullptr;
+            vStakeInputs[i].SetPrevout((CTransaction) *out.tx, out.i, pindexFrom);
+            kernelSearch.AddInput(&vStakeInputs[i]);
+        }
+    }
 
+    const uint256 hashPrev = pindexPrev->GetBlockHash();
+    const std::function<bool()> fnInterrupt = [this, &hashPrev]() {
+        // new block came in, move on
+        if (WITH_LOCK(g_best_block_mutex, return g_best_block) != hashPrev) return true;
         // Make sure the wallet is unlocked and shutdown hasn't been requested
-        if (IsLocked() || ShutdownRequested()) return false;
+        return IsLocked() || ShutdownRequested();
+    };
 
-        nCredit = 0;
+    while (!fKernelFound) {
+        if (fnInterrupt()) return false;
 
-        nAttempts++;
-        fKernelFound = Stake(pindexPrev, &stakeInput, nBits, nTxNewTime);
+        const int nCandidate = kernelSearch.Search(nTxNewTime, fnInterrupt);
+        nAttempts += kernelSearch.size();
 
         // update staker status (time, attempts)
-        pStakerStatus->SetLastTime(nTxNewTime);
+        pStakerStatus->SetLastTime(nCandidate < 0 ? kernelSearch.GetLastSlot() : nTxNewTime);
         pStakerStatus->SetLastTries(nAttempts);
 
-        if (!fKernelFound) continue;
+        if (nCandidate < 0) break;
+        CStakeInput& stakeInput = *kernelSearch.GetCandidate(nCandidate).stakeInput;
 
         // Found a kernel
         LogPrintf("CreateCoinStake : kernel found\n");
-        nCredit += stakeInput.GetValue();
+        nCredit = stakeInput.GetValue();
 
         // Add block reward to the credit
         nCredit += CRewards::GetBlockValue(pindexPrev->nHeight + 1);
@@ -2585,6 +3146,7 @@ bool CWallet::CreateCoinStake(
         std::vector<CTxOut> vout;
         if (!stakeInput.CreateTxOuts(this, vout, nCredit - nMasternodeCredit, onlyP2PK)) {
             LogPrintf("%s : failed to create output\n", __func__);
+            kernelSearch.Exclude(nCandidate);
             continue;
         }
         txNew.vout.insert(txNew.vout.end(), vout.begin(), vout.end());
@@ -2616,13 +3178,15 @@ bool CWallet::CreateCoinStake(
         CTxIn in;
         if (!stakeInput.CreateTxIn(this, in, hashTxOut)) {
             LogPrintf("%s : failed to create TxIn\n", __func__);
+            kernelSearch.Exclude(nCandidate);
             txNew.vin.clear();
             txNew.vout.clear();
+            txNew.vout.emplace_back(CTxOut(0, CScript()));
             continue;
         }
         txNew.vin.emplace_back(in);
 
-        break;
+        fKernelFound = true;
     }
     LogPrint(BCLog::STAKING, "%s: attempted staking %d times\n", __func__, nAttempts);
 
@@ -3130,18 +3694,21 @@ void CWallet::LockCoin(const COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.insert(output);
+    balanceLedger.MarkDirty(output.hash);
 }
 
 void CWallet::UnlockCoin(const COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.erase(output);
+    balanceLedger.MarkDirty(output.hash);
 }
 
 void CWallet::UnlockAllCoins()
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.clear();
+    balanceLedger.MarkAllDirty();
 }
 
 bool CWallet::IsLockedCoin(const uint256& hash, unsigned int n) const
@@ -3542,13 +4109,16 @@ std::string CWallet::GetWalletHelpString(bool showDebug)
     strUsage += HelpMessageOpt("-genproclimit=<n>", strprintf(_("Set the number of threads for coin generation if enabled (-1 = all cores, default: %d)"), DEFAULT_GENERATE_PROCLIMIT));
     strUsage += HelpMessageOpt("-minstakesplit=<amt>", strprintf(_("Minimum positive amount (in __DSW__) allowed by GUI and RPC for the stake split threshold (default: %s)"), FormatMoney(DEFAULT_MIN_STAKE_SPLIT_THRESHOLD)));
     strUsage += HelpMessageOpt("-staking=<n>", strprintf(_("Enable staking functionality (0-1, default: %u)"), DEFAULT_STAKING));
+    strUsage += HelpMessageOpt("-stakingthreads=<n>", strprintf(_("Set the number of threads searching for stake kernels (0 = one per core, <0 = leave that many cores free, default: %d)"), DEFAULT_STAKING_THREADS));
     if (showDebug) {
         strUsage += HelpMessageGroup(_("Wallet debugging/testing options:"));
+        strUsage += HelpMessageOpt("-checkwalletbalances", strprintf("Compare the balances kept by the wallet with a full scan of its transactions, and abort on a mismatch (default: %u)", Params().DefaultConsistencyChecks()));
         strUsage += HelpMessageOpt("-dblogsize=<n>", strprintf(_("Flush database activity from memory pool to disk log every <n> megabytes (default: %u)"), DEFAULT_WALLET_DBLOGSIZE));
         strUsage += HelpMessageOpt("-flushwallet", strprintf(_("Run a thread to flush wallet periodically (default: %u)"), DEFAULT_FLUSHWALLET));
         strUsage += HelpMessageOpt("-printcoinstake", _("Display verbose coin stake messages in the debug.log file."));
         strUsage += HelpMessageOpt("-printstakemodifier", _("Display the stake modifier calculations in the debug.log file."));
         strUsage += HelpMessageOpt("-privdb", strprintf(_("Sets the DB_PRIVATE flag in the wallet db environment (default: %u)"), DEFAULT_WALLET_PRIVDB));
+        strUsage += HelpMessageOpt("-rescanbatchdelay=<n>", "Wait <n> milliseconds before each batch of blocks of a wallet rescan, to test the rescans running concurrently (default: 0)");
     }
 
     return strUsage;
@@ -3700,7 +4270,7 @@ CWallet* CWallet::CreateWalletFromFile(const std::string walletFile)
         uiInterface.InitMessage(_("Rescanning..."));
         LogPrintf("Rescanning last %i blocks (from block %i)...\n", chainActive.Height() - pindexRescan->nHeight, pindexRescan->nHeight);
         const int64_t nWalletRescanTime = GetTimeMillis();
-        if (walletInstance->ScanForWalletTransactions(pindexRescan, true, true) == -1) {
+        if (walletInstance->ScanForWalletTransactions(pindexRescan, true, true) == WALLET_RESCAN_ABORTED) {
             UIError(_("Shutdown requested over the txs scan. Exiting."));
             return nullptr;
         }
@@ -3796,6 +4366,17 @@ void CMerkleTx::SetMerkleBranch(const CBlockIndex* pindex, int posInBlock)
     nIndex = posInBlock;
 }
 
+CBlockIndex* CMerkleTx::GetBlockIndex() const
+{
+    if (hashUnset())
+        return nullptr;
+    AssertLockHeld(cs_main);
+
+    // not cached: entries of mapBlockIndex are freed by rewindblockindex
+    BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+    return (mi != mapBlockIndex.end()) ? mi->second : nullptr;
+}
+
 int CMerkleTx::GetDepthInMainChain(bool enableIX) const
 {
     const CBlockIndex* pindexRet;
@@ -3810,17 +4391,12 @@ int CMerkleTx::GetDepthInMainChain(const CBlockIndex*& pindexRet, bool enableIX)
     int nResult;
 
     // Find the block it claims to be in
-    BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
-    if (mi == mapBlockIndex.end()) {
+    CBlockIndex* pindex = GetBlockIndex();
+    if (!pindex || !chainActive.Contains(pindex)) {
         nResult = 0;
     } else {
-        CBlockIndex* pindex = (*mi).second;
-        if (!pindex || !chainActive.Contains(pindex)) {
-            nResult = 0;
-        } else {
-            pindexRet = pindex;
-            nResult = ((nIndex == -1) ? (-1) : 1) * (chainActive.Height() - pindex->nHeight + 1);
-        }
+        pindexRet = pindex;
+        nResult = ((nIndex == -1) ? (-1) : 1) * (chainActive.Height() - pindex->nHeight + 1);
     }
 
     return nResult;
@@ -4125,6 +4701,10 @@ void CWalletTx::MarkDirty()
     m_amounts[AVAILABLE_CREDIT].Reset();
     nChangeCached = 0;
     fChangeCached = false;
+    if (pwallet) {
+        pwallet->balanceLedger.MarkDirty(GetHash());
+        pwallet->coinIndex.MarkDirty(GetHash());
+    }
 }
 
 void CWalletTx::BindWallet(CWallet* pwalletIn)
@@ -54,6 +54,7 @@ extern bool bSpendZeroConfChange;
 extern bool bdisableSystemnotifications;
 extern bool fSendFreeTransactions;
 extern bool fPayAtLeastCustomFee;
+extern bool fCheckWalletBalances;
 
 //! -paytxfee default
 static const CAmount DEFAULT_TRANSACTION_FEE = 0;
@@ -82,6 +83,11 @@ static const unsigned int DEFAULT_GENERATE_PROCLIMIT = 1;
 static const unsigned int DEFAULT_CREATEWALLETBACKUPS = 10;
 //! Default for -disablewallet
 static const bool DEFAULT_DISABLE_WALLET = false;
+//! Blocks read and filtered at once by a wallet rescan, the locks are released between batches
+static const unsigned int WALLET_RESCAN_BATCH_BLOCKS = 64;
+//! Results of a wallet rescan other than the number of transactions added
+static const int WALLET_RESCAN_ABORTED = -1;
+static const int WALLET_RESCAN_RUNNING = -2;
 
 extern const char * DEFAULT_WALLET_DAT;
 
@@ -95,6 +101,7 @@ class CCoinControl;
 class COutput;
 class CReserveKey;
 class CScript;
+class CWallet;
 class CWalletTx;
 class ScriptPubKeyMan;
 
@@ -228,6 +235,129 @@ struct CRecipient
     {}
 };
 
+/** Balances of a wallet, or the share of a single transaction in them */
+struct CWalletBalances
+{
+    CAmount nAvailable{0};
+    CAmount nUnconfirmed{0};
+    CAmount nImmature{0};
+    CAmount nWatchOnly{0};
+    CAmount nUnconfirmedWatchOnly{0};
+    CAmount nImmatureWatchOnly{0};
+    CAmount nLocked{0};
+    //! available minus locked credit of the transactions deep enough to stake
+    CAmount nStakeable{0};
+
+    bool IsNull() const;
+    CWalletBalances& operator+=(const CWalletBalances& other);
+    CWalletBalances& operator-=(const CWalletBalances& other);
+    bool operator==(const CWalletBalances& other) const;
+    std::string ToString() const;
+};
+
+/**
+ * Running sums of the wallet balances, so that reading them does not walk
+ * the whole wallet. The share of a transaction is computed again only when
+ * it is marked dirty (see CWalletTx::MarkDirty), when it is unconfirmed, or,
+ * for the ones not yet mature nor deep enough to stake, on a new tip.
+ * A reorg, or a change of the stake depth or collateral rules, rebuilds it.
+ */
+class CWalletBalanceLedger
+{
+private:
+    //! only protects setDirty and fAllDirty, transactions are marked dirty without cs_wallet
+    RecursiveMutex cs_dirty;
+    std::set<uint256> setDirty;
+    bool fAllDirty{true};
+
+    std::map<uint256, CWalletBalances> mapShares;
+    std::set<uint256> setUnconfirmed;
+    std::set<uint256> setMaturing;
+    CWalletBalances total;
+    uint256 hashTip;
+    int nTipHeight{-1};
+    int nStakeMinDepth{0};
+    CAmount nCollateral{0};
+
+    void UpdateTx(const CWallet& wallet, const uint256& hash, int nStableDepth);
+
+public:
+    void MarkDirty(const uint256& hash);
+    void MarkAllDirty();
+
+    //! Brings the sums up to date with the wallet transactions and the active chain
+    const CWalletBalances& Update(const CWallet& wallet);
+};
+
+/**
+ * What a wallet rescan looks for in the blocks: the keys, redeem scripts and
+ * watch-only scripts of the wallet for the outputs, its transactions and
+ * spent outpoints for the inputs. It is a copy, so that the blocks are
+ * filtered by several threads without the wallet locks. Every transaction
+ * the wallet would add passes it, the ones that pass are checked again by
+ * the wallet.
+ */
+class CWalletScanFilter
+{
+public:
+    std::set<CKeyID> setKeys;
+    std::set<CScriptID> setScripts;
+    std::set<CScript> setWatchOnly;
+    boost::unordered_set<uint256, uint256CheapHasher> setTxids;
+    std::set<COutPoint> setSpent;
+    //! sizes of the key store and of the transactions it was copied from
+    size_t nKeyStoreSize{0};
+    size_t nWalletSize{0};
+
+    bool IsMine(const CScript& script) const;
+    bool IsRelevant(const CTransaction& tx) const;
+};
+
+/** An owned, unspent output of the wallet, with what stays the same until its transaction is marked dirty */
+struct CWalletCoin
+{
+    unsigned int n{0};
+    isminetype mine{ISMINE_NO};
+    bool fSolvable{false};
+    bool fHasDestination{false};
+    CTxDestination destination;
+};
+
+/**
+ * Owned, unspent outputs of the wallet transactions, so that the coins are
+ * enumerated without walking the history nor checking every output again.
+ * A transaction is indexed again when it is marked dirty, as its outputs
+ * are when they get spent. What changes with the chain or the settings,
+ * the depth, the locks and the masternode collaterals, is checked when the
+ * coins are enumerated.
+ */
+class CWalletCoinIndex
+{
+private:
+    //! only protects setDirty and fAllDirty, transactions are marked dirty without cs_wallet
+    RecursiveMutex cs_dirty;
+    std::set<uint256> setDirty;
+    bool fAllDirty{true};
+
+    //! transactions with unspent owned outputs
+    std::map<uint256, std::vector<CWalletCoin> > mapCoins;
+    //! transactions with all their owned outputs spent, left in setWallet until the spends are deep enough
+    std::set<uint256> setSpent;
+
+    void UpdateTx(const CWallet& wallet, const uint256& hash);
+
+public:
+    void MarkDirty(const uint256& hash);
+    void MarkAllDirty();
+
+    //! Indexes again the transactions marked dirty
+    void Update(const CWallet& wallet);
+    //! Removes from setWallet the spent transactions that can no longer be reorganized out of being spent
+    void PruneSpent(const CWallet& wallet, int nMaxReorgDepth);
+
+    const std::map<uint256, std::vector<CWalletCoin> >& GetCoins() const { return mapCoins; }
+    const CWalletCoin* GetCoin(const COutPoint& outpoint) const;
+};
 
 /**
  * A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
@@ -270,6 +400,13 @@ private:
 
     bool IsKeyUsed(const CPubKey& vchPubKey);
 
+    std::atomic<bool> fAbortRescan{false};
+    std::atomic<bool> fScanningWallet{false};
+
+    //! Number of keys, scripts and watch-only scripts, which only grows as the wallet learns them
+    size_t GetKeyStoreSize() const;
+    void GetScanFilter(CWalletScanFilter& filter) const;
+
 
 public:
 
@@ -346,6 +483,8 @@ public:
 
     boost::unordered_map<uint256, CWalletTx, uint256CheapHasher> mapWallet;
     mutable boost::unordered_set<uint256, uint256CheapHasher> setWallet;
+    mutable CWalletBalanceLedger balanceLedger;
+    mutable CWalletCoinIndex coinIndex;
 
     std::list<CAccountingEntry> laccentries;
 
@@ -467,11 +606,16 @@ public:
      */
     bool Upgrade(std::string& error, const int& prevVersion);
 
-    int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false, bool fromStartup = false);
+    int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false, bool fromStartup = false, CBlockIndex* pindexStop = nullptr);
+    void AbortRescan() { fAbortRescan = true; }
+    bool IsScanning() const { return fScanningWallet; }
     void ReacceptWalletTransactions(bool fFirstLoad = false);
     void ResendWalletTransactions(CConnman* connman);
 
     CAmount loopTxsBalance(std::function<void(const uint256&, const CWalletTx&, CAmount&)>method) const;
+    //! Computes every balance with a walk of the wallet, to check the ledger against
+    CWalletBalances ScanBalances() const;
+    CWalletBalances GetBalances() const;
     CAmount GetAvailableBalance() const;
     CAmount GetAvailableBalance(isminefilter& filter, bool useCache = false, int minDepth = 1) const;
     CAmount GetStakingBalance() const;
@@ -740,6 +884,9 @@ public:
 
     void SetMerkleBranch(const CBlockIndex* pIndex, int posInBlock);
 
+    /** Return the index of the block this tx claims to be in (nullptr if none or unknown). Requires cs_main. */
+    CBlockIndex* GetBlockIndex() const;
+
     /**
      * Return depth of transaction in blockchain:
      * <0  : conflicts with a transaction this deep in the blockchain
@@ -4,11 +4,15 @@
 
 #include "zip.h"
 
+#include "crypto/common.h"
 #include "init.h"
 #include "logging.h"
 #include "minizip/unzip.h"
 #include "util.h"
 
+#include <stdexcept>
+#include <string.h>
+
 #include <boost/filesystem.hpp>
 
 namespace fs = boost::filesystem;
@@ -141,3 +145,245 @@ bool CZipWrapper::ExtractZip(
 
     return true;
 }
+
+namespace {
+
+const uint32_t ZIP_LOCAL_HEADER_SIGNATURE = 0x04034b50;
+const uint32_t ZIP_CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+const uint32_t ZIP_END_SIGNATURE = 0x06054b50;
+const uint32_t ZIP_DESCRIPTOR_SIGNATURE = 0x08074b50;
+const uint16_t ZIP_FLAG_ENCRYPTED = 1 << 0;
+const uint16_t ZIP_FLAG_DESCRIPTOR = 1 << 3;
+const uint16_t ZIP_METHOD_STORED = 0;
+const uint16_t ZIP_METHOD_DEFLATED = 8;
+const uint16_t ZIP_EXTRA_ZIP64 = 0x0001;
+const size_t ZIP_STREAM_BUFFER_SIZE = 256 * 1024;
+
+} // anon namespace
+
+CZipStreamReader::CZipStreamReader(const ReadFunc& readIn) :
+    read(readIn),
+    vBuffer(ZIP_STREAM_BUFFER_SIZE),
+    nBufferBegin(0),
+    nBufferEnd(0),
+    nOffset(0),
+    fInEntry(false),
+    nFlags(0),
+    nMethod(0),
+    fZip64(false),
+    nCRC(0),
+    nCompressedSize(0),
+    nSize(0),
+    nCompressedRead(0),
+    nSizeRead(0),
+    nCRCRead(0),
+    fInflating(false)
+{
+    memset(&zs, 0, sizeof(zs));
+}
+
+CZipStreamReader::~CZipStreamReader()
+{
+    if (fInflating) {
+        inflateEnd(&zs);
+    }
+}
+
+bool CZipStreamReader::Fill()
+{
+    if (nBufferBegin > 0) {
+        memmove(vBuffer.data(), vBuffer.data() + nBufferBegin, nBufferEnd - nBufferBegin);
+        nBufferEnd -= nBufferBegin;
+        nBufferBegin = 0;
+    }
+    const size_t nRead = read(vBuffer.data() + nBufferEnd, vBuffer.size() - nBufferEnd);
+    nBufferEnd += nRead;
+    return nRead > 0;
+}
+
+void CZipStreamReader::ReadExact(char* buf, size_t n)
+{
+    while (n > 0) {
+        if (nBufferBegin == nBufferEnd && !Fill()) {
+            throw std::runtime_error("unexpected end of the zip archive");
+        }
+        const size_t nChunk = std::min(n, nBufferEnd - nBufferBegin);
+        memcpy(buf, vBuffer.data() + nBufferBegin, nChunk);
+        nBufferBegin += nChunk;
+        nOffset += nChunk;
+        buf += nChunk;
+        n -= nChunk;
+    }
+}
+
+uint16_t CZipStreamReader::ReadUInt16()
+{
+    unsigned char buf[2];
+    ReadExact((char*)buf, sizeof(buf));
+    return ReadLE16(buf);
+}
+
+uint32_t CZipStreamReader::ReadUInt32()
+{
+    unsigned char buf[4];
+    ReadExact((char*)buf, sizeof(buf));
+    return ReadLE32(buf);
+}
+
+uint64_t CZipStreamReader::ReadUInt64()
+{
+    unsigned char buf[8];
+    ReadExact((char*)buf, sizeof(buf));
+    return ReadLE64(buf);
+}
+
+bool CZipStreamReader::NextEntry(std::string& strNameRet)
+{
+    // Skip what is left of the current entry
+    if (fInEntry) {
+        char buf[4096];
+        while (ReadEntry(buf, sizeof(buf)) > 0) {}
+    }
+
+    const uint32_t nSignature = ReadUInt32();
+    if (nSignature == ZIP_CENTRAL_HEADER_SIGNATURE || nSignature == ZIP_END_SIGNATURE) {
+        return false;
+    }
+    if (nSignature != ZIP_LOCAL_HEADER_SIGNATURE) {
+        throw std::runtime_error("bad zip local header signature");
+    }
+
+    ReadUInt16(); // version needed to extract
+    nFlags = ReadUInt16();
+    nMethod = ReadUInt16();
+    ReadUInt32(); // modification time and date
+    nCRC = ReadUInt32();
+    nCompressedSize = ReadUInt32();
+    nSize = ReadUInt32();
+    const uint16_t nNameLength = ReadUInt16();
+    uint16_t nExtraLength = ReadUInt16();
+
+    strNameRet.assign(nNameLength, '\0');
+    if (nNameLength > 0) {
+        ReadExact(&strNameRet[0], nNameLength);
+    }
+
+    // The zip64 extra field holds the sizes that do not fit in the header
+    fZip64 = false;
+    while (nExtraLength >= 4) {
+        const uint16_t nId = ReadUInt16();
+        const uint16_t nLength = ReadUInt16();
+        nExtraLength -= 4;
+        if (nLength > nExtraLength) {
+            throw std::runtime_error("bad zip extra field");
+        }
+        std::vector<char> vExtra(nLength);
+        ReadExact(vExtra.data(), nLength);
+        nExtraLength -= nLength;
+
+        if (nId == ZIP_EXTRA_ZIP64) {
+            fZip64 = true;
+            size_t nPos = 0;
+            for (uint64_t* pSize : {&nSize, &nCompressedSize}) {
+                if (*pSize != 0xFFFFFFFF) continue;
+                if (nPos + 8 > vExtra.size()) {
+                    throw std::runtime_error("bad zip64 extra field");
+                }
+                *pSize = ReadLE64((const unsigned char*)vExtra.data() + nPos);
+                nPos += 8;
+            }
+        }
+    }
+    std::vector<char> vPadding(nExtraLength);
+    ReadExact(vPadding.data(), nExtraLength);
+
+    if (nFlags & ZIP_FLAG_ENCRYPTED) {
+        throw std::runtime_error("encrypted zip entries are not supported");
+    }
+    if (nMethod == ZIP_METHOD_DEFLATED) {
+        if (fInflating) {
+            inflateReset(&zs);
+        } else if (inflateInit2(&zs, -MAX_WBITS) == Z_OK) {
+            fInflating = true;
+        } else {
+            throw std::runtime_error("failed to initialize zlib");
+        }
+    } else if (nMethod == ZIP_METHOD_STORED) {
+        if (nFlags & ZIP_FLAG_DESCRIPTOR) {
+            throw std::runtime_error("stored zip entries of unknown size are not supported");
+        }
+    } else {
+        throw std::runtime_error("unsupported zip compression method");
+    }
+
+    nCompressedRead = 0;
+    nSizeRead = 0;
+    nCRCRead = crc32(0L, Z_NULL, 0);
+    fInEntry = true;
+    return true;
+}
+
+size_t CZipStreamReader::ReadEntry(char* buf, size_t n)
+{
+    if (!fInEntry) {
+        return 0;
+    }
+
+    size_t nProduced = 0;
+    bool fEnd = false;
+    if (nMethod == ZIP_METHOD_STORED) {
+        nProduced = std::min<uint64_t>(n, nCompressedSize - nCompressedRead);
+        ReadExact(buf, nProduced);
+        nCompressedRead += nProduced;
+        fEnd = nCompressedRead == nCompressedSize;
+    } else {
+        zs.next_out = (Bytef*)buf;
+        zs.avail_out = n;
+        while (zs.avail_out > 0) {
+            if (nBufferBegin == nBufferEnd && !Fill()) {
+                throw std::runtime_error("unexpected end of the zip archive");
+            }
+            zs.next_in = (Bytef*)vBuffer.data() + nBufferBegin;
+            zs.avail_in = nBufferEnd - nBufferBegin;
+            const int ret = inflate(&zs, Z_NO_FLUSH);
+            const size_t nConsumed = (nBufferEnd - nBufferBegin) - zs.avail_in;
+            nBufferBegin += nConsumed;
+            nOffset += nConsumed;
+            nCompressedRead += nConsumed;
+            if (ret == Z_STREAM_END) {
+                fEnd = true;
+                break;
+            }
+            if (ret != Z_OK) {
+                throw std::runtime_error("corrupted zip entry data");
+            }
+        }
+        nProduced = n - zs.avail_out;
+    }
+
+    nSizeRead += nProduced;
+    nCRCRead = crc32(nCRCRead, (const Bytef*)buf, nProduced);
+    if (fEnd) {
+        FinishEntry();
+    }
+    return nProduced;
+}
+
+void CZipStreamReader::FinishEntry()
+{
+    // The sizes and checksum of an entry written as a stream follow its data
+    if (nFlags & ZIP_FLAG_DESCRIPTOR) {
+        uint32_t nValue = ReadUInt32();
+        if (nValue == ZIP_DESCRIPTOR_SIGNATURE) {
+            nValue = ReadUInt32();
+        }
+        nCRC = nValue;
+        nCompressedSize = fZip64 ? ReadUInt64() : ReadUInt32();
+        nSize = fZip64 ? ReadUInt64() : ReadUInt32();
+    }
+    fInEntry = false;
+
+    if (nCompressedRead != nCompressedSize || nSizeRead != nSize || nCRCRead != nCRC) {
+        throw std::runtime_error("zip entry does not match its recorded size or checksum");
+    }
+}
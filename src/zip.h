@@ -5,7 +5,12 @@
 #ifndef ZIP_H
 #define ZIP_H
 
+#include <functional>
+#include <stdint.h>
 #include <string>
+#include <vector>
+
+#include <zlib.h>
 
 class CZipWrapper
 {
@@ -15,4 +20,54 @@ public:
         const std::string& outputPath);
 };
 
+/**
+ * Reads the entries of a zip archive front to back, from the local file
+ * headers, as its bytes arrive from a stream. The central directory at the
+ * end of the archive is never needed. Malformed or unsupported archives
+ * throw std::runtime_error.
+ */
+class CZipStreamReader
+{
+public:
+    /** Reads up to n bytes of the archive into buf, 0 at its end */
+    typedef std::function<size_t(char* buf, size_t n)> ReadFunc;
+
+    explicit CZipStreamReader(const ReadFunc& readIn);
+    ~CZipStreamReader();
+
+    /** Moves to the next entry, skipping the rest of the current one, false at the end of the archive */
+    bool NextEntry(std::string& strNameRet);
+    /** Reads up to n bytes of the current entry, 0 once all were read and checked */
+    size_t ReadEntry(char* buf, size_t n);
+    /** Bytes of the archive consumed so far */
+    uint64_t GetOffset() const { return nOffset; }
+
+private:
+    ReadFunc read;
+    std::vector<char> vBuffer;
+    size_t nBufferBegin;
+    size_t nBufferEnd;
+    uint64_t nOffset;
+
+    bool fInEntry;
+    uint16_t nFlags;
+    uint16_t nMethod;
+    bool fZip64;
+    uint32_t nCRC;
+    uint64_t nCompressedSize;
+    uint64_t nSize;
+    uint64_t nCompressedRead;
+    uint64_t nSizeRead;
+    uint32_t nCRCRead;
+    z_stream zs;
+    bool fInflating;
+
+    bool Fill();
+    void ReadExact(char* buf, size_t n);
+    uint16_t ReadUInt16();
+    uint32_t ReadUInt32();
+    uint64_t ReadUInt64();
+    void FinishEntry();
+};
+
 #endif // ZIP_H
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021-2024 The DECENOMY Core Developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test loading the block index from its snapshot file.
+
+- A node started with -blockindexsnapshot writes the snapshot at shutdown and
+  loads it at the next start.
+- Blocks connected without -blockindexsnapshot leave the snapshot stale, the
+  block index database is loaded instead.
+- A corrupted snapshot is rejected and the block index database is loaded.
+"""
+
+import os
+
+from test_framework.test_framework import PivxTestFramework
+from test_framework.util import assert_equal
+
+class BlockIndexSnapshotTest(PivxTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [["-blockindexsnapshot"]]
+
+    def datadir_path(self, *paths):
+        return os.path.join(self.nodes[0].datadir, "regtest", *paths)
+
+    def restart_and_check(self, extra_args, message=None, corrupt=False):
+        besthash = self.nodes[0].getbestblockhash()
+        blockcount = self.nodes[0].getblockcount()
+        self.stop_node(0)
+        if corrupt:
+            with open(self.datadir_path("blocks", "indexsnapshot.dat"), "r+b") as f:
+                f.seek(100)
+                byte = f.read(1)
+                f.seek(100)
+                f.write(bytes([byte[0] ^ 0xff]))
+        with open(self.datadir_path("debug.log"), encoding="utf-8") as f:
+            log_start = len(f.read())
+        self.start_node(0, extra_args)
+        if message is not None:
+            with open(self.datadir_path("debug.log"), encoding="utf-8") as f:
+                log = f.read()[log_start:]
+            assert message in log, "'%s' not found in the debug log" % message
+        assert_equal(self.nodes[0].getblockcount(), blockcount)
+        assert_equal(self.nodes[0].getbestblockhash(), besthash)
+
+    def run_test(self):
+        self.log.info("Loading the snapshot written at shutdown")
+        self.nodes[0].generate(50)
+        self.restart_and_check(["-blockindexsnapshot"], "51 entries loaded")
+        assert os.path.exists(self.datadir_path("blocks", "indexsnapshot.dat"))
+
+        self.log.info("Ignoring the snapshot after blocks were connected without it")
+        self.restart_and_check([])
+        self.nodes[0].generate(5)
+        self.restart_and_check(["-blockindexsnapshot"], "No snapshot matches the block index database")
+
+        self.log.info("Rejecting a corrupted snapshot")
+        self.nodes[0].generate(5)
+        self.restart_and_check(["-blockindexsnapshot"], "Failed to load", corrupt=True)
+        self.restart_and_check(["-blockindexsnapshot"], "61 entries loaded")
+        assert_equal(self.nodes[0].getblockcount(), 60)
+
+
+if __name__ == '__main__':
+    BlockIndexSnapshotTest().main()
@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021-2024 The DECENOMY Core Developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test applying a bootstrap archive while it is downloaded.
+
+Node 0 mines a chain, its blockchain folders are zipped into a fixture
+archive with a manifest signed with the spork key, and served by a local
+HTTP server. Node 1 bootstraps from it: the first download is cut short,
+the node stops and resumes the download from where the extraction was,
+then verifies every file against the manifest and loads the chain.
+An archive holding a file twice in place of another one of the manifest
+is refused.
+"""
+
+import configparser
+import hashlib
+import http.server
+import os
+import threading
+import zipfile
+
+from test_framework.test_framework import PivxTestFramework, SkipTest
+from test_framework.util import (
+    assert_equal,
+    assert_greater_than,
+    get_datadir_path,
+)
+
+SPORK_KEY = "932HEevBSujW2ud7RfB1YF91AFygbBRQj3de3LyaCRqNzKKgWXi"
+
+class BootstrapServer(http.server.HTTPServer):
+    def __init__(self, files):
+        super().__init__(("127.0.0.1", 0), BootstrapRequestHandler)
+        self.files = files
+        self.cut_next_download = True
+        self.ranges = []
+
+class BootstrapRequestHandler(http.server.BaseHTTPRequestHandler):
+    def do_GET(self):
+        data = self.server.files.get(self.path)
+        if data is None:
+            self.send_error(404)
+            return
+
+        start = 0
+        range_header = self.headers.get("Range")
+        if range_header is not None:
+            start = int(range_header.split("=")[1].split("-")[0])
+            self.server.ranges.append(start)
+            self.send_response(206)
+            self.send_header("Content-Range", "bytes %d-%d/%d" % (start, len(data) - 1, len(data)))
+        else:
+            self.send_response(200)
+        self.send_header("Content-Length", str(len(data) - start))
+        self.end_headers()
+
+        body = data[start:]
+        if self.path.endswith(".zip") and self.server.cut_next_download:
+            # the connection drops half way through
+            self.server.cut_next_download = False
+            body = body[:len(body) // 2]
+            self.close_connection = True
+        self.wfile.write(body)
+
+    def log_message(self, format, *args):
+        pass
+
+class BootstrapTest(PivxTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+
+    def setup_network(self):
+        # Check that __decenomy__ has been built with the bootstrap enabled
+        config = configparser.ConfigParser()
+        if not self.options.configfile:
+            self.options.configfile = os.path.abspath(os.path.join(os.path.dirname(__file__), "../config.ini"))
+        config.read_file(open(self.options.configfile))
+        if not config["components"].getboolean("ENABLE_BOOTSTRAP", fallback=False):
+            raise SkipTest("__decenomy__d has not been built with the bootstrap enabled.")
+
+        self.setup_nodes()
+
+    def make_fixture(self, datadir, duplicate=False):
+        """Zip the blockchain folders, with duplicate the first file is zipped
+        again in place of the last one, which stays in the manifest."""
+        archive = os.path.join(self.options.tmpdir, "bootstrap.zip")
+        entries = []
+        manifest = ""
+        for folder in ["blocks", "chainstate", "sporks"]:
+            for root, _, files in sorted(os.walk(os.path.join(datadir, folder))):
+                for name in sorted(files):
+                    path = os.path.join(root, name)
+                    arcname = os.path.relpath(path, datadir)
+                    entries.append((path, arcname))
+                    with open(path, "rb") as f:
+                        content = f.read()
+                    manifest += "%s %d %s\n" % (hashlib.sha256(content).hexdigest(), len(content), arcname)
+        if duplicate:
+            entries[-1] = entries[0]
+        with zipfile.ZipFile(archive, "w", zipfile.ZIP_DEFLATED) as z:
+            for path, arcname in entries:
+                z.write(path, arcname)
+        with open(archive, "rb") as f:
+            return f.read(), manifest
+
+    def run_test(self):
+        self.log.info("Mining the chain of the bootstrap on node 0")
+        self.nodes[0].generate(30)
+        besthash = self.nodes[0].getbestblockhash()
+        self.stop_node(0)
+
+        archive, manifest = self.make_fixture(os.path.join(get_datadir_path(self.options.tmpdir, 0), "regtest"))
+        archive_dup, _ = self.make_fixture(os.path.join(get_datadir_path(self.options.tmpdir, 0), "regtest"), duplicate=True)
+        self.nodes[1].importprivkey(SPORK_KEY, "spork")
+        address = self.nodes[1].getaddressesbylabel("spork")
+        signature = self.nodes[1].signmessage(list(address)[0], manifest)
+        manifest += "signature %s\n" % signature
+
+        server = BootstrapServer({
+            "/bootstrap.zip": archive,
+            "/bootstrap.zip.manifest": manifest.encode(),
+            "/dup/bootstrap.zip": archive_dup,
+            "/dup/bootstrap.zip.manifest": manifest.encode(),
+        })
+        threading.Thread(target=server.serve_forever, daemon=True).start()
+        url = "http://127.0.0.1:%d/bootstrap.zip" % server.server_address[1]
+        args = ["-bootstrap", "-bootstrapurl=%s" % url]
+
+        self.log.info("Interrupting the download of the bootstrap")
+        self.stop_node(1)
+        self.assert_start_raises_init_error(1, args, "Unable to download and apply the bootstrap file")
+        progress = os.path.join(get_datadir_path(self.options.tmpdir, 1), "regtest", "bootstrap.progress")
+        assert os.path.exists(progress)
+
+        self.log.info("Refusing to resume the bootstrap without its manifest")
+        manifest_data = server.files.pop("/bootstrap.zip.manifest")
+        self.assert_start_raises_init_error(1, ["-bootstrapurl=%s" % url], "Restart with -resync")
+        assert os.path.exists(progress)
+        server.files["/bootstrap.zip.manifest"] = manifest_data
+
+        self.log.info("Resuming the bootstrap on the next start")
+        self.start_node(1, ["-bootstrapurl=%s" % url])
+        assert_equal(len(server.ranges), 1)
+        assert_greater_than(server.ranges[0], 0)
+        assert not os.path.exists(progress)
+        assert_equal(self.nodes[1].getblockcount(), 30)
+        assert_equal(self.nodes[1].getbestblockhash(), besthash)
+
+        self.log.info("Refusing an archive with a duplicated file in place of a missing one")
+        url_dup = "http://127.0.0.1:%d/dup/bootstrap.zip" % server.server_address[1]
+        self.assert_start_raises_init_error(0, ["-bootstrap", "-bootstrapurl=%s" % url_dup], "Unable to download and apply the bootstrap file")
+        with open(os.path.join(get_datadir_path(self.options.tmpdir, 0), "regtest", "debug.log"), encoding="utf-8") as f:
+            assert "is in the archive more than once" in f.read()
+
+        server.shutdown()
+
+
+if __name__ == '__main__':
+    BootstrapTest().main()
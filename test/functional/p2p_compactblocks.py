@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021-2024 The DECENOMY Core Developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test compact block relay.
+
+Node 0 mines, node 1 asks it for high bandwidth relay (new blocks are sent as
+compact blocks straight away), node 2 requests the announced blocks as compact
+blocks. Blocks of transactions that are in the mempool of the receivers are
+rebuilt without a round trip, a transaction they refused to relay is requested
+with getblocktxn.
+"""
+
+from decimal import Decimal
+
+from test_framework.test_framework import PivxTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_greater_than,
+    connect_nodes,
+    sync_blocks,
+    sync_mempools,
+)
+
+class CompactBlocksTest(PivxTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 3
+        # nodes 1 and 2 refuse to relay low fee transactions
+        self.extra_args = [[],
+                           ["-cmpcthighbandwidth=1", "-minrelaytxfee=0.001", "-limitfreerelay=0"],
+                           ["-minrelaytxfee=0.001", "-limitfreerelay=0"]]
+
+    def setup_network(self):
+        self.setup_nodes()
+        connect_nodes(self.nodes[1], 0)
+        connect_nodes(self.nodes[2], 0)
+
+    def bytes_by_msg(self, node):
+        peer = node.getpeerinfo()[0]
+        return peer['bytesrecv_per_msg'], peer['bytessent_per_msg']
+
+    def msg_bytes(self, counts, msg):
+        return counts.get(msg, 0)
+
+    def mine_and_check(self, fRoundTrip):
+        before = [self.bytes_by_msg(node) for node in self.nodes[1:]]
+        self.nodes[0].generate(1)
+        sync_blocks(self.nodes)
+        after = [self.bytes_by_msg(node) for node in self.nodes[1:]]
+
+        for (recv_before, sent_before), (recv_after, sent_after) in zip(before, after):
+            assert_greater_than(self.msg_bytes(recv_after, 'cmpctblock'), self.msg_bytes(recv_before, 'cmpctblock'))
+            assert_equal(self.msg_bytes(recv_after, 'block'), self.msg_bytes(recv_before, 'block'))
+            if fRoundTrip:
+                assert_greater_than(self.msg_bytes(sent_after, 'getblocktxn'), self.msg_bytes(sent_before, 'getblocktxn'))
+                assert_greater_than(self.msg_bytes(recv_after, 'blocktxn'), self.msg_bytes(recv_before, 'blocktxn'))
+            else:
+                assert_equal(self.msg_bytes(sent_after, 'getblocktxn'), self.msg_bytes(sent_before, 'getblocktxn'))
+                assert_equal(self.msg_bytes(recv_after, 'blocktxn'), self.msg_bytes(recv_before, 'blocktxn'))
+
+        # the high bandwidth peer gets the block without asking for it
+        (_, hb_sent_before), (_, hb_sent_after) = before[0], after[0]
+        assert_equal(self.msg_bytes(hb_sent_after, 'getdata'), self.msg_bytes(hb_sent_before, 'getdata'))
+        (_, lb_sent_before), (_, lb_sent_after) = before[1], after[1]
+        assert_greater_than(self.msg_bytes(lb_sent_after, 'getdata'), self.msg_bytes(lb_sent_before, 'getdata'))
+
+    def run_test(self):
+        self.log.info("Mining past the PoS upgrade on node 0")
+        self.nodes[0].generate(260)
+        sync_blocks(self.nodes)
+
+        # node 1 asked node 0 to announce with compact blocks, node 2 did not
+        sendcmpct_size = 24 + 9
+        assert_equal(self.bytes_by_msg(self.nodes[1])[1]['sendcmpct'], 2 * sendcmpct_size)
+        assert_equal(self.bytes_by_msg(self.nodes[2])[1]['sendcmpct'], sendcmpct_size)
+
+        self.log.info("Relaying a block of transactions all in the mempool of the receivers")
+        self.nodes[0].settxfee(Decimal("0.01"))
+        for node in self.nodes[1:]:
+            for _ in range(3):
+                self.nodes[0].sendtoaddress(node.getnewaddress(), 1)
+        sync_mempools(self.nodes)
+        assert_equal(self.nodes[1].getmempoolinfo()['size'], 6)
+        self.mine_and_check(False)
+        assert_equal(self.nodes[1].getmempoolinfo()['size'], 0)
+
+        self.log.info("Relaying a block with a transaction the receivers don't have")
+        self.nodes[0].settxfee(Decimal("0.0002"))
+        txid = self.nodes[0].sendtoaddress(self.nodes[1].getnewaddress(), 1)
+        assert txid in self.nodes[0].getrawmempool()
+        self.mine_and_check(True)
+        assert txid in self.nodes[1].getblock(self.nodes[1].getbestblockhash())['tx']
+
+        self.log.info("Relaying empty blocks")
+        for _ in range(3):
+            self.mine_and_check(False)
+
+
+if __name__ == '__main__':
+    CompactBlocksTest().main()
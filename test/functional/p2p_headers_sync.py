@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021-2024 The DECENOMY Core Developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test headers first block download from several peers.
+
+Node 0 mines a chain past the PoS upgrade. Node 1 syncs it from node 0 alone,
+then nodes 2 and 3 sync it from all the nodes that already have it, so the
+blocks are requested in parallel and may arrive out of order. Node 4 syncs it
+from a P2P connection that answers each getdata in reverse order, so that all
+but the first block of a request are kept until their parent is stored.
+"""
+
+import os
+
+from test_framework.messages import ser_compact_size
+from test_framework.mininode import (
+    P2PInterface,
+    network_thread_start,
+)
+from test_framework.test_framework import PivxTestFramework
+from test_framework.util import (
+    assert_equal,
+    connect_nodes,
+    hex_str_to_bytes,
+    sync_blocks,
+    wait_until,
+)
+
+class msg_raw():
+    """A message sent as already serialized bytes."""
+    def __init__(self, command, data):
+        self.command = command
+        self.data = data
+
+    def serialize(self):
+        return self.data
+
+class ReverseOrderPeer(P2PInterface):
+    """Serves a chain of serialized blocks, sending the blocks of each getdata last first."""
+    def __init__(self, blocks):
+        super().__init__()
+        self.blocks = blocks
+        self.block_by_hash = {}
+        for block_hash, data in blocks:
+            self.block_by_hash[int(block_hash, 16)] = data
+        self.blocks_sent = 0
+
+    def on_getheaders(self, message):
+        headers = ser_compact_size(len(self.blocks))
+        for _, data in self.blocks:
+            version = int.from_bytes(data[:4], "little")
+            header_size = 112 if 3 < version < 7 else 80
+            headers += data[:header_size] + ser_compact_size(0)
+        self.send_message(msg_raw(b"headers", headers))
+
+    def on_getdata(self, message):
+        requested = [inv.hash for inv in message.inv if inv.type == 2 and inv.hash in self.block_by_hash]
+        for block_hash in reversed(requested):
+            self.send_message(msg_raw(b"block", self.block_by_hash[block_hash]))
+            self.blocks_sent += 1
+
+class HeadersSyncTest(PivxTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 5
+
+    def setup_network(self):
+        # the nodes are connected by the test, once there is a chain to sync
+        self.setup_nodes()
+
+    def run_test(self):
+        self.log.info("Mining PoW and PoS blocks on node 0")
+        self.nodes[0].generate(280)
+        height = self.nodes[0].getblockcount()
+        tip = self.nodes[0].getbestblockhash()
+
+        self.log.info("Syncing node 1 from a single peer")
+        connect_nodes(self.nodes[1], 0)
+        sync_blocks(self.nodes[0:2])
+        wait_until(lambda: self.nodes[1].getpeerinfo()[0]['synced_headers'] == height, timeout=30)
+        assert_equal(self.nodes[1].getbestblockhash(), tip)
+
+        self.log.info("Syncing nodes 2 and 3 from several peers")
+        connect_nodes(self.nodes[2], 0)
+        connect_nodes(self.nodes[2], 1)
+        connect_nodes(self.nodes[3], 0)
+        connect_nodes(self.nodes[3], 1)
+        connect_nodes(self.nodes[3], 2)
+        sync_blocks(self.nodes)
+        for node in self.nodes[0:4]:
+            assert_equal(node.getbestblockhash(), tip)
+            assert_equal(node.getblockcount(), height)
+
+        self.log.info("Relaying new blocks to all the peers")
+        self.nodes[3].generate(5)
+        sync_blocks(self.nodes[0:4])
+        assert_equal(self.nodes[0].getblockcount(), height + 5)
+
+        self.log.info("Syncing node 4 from blocks sent in reverse order")
+        height = self.nodes[0].getblockcount()
+        tip = self.nodes[0].getbestblockhash()
+        blocks = []
+        for h in range(1, height + 1):
+            block_hash = self.nodes[0].getblockhash(h)
+            blocks.append((block_hash, hex_str_to_bytes(self.nodes[0].getblock(block_hash, False))))
+        peer = self.nodes[4].add_p2p_connection(ReverseOrderPeer(blocks))
+        network_thread_start()
+        peer.wait_for_verack()
+        wait_until(lambda: self.nodes[4].getbestblockhash() == tip, timeout=120)
+        assert_equal(self.nodes[4].getblockcount(), height)
+        assert peer.blocks_sent >= height
+
+        # at least the blocks of the first request (MAX_BLOCKS_IN_TRANSIT_PER_PEER) but
+        # the last one sent were kept, then stored with their parent, not dropped
+        with open(os.path.join(self.nodes[4].datadir, "regtest", "debug.log"), encoding="utf-8") as f:
+            log = f.read()
+        buffered = log.count("BufferBlockOutOfOrder : buffering block")
+        assert buffered >= 15, "only %d blocks were buffered" % buffered
+        assert "ExpireBlocksOutOfOrder" not in log
+
+
+if __name__ == '__main__':
+    HeadersSyncTest().main()
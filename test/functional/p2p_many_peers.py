@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021-2024 The DECENOMY Core Developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Stress the socket handler with many loopback peers.
+
+For each -socketevents mode, restart the node, open many p2p connections to
+it, and check that all of them complete the handshake and get answers to
+pings sent all at once, then that they are all disconnected.
+
+Run with --peers=<n> to open more connections (the open file limit of the
+system permitting), and --socketevents=<modes> when the build lacks some.
+"""
+
+import time
+
+from test_framework.mininode import (
+    mininode_lock,
+    msg_ping,
+    network_thread_join,
+    network_thread_start,
+    P2PInterface,
+)
+from test_framework.test_framework import PivxTestFramework
+from test_framework.util import (
+    assert_equal,
+    wait_until,
+)
+
+class ManyPeersTest(PivxTestFramework):
+    def add_options(self, parser):
+        parser.add_option("--peers", dest="peers", default=200, type="int",
+                          help="number of p2p connections to open")
+        parser.add_option("--socketevents", dest="socketevents", default="select,poll,epoll",
+                          help="comma separated -socketevents modes to test")
+
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def run_test(self):
+        for mode in self.options.socketevents.split(','):
+            self.stress_peers(mode, self.options.peers)
+
+    def stress_peers(self, mode, num_peers):
+        self.log.info("Testing %d peers with -socketevents=%s" % (num_peers, mode))
+        self.restart_node(0, ["-socketevents=%s" % mode, "-maxconnections=%d" % (num_peers + 50)])
+        node = self.nodes[0]
+
+        start = time.time()
+        peers = [node.add_p2p_connection(P2PInterface()) for _ in range(num_peers)]
+        network_thread_start()
+        for peer in peers:
+            peer.wait_for_verack()
+        self.log.info("%d handshakes in %.2fs" % (num_peers, time.time() - start))
+        assert_equal(len(node.getpeerinfo()), num_peers)
+
+        # All the peers ping together, each pong is pushed by the message
+        # handler and has to wake the socket handler
+        for rnd in range(3):
+            start = time.time()
+            nonce = 1000 + rnd
+            for peer in peers:
+                peer.send_message(msg_ping(nonce=nonce))
+            for peer in peers:
+                wait_until(lambda: peer.last_message.get("pong") and peer.last_message["pong"].nonce == nonce,
+                           timeout=60, lock=mininode_lock)
+            self.log.info("%d pings in %.2fs" % (num_peers, time.time() - start))
+
+        node.disconnect_p2ps()
+        network_thread_join()
+        wait_until(lambda: len(node.getpeerinfo()) == 0, timeout=30)
+
+
+if __name__ == '__main__':
+    ManyPeersTest().main()
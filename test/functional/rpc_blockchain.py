@@ -11,6 +11,7 @@ Test the following RPCs:
     - getbestblockhash
     - getblockhash
     - getblockheader
+    - getmemoryinfo
     - getchaintxstats
     - getnetworkhashps
     - verifychain
@@ -41,6 +42,7 @@ class BlockchainTest(PivxTestFramework):
         #self._test_getblockchaininfo()
         self._test_gettxoutsetinfo()
         self._test_getblockheader()
+        self._test_getmemoryinfo()
         #self._test_getdifficulty()
         self.nodes[0].verifychain(0)
 
@@ -102,6 +104,15 @@ class BlockchainTest(PivxTestFramework):
         #assert isinstance(int(header['versionHex'], 16), int)
         assert isinstance(header['difficulty'], Decimal)
 
+    def _test_getmemoryinfo(self):
+        blockindex = self.nodes[0].getmemoryinfo()['blockindex']
+
+        # the genesis block and the 200 blocks of the cached chain, all in one slab
+        assert_equal(blockindex['entries'], 201)
+        assert_equal(blockindex['slabs'], 1)
+        assert_greater_than_or_equal(blockindex['arena'], blockindex['entries'] * blockindex['entrysize'])
+        assert_equal(blockindex['total'], blockindex['arena'] + blockindex['map'] + blockindex['payeesusage'])
+
     def _test_getdifficulty(self):
         difficulty = self.nodes[0].getdifficulty()
         # 1 hash in 2 should be valid, so difficulty should be 1/2**31
@@ -82,9 +82,11 @@ BASE_SCRIPTS= [
     'wallet_listreceivedby.py',                 # ~ 117 sec
     'mining_pos_fakestake.py',                  # ~ 113 sec
     'feature_reindex.py',                       # ~ 110 sec
+    'feature_blockindexsnapshot.py',            # ~ 40 sec
     'interface_http.py',                        # ~ 105 sec
     'wallet_listtransactions.py',               # ~ 97 sec
     'mempool_reorg.py',                         # ~ 92 sec
+    'p2p_many_peers.py',                        # ~ 90 sec
     'wallet_encryption.py',                     # ~ 89 sec
     'wallet_keypool.py',                        # ~ 88 sec
     'wallet_dump.py',                           # ~ 83 sec
@@ -96,12 +98,16 @@ BASE_SCRIPTS= [
 
     # vv Tests less than 60s vv
     'wallet_labels.py',                         # ~ 57 sec
+    'wallet_rescanblockchain.py',               # ~ 40 sec
+    'feature_bootstrap.py',                     # ~ 35 sec
     'rpc_signmessage.py',                       # ~ 54 sec
     'mempool_resurrect.py',                     # ~ 51 sec
     'mempool_spend_coinbase.py',                # ~ 50 sec
     'rpc_signrawtransaction.py',                # ~ 50 sec
     'rpc_decodescript.py',                      # ~ 50 sec
     'rpc_blockchain.py',                        # ~ 50 sec
+    'p2p_headers_sync.py',                      # ~ 50 sec
+    'p2p_compactblocks.py',                     # ~ 50 sec
     'wallet_disable.py',                        # ~ 50 sec
     'wallet_autocombine.py',                    # ~ 49 sec
     'mining_v5_upgrade.py',                     # ~ 48 sec
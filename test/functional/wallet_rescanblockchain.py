@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021-2024 The DECENOMY Core Developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the rescanblockchain and abortrescan RPCs.
+
+Node 0 pays an address of its own in three blocks, node 1 imports its key
+without a rescan, then rescans part of the chain and the whole of it.
+Node 1 is then restarted with a delay before each batch of blocks, to abort
+a running rescan and to race a second rescan against it.
+"""
+
+import threading
+
+from test_framework.authproxy import JSONRPCException
+from test_framework.test_framework import PivxTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+    get_rpc_proxy,
+    sync_blocks,
+    wait_until,
+)
+
+class RescanThread(threading.Thread):
+    def __init__(self, node):
+        threading.Thread.__init__(self)
+        # a new connection to the node, the same one can't be used from two threads
+        self.node = get_rpc_proxy(node.url, 1, timeout=600, coveragedir=node.coverage_dir)
+        self.result = None
+        self.error = None
+
+    def run(self):
+        try:
+            self.result = self.node.rescanblockchain()
+        except JSONRPCException as e:
+            self.error = e.error
+
+class RescanBlockchainTest(PivxTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+
+    def run_test(self):
+        self.log.info("Paying an address in three blocks")
+        self.nodes[0].generate(110)
+        address = self.nodes[0].getnewaddress()
+        heights = []
+        for _ in range(3):
+            self.nodes[0].sendtoaddress(address, 1)
+            self.nodes[0].generate(5)
+            heights.append(self.nodes[0].getblockcount())
+        sync_blocks(self.nodes)
+
+        self.nodes[1].importprivkey(self.nodes[0].dumpprivkey(address), "", False)
+        assert_equal(len(self.nodes[1].listtransactions()), 0)
+        assert_equal(self.nodes[1].abortrescan(), False)
+
+        self.log.info("Rescanning a height range")
+        result = self.nodes[1].rescanblockchain(0, heights[0])
+        assert_equal(result["start_height"], 0)
+        assert_equal(result["stop_height"], heights[0])
+        assert_equal(len(self.nodes[1].listtransactions()), 1)
+
+        result = self.nodes[1].rescanblockchain(heights[0] + 1, heights[1])
+        assert_equal(result["stop_height"], heights[1])
+        assert_equal(len(self.nodes[1].listtransactions()), 2)
+
+        self.log.info("Rescanning up to the tip")
+        result = self.nodes[1].rescanblockchain()
+        assert_equal(result["start_height"], 0)
+        assert_equal(result["stop_height"], self.nodes[1].getblockcount())
+        assert_equal(len(self.nodes[1].listtransactions()), 3)
+        assert_equal(self.nodes[1].getbalance(), 3)
+
+        self.log.info("Rejecting invalid heights")
+        assert_raises_rpc_error(-8, "Invalid start_height", self.nodes[1].rescanblockchain, -1)
+        assert_raises_rpc_error(-8, "Invalid stop_height", self.nodes[1].rescanblockchain, 0, self.nodes[1].getblockcount() + 1)
+        assert_raises_rpc_error(-8, "stop_height must be greater than start_height", self.nodes[1].rescanblockchain, 10, 5)
+
+        # two batches of blocks, each one waiting a second
+        self.restart_node(1, ["-rescanbatchdelay=1000"])
+
+        self.log.info("Aborting a running rescan")
+        thread = RescanThread(self.nodes[1])
+        thread.start()
+        wait_until(lambda: self.nodes[1].abortrescan(), timeout=30)
+        thread.join()
+        assert_equal(thread.result, None)
+        assert_equal(thread.error["code"], -1)
+        assert_equal(thread.error["message"], "Rescan aborted by user.")
+        assert_equal(self.nodes[1].abortrescan(), False)
+
+        self.log.info("Refusing a second rescan while one is running")
+        threads = [RescanThread(self.nodes[1]) for _ in range(2)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        results = [thread.result for thread in threads if thread.result is not None]
+        errors = [thread.error for thread in threads if thread.error is not None]
+        assert_equal(len(results), 1)
+        assert_equal(results[0]["stop_height"], self.nodes[1].getblockcount())
+        assert_equal(len(errors), 1)
+        assert_equal(errors[0]["code"], -4)
+        assert_equal(errors[0]["message"], "Wallet is currently rescanning. Abort existing rescan or wait.")
+        assert_equal(self.nodes[1].getbalance(), 3)
+
+
+if __name__ == '__main__':
+    RescanBlockchainTest().main()